@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# Load generator for `bible --daemon`
+# Starts --clients processes that each send --requests requests one after another and reports latency
+# Usage: python3 bench/daemon-load.py [--clients N] [--requests N] [--socket PATH]
+import argparse
+import json
+import multiprocessing
+import os
+import random
+import socket
+import time
+
+REFS = ["Genesis 1:1", "John 3:16", "Romans 8:28", "Psalms 23", "1 Corinthians 13:4-7", "Hebrews 11:1"]
+CHAPTERS = [("Genesis", 1), ("John", 3), ("Romans", 8), ("Psalms", 119), ("Revelation", 22)]
+QUERIES = ["grace", "faith", "loved the world", "hosts"]
+
+
+def default_socket():
+    # Same as the daemon's default (see util/daemon-client.c)
+    return os.environ.get("BIBLE_SOCKET") or "/tmp/bible-daemon/bible.sock"
+
+
+def make_request(i):
+    kind = random.choice(["lookup", "lookup", "chapter", "chapter", "search"])
+    if kind == "lookup":
+        return {"id": i, "method": "lookup", "ref": random.choice(REFS)}
+    if kind == "chapter":
+        book, chapter = random.choice(CHAPTERS)
+        return {"id": i, "method": "chapter", "book": book, "chapter": chapter, "raw": True, "titles": True}
+    return {"id": i, "method": "search", "query": random.choice(QUERIES), "limit": 20}
+
+
+def run_client(path, count, results):
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    reader = sock.makefile("rb")
+    latencies = []
+    errors = 0
+
+    for i in range(count):
+        request = make_request(i)
+        start = time.perf_counter()
+        sock.sendall((json.dumps(request) + "\n").encode())
+        response = json.loads(reader.readline())
+        latencies.append((time.perf_counter() - start) * 1000)
+        errors += "error" in response
+
+    sock.close()
+    results.put((latencies, errors))
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--clients", type=int, default=32)
+    parser.add_argument("--requests", type=int, default=500)
+    parser.add_argument("--socket", default=default_socket())
+    args = parser.parse_args()
+
+    results = multiprocessing.Queue()
+    clients = [multiprocessing.Process(target=run_client, args=(args.socket, args.requests, results))
+               for _ in range(args.clients)]
+
+    start = time.perf_counter()
+    for client in clients:
+        client.start()
+
+    latencies, errors = [], 0
+    for _ in clients:
+        client_latencies, client_errors = results.get()
+        latencies += client_latencies
+        errors += client_errors
+
+    for client in clients:
+        client.join()
+    elapsed = time.perf_counter() - start
+
+    print(f"{args.clients} clients, {len(latencies)} requests in {elapsed:.2f} s "
+          f"({len(latencies) / elapsed:.0f} requests/s), {errors} errors")
+    print(f"p50={percentile(latencies, 50):.2f} ms p99={percentile(latencies, 99):.2f} ms max={max(latencies):.2f} ms")
+
+
+if __name__ == "__main__":
+    main()
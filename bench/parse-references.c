@@ -0,0 +1,57 @@
+// Microbenchmark of the reference parser (libbible/reference.c), checking a few results first
+// Usage: make bench/parse-references && ./bench/parse-references [millions of references]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../libbible/bible.h"
+
+static const char *const refs[] =
+{
+    "John 3:16", "1 Cor 13:4-7; Jn 3:16, 18; Ps 23", "Genesis 1:1-2:3", "Rom 3:23; 6:23; 5:8; 10:9-10",
+    "Song of Solomon 2:1", "1Co 15", "Jude 3", "Rev 22:20-21", "Ps 119:105", "Matthew 5-7", "Hebrews"
+};
+#define REF_COUNT (sizeof(refs) / sizeof(refs[0]))
+
+static void print_ranges(const char *text)
+{
+    bible_range ranges[8];
+    int count = bible_parse_references(text, ranges, 8);
+    printf("%-36s", text);
+    for (int i = 0; i < count && i < 8; i++)
+        printf(" %s %i:%i-%i:%i", bible_book_title(BIBLE_REF_BOOK(ranges[i].first)),
+            BIBLE_REF_CHAPTER(ranges[i].first), BIBLE_REF_VERSE(ranges[i].first),
+            BIBLE_REF_CHAPTER(ranges[i].last), BIBLE_REF_VERSE(ranges[i].last));
+    printf(count < 0 ? " (invalid)\n" : "\n");
+}
+
+int main(int argc, char **argv)
+{
+    long total = (argc > 1) ? atof(argv[1]) * 1e6 : 10000000;
+
+    for (size_t i = 0; i < REF_COUNT; i++)
+        print_ranges(refs[i]);
+    print_ranges("Jn 3:16-14");
+    print_ranges("Nothing 1:1");
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Sum of the results, so the work isn't optimized away
+    bible_range ranges[8];
+    unsigned long check = 0, parsed = 0;
+    for (long i = 0; i < total; i++)
+    {
+        const char *text = refs[i % REF_COUNT];
+        int count = bible_parse_references(text, ranges, 8);
+        check += ranges[0].first + count;
+        parsed += count;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%ld references (%lu ranges) in %.3f s: %.1f million references/s, %.0f ns each (check %lu)\n",
+        total, parsed, seconds, total / seconds / 1e6, seconds / total * 1e9, check);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+# Latency benchmark for `bible --serve-stdio`
+# Keeps up to --inflight requests pipelined (sent without waiting for answers) and reports latency per method
+# Usage: python3 bench/serve-stdio.py [--requests N] [--inflight N] [--bible ./bible]
+import argparse
+import json
+import random
+import subprocess
+import threading
+import time
+
+REFS = ["Genesis 1:1", "John 3:16", "Romans 8:28", "Psalms 23", "1 Corinthians 13:4-7", "Hebrews 11:1"]
+CHAPTERS = [("Genesis", 1), ("John", 3), ("Romans", 8), ("Psalms", 119), ("Revelation", 22)]
+QUERIES = ["grace", "faith", "loved the world", "hosts"]
+
+
+def make_request(i):
+    kind = random.choice(["lookup", "lookup", "lookup", "range", "chapter", "search"])
+    if kind == "lookup":
+        return {"id": i, "method": "lookup", "ref": random.choice(REFS)}
+    if kind == "range":
+        book, chapter = random.choice(CHAPTERS)
+        return {"id": i, "method": "range", "book": book, "chapter": chapter, "from": 1, "to": 5}
+    if kind == "chapter":
+        book, chapter = random.choice(CHAPTERS)
+        return {"id": i, "method": "chapter", "book": book, "chapter": chapter}
+    return {"id": i, "method": "search", "query": random.choice(QUERIES), "limit": 20}
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--requests", type=int, default=5000)
+    parser.add_argument("--inflight", type=int, default=16)
+    parser.add_argument("--bible", default="./bible")
+    args = parser.parse_args()
+
+    proc = subprocess.Popen([args.bible, "--serve-stdio"], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            bufsize=0)
+    requests = [make_request(i) for i in range(args.requests)]
+    sent = {}
+    latencies = {}
+    window = threading.Semaphore(args.inflight)
+
+    def write():
+        for request in requests:
+            window.acquire()
+            sent[request["id"]] = time.perf_counter()
+            proc.stdin.write((json.dumps(request) + "\n").encode())
+        proc.stdin.close()
+
+    start = time.perf_counter()
+    writer = threading.Thread(target=write)
+    writer.start()
+
+    errors = 0
+    for line in proc.stdout:
+        now = time.perf_counter()
+        window.release()
+        response = json.loads(line)
+        method = requests[response["id"]]["method"]
+        latencies.setdefault(method, []).append((now - sent[response["id"]]) * 1000)
+        errors += "error" in response
+
+    writer.join()
+    proc.wait()
+    elapsed = time.perf_counter() - start
+
+    print(f"{args.requests} requests in {elapsed:.2f} s ({args.requests / elapsed:.0f} requests/s), {errors} errors")
+    for method, values in sorted(latencies.items()):
+        print(f"{method:8} n={len(values):6} p50={percentile(values, 50):7.2f} ms "
+              f"p99={percentile(values, 99):7.2f} ms max={max(values):7.2f} ms")
+
+
+if __name__ == "__main__":
+    main()
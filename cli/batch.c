@@ -0,0 +1,362 @@
+// Allows open_memstream and getline to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "batch.h"
+#include "../libbible/bible.h"
+#include "../util/reference.h"
+#include "../util/text.h"
+
+// References are read (and their memory reused) this many lines at a time
+#define BATCH_BLOCK 4096
+#define MAX_JOBS 64
+// References a line can have e.g. "Rom 3:23; 6:23; 5:8"
+#define MAX_RANGES 64
+
+// The verses of one chapter a line asks for (a line asks for several chapters e.g. "Gen 1:31-2:2")
+typedef struct
+{
+    // Line they're from, on the line's first lookup only (NULL on the others)
+    char *line;
+    // Book in the translation, and the chapter (0 if the line isn't a reference)
+    char book[40];
+    bible_ref chapter;
+    int verseStart, verseEnd;
+
+    // Output of the lookup (allocated by the worker)
+    char *result;
+    size_t resultLen;
+} Lookup;
+
+// Handed to the workers, which are started once and wait for each block
+typedef struct
+{
+    // Lookups of the current block, sorted by book and chapter
+    Lookup **sorted;
+    size_t count;
+
+    // Next lookup to be taken by a worker, and how many workers haven't run out of lookups yet
+    size_t next;
+    int busy;
+    // Blocks handed out so far, and whether there are no more
+    unsigned long blockCount;
+    bool finished;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready, done;
+} Block;
+
+typedef struct
+{
+    bible_conn *conn;
+    Block *block;
+    pthread_t thread;
+} Worker;
+
+// Names of the books in the translation, found when first needed (on the main thread)
+static char bookNames[BIBLE_BOOK_COUNT + 1][40];
+
+// Add a lookup of each chapter in [range] (of the line [line]) to [*lookups]
+static void add_range(bible_conn *conn, const bible_range *range, char *line, Lookup **lookups, size_t *count, size_t *size)
+{
+    int book = BIBLE_REF_BOOK(range->first);
+    if (bookNames[book][0] == '\0' && !bible_book_name(conn, book, bookNames[book], sizeof(bookNames[book])))
+        snprintf(bookNames[book], sizeof(bookNames[book]), "%s", bible_book_title(book));
+
+    int firstChapter = BIBLE_REF_CHAPTER(range->first), lastChapter = BIBLE_REF_CHAPTER(range->last);
+    if (lastChapter == BIBLE_REF_END)
+        lastChapter = bible_chapter_count(conn, range->first);
+
+    for (int chapter = firstChapter; chapter <= lastChapter; chapter++)
+    {
+        if (*count == *size)
+        {
+            *size *= 2;
+            *lookups = realloc(*lookups, *size * sizeof(Lookup));
+        }
+
+        Lookup *lookup = &(*lookups)[(*count)++];
+        *lookup = (Lookup) {
+            .line = line,
+            .chapter = BIBLE_REF(book, chapter, 0),
+            .verseStart = (chapter == firstChapter) ? BIBLE_REF_VERSE(range->first) : 1,
+            .verseEnd = (chapter == lastChapter && BIBLE_REF_VERSE(range->last) != BIBLE_REF_END) ? BIBLE_REF_VERSE(range->last) : 0
+        };
+        snprintf(lookup->book, sizeof(lookup->book), "%s", bookNames[book]);
+        line = NULL;
+    }
+
+    free(line);
+}
+
+static int compare_lookups(const void *a, const void *b)
+{
+    const Lookup *l1 = *(const Lookup**) a, *l2 = *(const Lookup**) b;
+
+    if (l1->chapter != l2->chapter)
+        return (l1->chapter < l2->chapter) ? -1 : 1;
+
+    // Keep the input order within a chapter
+    return (l1 < l2) ? -1 : (l1 > l2);
+}
+
+// Look up the verses of each lookup in [group] (of [groupLen] in the same chapter)
+static void look_up_chapter(Worker *worker, Lookup **group, size_t groupLen)
+{
+    // Unknown books have nothing to read
+    if (group[0]->chapter == 0)
+        return;
+
+    bible_passage *passage = bible_get_passage(worker->conn, group[0]->chapter, group[0]->chapter | BIBLE_REF_END);
+    if (passage == NULL)
+        return;
+
+    // Give each lookup in the group the verses it asked for
+    for (size_t i = 0; i < groupLen; i++)
+    {
+        Lookup *lookup = group[i];
+        FILE *out = open_memstream(&lookup->result, &lookup->resultLen);
+
+        for (size_t v = 0; v < passage->count; v++)
+        {
+            const bible_verse *verse = &passage->verses[v];
+            if (verse->verse < lookup->verseStart || (lookup->verseEnd > 0 && verse->verse > lookup->verseEnd))
+                continue;
+
+            fprintf(out, "%s %i:%i\t", lookup->book, BIBLE_REF_CHAPTER(lookup->chapter), verse->verse);
+            print_verse_text(out, verse->text, false);
+            fputc('\n', out);
+        }
+
+        fclose(out);
+    }
+
+    bible_passage_free(passage);
+}
+
+static void *worker_run(void *arg)
+{
+    Worker *worker = arg;
+    Block *block = worker->block;
+    unsigned long blocksDone = 0;
+
+    pthread_mutex_lock(&block->lock);
+    while (true)
+    {
+        while (block->blockCount == blocksDone && !block->finished)
+            pthread_cond_wait(&block->ready, &block->lock);
+        if (block->blockCount == blocksDone)
+            break;
+
+        // Take the next whole chapter, so each chapter is only read once
+        while (block->next < block->count)
+        {
+            size_t start = block->next, end = start;
+            while (end < block->count
+                && block->sorted[end]->chapter == block->sorted[start]->chapter)
+                end++;
+            block->next = end;
+
+            pthread_mutex_unlock(&block->lock);
+            look_up_chapter(worker, &block->sorted[start], end - start);
+            pthread_mutex_lock(&block->lock);
+        }
+
+        blocksDone = block->blockCount;
+        if (--block->busy == 0)
+            pthread_cond_signal(&block->done);
+    }
+    pthread_mutex_unlock(&block->lock);
+
+    return NULL;
+}
+
+// Look up every reference in [lookups] and print them in input order
+static size_t run_block(Lookup *lookups, size_t count, Block *block, int jobs)
+{
+    Lookup *sorted[count];
+    for (size_t i = 0; i < count; i++)
+        sorted[i] = &lookups[i];
+    qsort(sorted, count, sizeof(Lookup*), &compare_lookups);
+
+	// Wake the workers, and wait until they've all run out of lookups
+    pthread_mutex_lock(&block->lock);
+    block->sorted = sorted, block->count = count, block->next = 0;
+    block->busy = jobs;
+    block->blockCount++;
+    pthread_cond_broadcast(&block->ready);
+    while (block->busy > 0)
+        pthread_cond_wait(&block->done, &block->lock);
+    pthread_mutex_unlock(&block->lock);
+
+	// Lines with verses that weren't found
+    size_t notFound = 0, line = 0, lastNotFound = SIZE_MAX;
+    for (size_t i = 0; i < count; i++)
+    {
+        Lookup *lookup = &lookups[i];
+        line += (lookup->line != NULL);
+        bool wholeLine = lookup->line != NULL && (i + 1 == count || lookups[i + 1].line != NULL);
+
+        // Nothing was found, so print the reference with empty text (keeps the output line-aligned): the line
+        // if it's all of it, or the chapter's verses
+        if (lookup->result == NULL || lookup->resultLen == 0)
+        {
+            if (wholeLine)
+                printf("%s\t\n", lookup->line);
+            else if (lookup->verseStart > 1 || lookup->verseEnd > 0)
+                printf("%s %i:%i\t\n", lookup->book, BIBLE_REF_CHAPTER(lookup->chapter), lookup->verseStart);
+            else
+                printf("%s %i\t\n", lookup->book, BIBLE_REF_CHAPTER(lookup->chapter));
+            notFound += (lastNotFound != line);
+            lastNotFound = line;
+        }
+        else
+            fwrite(lookup->result, 1, lookup->resultLen, stdout);
+
+        free(lookup->result);
+        free(lookup->line);
+    }
+
+    fflush(stdout);
+
+    return notFound;
+}
+
+int batch_mode(int argCount, char **args)
+{
+    const char *translation = NULL;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = strtol(args[++i], NULL, 10);
+        else
+        {
+            fprintf(stderr, "bible: usage: bible --batch [--translation NAME] [--jobs N] < references\n");
+            return 2;
+        }
+    }
+
+    if (jobs < 1) jobs = 1;
+    if (jobs > MAX_JOBS) jobs = MAX_JOBS;
+
+    bible_ctx *ctx = bible_ctx_new("db");
+    if (translation == NULL)
+        translation = bible_translation_name(ctx, 0);
+
+    // The main connection resolves book names
+    bible_conn *conn = bible_conn_open(ctx, translation);
+    if (conn == NULL)
+    {
+        fprintf(stderr, "bible: couldn't open translation \"%s\"\n", translation);
+        bible_ctx_free(ctx);
+        return 1;
+    }
+
+    // One connection and thread per worker, which wait for each block
+    Block block = { 0 };
+    pthread_mutex_init(&block.lock, NULL);
+    pthread_cond_init(&block.ready, NULL);
+    pthread_cond_init(&block.done, NULL);
+
+    Worker workers[MAX_JOBS];
+    int started = 0;
+    for (; started < jobs; started++)
+    {
+        Worker *worker = &workers[started];
+        worker->block = &block;
+        worker->conn = bible_conn_open(ctx, translation);
+        if (worker->conn == NULL)
+        {
+            fprintf(stderr, "bible: couldn't open translation \"%s\"\n", translation);
+            break;
+        }
+
+        if (pthread_create(&worker->thread, NULL, &worker_run, worker) != 0)
+        {
+            fprintf(stderr, "bible: couldn't start worker %i\n", started + 1);
+            bible_conn_close(worker->conn);
+            break;
+        }
+    }
+    jobs = started;
+
+    size_t size = BATCH_BLOCK, count = 0, lineCount = 0, total = 0, notFound = 0;
+    Lookup *lookups = malloc(size * sizeof(Lookup));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char *line = NULL;
+    size_t lineSize = 0;
+    ssize_t lineLen;
+    while (jobs > 0 && (lineLen = getline(&line, &lineSize, stdin)) != -1)
+    {
+        // Remove the new line
+        if (lineLen > 0 && line[lineLen - 1] == '\n')
+            line[--lineLen] = '\0';
+
+        bible_range ranges[MAX_RANGES];
+        int rangeCount = parse_references(conn, line, ranges, MAX_RANGES);
+        if (rangeCount > MAX_RANGES)
+            fprintf(stderr, "bible: \"%s\" has more than %i references\n", line, MAX_RANGES);
+
+        // Every chapter of every reference, or the line with nothing found if it isn't (all) one
+        size_t lineStart = count;
+        for (int i = 0; rangeCount <= MAX_RANGES && i < rangeCount; i++)
+            add_range(conn, &ranges[i], (count == lineStart) ? strdup(line) : NULL, &lookups, &count, &size);
+        if (count == lineStart)
+        {
+            if (count == size)
+                lookups = realloc(lookups, (size *= 2) * sizeof(Lookup));
+            lookups[count++] = (Lookup) { .line = strdup(line) };
+        }
+
+        if (++lineCount == BATCH_BLOCK)
+        {
+            notFound += run_block(lookups, count, &block, jobs);
+            total += lineCount, lineCount = count = 0;
+        }
+    }
+
+    if (lineCount > 0)
+    {
+        notFound += run_block(lookups, count, &block, jobs);
+        total += lineCount;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    fprintf(stderr, "bible: %zu references (%zu not found) in %.3f s, %.0f references/s\n",
+        total, notFound, seconds, (seconds > 0) ? total / seconds : 0.0);
+
+    pthread_mutex_lock(&block.lock);
+    block.finished = true;
+    pthread_cond_broadcast(&block.ready);
+    pthread_mutex_unlock(&block.lock);
+
+    for (int i = 0; i < jobs; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        bible_conn_close(workers[i].conn);
+    }
+    pthread_cond_destroy(&block.ready);
+    pthread_cond_destroy(&block.done);
+    pthread_mutex_destroy(&block.lock);
+
+    free(line);
+    free(lookups);
+    bible_conn_close(conn);
+    bible_ctx_free(ctx);
+
+    return 0;
+}
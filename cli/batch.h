@@ -0,0 +1,3 @@
+// bible --batch [--translation NAME] [--jobs N]
+// Read one reference per line from stdin and print the verses in input order (returns the exit code)
+int batch_mode(int argCount, char **args);
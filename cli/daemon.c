@@ -0,0 +1,475 @@
+// Allows open_memstream and accept4 to work
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "daemon.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "rpc.h"
+#include "../util/daemon-client.h"
+
+#define MAX_JOBS 64
+#define MAX_EVENTS 64
+// Group whose users may use the daemon, if there's one (see --group)
+#define DAEMON_GROUP "bible"
+// Longest request line accepted from a client
+#define MAX_REQUEST 4096
+
+typedef struct
+{
+    int fd;
+
+    // Bytes read but not yet split into lines (only touched by the event loop)
+    char in[MAX_REQUEST];
+    size_t inLen;
+
+    // Responses waiting to be sent (shared with the workers)
+    char *out;
+    size_t outLen, outSize;
+    // Requests being answered
+    int pending;
+    // The client hung up
+    bool closing;
+    pthread_mutex_t lock;
+} Client;
+
+typedef struct Job
+{
+    Client *client;
+    char *line;
+    struct Job *next;
+} Job;
+
+static bible_ctx *ctx = NULL;
+static int epollFd = -1;
+// Workers tell the event loop that a closing client has no more requests through this pipe
+static int wakePipe[2];
+
+static Job *queueHead = NULL, *queueTail = NULL;
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueReady = PTHREAD_COND_INITIALIZER;
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig)
+{
+    (void) sig;
+    running = 0;
+}
+
+static void push_job(Client *client, char *line)
+{
+    Job *job = malloc(sizeof(Job));
+    job->client = client, job->line = line, job->next = NULL;
+
+    pthread_mutex_lock(&queueLock);
+    if (queueTail != NULL)
+        queueTail->next = job;
+    else
+        queueHead = job;
+    queueTail = job;
+    pthread_cond_signal(&queueReady);
+    pthread_mutex_unlock(&queueLock);
+}
+
+static Job *pop_job(void)
+{
+    pthread_mutex_lock(&queueLock);
+    while (queueHead == NULL)
+        pthread_cond_wait(&queueReady, &queueLock);
+
+    Job *job = queueHead;
+    queueHead = job->next;
+    if (queueHead == NULL)
+        queueTail = NULL;
+    pthread_mutex_unlock(&queueLock);
+
+    return job;
+}
+
+// Send as much of the queued output as the socket takes (lock must be held)
+// Returns false if the client can't be written to anymore
+static bool flush_client(Client *client)
+{
+    size_t sent = 0;
+    while (sent < client->outLen)
+    {
+        ssize_t n = send(client->fd, client->out + sent, client->outLen - sent, MSG_NOSIGNAL);
+        if (n > 0)
+            sent += n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        else
+        {
+            client->outLen = 0;
+            return false;
+        }
+    }
+
+    memmove(client->out, client->out + sent, client->outLen - sent);
+    client->outLen -= sent;
+
+    // Wait for the socket to be writable if there's more to send
+    struct epoll_event event = { .events = EPOLLIN | (client->outLen > 0 ? EPOLLOUT : 0), .data.ptr = client };
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, client->fd, &event);
+
+    return true;
+}
+
+static inline bool can_free(Client *client)
+{
+    return client->closing && client->pending == 0 && client->outLen == 0;
+}
+
+static void free_client(Client *client)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    pthread_mutex_destroy(&client->lock);
+    free(client->out);
+    free(client);
+}
+
+// Clients closed during a round of events, however many there are
+static Client **closed = NULL;
+static size_t closedSize = 0;
+
+static void add_closed(Client *client, size_t index)
+{
+    if (index == closedSize)
+    {
+        closedSize = (closedSize == 0) ? MAX_EVENTS : closedSize * 2;
+        closed = realloc(closed, closedSize * sizeof(Client*));
+    }
+    closed[index] = client;
+}
+
+static void *worker_run(void *arg)
+{
+    (void) arg;
+    // Connections stay open for the life of the daemon, chapters are shared through the cache
+    RpcSession session = { .ctx = ctx };
+
+    while (true)
+    {
+        Job *job = pop_job();
+        // NULL client means stop
+        if (job->client == NULL)
+        {
+            free(job);
+            break;
+        }
+
+        char *response = NULL;
+        size_t responseLen = 0;
+
+        FILE *out = open_memstream(&response, &responseLen);
+        rpc_handle(&session, job->line, out);
+        fclose(out);
+
+        Client *client = job->client;
+        pthread_mutex_lock(&client->lock);
+        if (!client->closing || client->outLen > 0)
+        {
+            if (client->outLen + responseLen > client->outSize)
+            {
+                client->outSize = (client->outLen + responseLen) * 2;
+                client->out = realloc(client->out, client->outSize);
+            }
+
+            memcpy(client->out + client->outLen, response, responseLen);
+            client->outLen += responseLen;
+            flush_client(client);
+        }
+        client->pending--;
+        bool done = can_free(client);
+        pthread_mutex_unlock(&client->lock);
+
+        // Only the event loop frees clients
+        if (done && write(wakePipe[1], &client, sizeof(Client*)) != sizeof(Client*))
+            perror("bible: couldn't wake the event loop");
+
+        free(response);
+        free(job->line);
+        free(job);
+    }
+
+    rpc_close(&session);
+
+    return NULL;
+}
+
+static void accept_clients(int listenFd)
+{
+    int fd;
+    while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        Client *client = calloc(1, sizeof(Client));
+        client->fd = fd;
+        pthread_mutex_init(&client->lock, NULL);
+
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+// Read from [client] and queue each complete line
+// Returns false once the client has hung up
+static bool read_client(Client *client)
+{
+    while (true)
+    {
+        ssize_t n = read(client->fd, client->in + client->inLen, sizeof(client->in) - client->inLen);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (n <= 0)
+            return false;
+
+        client->inLen += n;
+
+        char *start = client->in, *newLine;
+        while ((newLine = memchr(start, '\n', client->in + client->inLen - start)) != NULL)
+        {
+            *newLine = '\0';
+            if (newLine > start)
+            {
+                pthread_mutex_lock(&client->lock);
+                client->pending++;
+                pthread_mutex_unlock(&client->lock);
+
+                push_job(client, strdup(start));
+            }
+            start = newLine + 1;
+        }
+
+        client->inLen -= start - client->in;
+        memmove(client->in, start, client->inLen);
+
+        // A request that doesn't fit is dropped along with the client
+        if (client->inLen == sizeof(client->in))
+            return false;
+    }
+}
+
+// Listen on [path], which the users of [group] can use too (only the user, if it's -1)
+static int listen_on(const char *path, gid_t group)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "bible: socket path is too long\n");
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    if (!daemon_socket_dir(path))
+    {
+        fprintf(stderr, "bible: the socket's directory belongs to someone else (or others can write to it)\n");
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    // Replace a socket left behind by a daemon that didn't exit cleanly (but not a running one)
+    if (daemon_connect(path))
+    {
+        daemon_disconnect();
+        fprintf(stderr, "bible: a daemon is already listening on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+
+	// Made only the user's, then given to the group
+    mode_t mask = umask(0177);
+    bool listening = bind(fd, (struct sockaddr*) &address, sizeof(address)) == 0 && listen(fd, SOMAXCONN) == 0;
+    umask(mask);
+    if (!listening)
+    {
+        perror("bible: couldn't listen on socket");
+        close(fd);
+        return -1;
+    }
+
+    if (group != (gid_t) -1 && (chown(path, -1, group) != 0 || chmod(path, 0660) != 0))
+    {
+        perror("bible: couldn't give the socket to the group");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+
+    return fd;
+}
+
+int daemon_mode(int argCount, char **args)
+{
+    const char *path = daemon_socket_path();
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	// The users who may use the daemon besides its own: the "bible" group, if there's one
+    const char *groupName = (getgrnam(DAEMON_GROUP) != NULL) ? DAEMON_GROUP : NULL;
+
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--socket") == 0 && i + 1 < argCount)
+            path = args[++i];
+        else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = strtol(args[++i], NULL, 10);
+        else if (strcmp(args[i], "--group") == 0 && i + 1 < argCount)
+            groupName = args[++i];
+        else if (strcmp(args[i], "--private") == 0)
+            groupName = NULL;
+        else
+        {
+            fprintf(stderr, "bible: usage: bible --daemon [--socket PATH] [--jobs N] [--group NAME | --private]\n");
+            return 2;
+        }
+    }
+
+    if (jobs < 2) jobs = 2;
+    if (jobs > MAX_JOBS) jobs = MAX_JOBS;
+
+    struct group *group = (groupName != NULL) ? getgrnam(groupName) : NULL;
+    if (groupName != NULL && group == NULL)
+    {
+        fprintf(stderr, "bible: there's no group \"%s\"\n", groupName);
+        return 1;
+    }
+
+    // Translations and cached chapters are shared by all workers
+    ctx = bible_ctx_new("db");
+
+    int listenFd = listen_on(path, (group != NULL) ? group->gr_gid : (gid_t) -1);
+    if (listenFd < 0)
+        return 1;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0 || pipe2(wakePipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        perror("bible: couldn't set up the event loop");
+        return 1;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.ptr = wakePipe;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakePipe[0], &event);
+
+    signal(SIGINT, &stop);
+    signal(SIGTERM, &stop);
+
+    pthread_t workers[MAX_JOBS];
+    int started = 0;
+    while (started < jobs && pthread_create(&workers[started], NULL, &worker_run, NULL) == 0)
+        started++;
+    if (started < jobs)
+        fprintf(stderr, "bible: couldn't start worker %i\n", started + 1);
+    if (started == 0)
+    {
+        bible_ctx_free(ctx);
+        close(listenFd);
+        unlink(path);
+        return 1;
+    }
+    jobs = started;
+
+    fprintf(stderr, "bible: listening on %s with %li workers, for %s%s\n", path, jobs,
+        (group != NULL) ? "the users of group " : "you only", (group != NULL) ? group->gr_name : "");
+
+    struct epoll_event events[MAX_EVENTS];
+    while (running)
+    {
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+
+        // Clients are freed after all events of this round are handled
+        size_t closedCount = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                accept_clients(listenFd);
+                continue;
+            }
+
+            if (events[i].data.ptr == wakePipe)
+            {
+                Client *client;
+                while (read(wakePipe[0], &client, sizeof(Client*)) == sizeof(Client*))
+                    add_closed(client, closedCount++);
+                continue;
+            }
+
+            Client *client = events[i].data.ptr;
+
+            bool open = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                open = read_client(client);
+
+            pthread_mutex_lock(&client->lock);
+            if (open && (events[i].events & EPOLLOUT))
+                open = flush_client(client);
+
+            if (!open && !client->closing)
+            {
+                client->closing = true;
+                // Nothing more can be sent once the client is gone
+                client->outLen = 0;
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+
+                if (can_free(client))
+                    add_closed(client, closedCount++);
+            }
+            pthread_mutex_unlock(&client->lock);
+        }
+
+        for (size_t i = 0; i < closedCount; i++)
+            free_client(closed[i]);
+    }
+
+    // Tell the workers to stop
+    for (int i = 0; i < jobs; i++)
+        push_job(NULL, NULL);
+    for (int i = 0; i < jobs; i++)
+        pthread_join(workers[i], NULL);
+
+    size_t misses, hits;
+    bible_cache_stats(ctx, &misses, &hits);
+    fprintf(stderr, "bible: %zu chapters read, %zu served from the cache\n", misses, hits);
+
+    bible_ctx_free(ctx);
+    close(listenFd);
+    unlink(path);
+    free(closed);
+
+    return 0;
+}
+
+#else
+
+int daemon_mode(int argCount, char **args)
+{
+    (void) argCount, (void) args;
+    fprintf(stderr, "bible: --daemon is only supported on Linux\n");
+
+    return 1;
+}
+
+#endif
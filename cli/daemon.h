@@ -0,0 +1,3 @@
+// bible --daemon [--socket PATH] [--jobs N]
+// Serve requests (see rpc.h) over a Unix domain socket from one shared cache (returns the exit code)
+int daemon_mode(int argCount, char **args);
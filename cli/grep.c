@@ -0,0 +1,415 @@
+// Allows open_memstream to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+// memmem isn't part of POSIX
+#define  _GNU_SOURCE
+#define  _DARWIN_C_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <regex.h>
+#include "grep.h"
+#include "../libbible/bible.h"
+
+#define MAX_JOBS 64
+#define MAX_LITERAL 64
+
+// One book of one translation, searched by one worker
+typedef struct
+{
+    size_t translation;
+    int book;
+    char bookName[40];
+
+    // Matching lines (written by the worker, printed in order by the main thread)
+    char *output;
+    size_t outputLen, matches;
+    bool done;
+} Chunk;
+
+typedef struct
+{
+    bible_ctx *ctx;
+    const char *translations[64];
+    size_t translationCount;
+
+    const char *pattern;
+    int flags;
+    bool notes, showTranslation;
+    // Text every match must contain (so verses without it are skipped without running the regex)
+    char literal[MAX_LITERAL];
+    size_t literalLen;
+
+    Chunk *chunks;
+    size_t chunkCount, next;
+    size_t verses, regexRuns;
+    pthread_mutex_t lock;
+    pthread_cond_t chunkDone;
+} Grep;
+
+// The text of a book with tags stripped, as one buffer of verses separated by '\0'
+typedef struct
+{
+    char *text;
+    size_t len, size;
+
+    // Verse i starts at text[starts[i]]
+    size_t *starts;
+    bible_ref *refs;
+    size_t count, capacity;
+
+    bool notes;
+} BookText;
+
+static void add_verse(bible_ref ref, const char *text, void *data)
+{
+    BookText *book = data;
+
+    if (book->count == book->capacity)
+    {
+        book->capacity = (book->capacity == 0) ? 256 : book->capacity * 2;
+        book->starts = realloc(book->starts, book->capacity * sizeof(size_t));
+        book->refs = realloc(book->refs, book->capacity * sizeof(bible_ref));
+    }
+
+    // Stripping never makes the text longer
+    size_t textSize = strlen(text) + 1;
+    if (book->len + textSize > book->size)
+    {
+        while (book->len + textSize > book->size)
+            book->size = (book->size == 0) ? 65536 : book->size * 2;
+        book->text = realloc(book->text, book->size);
+    }
+
+    book->starts[book->count] = book->len;
+    book->refs[book->count] = ref;
+    book->count++;
+
+    book->len += (book->notes ? bible_strip_tags_keep_notes : bible_strip_tags)(text, &book->text[book->len], textSize) + 1;
+}
+
+// Find the longest piece of text that every match of an extended regex must contain
+// Only looks outside brackets and gives up on patterns with a top-level '|'
+static size_t required_literal(const char *pattern, char *literal, size_t literalSize)
+{
+    char run[MAX_LITERAL];
+    size_t runLen = 0, bestLen = 0;
+    int depth = 0;
+
+    for (const char *p = pattern; ; p++)
+    {
+        bool endRun = true;
+        char c = *p;
+
+        if (c == '\0')
+            ;
+        // Escaped punctuation is a literal, but \b, \w, \<, \1 etc. aren't
+        else if (c == '\\')
+        {
+            if (p[1] == '\0')
+                return 0;
+            c = *++p;
+            if (depth > 0 || isalnum((unsigned char) c) || c == '<' || c == '>' || c == '`' || c == '\'')
+                c = '\0';
+        }
+        else if (c == '|' && depth == 0)
+            return 0;
+        else if (c == '(')
+            depth++, c = '\0';
+        else if (c == ')')
+            depth--, c = '\0';
+        else if (c == '[')
+        {
+            // Skip the bracket expression ("[]...]" and "[^]...]" include ']')
+            p++;
+            if (*p == '^') p++;
+            if (*p == ']') p++;
+            while (*p != '\0' && *p != ']')
+                p++;
+            if (*p == '\0')
+                return 0;
+            c = '\0';
+        }
+        else if (c == '{')
+        {
+            while (*p != '\0' && *p != '}')
+                p++;
+            if (*p == '\0')
+                return 0;
+            c = '\0';
+        }
+        else if (depth > 0 || strchr(".^$*+?", c) != NULL)
+            c = '\0';
+
+        // Characters followed by ?, * or {} are optional; + keeps one
+        if (c != '\0')
+        {
+            char next = p[1];
+            if (next != '?' && next != '*' && next != '{' && runLen + 1 < sizeof(run))
+            {
+                run[runLen++] = c;
+                endRun = (next == '+');
+            }
+        }
+
+        if (endRun)
+        {
+            if (runLen > bestLen && runLen < literalSize)
+            {
+                memcpy(literal, run, runLen);
+                bestLen = runLen;
+            }
+            runLen = 0;
+        }
+
+        if (*p == '\0')
+            break;
+    }
+
+    literal[bestLen] = '\0';
+
+    return bestLen;
+}
+
+static void search_chunk(Grep *grep, Chunk *chunk, bible_conn *conn, regex_t *regex, BookText *book)
+{
+    book->len = 0, book->count = 0;
+    bible_each_verse(conn, chunk->book, &add_verse, book);
+
+    // Case-insensitive prefiltering works on a lower case copy
+    char *haystack = book->text;
+    if ((grep->flags & REG_ICASE) && book->len > 0)
+    {
+        haystack = malloc(book->len);
+        for (size_t i = 0; i < book->len; i++)
+            haystack[i] = tolower((unsigned char) book->text[i]);
+    }
+
+    FILE *out = open_memstream(&chunk->output, &chunk->outputLen);
+    size_t runs = 0;
+
+    for (size_t v = 0; v < book->count; v++)
+    {
+        // Jump straight to the next verse containing the literal
+        if (grep->literalLen > 0)
+        {
+            size_t from = book->starts[v];
+            const char *found = memmem(&haystack[from], book->len - from, grep->literal, grep->literalLen);
+            if (found == NULL)
+                break;
+
+            size_t offset = found - haystack;
+            while (v + 1 < book->count && book->starts[v + 1] <= offset)
+                v++;
+        }
+
+        const char *text = &book->text[book->starts[v]];
+        runs++;
+        if (regexec(regex, text, 0, NULL, 0) == 0)
+        {
+            if (grep->showTranslation)
+                fprintf(out, "%s ", grep->translations[chunk->translation]);
+            fprintf(out, "%s %i:%i\t%s\n", chunk->bookName, BIBLE_REF_CHAPTER(book->refs[v]), BIBLE_REF_VERSE(book->refs[v]), text);
+            chunk->matches++;
+        }
+    }
+
+    fclose(out);
+    if (haystack != book->text)
+        free(haystack);
+
+    pthread_mutex_lock(&grep->lock);
+    grep->verses += book->count;
+    grep->regexRuns += runs;
+    chunk->done = true;
+    pthread_cond_broadcast(&grep->chunkDone);
+    pthread_mutex_unlock(&grep->lock);
+}
+
+static void *grep_worker(void *arg)
+{
+    Grep *grep = arg;
+
+    // glibc serialises regexec on a shared pattern, so every worker compiles its own
+    regex_t regex;
+    bool compiled = regcomp(&regex, grep->pattern, grep->flags) == 0;
+
+    bible_conn *conns[64] = { NULL };
+    BookText book = { .notes = grep->notes };
+
+    for (;;)
+    {
+        pthread_mutex_lock(&grep->lock);
+        size_t i = grep->next++;
+        pthread_mutex_unlock(&grep->lock);
+
+        if (i >= grep->chunkCount)
+            break;
+
+        Chunk *chunk = &grep->chunks[i];
+        if (conns[chunk->translation] == NULL)
+            conns[chunk->translation] = bible_conn_open(grep->ctx, grep->translations[chunk->translation]);
+
+        if (compiled && conns[chunk->translation] != NULL)
+            search_chunk(grep, chunk, conns[chunk->translation], &regex, &book);
+        else
+        {
+            pthread_mutex_lock(&grep->lock);
+            chunk->done = true;
+            pthread_cond_broadcast(&grep->chunkDone);
+            pthread_mutex_unlock(&grep->lock);
+        }
+    }
+
+    for (size_t t = 0; t < grep->translationCount; t++)
+        bible_conn_close(conns[t]);
+    free(book.text);
+    free(book.starts);
+    free(book.refs);
+    if (compiled)
+        regfree(&regex);
+
+    return NULL;
+}
+
+// Split the translations into books, in order
+static void add_chunks(Grep *grep)
+{
+    size_t size = 0;
+
+    for (size_t t = 0; t < grep->translationCount; t++)
+    {
+        bible_conn *conn = bible_conn_open(grep->ctx, grep->translations[t]);
+        if (conn == NULL)
+        {
+            fprintf(stderr, "bible: couldn't open translation \"%s\"\n", grep->translations[t]);
+            continue;
+        }
+
+        char bookName[40];
+        for (int book = bible_adjacent_book(conn, 0, 1, bookName, sizeof(bookName)); book > 0;
+            book = bible_adjacent_book(conn, book, 1, bookName, sizeof(bookName)))
+        {
+            if (grep->chunkCount == size)
+            {
+                size = (size == 0) ? 128 : size * 2;
+                grep->chunks = realloc(grep->chunks, size * sizeof(Chunk));
+            }
+
+            Chunk *chunk = &grep->chunks[grep->chunkCount++];
+            *chunk = (Chunk) { .translation = t, .book = book };
+            memcpy(chunk->bookName, bookName, sizeof(bookName));
+        }
+
+        bible_conn_close(conn);
+    }
+}
+
+int grep_mode(int argCount, char **args)
+{
+    Grep grep = {
+        .flags = REG_EXTENDED | REG_NOSUB,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .chunkDone = PTHREAD_COND_INITIALIZER
+    };
+    const char *translation = NULL;
+    bool all = false;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "--all") == 0)
+            all = true;
+        else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = atol(args[++i]);
+        else if (strcmp(args[i], "-i") == 0 || strcmp(args[i], "--ignore-case") == 0)
+            grep.flags |= REG_ICASE;
+        else if (strcmp(args[i], "--notes") == 0)
+            grep.notes = true;
+        else if (grep.pattern == NULL)
+            grep.pattern = args[i];
+        else
+            grep.pattern = NULL, i = argCount;
+    }
+
+    if (grep.pattern == NULL)
+    {
+        fprintf(stderr, "bible: usage: bible --grep [--translation NAME | --all] [--jobs N] [-i] [--notes] <regex>\n");
+        return 2;
+    }
+
+    // Report bad patterns before starting
+    regex_t regex;
+    int error = regcomp(&regex, grep.pattern, grep.flags);
+    if (error != 0)
+    {
+        char message[128];
+        regerror(error, &regex, message, sizeof(message));
+        fprintf(stderr, "bible: %s: %s\n", grep.pattern, message);
+        return 2;
+    }
+    regfree(&regex);
+
+    grep.ctx = bible_ctx_new("db");
+    if (all)
+    {
+        for (size_t t = 0; t < bible_translation_count(grep.ctx) && t < 64; t++)
+            grep.translations[grep.translationCount++] = bible_translation_name(grep.ctx, t);
+        grep.showTranslation = true;
+    }
+    else
+    {
+        grep.translations[grep.translationCount++] = (translation != NULL) ? translation : bible_translation_name(grep.ctx, 0);
+    }
+
+    grep.literalLen = required_literal(grep.pattern, grep.literal, sizeof(grep.literal));
+    if (grep.flags & REG_ICASE)
+        for (size_t i = 0; i < grep.literalLen; i++)
+            grep.literal[i] = tolower((unsigned char) grep.literal[i]);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    add_chunks(&grep);
+
+    if (jobs < 1) jobs = 1;
+    if (jobs > MAX_JOBS) jobs = MAX_JOBS;
+    pthread_t workers[MAX_JOBS];
+    int started = bible_threads_start(workers, jobs, &grep_worker, &grep);
+
+    // Print books in order as soon as they (and the ones before them) are done
+    size_t matches = 0;
+    for (size_t i = 0; i < grep.chunkCount; i++)
+    {
+        pthread_mutex_lock(&grep.lock);
+        while (!grep.chunks[i].done)
+            pthread_cond_wait(&grep.chunkDone, &grep.lock);
+        pthread_mutex_unlock(&grep.lock);
+
+        if (grep.chunks[i].output != NULL)
+            fwrite(grep.chunks[i].output, 1, grep.chunks[i].outputLen, stdout);
+        free(grep.chunks[i].output);
+        matches += grep.chunks[i].matches;
+    }
+    fflush(stdout);
+
+    bible_threads_join(workers, started);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "bible: %zu matches in %zu verses in %.3f s (regex run on %zu verses)\n",
+        matches, grep.verses, seconds, grep.regexRuns);
+
+    free(grep.chunks);
+    bible_ctx_free(grep.ctx);
+    pthread_mutex_destroy(&grep.lock);
+    pthread_cond_destroy(&grep.chunkDone);
+
+    return 0;
+}
@@ -0,0 +1,4 @@
+// bible --grep [--translation NAME | --all] [--jobs N] [-i] [--notes] <regex>
+// Print the verses whose text (without tags) matches an extended regex, in Bible order
+// (--notes also searches footnotes). Returns the exit code
+int grep_mode(int argCount, char **args);
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parallels.h"
+#include "../libbible/bible.h"
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// "Book chapter:verse" or "Book chapter:first-last" of verses [first..last] (in one chapter)
+static void print_passage(bible_conn *conn, bible_ref first, bible_ref last)
+{
+    static int lastBook = 0;
+    static char bookName[40] = "";
+
+    int book = BIBLE_REF_BOOK(first);
+    if (book != lastBook)
+    {
+        if (!bible_book_name(conn, book, bookName, sizeof(bookName)))
+            snprintf(bookName, sizeof(bookName), "%s", bible_book_title(book));
+        lastBook = book;
+    }
+
+    printf("%s %i:%i", bookName, BIBLE_REF_CHAPTER(first), BIBLE_REF_VERSE(first));
+    if (last != first)
+        printf("-%i", BIBLE_REF_VERSE(last));
+}
+
+int parallels_mode(int argCount, char **args)
+{
+    const char *translation = NULL;
+    int jobs = 0;
+    double minSimilarity = 0;
+
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = atoi(args[++i]);
+        else if (strcmp(args[i], "--min") == 0 && i + 1 < argCount)
+            minSimilarity = atof(args[++i]);
+        else
+        {
+            fprintf(stderr, "bible: usage: bible --parallels [--translation NAME] [--jobs N] [--min SIMILARITY]\n");
+            return 2;
+        }
+    }
+
+    bible_ctx *ctx = bible_ctx_new("db");
+    if (translation == NULL)
+        translation = bible_translation_name(ctx, 0);
+
+    bible_conn *conn = bible_conn_open(ctx, translation);
+    if (conn == NULL)
+    {
+        fprintf(stderr, "bible: couldn't open translation \"%s\"\n", translation);
+        bible_ctx_free(ctx);
+        return 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool built = bible_parallels_build(conn, jobs);
+    double time = seconds_since(&start);
+
+    bible_parallels *parallels = built ? bible_get_parallels(conn, 0) : NULL;
+    size_t shown = 0;
+    for (size_t i = 0; parallels != NULL && i < parallels->count; i++)
+    {
+        // Each pair is kept from both sides
+        const bible_parallel *parallel = &parallels->parallels[i];
+        if (parallel->first > parallel->otherFirst || parallel->similarity < minSimilarity)
+            continue;
+
+        print_passage(conn, parallel->first, parallel->last);
+        putchar('\t');
+        print_passage(conn, parallel->otherFirst, parallel->otherLast);
+        printf("\t%.2f\n", parallel->similarity);
+        shown++;
+    }
+
+    if (parallels != NULL)
+        fprintf(stderr, "bible: %zu parallel passages (found or loaded in %.3f s)\n", shown, time);
+    else
+        fprintf(stderr, "bible: couldn't find the parallel passages of %s\n", translation);
+    bible_parallels_free(parallels);
+
+    bible_conn_close(conn);
+    bible_ctx_free(ctx);
+
+    return (parallels != NULL) ? 0 : 1;
+}
@@ -0,0 +1,3 @@
+// bible --parallels [--translation NAME] [--jobs N] [--min SIMILARITY]
+// Find (or load) the parallel passages of a translation and print each pair once. Returns the exit code
+int parallels_mode(int argCount, char **args);
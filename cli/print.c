@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "print.h"
+#include "../libbible/bible.h"
+#include "../util/reference.h"
+#include "../util/text.h"
+
+typedef struct
+{
+    FILE *out;
+    bool colour;
+} PrintOptions;
+
+static void print_verse(int verse, const char *text, PrintOptions *options)
+{
+    fprintf(options->out, "[%i] ", verse);
+    print_verse_text(options->out, text, options->colour);
+    fputc('\n', options->out);
+}
+
+// Print the verses of the references, with a heading wherever the chapter changes
+// (e.g. "John 3", or "John 3:16-18" for some verses of a single chapter)
+static int print_selection(bible_conn *conn, const bible_range *ranges, size_t count, PrintOptions *options)
+{
+    bool versesOfOneChapter = count == 1 && ranges[0].first >> 8 == ranges[0].last >> 8
+        && BIBLE_REF_VERSE(ranges[0].last) != BIBLE_REF_END;
+
+    bible_selection *selection = bible_get_ranges(conn, ranges, count);
+    if (selection == NULL)
+    {
+        fprintf(stderr, "bible: couldn't find any of those verses\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < selection->count; i++)
+    {
+        bible_ref ref = selection->refs[i];
+        // (Without the verses, refs are the same in the same chapter)
+        if (i == 0 || ref >> 8 != selection->refs[i - 1] >> 8)
+        {
+            char longName[40];
+            if (!bible_book_name(conn, BIBLE_REF_BOOK(ref), longName, sizeof(longName)))
+                snprintf(longName, sizeof(longName), "%s", bible_book_title(BIBLE_REF_BOOK(ref)));
+
+            fprintf(options->out, options->colour ? "%s\033[1m%s %i" : "%s%s %i", (i > 0) ? "\n" : "", longName, BIBLE_REF_CHAPTER(ref));
+            if (versesOfOneChapter)
+            {
+                int first = BIBLE_REF_VERSE(ranges[0].first), last = BIBLE_REF_VERSE(ranges[0].last);
+                fprintf(options->out, (last > first) ? ":%i-%i" : ":%i", first, last);
+            }
+            fputs(options->colour ? "\033[22m\n" : "\n", options->out);
+        }
+
+        print_verse(selection->verses[i].verse, selection->verses[i].text, options);
+    }
+
+    bible_selection_free(selection);
+    return 0;
+}
+
+int print_mode(int argCount, char **args)
+{
+    const char *translation = NULL;
+    // Colour by default only when printing to a terminal
+    PrintOptions options = { .out = stdout, .colour = isatty(STDOUT_FILENO) && getenv("NO_COLOR") == NULL };
+
+    // Join the remaining arguments, so both `John 3:16` and "John 3:16" work
+    char ref[128] = "";
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "--color") == 0)
+            options.colour = true;
+        else if (strcmp(args[i], "--no-color") == 0)
+            options.colour = false;
+        else
+        {
+            if (ref[0] != '\0')
+                strncat(ref, " ", sizeof(ref) - strlen(ref) - 1);
+            strncat(ref, args[i], sizeof(ref) - strlen(ref) - 1);
+        }
+    }
+
+    if (ref[0] == '\0')
+    {
+        fprintf(stderr, "bible: usage: bible --print [--translation NAME] [--color | --no-color] <book> <chapter>[:<verse>[-<verse>]][; ...]\n");
+        return 2;
+    }
+
+    // Only the translation that is needed is opened
+    bible_ctx *ctx = bible_ctx_new("db");
+    if (translation == NULL)
+        translation = bible_translation_name(ctx, 0);
+
+    bible_conn *conn = bible_conn_open(ctx, translation);
+    if (conn == NULL)
+    {
+        fprintf(stderr, "bible: couldn't open translation \"%s\"\n", translation);
+        bible_ctx_free(ctx);
+        return 1;
+    }
+
+	// A list of references e.g. "Rom 3:23; 6:23; 5:8" is read all at once
+    bible_range ranges[64];
+    int rangeCount = parse_references(conn, ref, ranges, sizeof(ranges) / sizeof(*ranges));
+    int status = 0;
+    if (rangeCount < 0)
+    {
+        fprintf(stderr, "bible: couldn't read \"%s\" as references. Check your spelling\n", ref);
+        status = 1;
+    }
+
+    else if ((size_t) rangeCount > sizeof(ranges) / sizeof(*ranges))
+    {
+        fprintf(stderr, "bible: too many references (at most %zu)\n", sizeof(ranges) / sizeof(*ranges));
+        status = 1;
+    }
+
+    else
+        status = print_selection(conn, ranges, rangeCount, &options);
+
+    bible_conn_close(conn);
+    bible_ctx_free(ctx);
+
+    return status;
+}
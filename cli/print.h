@@ -0,0 +1,3 @@
+// bible --print [--translation NAME] [--color | --no-color] <book> <chapter>[:<verse>[-<verse>]]
+// Print Bible text to stdout without starting ncurses (returns the exit code)
+int print_mode(int argCount, char **args);
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "query.h"
+#include "../libbible/bible.h"
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int query_mode(int argCount, char **args)
+{
+    const char *translation = NULL;
+    int jobs = 0;
+    bool countOnly = false;
+
+    // Join the remaining arguments, so the query doesn't need quotes
+    char query[512] = "";
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = atoi(args[++i]);
+        else if (strcmp(args[i], "--count") == 0)
+            countOnly = true;
+        else
+        {
+            if (query[0] != '\0')
+                strncat(query, " ", sizeof(query) - strlen(query) - 1);
+            strncat(query, args[i], sizeof(query) - strlen(query) - 1);
+        }
+    }
+
+    if (query[0] == '\0')
+    {
+        fprintf(stderr, "bible: usage: bible --query [--translation NAME] [--jobs N] [--count] <query>\n");
+        return 2;
+    }
+
+    bible_ctx *ctx = bible_ctx_new("db");
+    if (translation == NULL)
+        translation = bible_translation_name(ctx, 0);
+
+    // Building takes a while the first time (or after a translation changed)
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!bible_index_build(ctx, jobs))
+    {
+        fprintf(stderr, "bible: couldn't build the word index\n");
+        bible_ctx_free(ctx);
+        return 1;
+    }
+    double loadTime = seconds_since(&start);
+
+    char error[128];
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bible_refs *refs = bible_index_query(ctx, query, translation, error, sizeof(error));
+    double queryTime = seconds_since(&start);
+
+    if (refs == NULL)
+    {
+        fprintf(stderr, "bible: %s\n", error);
+        bible_ctx_free(ctx);
+        return 2;
+    }
+
+    // Show the verses in [translation]
+    bible_conn *conn = countOnly ? NULL : bible_conn_open(ctx, translation);
+    char bookName[40] = "";
+    int lastBook = 0;
+
+    for (size_t i = 0; conn != NULL && i < refs->count; i++)
+    {
+        bible_ref ref = refs->refs[i];
+        int book = BIBLE_REF_BOOK(ref), chapter = BIBLE_REF_CHAPTER(ref), verse = BIBLE_REF_VERSE(ref);
+        if (book != lastBook)
+        {
+            if (!bible_book_name(conn, book, bookName, sizeof(bookName)))
+                snprintf(bookName, sizeof(bookName), "%s", bible_book_title(book));
+            lastBook = book;
+        }
+
+        bible_passage *passage = bible_get_passage(conn, ref, ref);
+        if (passage != NULL && passage->count > 0)
+        {
+            char text[strlen(passage->verses[0].text) + 1];
+            bible_strip_tags(passage->verses[0].text, text, sizeof(text));
+            printf("%s %i:%i\t%s\n", bookName, chapter, verse, text);
+        }
+        // The verse is only in another translation
+        else
+        {
+            printf("%s %i:%i\t\n", bookName, chapter, verse);
+        }
+        bible_passage_free(passage);
+    }
+
+    if (countOnly)
+        printf("%zu\n", refs->count);
+
+    fprintf(stderr, "bible: %zu verses in %.0f µs (index ready in %.3f s)\n", refs->count, queryTime * 1e6, loadTime);
+
+    bible_refs_free(refs);
+    bible_conn_close(conn);
+    bible_ctx_free(ctx);
+
+    return 0;
+}
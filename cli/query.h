@@ -0,0 +1,4 @@
+// bible --query [--translation NAME] [--jobs N] [--count] <query>
+// Print the verses matching a word query across translations, e.g. "NKJV:grace NOT MSG:grace"
+// or "faith NEAR/5 works" (see bible_index_query()). Returns the exit code
+int query_mode(int argCount, char **args);
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "related.h"
+#include "../libbible/bible.h"
+#include "../util/reference.h"
+
+#define DEFAULT_RELATED 10
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+typedef struct
+{
+    bible_ref *refs;
+    size_t count, size;
+} VerseList;
+
+static void add_ref(bible_ref ref, const char *text, void *data)
+{
+    (void) text;
+    VerseList *list = data;
+
+    if (list->count == list->size)
+    {
+        list->size = (list->size == 0) ? 1024 : list->size * 2;
+        list->refs = realloc(list->refs, list->size * sizeof(bible_ref));
+    }
+    list->refs[list->count++] = ref;
+}
+
+// "Book chapter:verse" of [ref]
+static void print_reference(bible_conn *conn, bible_ref ref)
+{
+    static int lastBook = 0;
+    static char bookName[40] = "";
+
+    int book = BIBLE_REF_BOOK(ref);
+    if (book != lastBook)
+    {
+        if (!bible_book_name(conn, book, bookName, sizeof(bookName)))
+            snprintf(bookName, sizeof(bookName), "%s", bible_book_title(book));
+        lastBook = book;
+    }
+
+    printf("%s %i:%i", bookName, BIBLE_REF_CHAPTER(ref), BIBLE_REF_VERSE(ref));
+}
+
+// Related verses of every verse, one line each: the verse, then its related verses separated by tabs
+static int related_all(bible_conn *conn, int limit, int jobs)
+{
+    VerseList list = { 0 };
+    for (int book = bible_adjacent_book(conn, 0, 1, NULL, 0); book > 0; book = bible_adjacent_book(conn, book, 1, NULL, 0))
+        bible_each_verse(conn, book, &add_ref, &list);
+
+    bible_ref *related = malloc((list.count * limit + 1) * sizeof(bible_ref));
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool ok = bible_related_batch(conn, list.refs, list.count, limit, jobs, related);
+    double time = seconds_since(&start);
+
+    for (size_t i = 0; ok && i < list.count; i++)
+    {
+        print_reference(conn, list.refs[i]);
+        for (int r = 0; r < limit && related[i * limit + r] != 0; r++)
+        {
+            putchar('\t');
+            print_reference(conn, related[i * limit + r]);
+        }
+        putchar('\n');
+    }
+
+    if (ok)
+        fprintf(stderr, "bible: related verses of %zu verses in %.3f s\n", list.count, time);
+    else
+        fprintf(stderr, "bible: couldn't build the related verses of %s\n", bible_conn_translation(conn));
+
+    free(related);
+    free(list.refs);
+
+    return ok ? 0 : 1;
+}
+
+int related_mode(int argCount, char **args)
+{
+    const char *translation = NULL;
+    int limit = DEFAULT_RELATED, jobs = 0;
+    bool all = false;
+
+    // Join the remaining arguments, so both `John 3:16` and "John 3:16" work
+    char ref[128] = "";
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "-k") == 0 && i + 1 < argCount)
+            limit = atoi(args[++i]);
+        else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = atoi(args[++i]);
+        else if (strcmp(args[i], "--all") == 0)
+            all = true;
+        else
+        {
+            if (ref[0] != '\0')
+                strncat(ref, " ", sizeof(ref) - strlen(ref) - 1);
+            strncat(ref, args[i], sizeof(ref) - strlen(ref) - 1);
+        }
+    }
+
+    if (limit <= 0 || (!all && ref[0] == '\0'))
+    {
+        fprintf(stderr, "bible: usage: bible --related [--translation NAME] [-k N] <book> <chapter>:<verse>\n"
+                        "       bible --related --all [--translation NAME] [-k N] [--jobs N]\n");
+        return 2;
+    }
+
+    bible_ctx *ctx = bible_ctx_new("db");
+    if (translation == NULL)
+        translation = bible_translation_name(ctx, 0);
+
+    bible_conn *conn = bible_conn_open(ctx, translation);
+    if (conn == NULL)
+    {
+        fprintf(stderr, "bible: couldn't open translation \"%s\"\n", translation);
+        bible_ctx_free(ctx);
+        return 1;
+    }
+
+	// One verse
+    bible_range range;
+    bool oneVerse = !all && parse_references(conn, ref, &range, 1) == 1 && range.first == range.last;
+
+    int status = 0;
+    if (all)
+        status = related_all(conn, limit, jobs);
+
+    else if (!oneVerse)
+    {
+        fprintf(stderr, "bible: \"%s\" isn't one verse (like \"John 3:16\")\n", ref);
+        status = 2;
+    }
+
+    else
+    {
+        // The first query loads (or builds) the matrix
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bible_results *results = bible_related(conn, range.first, limit);
+        double loadTime = seconds_since(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bible_results_free(bible_related(conn, range.first, limit));
+        double queryTime = seconds_since(&start);
+
+        if (results == NULL)
+        {
+            fprintf(stderr, "bible: couldn't find \"%s\" in %s\n", ref, translation);
+            status = 1;
+        }
+
+        for (size_t i = 0; results != NULL && i < results->count; i++)
+        {
+            const bible_hit *hit = &results->hits[i];
+            printf("%s %i:%i\t%.2f\t%s\n", hit->book, BIBLE_REF_CHAPTER(hit->ref), BIBLE_REF_VERSE(hit->ref), 1 - hit->score, hit->text);
+        }
+
+        if (results != NULL)
+            fprintf(stderr, "bible: %zu related verses in %.0f µs (first query %.3f s)\n", results->count, queryTime * 1e6, loadTime);
+        bible_results_free(results);
+    }
+
+    bible_conn_close(conn);
+    bible_ctx_free(ctx);
+
+    return status;
+}
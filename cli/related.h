@@ -0,0 +1,5 @@
+// bible --related [--translation NAME] [-k N] <reference>
+// bible --related --all [--translation NAME] [-k N] [--jobs N]
+// Print the verses that share the most (rare) words with a verse, or with every verse of the translation
+// (computed in parallel). Returns the exit code
+int related_mode(int argCount, char **args);
@@ -0,0 +1,300 @@
+// Allows open_memstream to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rpc.h"
+#include "../util/json.h"
+#include "../util/reference.h"
+#include "../util/text.h"
+
+#define RPC_DEFAULT_LIMIT 50
+// References a lookup can have
+#define RPC_MAX_RANGES 64
+
+// Get an open connection to [translation], opening it on first use
+static bible_conn *get_connection(RpcSession *session, const char *translation)
+{
+    for (size_t i = 0; i < session->count; i++)
+    {
+        if (strcmp(bible_conn_translation(session->open[i]), translation) == 0)
+            return session->open[i];
+    }
+
+    bible_conn *conn = bible_conn_open(session->ctx, translation);
+    if (conn == NULL)
+        return NULL;
+
+    // No room to keep it open, so replace the first one
+    if (session->count == RPC_MAX_CONNECTIONS)
+    {
+        bible_conn_close(session->open[0]);
+        session->open[0] = conn;
+    }
+
+    else
+    {
+        session->open[session->count++] = conn;
+    }
+
+    return conn;
+}
+
+// Write verse text without tags as a JSON string
+static void write_verse_text(FILE *out, const char *text)
+{
+    char *plain = NULL;
+    size_t plainLen = 0;
+
+    FILE *stream = open_memstream(&plain, &plainLen);
+    print_verse_text(stream, text, false);
+    fclose(stream);
+
+    json_write_string(out, plain);
+    free(plain);
+}
+
+static void write_error(FILE *out, const char *id, const char *error)
+{
+    fprintf(out, "{\"id\":%s,\"error\":", id);
+    json_write_string(out, error);
+    fputs("}\n", out);
+}
+
+// Write the "book", "chapter" and "verses" fields of [count] [verses] of a chapter
+static void write_chapter(FILE *out, const char *book, int chapter, const bible_verse *verses, size_t count, bool raw, bool titles)
+{
+    fputs("\"book\":", out);
+    json_write_string(out, book);
+    fprintf(out, ",\"chapter\":%i,\"verses\":[", chapter);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const bible_verse *verse = &verses[i];
+
+        fprintf(out, "%s{\"verse\":%i,\"text\":", (i > 0) ? "," : "", verse->verse);
+        if (raw)
+            json_write_string(out, verse->text);
+        else
+            write_verse_text(out, verse->text);
+
+        if (titles && verse->title != NULL)
+        {
+            fputs(",\"title\":", out);
+            json_write_string(out, verse->title);
+        }
+        fputc('}', out);
+    }
+
+    fputc(']', out);
+}
+
+// Write the verses [verseStart]..[verseEnd] of a chapter ([verseEnd] = 0 is the end of the chapter)
+static void write_verses(RpcSession *session, FILE *out, const char *id, const char *request, const char *translation,
+    const char *book, int chapter, int verseStart, int verseEnd)
+{
+    // "raw": true keeps the tags (used by the UI), "titles": true adds section titles
+    bool raw = json_get_bool(request, "raw"), titles = json_get_bool(request, "titles");
+
+    bible_conn *conn = get_connection(session, translation);
+    if (conn == NULL)
+    {
+        write_error(out, id, "couldn't open translation");
+        return;
+    }
+
+    int bookIndex = bible_find_book(conn, book, NULL, 0);
+    if (bookIndex <= 0)
+    {
+        write_error(out, id, "couldn't find that book");
+        return;
+    }
+
+	// (Numbers a ref can't hold aren't in any chapter)
+    bible_passage *passage = NULL;
+    if (chapter > 0 && chapter < BIBLE_REF_END && verseStart >= 0 && verseStart < BIBLE_REF_END && verseEnd >= 0)
+        passage = bible_get_passage(conn, BIBLE_REF(bookIndex, chapter, verseStart),
+            BIBLE_REF(bookIndex, chapter, (verseEnd > 0 && verseEnd < BIBLE_REF_END) ? verseEnd : BIBLE_REF_END));
+    if (passage == NULL)
+    {
+        write_error(out, id, "couldn't find those verses");
+        return;
+    }
+
+    fprintf(out, "{\"id\":%s,\"result\":{\"translation\":", id);
+    json_write_string(out, translation);
+    fputc(',', out);
+    write_chapter(out, passage->book, chapter, passage->verses, passage->count, raw, titles);
+    fputs("}}\n", out);
+
+    bible_passage_free(passage);
+}
+
+// Write the verses of [ranges], as one chapter if they're all in one (like write_verses()), otherwise as
+// "passages": one chapter after the other
+static void write_ranges(RpcSession *session, FILE *out, const char *id, const char *request, const char *translation,
+    const bible_range *ranges, size_t count)
+{
+    bool raw = json_get_bool(request, "raw"), titles = json_get_bool(request, "titles");
+
+    bible_conn *conn = get_connection(session, translation);
+    if (conn == NULL)
+    {
+        write_error(out, id, "couldn't open translation");
+        return;
+    }
+
+    bible_selection *selection = bible_get_ranges(conn, ranges, count);
+    if (selection == NULL)
+    {
+        write_error(out, id, "couldn't find those verses");
+        return;
+    }
+
+    bool oneChapter = selection->refs[0] >> 8 == selection->refs[selection->count - 1] >> 8;
+    fprintf(out, "{\"id\":%s,\"result\":{\"translation\":", id);
+    json_write_string(out, translation);
+    fputs(oneChapter ? "," : ",\"passages\":[", out);
+
+	// (Without the verses, refs are the same in the same chapter)
+    for (size_t first = 0, end; first < selection->count; first = end)
+    {
+        bible_ref ref = selection->refs[first];
+        for (end = first + 1; end < selection->count && selection->refs[end] >> 8 == ref >> 8; end++);
+
+        char book[40];
+        if (!bible_book_name(conn, BIBLE_REF_BOOK(ref), book, sizeof(book)))
+            snprintf(book, sizeof(book), "%s", bible_book_title(BIBLE_REF_BOOK(ref)));
+
+        if (!oneChapter)
+            fputs((first > 0) ? ",{" : "{", out);
+        write_chapter(out, book, BIBLE_REF_CHAPTER(ref), &selection->verses[first], end - first, raw, titles);
+        if (!oneChapter)
+            fputc('}', out);
+    }
+
+    fputs(oneChapter ? "}}\n" : "]}}\n", out);
+
+    bible_selection_free(selection);
+}
+
+void rpc_handle(RpcSession *session, const char *request, FILE *out)
+{
+    char id[64] = "null", method[32] = "", translation[32] = "";
+
+    json_get_raw(request, "id", id, sizeof(id));
+    if (!json_get_string(request, "method", method, sizeof(method)))
+    {
+        write_error(out, id, "missing method");
+        return;
+    }
+
+    if (!json_get_string(request, "translation", translation, sizeof(translation)))
+        snprintf(translation, sizeof(translation), "%s", bible_translation_name(session->ctx, 0));
+
+	// Only the translations in the db folder: the name becomes part of file paths (of the db and its indexes)
+    if (strcmp(method, "translations") != 0
+        && (strchr(translation, '/') != NULL || bible_translation_index(session->ctx, translation) < 0))
+    {
+        write_error(out, id, "no such translation");
+        return;
+    }
+
+    if (strcmp(method, "translations") == 0)
+    {
+        fprintf(out, "{\"id\":%s,\"result\":{\"translations\":[", id);
+        for (size_t i = 0; i < bible_translation_count(session->ctx); i++)
+        {
+            if (i > 0) fputc(',', out);
+            json_write_string(out, bible_translation_name(session->ctx, i));
+        }
+        fputs("]}}\n", out);
+    }
+
+    else if (strcmp(method, "lookup") == 0)
+    {
+        char ref[128];
+        bible_range ranges[RPC_MAX_RANGES];
+        int count = -1;
+
+        bible_conn *conn = get_connection(session, translation);
+        if (json_get_string(request, "ref", ref, sizeof(ref)) && conn != NULL)
+            count = parse_references(conn, ref, ranges, RPC_MAX_RANGES);
+
+        if (conn == NULL)
+            write_error(out, id, "couldn't open translation");
+        else if (count < 0)
+            write_error(out, id, "expected \"ref\" like \"John 3:16\" or \"Rom 3:23; 6:23\"");
+        else if (count > RPC_MAX_RANGES)
+            write_error(out, id, "too many references");
+        else
+            write_ranges(session, out, id, request, translation, ranges, count);
+    }
+
+    else if (strcmp(method, "range") == 0 || strcmp(method, "chapter") == 0)
+    {
+        char book[40];
+        double chapter = 0, from = 1, to = 0;
+
+        bool valid = json_get_string(request, "book", book, sizeof(book))
+            && json_get_number(request, "chapter", &chapter) && chapter > 0;
+
+        // A range without verses is the whole chapter
+        if (strcmp(method, "range") == 0)
+        {
+            json_get_number(request, "from", &from);
+            if (!json_get_number(request, "to", &to))
+                to = from;
+        }
+
+        if (valid)
+            write_verses(session, out, id, request, translation, book, chapter, from, to);
+        else
+            write_error(out, id, "expected \"book\" and \"chapter\"");
+    }
+
+    else if (strcmp(method, "search") == 0)
+    {
+        char query[128];
+        double limit = RPC_DEFAULT_LIMIT;
+        json_get_number(request, "limit", &limit);
+
+        bible_conn *conn = get_connection(session, translation);
+        if (!json_get_string(request, "query", query, sizeof(query)) || query[0] == '\0')
+            write_error(out, id, "expected \"query\"");
+        else if (conn == NULL)
+            write_error(out, id, "couldn't open translation");
+        else
+        {
+            bible_results *results = json_get_bool(request, "fuzzy") ? bible_search_fuzzy(conn, query, 0, limit, NULL) : bible_search(conn, query, limit);
+
+            fprintf(out, "{\"id\":%s,\"result\":{\"results\":[", id);
+            for (size_t i = 0; results != NULL && i < results->count; i++)
+            {
+                const bible_hit *hit = &results->hits[i];
+
+                fprintf(out, "%s{\"book\":", (i > 0) ? "," : "");
+                json_write_string(out, hit->book);
+                fprintf(out, ",\"chapter\":%i,\"verse\":%i,\"text\":", BIBLE_REF_CHAPTER(hit->ref), BIBLE_REF_VERSE(hit->ref));
+                write_verse_text(out, hit->text);
+                fputc('}', out);
+            }
+            fputs("]}}\n", out);
+
+            bible_results_free(results);
+        }
+    }
+
+    else
+    {
+        write_error(out, id, "unknown method");
+    }
+}
+
+void rpc_close(RpcSession *session)
+{
+    for (size_t i = 0; i < session->count; i++)
+        bible_conn_close(session->open[i]);
+
+    session->count = 0;
+}
@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include "../libbible/bible.h"
+
+#define RPC_MAX_CONNECTIONS 16
+
+// Connections kept open by one worker thread between requests
+typedef struct
+{
+    // Shared by all sessions (so is its chapter cache)
+    bible_ctx *ctx;
+
+    bible_conn *open[RPC_MAX_CONNECTIONS];
+    size_t count;
+} RpcSession;
+
+// Answer one JSON request line, e.g. {"id": 1, "method": "lookup", "ref": "John 3:16"}
+// and write a one-line JSON response (tagged with the same id) to [out]
+//
+// Methods (all take an optional "translation"):
+//  lookup       {"ref": "John 3:16-18"} or a list like {"ref": "Rom 3:23; 6:23"}: the verses come back as
+//               one chapter if they're in one, otherwise as "passages" of one chapter each
+//  range        {"book": "John", "chapter": 3, "from": 16, "to": 18}
+//  chapter      {"book": "John", "chapter": 3}
+//               (lookup, range and chapter also take "raw": true to keep tags and "titles": true for section titles)
+//  search       {"query": "loved the world", "limit": 50}
+//               ("fuzzy": true allows typos, closest matches first)
+//  translations {}
+void rpc_handle(RpcSession *session, const char *request, FILE *out);
+// Close the connections of [session]
+void rpc_close(RpcSession *session);
@@ -0,0 +1,156 @@
+// Allows open_memstream and getline to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "serve.h"
+#include "rpc.h"
+
+#define MAX_JOBS 64
+
+typedef struct Request
+{
+    char *line;
+    struct Request *next;
+} Request;
+
+// Requests waiting for a worker
+static Request *queueHead = NULL, *queueTail = NULL;
+static bool inputClosed = false;
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueReady = PTHREAD_COND_INITIALIZER;
+
+static bible_ctx *ctx = NULL;
+
+// Responses are written one whole line at a time
+static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void push_request(char *line)
+{
+    Request *request = malloc(sizeof(Request));
+    request->line = line, request->next = NULL;
+
+    pthread_mutex_lock(&queueLock);
+    if (queueTail != NULL)
+        queueTail->next = request;
+    else
+        queueHead = request;
+    queueTail = request;
+    pthread_cond_signal(&queueReady);
+    pthread_mutex_unlock(&queueLock);
+}
+
+// Wait for the next request (NULL when there are no more)
+static char *pop_request(void)
+{
+    pthread_mutex_lock(&queueLock);
+    while (queueHead == NULL && !inputClosed)
+        pthread_cond_wait(&queueReady, &queueLock);
+
+    char *line = NULL;
+    Request *request = queueHead;
+    if (request != NULL)
+    {
+        queueHead = request->next;
+        if (queueHead == NULL)
+            queueTail = NULL;
+
+        line = request->line;
+        free(request);
+    }
+    pthread_mutex_unlock(&queueLock);
+
+    return line;
+}
+
+static void *worker_run(void *arg)
+{
+    (void) arg;
+    // Each worker keeps its own connections warm
+    RpcSession session = { .ctx = ctx };
+
+    char *line;
+    while ((line = pop_request()) != NULL)
+    {
+        char *response = NULL;
+        size_t responseLen = 0;
+
+        FILE *out = open_memstream(&response, &responseLen);
+        rpc_handle(&session, line, out);
+        fclose(out);
+
+        // Whichever request finishes first is answered first, the id tells them apart
+        pthread_mutex_lock(&outputLock);
+        fwrite(response, 1, responseLen, stdout);
+        fflush(stdout);
+        pthread_mutex_unlock(&outputLock);
+
+        free(response);
+        free(line);
+    }
+
+    rpc_close(&session);
+
+    return NULL;
+}
+
+int serve_stdio_mode(int argCount, char **args)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = strtol(args[++i], NULL, 10);
+        else
+        {
+            fprintf(stderr, "bible: usage: bible --serve-stdio [--jobs N]\n");
+            return 2;
+        }
+    }
+
+    // At least two workers, so a slow request can't hold up the rest
+    if (jobs < 2) jobs = 2;
+    if (jobs > MAX_JOBS) jobs = MAX_JOBS;
+
+    // Translations and cached chapters are shared by all workers
+    ctx = bible_ctx_new("db");
+
+    pthread_t workers[MAX_JOBS];
+    int started = 0;
+    while (started < jobs && pthread_create(&workers[started], NULL, &worker_run, NULL) == 0)
+        started++;
+    if (started < jobs)
+        fprintf(stderr, "bible: couldn't start worker %i\n", started + 1);
+    if (started == 0)
+    {
+        bible_ctx_free(ctx);
+        return 1;
+    }
+    jobs = started;
+
+    char *line = NULL;
+    size_t lineSize = 0;
+    ssize_t lineLen;
+    while ((lineLen = getline(&line, &lineSize, stdin)) != -1)
+    {
+        // Skip empty lines
+        if (lineLen > 1)
+            push_request(strdup(line));
+    }
+    free(line);
+
+    pthread_mutex_lock(&queueLock);
+    inputClosed = true;
+    pthread_cond_broadcast(&queueReady);
+    pthread_mutex_unlock(&queueLock);
+
+    for (int i = 0; i < jobs; i++)
+        pthread_join(workers[i], NULL);
+
+    bible_ctx_free(ctx);
+
+    return 0;
+}
@@ -0,0 +1,4 @@
+// bible --serve-stdio [--jobs N]
+// Answer JSON-lines requests from stdin on stdout until stdin is closed (returns the exit code)
+// See rpc.h for the requests
+int serve_stdio_mode(int argCount, char **args);
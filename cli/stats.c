@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "../libbible/bible.h"
+
+typedef enum
+{
+    SORT_NONE,
+    SORT_VERSES,
+    SORT_WORDS,
+    SORT_CHARACTERS,
+    SORT_RED
+} Sort;
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double red_share(const bible_stats *stats)
+{
+    return (stats->words > 0) ? (double) stats->redWords / stats->words : 0;
+}
+
+static double sort_key(const bible_stats *stats, Sort sort)
+{
+    switch (sort)
+    {
+        case SORT_VERSES: return stats->verses;
+        case SORT_WORDS: return stats->words;
+        case SORT_CHARACTERS: return stats->characters;
+        case SORT_RED: return red_share(stats);
+        default: return 0;
+    }
+}
+
+static Sort sortBy;
+
+// Most first, then in Bible order
+static int compare_stats(const void *a, const void *b)
+{
+    const bible_stats *statsA = a, *statsB = b;
+    double keyA = sort_key(statsA, sortBy), keyB = sort_key(statsB, sortBy);
+    if (keyA != keyB)
+        return (keyA < keyB) - (keyA > keyB);
+
+    return (statsA->ref > statsB->ref) - (statsA->ref < statsB->ref);
+}
+
+int stats_mode(int argCount, char **args)
+{
+    const char *translation = NULL;
+    int limit = 0, jobs = 0;
+    bool books = false;
+    sortBy = SORT_NONE;
+
+    static const char *sortNames[] = { "", "verses", "words", "characters", "red" };
+    for (int i = 0; i < argCount; i++)
+    {
+        bool known = true;
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "-n") == 0 && i + 1 < argCount)
+            limit = atoi(args[++i]);
+        else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argCount)
+            jobs = atoi(args[++i]);
+        else if (strcmp(args[i], "--books") == 0)
+            books = true;
+        else if (strcmp(args[i], "--sort") == 0 && i + 1 < argCount)
+        {
+            i++;
+            known = false;
+            for (Sort s = SORT_VERSES; s <= SORT_RED; s++)
+                if (strcmp(args[i], sortNames[s]) == 0)
+                    sortBy = s, known = true;
+        }
+        else
+            known = false;
+
+        if (!known)
+        {
+            fprintf(stderr, "bible: usage: bible --stats [--translation NAME] [--books] [--sort verses|words|characters|red] [-n N] [--jobs N]\n");
+            return 2;
+        }
+    }
+
+    bible_ctx *ctx = bible_ctx_new("db");
+    if (translation == NULL)
+        translation = bible_translation_name(ctx, 0);
+
+    bible_conn *conn = bible_conn_open(ctx, translation);
+    if (conn == NULL)
+    {
+        fprintf(stderr, "bible: couldn't open translation \"%s\"\n", translation);
+        bible_ctx_free(ctx);
+        return 1;
+    }
+
+    // Counted (or loaded) once, then every question is answered from the table
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool counted = bible_stats_build(conn, jobs);
+    double countTime = seconds_since(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bible_stats_table *table = counted ? bible_stats_table_get(conn, books) : NULL;
+    if (table != NULL && sortBy != SORT_NONE)
+        qsort(table->stats, table->count, sizeof(bible_stats), &compare_stats);
+    double queryTime = seconds_since(&start);
+
+    int lastBook = 0;
+    char bookName[40] = "";
+    for (size_t i = 0; table != NULL && i < table->count && (limit <= 0 || (int) i < limit); i++)
+    {
+        const bible_stats *stats = &table->stats[i];
+        int book = BIBLE_REF_BOOK(stats->ref);
+        if (book != lastBook)
+        {
+            if (!bible_book_name(conn, book, bookName, sizeof(bookName)))
+                snprintf(bookName, sizeof(bookName), "%s", bible_book_title(book));
+            lastBook = book;
+        }
+
+        if (books)
+            printf("%s", bookName);
+        else
+            printf("%s %i", bookName, BIBLE_REF_CHAPTER(stats->ref));
+        printf("\t%u verses\t%u words\t%u characters\t%.1f min\t%.1f%% red\n",
+            stats->verses, stats->words, stats->characters, stats->minutes, red_share(stats) * 100);
+    }
+
+    if (table != NULL)
+        fprintf(stderr, "bible: %zu %s in %.0f µs (counted or loaded in %.3f s)\n", table->count, books ? "books" : "chapters",
+            queryTime * 1e6, countTime);
+    else
+        fprintf(stderr, "bible: couldn't count the chapters of %s\n", translation);
+    bible_stats_table_free(table);
+
+    bible_conn_close(conn);
+    bible_ctx_free(ctx);
+
+    return (table != NULL) ? 0 : 1;
+}
@@ -0,0 +1,4 @@
+// bible --stats [--translation NAME] [--books] [--sort verses|words|characters|red] [-n N] [--jobs N]
+// Print the counts of every chapter (or book): verses, words, characters, reading time and share of red
+// letters, in Bible order or most first. Returns the exit code
+int stats_mode(int argCount, char **args);
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "versification.h"
+#include "../libbible/bible.h"
+
+// Every verse of a translation, in Bible order
+typedef struct
+{
+    size_t count, size;
+    bible_ref *refs;
+} VerseList;
+
+static void add_verse(bible_ref ref, const char *text, void *data)
+{
+    (void) text;
+    VerseList *verses = data;
+
+    if (verses->count == verses->size)
+    {
+        verses->size = (verses->size == 0) ? 4096 : verses->size * 2;
+        verses->refs = realloc(verses->refs, verses->size * sizeof(bible_ref));
+    }
+    verses->refs[verses->count++] = ref;
+}
+
+static VerseList list_verses(bible_conn *conn)
+{
+    VerseList verses = { 0 };
+    for (int book = 1; book <= BIBLE_BOOK_COUNT; book++)
+        bible_each_verse(conn, book, &add_verse, &verses);
+
+    return verses;
+}
+
+static bool has_verse(const VerseList *verses, bible_ref ref)
+{
+    size_t low = 0, high = verses->count;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (verses->refs[mid] < ref)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low < verses->count && verses->refs[low] == ref;
+}
+
+// Last verse of [ref]'s range, if it runs on to the end of the chapter
+static int last_verse(bible_conn *conn, bible_ref ref)
+{
+    if (BIBLE_REF_VERSE(ref) != BIBLE_REF_END)
+        return BIBLE_REF_VERSE(ref);
+
+    return bible_verse_count(conn, ref);
+}
+
+// e.g. "Malachi 3:19-24 = 4:1-6"
+static void print_renumbering(bible_conn *conn, const bible_renumbering *r)
+{
+    int last = last_verse(conn, r->last);
+    int standardLast = BIBLE_REF_VERSE(r->standard) + (last - BIBLE_REF_VERSE(r->first));
+
+    printf("  %s %i:%i", bible_book_title(BIBLE_REF_BOOK(r->first)), BIBLE_REF_CHAPTER(r->first), BIBLE_REF_VERSE(r->first));
+    if (last > BIBLE_REF_VERSE(r->first))
+        printf("-%i", last);
+    printf(" = %i:%i", BIBLE_REF_CHAPTER(r->standard), BIBLE_REF_VERSE(r->standard));
+    if (standardLast > BIBLE_REF_VERSE(r->standard))
+        printf("-%i", standardLast);
+    putchar('\n');
+}
+
+static void print_ref(const char *label, bible_ref ref)
+{
+    printf("    %s %s %i:%i\n", label, bible_book_title(BIBLE_REF_BOOK(ref)), BIBLE_REF_CHAPTER(ref), BIBLE_REF_VERSE(ref));
+}
+
+int versification_mode(int argCount, char **args)
+{
+    const char *translation = NULL;
+    bool verbose = false;
+
+    for (int i = 0; i < argCount; i++)
+    {
+        if (strcmp(args[i], "--translation") == 0 && i + 1 < argCount)
+            translation = args[++i];
+        else if (strcmp(args[i], "-v") == 0)
+            verbose = true;
+        else
+        {
+            fprintf(stderr, "bible: usage: bible --versification [--translation NAME] [-v]\n");
+            return 2;
+        }
+    }
+
+    bible_ctx *ctx = bible_ctx_new("db");
+    size_t count = bible_translation_count(ctx);
+
+    bible_conn **conns = calloc(count, sizeof(bible_conn*));
+    VerseList *verses = calloc(count, sizeof(VerseList));
+    int status = 0;
+
+    for (size_t t = 0; t < count; t++)
+    {
+        const char *name = bible_translation_name(ctx, t);
+        if ((conns[t] = bible_conn_open(ctx, name)) == NULL)
+        {
+            fprintf(stderr, "bible: couldn't open translation \"%s\"\n", name);
+            status = 1;
+            continue;
+        }
+        verses[t] = list_verses(conns[t]);
+
+        if (translation != NULL && strcmp(name, translation) != 0)
+            continue;
+
+        const bible_renumbering *renumberings;
+        size_t renumberingCount = bible_versification(conns[t], &renumberings);
+        printf("%s: %zu verses, ", name, verses[t].count);
+        if (renumberingCount == 0)
+            printf("standard numbering\n");
+        else
+            printf("%zu passage%s numbered differently\n", renumberingCount, (renumberingCount == 1) ? "" : "s");
+
+        for (size_t i = 0; i < renumberingCount; i++)
+            print_renumbering(conns[t], &renumberings[i]);
+    }
+
+	// Every verse of each translation, mapped to every other one and back
+    size_t mapped = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t from = 0; from < count; from++)
+    {
+        if (conns[from] == NULL || (translation != NULL && strcmp(bible_translation_name(ctx, from), translation) != 0))
+            continue;
+
+        for (size_t to = 0; to < count; to++)
+        {
+            if (to == from || conns[to] == NULL)
+                continue;
+
+            size_t missing = 0, changed = 0;
+            for (size_t i = 0; i < verses[from].count; i++)
+            {
+                bible_ref ref = verses[from].refs[i];
+                bible_ref other = bible_map_verse(conns[from], conns[to], ref);
+                bible_ref back = bible_map_verse(conns[to], conns[from], other);
+                mapped += 2;
+
+                if (!has_verse(&verses[to], other))
+                {
+                    missing++;
+                    if (verbose)
+                        print_ref("not there:", ref);
+                }
+                else if (back != ref)
+                {
+                    changed++;
+                    if (verbose)
+                        print_ref("maps back elsewhere:", ref);
+                }
+            }
+
+            printf("%s -> %s: %zu not in %s, %zu map back to another verse\n", bible_translation_name(ctx, from),
+                bible_translation_name(ctx, to), missing, bible_translation_name(ctx, to), changed);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (mapped > 0)
+        fprintf(stderr, "bible: mapped %zu verses in %.3f s (%.0f ns each)\n", mapped, seconds, seconds * 1e9 / mapped);
+
+    for (size_t t = 0; t < count; t++)
+    {
+        free(verses[t].refs);
+        bible_conn_close(conns[t]);
+    }
+    free(verses);
+    free(conns);
+    bible_ctx_free(ctx);
+
+    return status;
+}
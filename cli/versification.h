@@ -0,0 +1,5 @@
+// bible --versification [--translation NAME] [-v]
+// Print the verses each translation (or just NAME) numbers differently from the standard (KJV) numbering,
+// then check the mapping between every pair of translations: how many verses land on a verse the other
+// translation doesn't have, and how many don't map back to themselves (-v lists them). Returns the exit code
+int versification_mode(int argCount, char **args);
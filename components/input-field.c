@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -61,6 +62,9 @@ static InputField* inf_new(Rect rect, const char *placeholder)
     */
     inf->wasTyping = false;
 
+    inf->onTextChanged = NULL;
+    inf->hint[0] = '\0';
+
     // Add input field to [infs] array
     infs[infsIndex] = inf;
 
@@ -170,6 +174,47 @@ static void inf_border(WINDOW *win, bool add)
     wrefresh(win);
 }
 
+// Draw [hint] after the text (or only rub out the previous one if it's empty), leaving the cursor where it was
+static void inf_draw_hint(InputField *inf)
+{
+    WINDOW *win = inf->win;
+    int y = getcury(win), x = getcurx(win);
+    // Up to the right border
+    int room = inf->winDim.w - 1 - x;
+
+    for (int i = 0; i < room; i++)
+        waddch(win, ' ');
+
+    if (room > 0 && inf->hint[0] != '\0')
+    {
+        wattron(win, A_DIM);
+        mvwaddnstr(win, y, x, inf->hint, room);
+        wattroff(win, A_DIM);
+    }
+
+    wmove(win, y, x);
+    wrefresh(win);
+}
+
+// Remove the hint of [inf] (its text changed or it lost focus)
+static void inf_clear_hint(InputField *inf)
+{
+    if (inf->hint[0] != '\0')
+    {
+        inf->hint[0] = '\0';
+        wmove(inf->win, 1, 1 + inf->strLen);
+        inf_draw_hint(inf);
+    }
+}
+
+// Text of [inf] was changed by the user
+static void inf_text_changed(InputField *inf)
+{
+    inf_clear_hint(inf);
+    if (inf->textField && inf->onTextChanged != NULL)
+        (*inf->onTextChanged)(inf->str);
+}
+
 // Clear input field text [str] and update it on the terminal
 static void inf_clear(InputField *inf)
 {
@@ -178,6 +223,9 @@ static void inf_clear(InputField *inf)
         // Remove border
         inf_border(infs[currentFocusIndex]->win, false);
 
+        // Remove the hint first (it's after the text)
+        inf_clear_hint(inf);
+
         // Remove previous input field text displayed in the terminal
         for (int i = 0; i < inf->strLen; i++)
             mvwdelch(inf->win, getcury(inf->win), getcurx(inf->win) - 1);
@@ -300,6 +348,8 @@ void inf_switch_focus(size_t i)
     {
         // Remove border from current focused window
         inf_border(infs[currentFocusIndex]->win, false);
+        // Its hint is only for when it's being typed in
+        inf_clear_hint(infs[currentFocusIndex]);
         // Reset [wasTyping]
         infs[currentFocusIndex]->wasTyping = false;
         
@@ -445,6 +495,8 @@ void inf_update(int ch)
                 inf->str[inf->strLen - 1] = '\0';
                 // Update length
                 inf->strLen--;
+
+                inf_text_changed(inf);
             }
 
             return;
@@ -493,11 +545,34 @@ void inf_update(int ch)
                 strncat(inf->str, &c, 1);
                 // Update string length
                 inf->strLen++;
+
+                inf_text_changed(inf);
             }
         }
     }
 }
 
+// Call [onTextChanged] every time the user changes the text of the [i]th text field
+void inf_set_on_change(size_t i, void (*onTextChanged)(const char*))
+{
+    if (i < infsIndex && infs[i]->textField)
+        infs[i]->onTextChanged = onTextChanged;
+}
+
+// Show [hint] dimmed after the text of the [i]th input field
+void inf_set_hint(size_t i, const char *hint)
+{
+    if (i < infsIndex)
+    {
+        InputField *inf = infs[i];
+        snprintf(inf->hint, sizeof(inf->hint), "%s", hint);
+
+        // Drawn after the text, wherever the cursor of the window is
+        wmove(inf->win, 1, 1 + inf->strLen);
+        inf_draw_hint(inf);
+    }
+}
+
 // Get value from [i]th text field
 const char* inf_get_text_value(size_t i)
 {
@@ -50,6 +50,11 @@ typedef struct
         bool (*onEnterPressedNum)(float);
     };
 
+    // Called after each key that changes the text of a text field (can be NULL)
+    void (*onTextChanged)(const char*);
+    // Dimmed text shown after the typed text e.g. the rest of a suggestion (not part of [str])
+    char hint[128];
+
     bool textField, wasTyping;
     
     char str[];
@@ -91,6 +96,10 @@ bool inf_set_text_value(size_t index, const char *newText);
 bool inf_set_number_value(size_t index, float newNumber);
 // Switch focus to a [index]th input field, so user can type
 void inf_switch_focus(size_t index);
+// Call [onTextChanged] with the text of the [index]th text field every time the user changes it
+void inf_set_on_change(size_t index, void (*onTextChanged)(const char*));
+// Show [hint] dimmed after the text of the [index]th input field until the text changes (can be empty)
+void inf_set_hint(size_t index, const char *hint);
 // Get value from [index]th text field
 const char* inf_get_text_value(size_t index);
 // Get value from [index]th number field
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "list-view.h"
+
+static MEVENT mouseEvent;
+
+ListView *lv_new(Rect rect, void (*drawItem)(WINDOW*, size_t, int, void*), void *data)
+{
+    assert(rect.w > 0 && rect.h > 0 && drawItem != NULL);
+
+    ListView *lv = calloc(1, sizeof(ListView));
+
+    lv->win = newwin(rect.h, rect.w, rect.y, rect.x);
+    lv->winDim = rect;
+    lv->drawItem = drawItem;
+    lv->data = data;
+
+    keypad(lv->win, true); // Allow arrow keys
+
+    return lv;
+}
+
+void lv_set_count(ListView *lv, size_t count)
+{
+    lv->count = count;
+    lv->selected = 0, lv->top = 0;
+}
+
+void lv_select(ListView *lv, size_t index)
+{
+    if (lv->count == 0)
+        return;
+
+    if (index >= lv->count)
+        index = lv->count - 1;
+    lv->selected = index;
+
+    // Scroll so the selected item is on screen
+    if (lv->selected < lv->top)
+        lv->top = lv->selected;
+    else if (lv->selected >= lv->top + lv->winDim.h)
+        lv->top = lv->selected - lv->winDim.h + 1;
+}
+
+void lv_draw(ListView *lv)
+{
+    werase(lv->win);
+
+    // Only the items that fit in the window are drawn
+    for (int row = 0; row < lv->winDim.h && lv->top + row < lv->count; row++)
+    {
+        size_t index = lv->top + row;
+
+        wmove(lv->win, row, 0);
+        if (index == lv->selected)
+            wattron(lv->win, A_REVERSE);
+
+        lv->drawItem(lv->win, index, lv->winDim.w, lv->data);
+
+        // Fill the rest of the selected line
+        if (index == lv->selected)
+        {
+            for (int x = getcurx(lv->win); x < lv->winDim.w && getcury(lv->win) == row; x++)
+                waddch(lv->win, ' ');
+            wattroff(lv->win, A_REVERSE);
+        }
+    }
+
+    wrefresh(lv->win);
+}
+
+bool lv_handle_key(ListView *lv, int ch)
+{
+    size_t page = lv->winDim.h;
+
+    if (ch == KEY_UP)
+        lv_select(lv, (lv->selected > 0) ? lv->selected - 1 : 0);
+    else if (ch == KEY_DOWN)
+        lv_select(lv, lv->selected + 1);
+    else if (ch == KEY_PPAGE)
+        lv_select(lv, (lv->selected > page) ? lv->selected - page : 0);
+    else if (ch == KEY_NPAGE)
+        lv_select(lv, lv->selected + page);
+    else if (ch == KEY_HOME)
+        lv_select(lv, 0);
+    else if (ch == KEY_END)
+        lv_select(lv, (lv->count > 0) ? lv->count - 1 : 0);
+    // Scroll wheel
+    else if (ch == KEY_MOUSE && getmouse(&mouseEvent) == OK
+        && (mouseEvent.bstate & BUTTON4_PRESSED || mouseEvent.bstate & BUTTON5_PRESSED))
+        lv_select(lv, (mouseEvent.bstate & BUTTON4_PRESSED)
+            ? ((lv->selected > 3) ? lv->selected - 3 : 0)
+            : lv->selected + 3);
+    else
+        return false;
+
+    lv_draw(lv);
+
+    return true;
+}
+
+void lv_print_clipped(WINDOW *win, const char *str, int width)
+{
+    int columns = 0;
+    const char *end = str;
+
+    // Count characters, not bytes (UTF-8 continuation bytes start with 10xxxxxx)
+    while (*end != '\0')
+    {
+        if (((unsigned char) *end & 0xC0) != 0x80)
+        {
+            if (columns == width)
+                break;
+            columns++;
+        }
+        end++;
+    }
+
+    waddnstr(win, str, end - str);
+}
+
+void lv_free(ListView *lv)
+{
+    if (lv != NULL)
+    {
+        delwin(lv->win);
+        free(lv);
+    }
+}
@@ -0,0 +1,50 @@
+#include <ncurses.h>
+
+#ifndef INF_RECT
+#define INF_RECT
+
+typedef struct
+{
+    int w, h, x, y;
+} Rect;
+#endif
+
+#ifndef LIST_VIEW
+#define LIST_VIEW
+
+// Scrollable list that only draws the rows on screen, so it costs the same for 10 or 100,000 items
+typedef struct
+{
+    WINDOW *win;
+    Rect winDim;
+
+    size_t count, selected, top;
+
+    // Draws item [index] on the current line of [win] in at most [width] columns
+    void (*drawItem)(WINDOW *win, size_t index, int width, void *data);
+    void *data;
+} ListView;
+#endif
+
+// Create list view
+ListView *lv_new
+(
+    // Position and size
+    Rect rect,
+    // Function that draws one item
+    void (*drawItem)(WINDOW *win, size_t index, int width, void *data),
+    // Passed to [drawItem]
+    void *data
+);
+// Change the number of items (and go back to the first one)
+void lv_set_count(ListView *lv, size_t count);
+// Draw the visible items
+void lv_draw(ListView *lv);
+// Handle arrow keys, page up/down, home/end and the scroll wheel (returns false if [ch] wasn't for the list)
+bool lv_handle_key(ListView *lv, int ch);
+// Select item [index] and scroll to it
+void lv_select(ListView *lv, size_t index);
+// Print [str] (UTF-8) in at most [width] columns
+void lv_print_clipped(WINDOW *win, const char *str, int width);
+// Free up used memory
+void lv_free(ListView *lv);
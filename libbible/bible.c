@@ -0,0 +1,664 @@
+// Allows strndup to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "internal.h"
+
+// SQL queries (in the same order as [Statement])
+static const char *queries[STMT_COUNT] =
+{
+    [STMT_BOOK_NAMES] =
+        "SELECT book_number, short_name, long_name FROM books "
+        "ORDER BY book_number ASC",
+    [STMT_BOOK_NAME] =
+        "SELECT long_name FROM books "
+        "WHERE book_number = ?",
+    [STMT_NEXT_BOOK] =
+        "SELECT book_number, long_name FROM books "
+        "WHERE book_number > ? "
+        "ORDER BY book_number ASC LIMIT 1",
+    [STMT_PREV_BOOK] =
+        "SELECT book_number, long_name FROM books "
+        "WHERE book_number < ? "
+        "ORDER BY book_number DESC LIMIT 1",
+    [STMT_CHAPTER_COUNT] =
+        "SELECT MAX(chapter) FROM verses "
+        "WHERE book_number = ?",
+    [STMT_VERSE_COUNT] =
+        "SELECT MAX(verse) FROM verses "
+        "WHERE book_number = ? AND chapter = ?",
+    [STMT_CHAPTER] =
+        "SELECT verse, text FROM verses "
+        "WHERE book_number = ? AND chapter = ? "
+        "ORDER BY verse ASC",
+    [STMT_TITLES] =
+        "SELECT verse, title FROM stories "
+        "WHERE book_number = ? AND chapter = ? "
+        "ORDER BY verse ASC, order_if_several ASC",
+    // Rowids are VERSE_ID()s
+    [STMT_SEARCH] =
+        "SELECT verses_fts.rowid, books.long_name, verses_fts.text, bm25(verses_fts) AS score "
+        "FROM search.verses_fts "
+        "JOIN books ON books.book_number = verses_fts.rowid / 1000000 "
+        "WHERE verses_fts MATCH ? "
+        "ORDER BY score LIMIT ?",
+    // Used when there's no search index
+    [STMT_SEARCH_SLOW] =
+        "SELECT verses.book_number * 1000000 + verses.chapter * 1000 + verses.verse, books.long_name, verses.text, 0 "
+        "FROM verses "
+        "JOIN books ON verses.book_number = books.book_number "
+        "WHERE verses.text LIKE ? "
+        "ORDER BY verses.book_number, verses.chapter, verses.verse "
+        "LIMIT ?",
+    [STMT_BOOK_VERSES] =
+        "SELECT chapter, verse, text FROM verses "
+        "WHERE book_number = ? "
+        "ORDER BY chapter ASC, verse ASC",
+    // The ranges of bible_get_ranges() (sorted and merged, one book each) are put in a temporary table
+    // and joined with the verses, so only the verses in them are read (with the verses index, if there is one)
+    [STMT_CLEAR_RANGES] =
+        "DELETE FROM temp.ranges",
+    [STMT_ADD_RANGE] =
+        "INSERT INTO temp.ranges VALUES (?, ?, ?, ?, ?)",
+    [STMT_RANGE_VERSES] =
+        "SELECT verses.book_number, verses.chapter, verses.verse, verses.text "
+        "FROM temp.ranges "
+        "JOIN verses ON verses.book_number = ranges.book_number "
+        "AND (verses.chapter, verses.verse) BETWEEN (ranges.first_chapter, ranges.first_verse) AND (ranges.last_chapter, ranges.last_verse) "
+        "ORDER BY ranges.rowid ASC, verses.chapter ASC, verses.verse ASC",
+    [STMT_RANGE_TITLES] =
+        "SELECT stories.book_number, stories.chapter, stories.verse, stories.title "
+        "FROM temp.ranges "
+        "JOIN stories ON stories.book_number = ranges.book_number "
+        "AND (stories.chapter, stories.verse) BETWEEN (ranges.first_chapter, ranges.first_verse) AND (ranges.last_chapter, ranges.last_verse) "
+        "ORDER BY ranges.rowid ASC, stories.chapter ASC, stories.verse ASC, stories.order_if_several ASC",
+    [STMT_ALL_TITLES] =
+        "SELECT book_number, chapter, verse, title FROM stories "
+        "ORDER BY book_number ASC, chapter ASC, verse ASC, order_if_several ASC",
+};
+
+static const char createRanges[] =
+    "CREATE TEMP TABLE IF NOT EXISTS ranges"
+    "(book_number INTEGER, first_chapter INTEGER, first_verse INTEGER, last_chapter INTEGER, last_verse INTEGER)";
+
+static const char storyTableExists[] =
+    "SELECT COUNT(*) FROM sqlite_master "
+    "WHERE type='table' "
+    "AND name='stories'";
+
+bible_ctx *bible_ctx_new(const char *dbDir)
+{
+    bible_ctx *ctx = calloc(1, sizeof(bible_ctx));
+    if (ctx == NULL)
+        return NULL;
+
+    ctx->dbDir = strdup(dbDir);
+    pthread_mutex_init(&ctx->cacheLock, NULL);
+    pthread_mutex_init(&ctx->indexLock, NULL);
+
+    registry_load(ctx);
+
+    return ctx;
+}
+
+void bible_ctx_free(bible_ctx *ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    cache_clear(ctx);
+    word_index_free(ctx->wordIndex);
+    fuzzy_index_free(ctx->fuzzyIndexes);
+    related_index_free(ctx->relatedIndexes);
+    parallel_index_free(ctx->parallelIndexes);
+    stats_index_free(ctx->statsIndexes);
+    versification_free(ctx->versifications);
+    book_index_free(ctx->bookIndexes);
+    title_index_free(ctx->titleIndexes);
+    pthread_mutex_destroy(&ctx->cacheLock);
+    pthread_mutex_destroy(&ctx->indexLock);
+
+    registry_free(ctx);
+    free(ctx->dbDir);
+    free(ctx);
+}
+
+void bible_cache_stats(bible_ctx *ctx, size_t *misses, size_t *hits)
+{
+    pthread_mutex_lock(&ctx->cacheLock);
+    *misses = ctx->misses, *hits = ctx->hits;
+    pthread_mutex_unlock(&ctx->cacheLock);
+}
+
+bible_conn *bible_conn_open(bible_ctx *ctx, const char *name)
+{
+    if (ctx == NULL || name == NULL || name[0] == '\0' || strlen(name) >= sizeof(((bible_conn*) 0)->translation))
+        return NULL;
+
+    bible_conn *conn = calloc(1, sizeof(bible_conn));
+    if (conn == NULL)
+        return NULL;
+
+    conn->ctx = ctx;
+    strcpy(conn->translation, name);
+    conn->translationIndex = bible_translation_index(ctx, name);
+
+	// Path to db
+    char path[strlen(ctx->dbDir) + strlen(name) + sizeof(TRANSLATION_EXTENSION) + 1];
+    translation_path(ctx, name, path, sizeof(path));
+
+	// [lock] keeps threads from using the connection at the same time, so SQLite doesn't need to
+    if (sqlite3_open_v2(path, &conn->db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(conn->db);
+        free(conn);
+        return NULL;
+    }
+
+	// Not every translation has titles
+    sqlite3_stmt *sql;
+    if (sqlite3_prepare_v2(conn->db, storyTableExists, -1, &sql, NULL) == SQLITE_OK
+        && sqlite3_step(sql) == SQLITE_ROW)
+        conn->hasStories = sqlite3_column_int(sql, 0) > 0;
+    sqlite3_finalize(sql);
+
+    pthread_mutex_init(&conn->lock, NULL);
+
+    return conn;
+}
+
+void bible_conn_close(bible_conn *conn)
+{
+    if (conn == NULL)
+        return;
+
+    for (int i = 0; i < STMT_COUNT; i++)
+        sqlite3_finalize(conn->statements[i]);
+
+    sqlite3_close(conn->db);
+    pthread_mutex_destroy(&conn->lock);
+    free(conn);
+}
+
+const char *bible_conn_translation(const bible_conn *conn)
+{
+    return (conn != NULL) ? conn->translation : "";
+}
+
+sqlite3_stmt *statement(bible_conn *conn, Statement id)
+{
+    if (conn->statements[id] == NULL
+        && sqlite3_prepare_v2(conn->db, queries[id], -1, &conn->statements[id], NULL) != SQLITE_OK)
+    {
+        sqlite3_finalize(conn->statements[id]);
+        conn->statements[id] = NULL;
+    }
+
+    return conn->statements[id];
+}
+
+void done(sqlite3_stmt *sql)
+{
+    sqlite3_reset(sql);
+    sqlite3_clear_bindings(sql);
+}
+
+void copy_book_name(char *longName, size_t longNameSize, const unsigned char *name)
+{
+    if (longName == NULL || longNameSize == 0)
+        return;
+
+    snprintf(longName, longNameSize, "%s", (name != NULL) ? (const char*) name : "");
+
+	// Some translations pad the name with whitespace
+    for (size_t n = strlen(longName); n > 0 && isspace((unsigned char) longName[n - 1]); n--)
+        longName[n - 1] = '\0';
+}
+
+// Run a query that takes up to two ints and returns one int
+static int query_int(bible_conn *conn, Statement id, int arg1, int arg2)
+{
+    int result = 0;
+
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = statement(conn, id);
+    if (sql != NULL)
+    {
+        sqlite3_bind_int(sql, 1, arg1);
+        if (sqlite3_bind_parameter_count(sql) > 1)
+            sqlite3_bind_int(sql, 2, arg2);
+
+        if (sqlite3_step(sql) == SQLITE_ROW)
+            result = sqlite3_column_int(sql, 0);
+        done(sql);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    return result;
+}
+
+bool bible_book_name(bible_conn *conn, int book, char *longName, size_t longNameSize)
+{
+    if (conn == NULL || book_number(book) == 0)
+        return false;
+
+	// Names are kept in memory once the translation is asked for one
+    if (book_index_name(conn, book, longName, longNameSize))
+        return true;
+
+    bool found = false;
+
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = statement(conn, STMT_BOOK_NAME);
+    if (sql != NULL)
+    {
+        sqlite3_bind_int(sql, 1, book_number(book));
+        if (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            copy_book_name(longName, longNameSize, sqlite3_column_text(sql, 0));
+            found = true;
+        }
+        done(sql);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    return found;
+}
+
+int bible_adjacent_book(bible_conn *conn, int book, int direction, char *longName, size_t longNameSize)
+{
+    if (conn == NULL)
+        return 0;
+
+    if (direction == 0)
+        return bible_book_name(conn, book, longName, longNameSize) ? book : 0;
+
+    int bookNumber = book_number(book), adjacent = 0;
+
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = statement(conn, (direction > 0) ? STMT_NEXT_BOOK : STMT_PREV_BOOK);
+	// Skipping books that aren't one of the 66
+    while (sql != NULL && adjacent == 0 && (bookNumber > 0 || direction > 0))
+    {
+        sqlite3_bind_int(sql, 1, bookNumber);
+        bookNumber = 0;
+        if (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            bookNumber = sqlite3_column_int(sql, 0);
+            if ((adjacent = book_index(bookNumber)) != 0)
+                copy_book_name(longName, longNameSize, sqlite3_column_text(sql, 1));
+        }
+        done(sql);
+
+        if (bookNumber == 0)
+            break;
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    return adjacent;
+}
+
+int bible_chapter_count(bible_conn *conn, bible_ref ref)
+{
+    int bookNumber = book_number(BIBLE_REF_BOOK(ref));
+    return (conn != NULL && bookNumber > 0) ? query_int(conn, STMT_CHAPTER_COUNT, bookNumber, 0) : 0;
+}
+
+int bible_verse_count(bible_conn *conn, bible_ref ref)
+{
+    int bookNumber = book_number(BIBLE_REF_BOOK(ref));
+    return (conn != NULL && bookNumber > 0) ? query_int(conn, STMT_VERSE_COUNT, bookNumber, BIBLE_REF_CHAPTER(ref)) : 0;
+}
+
+bible_ref bible_adjacent_chapter(bible_conn *conn, bible_ref ref, int direction)
+{
+    int book = BIBLE_REF_BOOK(ref), chapter = BIBLE_REF_CHAPTER(ref);
+    if (conn == NULL || book_number(book) == 0)
+        return 0;
+
+    if (direction > 0 && chapter < bible_chapter_count(conn, ref))
+        return BIBLE_REF(book, chapter + 1, 1);
+    if (direction < 0 && chapter > 1)
+        return BIBLE_REF(book, chapter - 1, 1);
+
+    book = bible_adjacent_book(conn, book, direction, NULL, 0);
+    if (book == 0)
+        return 0;
+
+    return BIBLE_REF(book, (direction > 0) ? 1 : bible_chapter_count(conn, BIBLE_REF(book, 0, 0)), 1);
+}
+
+bible_ref bible_adjacent_verse(bible_conn *conn, bible_ref ref, int direction)
+{
+    if (conn == NULL || book_number(BIBLE_REF_BOOK(ref)) == 0)
+        return 0;
+
+    int verse = BIBLE_REF_VERSE(ref);
+    if (direction > 0 && verse < bible_verse_count(conn, ref))
+        return ref + 1;
+    if (direction < 0 && verse > 1)
+        return ref - 1;
+
+    bible_ref adjacent = bible_adjacent_chapter(conn, ref, direction);
+    if (adjacent == 0 || direction > 0)
+        return adjacent;
+
+	// Last verse of the chapter before
+    int count = bible_verse_count(conn, adjacent);
+    return (count > 0) ? adjacent - 1 + count : 0;
+}
+
+size_t load_chapter(bible_conn *conn, bible_ref chapter, CachedVerse **verses)
+{
+    size_t count = 0, size = 0;
+    *verses = NULL;
+
+    int bookNumber = book_number(BIBLE_REF_BOOK(chapter));
+    if (bookNumber == 0)
+        return 0;
+
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = statement(conn, STMT_CHAPTER);
+    if (sql != NULL)
+    {
+        sqlite3_bind_int(sql, 1, bookNumber);
+        sqlite3_bind_int(sql, 2, BIBLE_REF_CHAPTER(chapter));
+
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            if (count == size)
+            {
+                size = (size == 0) ? 32 : size * 2;
+                *verses = realloc(*verses, size * sizeof(CachedVerse));
+            }
+
+            const unsigned char *text = sqlite3_column_text(sql, 1);
+            (*verses)[count++] = (CachedVerse)
+            {
+                .verse = sqlite3_column_int(sql, 0),
+                .text = strdup((text != NULL) ? (const char*) text : ""),
+                .title = NULL
+            };
+        }
+        done(sql);
+    }
+
+    sql = (count > 0 && conn->hasStories) ? statement(conn, STMT_TITLES) : NULL;
+    if (sql != NULL)
+    {
+        sqlite3_bind_int(sql, 1, bookNumber);
+        sqlite3_bind_int(sql, 2, BIBLE_REF_CHAPTER(chapter));
+
+        // Both lists are sorted by verse
+        size_t i = 0;
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            int verse = sqlite3_column_int(sql, 0);
+            const char *title = (const char*) sqlite3_column_text(sql, 1);
+
+            while (i < count && (*verses)[i].verse < verse) i++;
+            // Only the first title of a verse is shown
+            if (i < count && (*verses)[i].verse == verse && (*verses)[i].title == NULL && title != NULL && title[0] != '\0')
+                (*verses)[i].title = strdup(title);
+        }
+        done(sql);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    return count;
+}
+
+bible_passage *bible_get_passage(bible_conn *conn, bible_ref first, bible_ref last)
+{
+    if (conn == NULL)
+        return NULL;
+
+    bible_ref chapter = first & ~(bible_ref) 0xFF;
+    CachedChapter *cached = cache_get_chapter(conn, chapter);
+    if (cached == NULL)
+        return NULL;
+
+	// Past the chapter is the end of it
+    int verseStart = BIBLE_REF_VERSE(first), verseEnd = (last < chapter + BIBLE_REF_END) ? BIBLE_REF_VERSE(last) : BIBLE_REF_END;
+
+    // Size of the verses that are asked for, so they can be copied into one buffer
+    size_t count = 0, textSize = 0;
+    for (size_t i = 0; i < cached->count; i++)
+    {
+        const CachedVerse *verse = &cached->verses[i];
+        if (verse->verse >= verseStart && verse->verse <= verseEnd)
+        {
+            count++;
+            textSize += strlen(verse->text) + 1 + ((verse->title != NULL) ? strlen(verse->title) + 1 : 0);
+        }
+    }
+
+    bible_passage *passage = NULL;
+    if (count > 0)
+    {
+        passage = malloc(sizeof(bible_passage) + count * sizeof(bible_verse) + textSize);
+        passage->ref = chapter;
+        passage->count = 0;
+        passage->verses = (bible_verse*) (passage + 1);
+        bible_book_name(conn, BIBLE_REF_BOOK(chapter), passage->book, sizeof(passage->book));
+
+        char *text = (char*) (passage->verses + count);
+        for (size_t i = 0; i < cached->count; i++)
+        {
+            const CachedVerse *verse = &cached->verses[i];
+            if (verse->verse < verseStart || verse->verse > verseEnd)
+                continue;
+
+            bible_verse *copy = &passage->verses[passage->count++];
+            copy->verse = verse->verse;
+
+            copy->text = strcpy(text, verse->text);
+            text += strlen(verse->text) + 1;
+
+            copy->title = NULL;
+            if (verse->title != NULL)
+            {
+                copy->title = strcpy(text, verse->title);
+                text += strlen(verse->title) + 1;
+            }
+        }
+    }
+
+    cache_release(conn->ctx, cached);
+
+    return passage;
+}
+
+size_t bible_each_verse(bible_conn *conn, int book, bible_verse_callback callback, void *data)
+{
+    int bookNumber = book_number(book);
+    if (conn == NULL || callback == NULL || bookNumber == 0)
+        return 0;
+
+    size_t count = 0;
+
+	// Straight from the database: whole books would only push chapters out of the cache
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = statement(conn, STMT_BOOK_VERSES);
+    if (sql != NULL)
+    {
+        sqlite3_bind_int(sql, 1, bookNumber);
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            const unsigned char *text = sqlite3_column_text(sql, 2);
+            callback(BIBLE_REF(book, sqlite3_column_int(sql, 0), sqlite3_column_int(sql, 1)), (text != NULL) ? (const char*) text : "", data);
+            count++;
+        }
+        done(sql);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    return count;
+}
+
+void bible_passage_free(bible_passage *passage)
+{
+    // The verses and their text are part of the same allocation
+    free(passage);
+}
+
+// A verse of bible_get_ranges() while they're read (text and title are offsets into one buffer)
+typedef struct
+{
+    bible_ref ref;
+    size_t text, title;
+} RangeVerse;
+
+#define NO_TITLE SIZE_MAX
+
+// Add [str] (with its '\0') to the end of [*buffer] and return where it starts
+static size_t append_text(char **buffer, size_t *length, size_t *size, const unsigned char *str)
+{
+    size_t strLength = (str != NULL) ? strlen((const char*) str) : 0, at = *length;
+    while (*length + strLength + 1 > *size)
+    {
+        *size = (*size == 0) ? 4096 : *size * 2;
+        *buffer = realloc(*buffer, *size);
+    }
+
+    memcpy(*buffer + at, (str != NULL) ? (const char*) str : "", strLength);
+    (*buffer)[at + strLength] = '\0';
+    *length += strLength + 1;
+
+    return at;
+}
+
+// Put sorted [ranges] in the temporary table (one row per book), replacing the last ones (lock must be held)
+static bool add_ranges(bible_conn *conn, const bible_range *ranges, size_t count)
+{
+    if (!conn->hasRanges)
+        conn->hasRanges = sqlite3_exec(conn->db, createRanges, NULL, NULL, NULL) == SQLITE_OK;
+
+    sqlite3_stmt *clear = conn->hasRanges ? statement(conn, STMT_CLEAR_RANGES) : NULL;
+    sqlite3_stmt *add = conn->hasRanges ? statement(conn, STMT_ADD_RANGE) : NULL;
+    if (clear == NULL || add == NULL)
+        return false;
+
+    bool added = sqlite3_step(clear) == SQLITE_DONE;
+    done(clear);
+
+    for (size_t i = 0; added && i < count; i++)
+    {
+        // A range going on into the next books is split at their ends
+        for (int book = BIBLE_REF_BOOK(ranges[i].first); added && book <= BIBLE_REF_BOOK(ranges[i].last); book++)
+        {
+            bible_ref first = (book == BIBLE_REF_BOOK(ranges[i].first)) ? ranges[i].first : BIBLE_REF(book, 1, 1);
+            bible_ref last = (book == BIBLE_REF_BOOK(ranges[i].last)) ? ranges[i].last : BIBLE_REF(book, BIBLE_REF_END, BIBLE_REF_END);
+
+            sqlite3_bind_int(add, 1, book_number(book));
+            sqlite3_bind_int(add, 2, BIBLE_REF_CHAPTER(first));
+            sqlite3_bind_int(add, 3, BIBLE_REF_VERSE(first));
+            sqlite3_bind_int(add, 4, BIBLE_REF_CHAPTER(last));
+            sqlite3_bind_int(add, 5, BIBLE_REF_VERSE(last));
+            added = sqlite3_step(add) == SQLITE_DONE;
+            done(add);
+        }
+    }
+
+    return added;
+}
+
+bible_selection *bible_get_ranges(bible_conn *conn, const bible_range *ranges, size_t count)
+{
+    if (conn == NULL || ranges == NULL || count == 0)
+        return NULL;
+
+    bible_range *merged = malloc(count * sizeof(bible_range));
+    if (merged == NULL)
+        return NULL;
+    memcpy(merged, ranges, count * sizeof(bible_range));
+    count = bible_merge_ranges(merged, count);
+
+    RangeVerse *verses = NULL;
+    size_t verseCount = 0, verseSize = 0;
+    char *buffer = NULL;
+    size_t length = 0, size = 0;
+
+    pthread_mutex_lock(&conn->lock);
+	// The ranges are only written to the temporary database once, when the transaction ends
+    sqlite3_exec(conn->db, "BEGIN", NULL, NULL, NULL);
+
+    sqlite3_stmt *sql = add_ranges(conn, merged, count) ? statement(conn, STMT_RANGE_VERSES) : NULL;
+    if (sql != NULL)
+    {
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            if (verseCount == verseSize)
+            {
+                verseSize = (verseSize == 0) ? 32 : verseSize * 2;
+                verses = realloc(verses, verseSize * sizeof(RangeVerse));
+            }
+
+            verses[verseCount++] = (RangeVerse)
+            {
+                .ref = row_ref(sqlite3_column_int(sql, 0), sqlite3_column_int(sql, 1), sqlite3_column_int(sql, 2)),
+                .text = append_text(&buffer, &length, &size, sqlite3_column_text(sql, 3)),
+                .title = NO_TITLE
+            };
+        }
+        done(sql);
+    }
+
+    sql = (verseCount > 0 && conn->hasStories) ? statement(conn, STMT_RANGE_TITLES) : NULL;
+    if (sql != NULL)
+    {
+        // Both lists are in Bible order
+        size_t i = 0;
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            bible_ref ref = row_ref(sqlite3_column_int(sql, 0), sqlite3_column_int(sql, 1), sqlite3_column_int(sql, 2));
+            const unsigned char *title = sqlite3_column_text(sql, 3);
+
+            while (i < verseCount && verses[i].ref < ref) i++;
+            // Only the first title of a verse is shown
+            if (i < verseCount && verses[i].ref == ref && verses[i].title == NO_TITLE && title != NULL && title[0] != '\0')
+                verses[i].title = append_text(&buffer, &length, &size, title);
+        }
+        done(sql);
+    }
+
+    sqlite3_exec(conn->db, "COMMIT", NULL, NULL, NULL);
+    pthread_mutex_unlock(&conn->lock);
+    free(merged);
+
+	// One allocation, like a passage
+    bible_selection *selection = NULL;
+    if (verseCount > 0)
+        selection = malloc(sizeof(bible_selection) + verseCount * (sizeof(bible_verse) + sizeof(bible_ref)) + length);
+    if (selection != NULL)
+    {
+        selection->count = verseCount;
+        selection->verses = (bible_verse*) (selection + 1);
+        selection->refs = (bible_ref*) (selection->verses + verseCount);
+
+        char *text = memcpy(selection->refs + verseCount, buffer, length);
+        for (size_t i = 0; i < verseCount; i++)
+        {
+            selection->refs[i] = verses[i].ref;
+            selection->verses[i] = (bible_verse)
+            {
+                .verse = BIBLE_REF_VERSE(verses[i].ref),
+                .text = text + verses[i].text,
+                .title = (verses[i].title != NO_TITLE) ? text + verses[i].title : NULL
+            };
+        }
+    }
+
+    free(verses);
+    free(buffer);
+
+    return selection;
+}
+
+void bible_selection_free(bible_selection *selection)
+{
+    // The verses and their text are part of the same allocation
+    free(selection);
+}
@@ -0,0 +1,398 @@
+// libbible: reentrant access to the Bible translations (MyBible SQLite files) in a folder
+//
+// A [bible_ctx] holds the list of translations and a chapter cache shared by everything using it
+// A [bible_conn] is an open translation. Every function taking one is safe to call from any thread
+// (calls on the same connection take turns, so give each busy thread its own connection)
+// Results are returned in buffers owned by the caller
+
+#ifndef LIBBIBLE_H
+#define LIBBIBLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+typedef struct bible_ctx bible_ctx;
+typedef struct bible_conn bible_conn;
+
+// Books as numbered from Genesis (1) to Revelation (66)
+#define BIBLE_BOOK_COUNT 66
+
+// Every verse, chapter (verse 0) and book (chapter 0) is a bible_ref, packed in 32 bits: book (1..66) << 16 |
+// chapter << 8 | verse, so references sort in Bible order and compare as integers
+// In ranges, BIBLE_REF_END as the verse is the end of the chapter (and as the chapter, the end of the book)
+// The translations' own book numbers (MyBible's, e.g. 10 for Genesis) stay inside libbible
+typedef uint32_t bible_ref;
+#define BIBLE_REF(book, chapter, verse) ((bible_ref) (book) << 16 | (bible_ref) (chapter) << 8 | (bible_ref) (verse))
+#define BIBLE_REF_BOOK(ref) ((int) ((ref) >> 16 & 0xFF))
+#define BIBLE_REF_CHAPTER(ref) ((int) ((ref) >> 8 & 0xFF))
+#define BIBLE_REF_VERSE(ref) ((int) ((ref) & 0xFF))
+#define BIBLE_REF_END 0xFF
+
+typedef struct
+{
+    int verse;
+    // Verse text with its tags e.g. <J>, <f>
+    const char *text;
+    // Section title before the verse (NULL if it has none)
+    const char *title;
+} bible_verse;
+
+// Verses of one chapter (free with bible_passage_free())
+typedef struct
+{
+    char book[40];
+    // Book and chapter (verse 0)
+    bible_ref ref;
+
+    size_t count;
+    bible_verse *verses;
+} bible_passage;
+
+typedef struct
+{
+    char book[40];
+    bible_ref ref;
+    // Verse text without tags
+    const char *text;
+    // How well the verse matches (lower is better)
+    double score;
+} bible_hit;
+
+// Search results (free with bible_results_free())
+typedef struct
+{
+    size_t count;
+    bible_hit *hits;
+    // The limit was reached, so there may be more matches
+    bool truncated;
+    // Matched whole words with the search index (rather than plain text, when there's no index)
+    bool indexed;
+} bible_results;
+
+// Verses in Bible order (free with bible_refs_free())
+typedef struct
+{
+    size_t count;
+    bible_ref *refs;
+} bible_refs;
+
+// Verses [first]..[last]
+typedef struct
+{
+    bible_ref first, last;
+} bible_range;
+
+// Verses of several passages (free with bible_selection_free())
+typedef struct
+{
+    size_t count;
+    bible_verse *verses;
+    // Book, chapter and verse of each of [verses]
+    bible_ref *refs;
+} bible_selection;
+
+// What's known about a translation file without opening it (kept in a manifest, see bible_ctx_new())
+typedef struct
+{
+    // File name without ".SQLite3" e.g. "KJV"
+    char name[64];
+    // From the translation's info table ("" if it doesn't say)
+    char language[16], description[112];
+    // Of the file, when it was last read
+    int64_t size, mtime;
+    // Books it has (of the 66), and BIBLE_TRANSLATION_* flags
+    uint16_t bookCount, flags;
+} bible_translation_info;
+
+enum
+{
+    // Has titles (a stories table)
+    BIBLE_TRANSLATION_TITLES = 1,
+    BIBLE_TRANSLATION_OLD_TESTAMENT = 2,
+    BIBLE_TRANSLATION_NEW_TESTAMENT = 4,
+    // The file was removed after the context was made (it keeps its index)
+    BIBLE_TRANSLATION_REMOVED = 8
+};
+
+// Find the translations in [dbDir] (e.g. "db"). Returns NULL if out of memory
+// What's in each file is kept in [dbDir]/.index/translations, so if the folder hasn't changed since, none
+// of them are opened (otherwise only the new and changed ones are)
+bible_ctx *bible_ctx_new(const char *dbDir);
+void bible_ctx_free(bible_ctx *ctx);
+// Look at [dbDir] again for translations added, changed or removed since. Added ones go after the others,
+// so the index of every translation stays the same. Returns true if anything changed
+// (not safe while other threads are using the list of translations of [ctx])
+bool bible_ctx_refresh(bible_ctx *ctx);
+size_t bible_translation_count(const bible_ctx *ctx);
+// Name of the [index]th translation e.g. "KJV" ("" if there's no such translation)
+const char *bible_translation_name(const bible_ctx *ctx, size_t index);
+// What's known about the [index]th translation (NULL if there's no such translation)
+const bible_translation_info *bible_translation(const bible_ctx *ctx, size_t index);
+// Index of translation [name] (-1 if there's no such translation). A hash lookup
+int bible_translation_index(const bible_ctx *ctx, const char *name);
+// Number of chapters read from the databases and served from the cache
+void bible_cache_stats(bible_ctx *ctx, size_t *misses, size_t *hits);
+
+// Open translation [name] (read-only). Returns NULL if it can't be opened
+bible_conn *bible_conn_open(bible_ctx *ctx, const char *name);
+void bible_conn_close(bible_conn *conn);
+const char *bible_conn_translation(const bible_conn *conn);
+
+// A book whose name starts with what's been typed
+typedef struct
+{
+    int book;
+    // The translation's name for it
+    char name[40];
+} bible_book_suggestion;
+
+// Books of [conn]'s translation with a name starting with [typed], best first: the ones named exactly (by
+// the translation or by a standard name or abbreviation like "Jn"), then the ones whose name in the
+// translation starts with it, then the others, each in Bible order. Case, spaces, dots and accents don't
+// matter. Puts up to [max] in [suggestions] and returns how many there are
+size_t bible_suggest_books(bible_conn *conn, const char *typed, bible_book_suggestion *suggestions, size_t max);
+// Book (1..66) of the best suggestion for [name] (see bible_suggest_books()), 0 if there's none
+// Its full name is copied to [longName] if it isn't NULL
+int bible_find_book(bible_conn *conn, const char *name, char *longName, size_t longNameSize);
+// Full name of [book] in [conn]'s translation
+bool bible_book_name(bible_conn *conn, int book, char *longName, size_t longNameSize);
+// The translation's book after ([direction] > 0) or before ([direction] < 0) [book] (0 at the ends, and
+// before the first one), or [book] itself if it has it ([direction] = 0)
+int bible_adjacent_book(bible_conn *conn, int book, int direction, char *longName, size_t longNameSize);
+// Book (1..66) named [length] bytes of [name] e.g. "1 Corinthians", "1 Cor." or "1co" (English names and
+// common abbreviations, otherwise the first book starting with it). 0 if there's none. Doesn't need a translation
+int bible_book_lookup(const char *name, size_t length);
+// English name of [book] (1..66)
+const char *bible_book_title(int book);
+// Parse references like "1 Cor 13:4-7; Jn 3:16, 18; Ps 23" into ranges. A book on its own is the whole book
+// and a chapter on its own the whole chapter. Puts up to [maxRanges] in [ranges] and returns how many
+// there are, or -1 if [text] isn't a list of references
+int bible_parse_references(const char *text, bible_range *ranges, size_t maxRanges);
+// Sort [ranges] and join the ones that overlap or follow on in the same chapter. Returns how many are left
+size_t bible_merge_ranges(bible_range *ranges, size_t count);
+// Verse 1 of the chapter after ([direction] > 0) or before [ref]'s one in [conn]'s translation, going on to
+// the next or previous book at the ends (0 past the first or last chapter)
+bible_ref bible_adjacent_chapter(bible_conn *conn, bible_ref ref, int direction);
+// Verse after ([direction] > 0) or before [ref], going on to the next or previous chapter (0 at the ends)
+bible_ref bible_adjacent_verse(bible_conn *conn, bible_ref ref, int direction);
+// Chapters of [ref]'s book and verses of [ref]'s chapter in [conn]'s translation (0 if it doesn't have them)
+int bible_chapter_count(bible_conn *conn, bible_ref ref);
+int bible_verse_count(bible_conn *conn, bible_ref ref);
+
+// Verses [first]..[last] of [first]'s chapter (a [last] of verse BIBLE_REF_END, or past the chapter, is the
+// end of it). Returns NULL if none of them exist
+bible_passage *bible_get_passage(bible_conn *conn, bible_ref first, bible_ref last);
+void bible_passage_free(bible_passage *passage);
+// The verses in [count] [ranges] (e.g. from bible_parse_references()) in Bible order, each one once
+// They're read in one query that only visits those verses, however many chapters they're spread over
+// Returns NULL if none of them exist
+bible_selection *bible_get_ranges(bible_conn *conn, const bible_range *ranges, size_t count);
+void bible_selection_free(bible_selection *selection);
+// Call [callback] with every verse of [book], in order, with its text as stored (tags included)
+// The connection is locked meanwhile, so [callback] mustn't use it. Returns the number of verses
+typedef void (*bible_verse_callback)(bible_ref ref, const char *text, void *data);
+size_t bible_each_verse(bible_conn *conn, int book, bible_verse_callback callback, void *data);
+
+// Verses containing all the words in [query] (the last one may be unfinished), best matches first
+// Uses a full-text index kept next to the translation (built on first use)
+bible_results *bible_search(bible_conn *conn, const char *query, int limit);
+// Same as bible_search(), but gives up and returns NULL as soon as *[cancel] isn't 0 (set from another thread)
+bible_results *bible_search_cancellable(bible_conn *conn, const char *query, int limit, volatile int *cancel);
+// If [query] only narrows down [previousQuery] (more letters or words were typed), the matches
+// among [previous] without querying the database again. Otherwise (or if [previous] was truncated) NULL
+bible_results *bible_search_refine(const bible_results *previous, const char *previousQuery, const char *query);
+// Verses with a piece of text at most [maxDistance] typos (letters added, removed or changed) away
+// from [query] (0 picks about one per 6 letters), closest first. [score] is the number of typos
+// [cancel] works like in bible_search_cancellable() and can be NULL
+bible_results *bible_search_fuzzy(bible_conn *conn, const char *query, int maxDistance, int limit, volatile int *cancel);
+void bible_results_free(bible_results *results);
+// Build (or rebuild, if the translation changed) the search index of [conn]'s translation
+bool bible_search_index(bible_conn *conn);
+
+// The [limit] verses of [conn]'s translation that share the most (rare) words with verse [ref] (TF-IDF),
+// most related first. Returns NULL if there's no such verse
+// The matrix is built the first time (and whenever the translation changes) and kept in [dbDir]/.index
+bible_results *bible_related(bible_conn *conn, bible_ref ref, int limit);
+// Related verses of each of [count] verses [refs] on [threads] threads (0 = one per core)
+// [out] gets [limit] verses per verse, most related first (0 where there are fewer)
+bool bible_related_batch(bible_conn *conn, const bible_ref *refs, size_t count, int limit, int threads, bible_ref *out);
+
+// Passage [first..last] that nearly repeats [otherFirst..otherLast]
+typedef struct
+{
+    bible_ref first, last, otherFirst, otherLast;
+    // Estimated share of 3-word pieces they have in common (0..1)
+    float similarity;
+} bible_parallel;
+typedef struct
+{
+    size_t count;
+    bible_parallel *parallels;
+} bible_parallels;
+
+// Find the parallel passages of [conn]'s translation (MinHash) on [threads] threads (0 = one per core)
+// They're kept in [dbDir]/.index and only found again if the translation changed
+bool bible_parallels_build(bible_conn *conn, int threads);
+// Parallel passages in (or reaching into) [chapter]'s chapter (every one if [chapter] is 0), by first verse
+// Returns NULL if they haven't been found with bible_parallels_build() (it's never done here)
+bible_parallels *bible_get_parallels(bible_conn *conn, bible_ref chapter);
+void bible_parallels_free(bible_parallels *parallels);
+
+// Average silent reading speed, for reading times
+#define BIBLE_WORDS_PER_MINUTE 238
+
+// Counts of a chapter (or a whole book if [ref]'s chapter is 0), without notes and tags
+typedef struct
+{
+    bible_ref ref;
+    uint32_t verses, words, characters;
+    // Words of Jesus (inside <J></J>)
+    uint32_t redWords;
+    float minutes;
+} bible_stats;
+typedef struct
+{
+    size_t count;
+    bible_stats *stats;
+} bible_stats_table;
+
+// Count every chapter of [conn]'s translation on [threads] threads (0 = one per core)
+// The counts are kept in [dbDir]/.index and only counted again if the translation changed
+bool bible_stats_build(bible_conn *conn, int threads);
+// Counts of [ref]'s chapter (the whole book if its chapter is 0). Counts the translation the first time
+bool bible_stats_get(bible_conn *conn, bible_ref ref, bible_stats *stats);
+// Counts of every chapter (or every book), in Bible order
+bible_stats_table *bible_stats_table_get(bible_conn *conn, bool books);
+void bible_stats_table_free(bible_stats_table *table);
+
+// Verses a translation numbers differently from the standard (KJV) numbering: its verses [first..last] are the
+// standard's from [standard] on (in one chapter). The other numbering is mostly the Hebrew one, e.g. Malachi
+// 3:19-24 for 4:1-6, Joel 3 for 2:28-32 and Psalm titles as verse 1
+typedef struct
+{
+    bible_ref first, last, standard;
+} bible_renumbering;
+
+// [ref] of [conn]'s translation in the standard numbering, and the other way round
+// How the translation numbers its verses is worked out the first time (lookups are binary searches)
+bible_ref bible_to_standard(bible_conn *conn, bible_ref ref);
+bible_ref bible_from_standard(bible_conn *conn, bible_ref ref);
+// Verse [ref] of [from]'s translation as [to]'s translation numbers it
+bible_ref bible_map_verse(bible_conn *from, bible_conn *to, bible_ref ref);
+// The verses [conn]'s translation numbers differently, sorted (owned by the context). Returns how many
+size_t bible_versification(bible_conn *conn, const bible_renumbering **renumberings);
+
+// Build the word index of every translation (kept in [dbDir]/.index) on [threads] threads (0 = one per core)
+// It's only rebuilt if a translation changed. Returns false if it can't be built
+bool bible_index_build(bible_ctx *ctx, int threads);
+// Verses matching [query] across translations, e.g. "NKJV:grace NOT MSG:grace" or "faith NEAR/5 works"
+// Words can be joined with AND (or spaces), OR, NOT, NEAR/n (words apart) and brackets. Words without a
+// translation ("KJV:word" or "KJV:( ... )") are looked up in [translation] (the first one if NULL)
+// Returns NULL with a message in [error] if the query is invalid. Builds the index the first time
+bible_refs *bible_index_query(bible_ctx *ctx, const char *query, const char *translation, char *error, size_t errorSize);
+void bible_refs_free(bible_refs *refs);
+
+// Where a word is in one book (verses [first]..[first + count - 1] of a bible_concordance)
+typedef struct
+{
+    int book;
+    size_t first, count;
+    // Times the word is used in the book
+    size_t occurrences;
+} bible_book_range;
+
+// Every verse of a translation with a word in it (free with bible_concordance_free())
+typedef struct
+{
+    size_t count;
+    // In Bible order
+    bible_ref *refs;
+    // Word number of the first use in each verse (see bible_word_offset())
+    uint32_t *positions;
+    // Times the word is used in all of them
+    size_t occurrences;
+
+    size_t bookCount;
+    bible_book_range *books;
+} bible_concordance;
+
+// Look up [word] in the word index (built the first time) for [translation] (NULL is the first one)
+// Returns NULL if the translation never uses it
+bible_concordance *bible_concordance_get(bible_ctx *ctx, const char *word, const char *translation);
+void bible_concordance_free(bible_concordance *concordance);
+
+// Copy verse [text] to [out] without tags, footnotes or notes. Returns the length of [out]
+size_t bible_strip_tags(const char *text, char *out, size_t outSize);
+// Same as bible_strip_tags(), but keeps the text of footnotes and notes
+size_t bible_strip_tags_keep_notes(const char *text, char *out, size_t outSize);
+// Byte offset of word number [position] of [text] (stripped of tags), as the word index counts them
+// Sets [length] to its length in bytes. Returns -1 if there aren't that many words
+long bible_word_offset(const char *text, uint32_t position, size_t *length);
+
+// Section titles of a translation e.g. "The Sermon on the Mount" at Matthew 5:1
+typedef struct
+{
+    bible_ref ref;
+    // Of the title, in the outline's [text]
+    uint32_t offset;
+} bible_section;
+
+typedef struct
+{
+    size_t count;
+    // Sorted by verse (several titles of one verse in the translation's order)
+    const bible_section *sections;
+    const char *text;
+} bible_outline;
+
+// Sections of [conn]'s translation, without tags (read with one query the first time, and owned by the context)
+// Returns false if they can't be read. A translation without titles has none
+bool bible_outline_get(bible_conn *conn, bible_outline *outline);
+// First section at or after [ref] ([outline]'s count if there's none), a binary search. The sections of
+// a book are from the one of BIBLE_REF(book, 0, 0) to the one of the next book's
+size_t bible_outline_find(const bible_outline *outline, bible_ref ref);
+
+// Bookmarks (of verses) and highlights (of words of verses), in a SQLite database of the user's
+// Verses are in the standard (KJV) numbering, so bookmarks are the same in every translation.
+// Words are numbered from 0 as a verse is shown (separated by spaces, without the verse number)
+typedef struct bible_notes bible_notes;
+
+typedef struct
+{
+    bible_ref ref;
+    uint16_t firstWord, lastWord;
+} bible_highlight;
+
+// Annotations of some verses (free with bible_annotations_free())
+typedef struct
+{
+    // Bookmarked verses, sorted
+    size_t bookmarkCount;
+    bible_ref *bookmarks;
+    // Highlighted words, sorted by verse and then word, and not overlapping
+    size_t highlightCount;
+    bible_highlight *highlights;
+} bible_annotations;
+
+// Open (or make) the database at [path]. Returns NULL if it can't be opened
+bible_notes *bible_notes_open(const char *path);
+void bible_notes_close(bible_notes *notes);
+// Bookmarks of verses [first]..[last] and highlights of [translation] in them, with one query each
+bible_annotations *bible_annotations_get(bible_notes *notes, const char *translation, bible_ref first, bible_ref last);
+void bible_annotations_free(bible_annotations *annotations);
+// Bookmark [ref], or remove its bookmark. Returns whether it's bookmarked now
+bool bible_bookmark_toggle(bible_notes *notes, bible_ref ref);
+// Highlight words [firstWord]..[lastWord] of [ref] in [translation], or clear them if they all are already
+// Returns false if the database couldn't be changed
+bool bible_highlight_toggle(bible_notes *notes, const char *translation, bible_ref ref, uint16_t firstWord, uint16_t lastWord);
+
+// Start [function]([data]) on [count] threads, into [workers], or run it here if none can start
+// Returns how many started, to wait for with bible_threads_join()
+int bible_threads_start(pthread_t *workers, int count, void *(*function)(void*), void *data);
+void bible_threads_join(pthread_t *workers, int started);
+// Run [function]([data]) on [threads] threads (0 = one per core) and wait for them
+void bible_threads_run(int threads, void *(*function)(void*), void *data);
+
+#endif
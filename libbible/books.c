@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+// Book names of each translation, for suggestions as a book is typed
+//
+// The translation's own names (long and short, so localized ones too) and the standard names and
+// abbreviations go into one array sorted by key, made the first time the translation is asked. Every name
+// starting with what's typed is then next to each other, found with one binary search
+
+// Where a name comes from, best first (when nothing is typed exactly)
+enum
+{
+    LONG_NAME,
+    OTHER_NAME
+};
+
+typedef struct
+{
+    // Lower case, without spaces, dots and accents (see fold_name())
+    char key[40];
+    uint8_t book, source;
+} BookName;
+
+struct BookIndex
+{
+    char translation[64];
+    BookIndex *next;
+
+    size_t count;
+    BookName *names;
+    // The translation's name of each book 1..66 ("" if it doesn't have the book)
+    char longNames[BIBLE_BOOK_COUNT + 1][40];
+};
+
+// [name] the way keys are compared e.g. "1 Corinthians" -> "1corinthians", "Génesis" -> "genesis"
+static size_t fold_name(const char *name, char *key, size_t keySize)
+{
+    size_t length = 0;
+    bool unknown;
+    char word[40];
+
+    for (size_t wordLength; (wordLength = next_word(&name, word, sizeof(word), &unknown)) > 0; )
+    {
+        if (length + wordLength >= keySize)
+            break;
+        memcpy(&key[length], word, wordLength);
+        length += wordLength;
+    }
+    key[length] = '\0';
+
+    return length;
+}
+
+static void add_name(BookIndex *index, size_t *capacity, int book, const char *name, uint8_t source)
+{
+    if (index->count == *capacity)
+    {
+        size_t newCapacity = (*capacity == 0) ? 512 : *capacity * 2;
+        BookName *names = realloc(index->names, newCapacity * sizeof(BookName));
+        if (names == NULL)
+            return;
+        index->names = names, *capacity = newCapacity;
+    }
+
+    BookName *entry = &index->names[index->count];
+    if (fold_name(name, entry->key, sizeof(entry->key)) == 0)
+        return;
+    entry->book = book;
+    entry->source = source;
+    index->count++;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(((const BookName*) a)->key, ((const BookName*) b)->key);
+}
+
+static BookIndex *build_book_index(bible_conn *conn)
+{
+    BookIndex *index = calloc(1, sizeof(BookIndex));
+    if (index == NULL)
+        return NULL;
+    snprintf(index->translation, sizeof(index->translation), "%s", conn->translation);
+
+    size_t capacity = 0;
+
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = statement(conn, STMT_BOOK_NAMES);
+    if (sql != NULL)
+    {
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+			// Skipping books that aren't one of the 66
+            int book = book_index(sqlite3_column_int(sql, 0));
+            if (book == 0)
+                continue;
+
+            copy_book_name(index->longNames[book], sizeof(index->longNames[book]), sqlite3_column_text(sql, 2));
+            add_name(index, &capacity, book, index->longNames[book], LONG_NAME);
+
+            const unsigned char *shortName = sqlite3_column_text(sql, 1);
+            if (shortName != NULL)
+                add_name(index, &capacity, book, (const char*) shortName, OTHER_NAME);
+        }
+        done(sql);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+	// Standard names and abbreviations of the books the translation has
+    int book;
+    const char *key;
+    for (size_t i = 0; (key = standard_book_key(i, &book)) != NULL; i++)
+        if (index->longNames[book][0] != '\0')
+            add_name(index, &capacity, book, key, OTHER_NAME);
+
+    qsort(index->names, index->count, sizeof(BookName), &compare_names);
+
+    return index;
+}
+
+void book_index_free(BookIndex *index)
+{
+    while (index != NULL)
+    {
+        BookIndex *next = index->next;
+
+        free(index->names);
+        free(index);
+
+        index = next;
+    }
+}
+
+static BookIndex *get_book_index(bible_conn *conn)
+{
+    bible_ctx *ctx = conn->ctx;
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    BookIndex *index = ctx->bookIndexes;
+    while (index != NULL && strcmp(index->translation, conn->translation) != 0)
+        index = index->next;
+
+    if (index == NULL && (index = build_book_index(conn)) != NULL)
+    {
+        index->next = ctx->bookIndexes;
+        ctx->bookIndexes = index;
+    }
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    // It doesn't change once made, so it's used without the lock
+    return index;
+}
+
+bool book_index_name(bible_conn *conn, int book, char *longName, size_t longNameSize)
+{
+    BookIndex *index = (book >= 1 && book <= BIBLE_BOOK_COUNT) ? get_book_index(conn) : NULL;
+    if (index == NULL || index->longNames[book][0] == '\0')
+        return false;
+
+    copy_book_name(longName, longNameSize, (const unsigned char*) index->longNames[book]);
+    return true;
+}
+
+size_t bible_suggest_books(bible_conn *conn, const char *typed, bible_book_suggestion *suggestions, size_t max)
+{
+    BookIndex *index = (conn != NULL && typed != NULL) ? get_book_index(conn) : NULL;
+    if (index == NULL)
+        return 0;
+
+    char key[40];
+    size_t keyLength = fold_name(typed, key, sizeof(key));
+    if (keyLength == 0)
+        return 0;
+
+	// First name that isn't before [key]
+    size_t low = 0, high = index->count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (strcmp(index->names[mid].key, key) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+	// Best rank of each book: named exactly, then starting like the translation's name, then like another name
+    uint8_t rank[BIBLE_BOOK_COUNT + 1];
+    memset(rank, UINT8_MAX, sizeof(rank));
+    for (size_t i = low; i < index->count && strncmp(index->names[i].key, key, keyLength) == 0; i++)
+    {
+        const BookName *name = &index->names[i];
+        uint8_t nameRank = (name->key[keyLength] == '\0') ? 0 : 1 + name->source;
+        if (nameRank < rank[name->book])
+            rank[name->book] = nameRank;
+    }
+
+	// In Bible order within each rank
+    size_t count = 0;
+    for (uint8_t r = 0; r <= 1 + OTHER_NAME && count < max; r++)
+    {
+        for (int book = 1; book <= BIBLE_BOOK_COUNT && count < max; book++)
+        {
+            if (rank[book] != r)
+                continue;
+
+            suggestions[count].book = book;
+            snprintf(suggestions[count].name, sizeof(suggestions[count].name), "%s", index->longNames[book]);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int bible_find_book(bible_conn *conn, const char *name, char *longName, size_t longNameSize)
+{
+    bible_book_suggestion best;
+    if (bible_suggest_books(conn, name, &best, 1) == 0)
+        return 0;
+
+    copy_book_name(longName, longNameSize, (const unsigned char*) best.name);
+    return best.book;
+}
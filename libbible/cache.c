@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+// Translation and chapter as one word, so finding it takes one comparison
+static inline uint64_t chapter_key(const bible_conn *conn, bible_ref chapter)
+{
+    return (uint64_t) conn->translationIndex << 32 | chapter;
+}
+
+static size_t hash_chapter(uint64_t key)
+{
+    // Finalizer of splitmix64
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ull;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBull;
+    key ^= key >> 31;
+
+    return key % CACHE_SLOTS;
+}
+
+static void free_chapter(CachedChapter *chapter)
+{
+    for (size_t i = 0; i < chapter->count; i++)
+    {
+        free(chapter->verses[i].text);
+        free(chapter->verses[i].title);
+    }
+
+    free(chapter->verses);
+    free(chapter);
+}
+
+static inline bool is_chapter(const CachedChapter *cached, uint64_t key)
+{
+    return cached != NULL && cached->key == key;
+}
+
+CachedChapter *cache_get_chapter(bible_conn *conn, bible_ref chapter)
+{
+    bible_ctx *ctx = conn->ctx;
+    uint64_t key = chapter_key(conn, chapter);
+    size_t slot = hash_chapter(key);
+
+    // Translations outside the context aren't cached
+    bool cacheable = conn->translationIndex >= 0;
+
+    pthread_mutex_lock(&ctx->cacheLock);
+    CachedChapter *cached = ctx->slots[slot];
+    if (cacheable && is_chapter(cached, key))
+    {
+        cached->refs++;
+        ctx->hits++;
+        pthread_mutex_unlock(&ctx->cacheLock);
+
+        return cached;
+    }
+    ctx->misses++;
+    pthread_mutex_unlock(&ctx->cacheLock);
+
+    // Read the chapter without holding the lock, so other threads aren't blocked
+    CachedVerse *verses;
+    size_t count = load_chapter(conn, chapter, &verses);
+    if (count == 0)
+        return NULL;
+
+    CachedChapter *loaded = calloc(1, sizeof(CachedChapter));
+    loaded->key = key;
+    loaded->verses = verses, loaded->count = count;
+    loaded->refs = 1;
+
+    // Freed when it's released
+    if (!cacheable)
+    {
+        loaded->evicted = true;
+        return loaded;
+    }
+
+    pthread_mutex_lock(&ctx->cacheLock);
+    cached = ctx->slots[slot];
+    // Another thread loaded the same chapter in the meantime, use theirs
+    if (is_chapter(cached, key))
+    {
+        cached->refs++;
+        pthread_mutex_unlock(&ctx->cacheLock);
+
+        free_chapter(loaded);
+        return cached;
+    }
+
+    // Evict the previous chapter in the slot
+    if (cached != NULL)
+    {
+        cached->evicted = true;
+        if (cached->refs == 0)
+            free_chapter(cached);
+    }
+
+    ctx->slots[slot] = loaded;
+    pthread_mutex_unlock(&ctx->cacheLock);
+
+    return loaded;
+}
+
+void cache_release(bible_ctx *ctx, CachedChapter *chapter)
+{
+    if (chapter == NULL)
+        return;
+
+    pthread_mutex_lock(&ctx->cacheLock);
+    bool canFree = (--chapter->refs == 0 && chapter->evicted);
+    pthread_mutex_unlock(&ctx->cacheLock);
+
+    if (canFree)
+        free_chapter(chapter);
+}
+
+void cache_clear(bible_ctx *ctx)
+{
+    pthread_mutex_lock(&ctx->cacheLock);
+    for (size_t i = 0; i < CACHE_SLOTS; i++)
+    {
+        CachedChapter *cached = ctx->slots[i];
+        if (cached != NULL)
+        {
+            cached->evicted = true;
+            if (cached->refs == 0)
+                free_chapter(cached);
+            ctx->slots[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&ctx->cacheLock);
+}
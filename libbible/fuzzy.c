@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "internal.h"
+
+// Fuzzy search: verses with a piece of text within a few typos (edit distance) of the query
+//
+// Every translation that is searched gets an in-memory index (kept until the context is freed) of
+// its verses' words (folded like the other indexes, joined by single spaces) and, for every
+// 3-letter piece (trigram), the verses that have it. Each typo changes at most 3 of the query's
+// trigrams, so verses missing more than that many per typo can't match and are skipped. The rest
+// are checked with Myers' bit-parallel edit distance, several verses at once
+
+#define GRAM_BUCKETS 65536
+#define GRAM_SIZE 3
+// Longest query (the matcher keeps one bit per letter)
+#define MAX_FUZZY_QUERY 64
+
+struct FuzzyIndex
+{
+    char translation[64];
+    FuzzyIndex *next;
+
+    size_t verseCount;
+    bible_ref *refs;
+    // Verse i's text is text[textStart[i]..textStart[i + 1]]
+    uint32_t *textStart;
+    char *text;
+    // Verses (indexes, in order) with a trigram in bucket b are gramVerses[gramStart[b]..gramStart[b + 1]]
+    uint32_t *gramStart, *gramVerses;
+};
+
+static uint32_t gram_bucket(const char *gram)
+{
+    uint32_t packed = (uint8_t) gram[0] << 16 | (uint8_t) gram[1] << 8 | (uint8_t) gram[2];
+    // Multiplicative hash (Knuth), top 16 bits
+    return (packed * 2654435761u) >> 16;
+}
+
+// Words of [text] folded and joined by single spaces
+static size_t fold_text(const char *text, char *out, size_t outSize)
+{
+    size_t length = 0;
+    char word[64];
+    bool unknown;
+
+    while (next_word(&text, word, sizeof(word), &unknown) > 0)
+    {
+        size_t wordLength = strlen(word);
+        if (length + wordLength + 2 > outSize)
+            break;
+
+        if (length > 0)
+            out[length++] = ' ';
+        memcpy(&out[length], word, wordLength);
+        length += wordLength;
+    }
+    out[length] = '\0';
+
+    return length;
+}
+
+typedef struct
+{
+    FuzzyIndex *index;
+    size_t verseSize, textSize;
+} FuzzyBuild;
+
+static void add_verse(bible_ref ref, const char *text, void *data)
+{
+    FuzzyBuild *build = data;
+    FuzzyIndex *index = build->index;
+
+    if (index->verseCount + 1 >= build->verseSize)
+    {
+        build->verseSize = (build->verseSize == 0) ? 1024 : build->verseSize * 2;
+        index->refs = realloc(index->refs, build->verseSize * sizeof(bible_ref));
+        index->textStart = realloc(index->textStart, (build->verseSize + 1) * sizeof(uint32_t));
+    }
+
+    // Folding and stripping tags never make the text longer
+    size_t start = index->textStart[index->verseCount], textLength = strlen(text);
+    if (start + textLength + 1 > build->textSize)
+    {
+        while (start + textLength + 1 > build->textSize)
+            build->textSize = (build->textSize == 0) ? 1 << 20 : build->textSize * 2;
+        index->text = realloc(index->text, build->textSize);
+    }
+
+    char plain[textLength + 1];
+    bible_strip_tags(text, plain, sizeof(plain));
+    size_t length = fold_text(plain, &index->text[start], build->textSize - start);
+
+    index->refs[index->verseCount] = ref;
+    index->textStart[++index->verseCount] = start + length;
+}
+
+static FuzzyIndex *build_fuzzy_index(bible_conn *conn)
+{
+    FuzzyIndex *index = calloc(1, sizeof(FuzzyIndex));
+    snprintf(index->translation, sizeof(index->translation), "%s", conn->translation);
+
+    FuzzyBuild build = { .index = index };
+    index->textStart = malloc(sizeof(uint32_t));
+    index->textStart[0] = 0;
+
+    for (int book = bible_adjacent_book(conn, 0, 1, NULL, 0); book > 0; book = bible_adjacent_book(conn, book, 1, NULL, 0))
+        bible_each_verse(conn, book, &add_verse, &build);
+
+    // Count the verses of every bucket (each verse once), then fill them in
+    index->gramStart = calloc(GRAM_BUCKETS + 1, sizeof(uint32_t));
+    uint32_t *lastVerse = malloc(GRAM_BUCKETS * sizeof(uint32_t));
+    memset(lastVerse, 0xFF, GRAM_BUCKETS * sizeof(uint32_t));
+
+    for (uint32_t v = 0; v < index->verseCount; v++)
+        for (uint32_t i = index->textStart[v]; i + GRAM_SIZE <= index->textStart[v + 1]; i++)
+        {
+            uint32_t bucket = gram_bucket(&index->text[i]);
+            if (lastVerse[bucket] != v)
+                lastVerse[bucket] = v, index->gramStart[bucket + 1]++;
+        }
+
+    for (size_t b = 0; b < GRAM_BUCKETS; b++)
+        index->gramStart[b + 1] += index->gramStart[b];
+
+    index->gramVerses = malloc((index->gramStart[GRAM_BUCKETS] + 1) * sizeof(uint32_t));
+    uint32_t *fill = malloc(GRAM_BUCKETS * sizeof(uint32_t));
+    memcpy(fill, index->gramStart, GRAM_BUCKETS * sizeof(uint32_t));
+    memset(lastVerse, 0xFF, GRAM_BUCKETS * sizeof(uint32_t));
+
+    for (uint32_t v = 0; v < index->verseCount; v++)
+        for (uint32_t i = index->textStart[v]; i + GRAM_SIZE <= index->textStart[v + 1]; i++)
+        {
+            uint32_t bucket = gram_bucket(&index->text[i]);
+            if (lastVerse[bucket] != v)
+                lastVerse[bucket] = v, index->gramVerses[fill[bucket]++] = v;
+        }
+
+    free(fill);
+    free(lastVerse);
+
+    return index;
+}
+
+void fuzzy_index_free(FuzzyIndex *index)
+{
+    while (index != NULL)
+    {
+        FuzzyIndex *next = index->next;
+
+        free(index->refs);
+        free(index->textStart);
+        free(index->text);
+        free(index->gramStart);
+        free(index->gramVerses);
+        free(index);
+
+        index = next;
+    }
+}
+
+// The fuzzy index of [conn]'s translation, built the first time
+static FuzzyIndex *get_fuzzy_index(bible_conn *conn)
+{
+    bible_ctx *ctx = conn->ctx;
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    FuzzyIndex *index = ctx->fuzzyIndexes;
+    while (index != NULL && strcmp(index->translation, conn->translation) != 0)
+        index = index->next;
+
+    if (index == NULL)
+    {
+        index = build_fuzzy_index(conn);
+        index->next = ctx->fuzzyIndexes;
+        ctx->fuzzyIndexes = index;
+    }
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    // Indexes don't change once built, so they're used without the lock
+    return index;
+}
+
+// Smallest edit distance between the query (as [peq], bit i of peq[c] is set if letter i is c)
+// and any piece of [text]
+static int myers_distance(const uint64_t *peq, int length, const char *text, size_t textLength)
+{
+    uint64_t pv = ~0ull, mv = 0, high = 1ull << (length - 1);
+    int score = length, best = length;
+
+    for (size_t j = 0; j < textLength; j++)
+    {
+        uint64_t eq = peq[(uint8_t) text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        score += ((ph & high) != 0) - ((mh & high) != 0);
+
+        // Matches can start anywhere in the text, so nothing is shifted in
+        ph <<= 1, mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        if (score < best)
+            best = score;
+    }
+
+    return best;
+}
+
+#if defined(__GNUC__)
+// The same, for 4 verses at once (GCC and Clang turn this into SSE2 or AVX2 instructions)
+#define LANES 4
+typedef uint64_t Bits __attribute__((vector_size(LANES * 8)));
+typedef int64_t Scores __attribute__((vector_size(LANES * 8)));
+
+static void myers_distance_lanes(const uint64_t *peq, int length, const char **texts, const uint32_t *textLengths, int *distances)
+{
+    Bits pv = ~(Bits) { 0 }, mv = { 0 }, high = (Bits) { 0 } + (1ull << (length - 1));
+    Scores score = (Scores) { 0 } + length, best = score;
+
+    uint32_t longest = 0;
+    for (int l = 0; l < LANES; l++)
+        if (textLengths[l] > longest)
+            longest = textLengths[l];
+
+    for (uint32_t j = 0; j < longest; j++)
+    {
+        // Past the end of a verse nothing matches, which can't make its distance smaller
+        Bits eq;
+        for (int l = 0; l < LANES; l++)
+            eq[l] = (j < textLengths[l]) ? peq[(uint8_t) texts[l][j]] : 0;
+
+        Bits xv = eq | mv;
+        Bits xh = (((eq & pv) + pv) ^ pv) | eq;
+        Bits ph = mv | ~(xh | pv);
+        Bits mh = pv & xh;
+
+        // Comparisons give -1 for true
+        score -= (Scores) ((ph & high) != 0);
+        score += (Scores) ((mh & high) != 0);
+
+        ph <<= 1, mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        Scores smaller = (Scores) (score < best);
+        best = (score & smaller) | (best & ~smaller);
+    }
+
+    for (int l = 0; l < LANES; l++)
+        distances[l] = best[l];
+}
+#endif
+
+static int compare_hits(const void *a, const void *b)
+{
+    const bible_hit *hitA = a, *hitB = b;
+
+    if (hitA->score != hitB->score)
+        return (hitA->score > hitB->score) - (hitA->score < hitB->score);
+
+    return (hitA->ref > hitB->ref) - (hitA->ref < hitB->ref);
+}
+
+// Book names and text of the hits (after sorting and cutting to the limit)
+void fill_hits(bible_conn *conn, bible_results *results)
+{
+    int lastBook = 0;
+    char bookName[40] = "";
+
+    for (size_t i = 0; i < results->count; i++)
+    {
+        bible_hit *hit = &results->hits[i];
+        if (BIBLE_REF_BOOK(hit->ref) != lastBook)
+        {
+            lastBook = BIBLE_REF_BOOK(hit->ref);
+            bible_book_name(conn, lastBook, bookName, sizeof(bookName));
+        }
+        memcpy(hit->book, bookName, sizeof(hit->book));
+
+        bible_passage *passage = bible_get_passage(conn, hit->ref, hit->ref);
+        const char *text = (passage != NULL && passage->count > 0) ? passage->verses[0].text : "";
+
+        char *plain = malloc(strlen(text) + 1);
+        bible_strip_tags(text, plain, strlen(text) + 1);
+        hit->text = plain;
+
+        bible_passage_free(passage);
+    }
+}
+
+bible_results *bible_search_fuzzy(bible_conn *conn, const char *query, int maxDistance, int limit, volatile int *cancel)
+{
+    if (conn == NULL || query == NULL)
+        return NULL;
+
+    char pattern[MAX_FUZZY_QUERY + 1];
+    int length = fold_text(query, pattern, sizeof(pattern));
+    if (length == 0)
+        return NULL;
+
+    // About one typo per 6 letters
+    if (maxDistance <= 0)
+        maxDistance = (length + 4) / 6;
+    if (maxDistance < 1)
+        maxDistance = 1;
+
+    FuzzyIndex *index = get_fuzzy_index(conn);
+
+    uint64_t peq[256] = { 0 };
+    for (int i = 0; i < length; i++)
+        peq[(uint8_t) pattern[i]] |= 1ull << i;
+
+    // Candidates: verses with enough of the query's trigrams (each bucket counted once)
+    uint8_t *gramCount = calloc(index->verseCount, 1);
+    uint32_t buckets[MAX_FUZZY_QUERY];
+    int bucketCount = 0;
+    for (int i = 0; i + GRAM_SIZE <= length; i++)
+    {
+        uint32_t bucket = gram_bucket(&pattern[i]);
+        bool seen = false;
+        for (int b = 0; b < bucketCount && !seen; b++)
+            seen = buckets[b] == bucket;
+        if (!seen)
+            buckets[bucketCount++] = bucket;
+    }
+
+    int needed = bucketCount - maxDistance * GRAM_SIZE;
+    uint32_t *candidates = malloc((index->verseCount + 1) * sizeof(uint32_t));
+    size_t candidateCount = 0;
+
+    if (needed > 0)
+    {
+        for (int b = 0; b < bucketCount; b++)
+            for (uint32_t i = index->gramStart[buckets[b]]; i < index->gramStart[buckets[b] + 1]; i++)
+                if (++gramCount[index->gramVerses[i]] == needed)
+                    candidates[candidateCount++] = index->gramVerses[i];
+    }
+    // Short queries (or many typos): check every verse
+    else
+    {
+        for (uint32_t v = 0; v < index->verseCount; v++)
+            candidates[candidateCount++] = v;
+    }
+    free(gramCount);
+
+    bible_results *results = calloc(1, sizeof(bible_results));
+    size_t size = 0;
+
+    for (size_t c = 0; c < candidateCount; )
+    {
+        if (cancel != NULL && *cancel)
+        {
+            free(candidates);
+            bible_results_free(results);
+            return NULL;
+        }
+
+        int distances[4];
+        size_t count = 1;
+
+#if defined(__GNUC__)
+        if (c + LANES <= candidateCount)
+        {
+            const char *texts[LANES];
+            uint32_t textLengths[LANES];
+            for (int l = 0; l < LANES; l++)
+            {
+                uint32_t v = candidates[c + l];
+                texts[l] = &index->text[index->textStart[v]];
+                textLengths[l] = index->textStart[v + 1] - index->textStart[v];
+            }
+
+            myers_distance_lanes(peq, length, texts, textLengths, distances);
+            count = LANES;
+        }
+        else
+#endif
+        {
+            uint32_t v = candidates[c];
+            distances[0] = myers_distance(peq, length, &index->text[index->textStart[v]], index->textStart[v + 1] - index->textStart[v]);
+        }
+
+        for (size_t l = 0; l < count; l++)
+        {
+            if (distances[l] > maxDistance)
+                continue;
+
+            if (results->count == size)
+            {
+                size = (size == 0) ? 64 : size * 2;
+                results->hits = realloc(results->hits, size * sizeof(bible_hit));
+            }
+
+            results->hits[results->count++] = (bible_hit) { .ref = index->refs[candidates[c + l]], .score = distances[l] };
+        }
+
+        c += count;
+    }
+    free(candidates);
+
+    // Closest first, then in Bible order
+    qsort(results->hits, results->count, sizeof(bible_hit), &compare_hits);
+    if (limit >= 0 && results->count > (size_t) limit)
+    {
+        results->count = limit;
+        results->truncated = true;
+    }
+
+    fill_hits(conn, results);
+
+    return results;
+}
@@ -0,0 +1,1407 @@
+// Allows strdup to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "internal.h"
+
+// Word index of every translation, for queries that compare them ([dbDir]/.index/all.inv)
+//
+// The file is memory-mapped and laid out as:
+//   IndexHeader
+//   IndexTranslation[translationCount]  translations it was built from
+//   IndexTerm[termCount]                every word, sorted
+//   IndexList[listCount]                for each word, a posting list per translation that uses it
+//   uint32_t[hashSize]                  vocabulary hash table: term number + 1 (0 = empty), linear probing
+//   strings                             the words
+//   postings                            the posting lists
+// A posting list is varints: number of verses, size of the refs in bytes, the verses' refs
+// (each as the difference from the one before), then for each verse its number of positions
+// and the positions (word numbers in the verse, also as differences)
+// Numbers are in the machine's byte order; the index is rebuilt, not shared between machines
+
+#define INDEX_MAGIC "BIBLEINV"
+#define INDEX_VERSION 3
+
+#define MAX_WORD 64
+// Distance used by NEAR without a number
+#define DEFAULT_NEAR 10
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t translationCount, termCount, listCount, hashSize;
+    uint64_t termsOffset, listsOffset, hashOffset, stringsOffset, postingsOffset, fileSize;
+} IndexHeader;
+
+typedef struct
+{
+    char name[64];
+    int64_t size, mtime;
+} IndexTranslation;
+
+typedef struct
+{
+    uint32_t string, firstList;
+    uint16_t length, listCount;
+} IndexTerm;
+
+typedef struct
+{
+    uint64_t offset;
+    uint32_t translation, count;
+} IndexList;
+
+struct WordIndex
+{
+    void *map;
+    size_t size;
+
+    const IndexHeader *header;
+    const IndexTranslation *translations;
+    const IndexTerm *terms;
+    const IndexList *lists;
+    const uint32_t *hash;
+    const char *strings;
+    const uint8_t *postings;
+};
+
+// Growable byte buffer
+typedef struct
+{
+    uint8_t *data;
+    size_t size, capacity;
+} Bytes;
+
+static void bytes_reserve(Bytes *bytes, size_t extra)
+{
+    if (bytes->size + extra <= bytes->capacity)
+        return;
+
+    while (bytes->size + extra > bytes->capacity)
+        bytes->capacity = (bytes->capacity == 0) ? 4096 : bytes->capacity * 2;
+    bytes->data = realloc(bytes->data, bytes->capacity);
+}
+
+static void bytes_append(Bytes *bytes, const void *data, size_t size)
+{
+    bytes_reserve(bytes, size);
+    memcpy(&bytes->data[bytes->size], data, size);
+    bytes->size += size;
+}
+
+// 7 bits per byte, the high bit is set on all but the last byte
+static void put_varint(Bytes *bytes, uint32_t value)
+{
+    bytes_reserve(bytes, 5);
+    while (value >= 0x80)
+    {
+        bytes->data[bytes->size++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    bytes->data[bytes->size++] = value;
+}
+
+static const uint8_t *get_varint(const uint8_t *data, uint32_t *value)
+{
+    // Most differences fit in one byte
+    if (*data < 0x80)
+    {
+        *value = *data;
+        return data + 1;
+    }
+
+    uint32_t result = 0;
+    int shift = 0;
+    while (*data & 0x80)
+    {
+        result |= (uint32_t) (*data++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *value = result | ((uint32_t) *data << shift);
+
+    return data + 1;
+}
+
+static void index_path(const bible_ctx *ctx, char *path, size_t pathSize)
+{
+    sidecar_path(ctx, "all", ".inv", path, pathSize);
+}
+
+static bool translation_info(const bible_ctx *ctx, size_t translation, IndexTranslation *info)
+{
+    memset(info, 0, sizeof(IndexTranslation));
+    snprintf(info->name, sizeof(info->name), "%s", ctx->translations[translation].name);
+
+    return source_info(ctx, info->name, &info->size, &info->mtime);
+}
+
+// ---- Building ----
+
+typedef struct
+{
+    uint32_t verse;
+    uint32_t position;
+} Posting;
+
+// A word used in one book, with where it's used (in order)
+typedef struct
+{
+    char *word;
+    Posting *postings;
+    size_t count, size;
+} ItemWord;
+
+// One book of one translation, read by one thread
+typedef struct
+{
+    size_t translation;
+    int book;
+
+    ItemWord *words;
+    size_t wordCount, wordSize;
+    // words[byteStart[b]..byteStart[b + 1]] start with byte b (once sorted)
+    size_t byteStart[257];
+} BuildItem;
+
+// Words of one range of first bytes, encoded by one thread
+typedef struct
+{
+    IndexTerm *terms;
+    size_t termCount, termSize;
+    IndexList *lists;
+    size_t listCount, listSize;
+    Bytes strings, postings;
+} Shard;
+
+typedef struct
+{
+    const bible_ctx *ctx;
+
+    BuildItem *items;
+    size_t itemCount;
+    Shard shards[256];
+
+    // Next item or shard to work on
+    size_t next;
+    bool failed;
+    pthread_mutex_t lock;
+} Build;
+
+static uint32_t hash_word(const char *word, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char) word[i]) * 16777619u;
+
+    return hash;
+}
+
+// Find [word] in the item's hash table (of word indexes + 1), adding it if it isn't there
+static ItemWord *item_word(BuildItem *item, size_t **table, size_t *tableSize, const char *word)
+{
+    // Keep the table at most half full
+    if (item->wordCount * 2 >= *tableSize)
+    {
+        size_t newSize = (*tableSize == 0) ? 1024 : *tableSize * 2;
+        size_t *newTable = calloc(newSize, sizeof(size_t));
+        for (size_t i = 0; i < *tableSize; i++)
+        {
+            if ((*table)[i] == 0)
+                continue;
+
+            const char *other = item->words[(*table)[i] - 1].word;
+            size_t slot = hash_word(other, strlen(other)) & (newSize - 1);
+            while (newTable[slot] != 0)
+                slot = (slot + 1) & (newSize - 1);
+            newTable[slot] = (*table)[i];
+        }
+
+        free(*table);
+        *table = newTable, *tableSize = newSize;
+    }
+
+    size_t slot = hash_word(word, strlen(word)) & (*tableSize - 1);
+    while ((*table)[slot] != 0)
+    {
+        ItemWord *itemWord = &item->words[(*table)[slot] - 1];
+        if (strcmp(itemWord->word, word) == 0)
+            return itemWord;
+        slot = (slot + 1) & (*tableSize - 1);
+    }
+
+    if (item->wordCount == item->wordSize)
+    {
+        item->wordSize = (item->wordSize == 0) ? 256 : item->wordSize * 2;
+        item->words = realloc(item->words, item->wordSize * sizeof(ItemWord));
+    }
+
+    ItemWord *itemWord = &item->words[item->wordCount++];
+    *itemWord = (ItemWord) { .word = strdup(word) };
+    (*table)[slot] = item->wordCount;
+
+    return itemWord;
+}
+
+static int compare_item_words(const void *a, const void *b)
+{
+    return strcmp(((const ItemWord*) a)->word, ((const ItemWord*) b)->word);
+}
+
+// Read and split up the verses of one book
+static bool read_item(sqlite3 *db, BuildItem *item)
+{
+    sqlite3_stmt *sql;
+    if (sqlite3_prepare_v2(db, "SELECT chapter, verse, text FROM verses WHERE book_number = ? ORDER BY chapter, verse",
+        -1, &sql, NULL) != SQLITE_OK)
+        return false;
+    sqlite3_bind_int(sql, 1, book_number(item->book));
+
+    size_t *table = NULL, tableSize = 0;
+    char *plain = NULL;
+    size_t plainSize = 0;
+
+    while (sqlite3_step(sql) == SQLITE_ROW)
+    {
+        bible_ref verse = BIBLE_REF(item->book, sqlite3_column_int(sql, 0), sqlite3_column_int(sql, 1));
+        const char *text = (const char*) sqlite3_column_text(sql, 2);
+        if (text == NULL)
+            continue;
+
+        size_t textSize = strlen(text) + 1;
+        if (textSize > plainSize)
+            plain = realloc(plain, plainSize = textSize);
+        bible_strip_tags(text, plain, plainSize);
+
+        char word[MAX_WORD];
+        bool unknown;
+        uint32_t position = 0;
+        const char *str = plain;
+        while (next_word(&str, word, sizeof(word), &unknown) > 0)
+        {
+            ItemWord *itemWord = item_word(item, &table, &tableSize, word);
+            if (itemWord->count == itemWord->size)
+            {
+                itemWord->size = (itemWord->size == 0) ? 4 : itemWord->size * 2;
+                itemWord->postings = realloc(itemWord->postings, itemWord->size * sizeof(Posting));
+            }
+            itemWord->postings[itemWord->count++] = (Posting) { verse, position++ };
+        }
+    }
+    sqlite3_finalize(sql);
+    free(table);
+    free(plain);
+
+    qsort(item->words, item->wordCount, sizeof(ItemWord), &compare_item_words);
+
+    // Where each first byte starts, so shards can find their words
+    size_t w = 0;
+    for (int b = 0; b < 256; b++)
+    {
+        item->byteStart[b] = w;
+        while (w < item->wordCount && (unsigned char) item->words[w].word[0] == b)
+            w++;
+    }
+    item->byteStart[256] = w;
+
+    return true;
+}
+
+static void *read_items(void *arg)
+{
+    Build *build = arg;
+    sqlite3 *db = NULL;
+    size_t openTranslation = SIZE_MAX;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&build->lock);
+        size_t i = build->next++;
+        pthread_mutex_unlock(&build->lock);
+
+        if (i >= build->itemCount)
+            break;
+
+        // Items are grouped by translation, so each thread reopens rarely
+        BuildItem *item = &build->items[i];
+        if (item->translation != openTranslation)
+        {
+            sqlite3_close(db);
+
+            const char *name = build->ctx->translations[item->translation].name;
+            char path[strlen(build->ctx->dbDir) + strlen(name) + 16];
+            translation_path(build->ctx, name, path, sizeof(path));
+
+            openTranslation = item->translation;
+            if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+            {
+                build->failed = true;
+                continue;
+            }
+        }
+
+        if (!read_item(db, item))
+            build->failed = true;
+    }
+
+    sqlite3_close(db);
+
+    return NULL;
+}
+
+// A word of an item, for sorting the words of a shard
+typedef struct
+{
+    const char *word;
+    size_t item, index;
+} ShardWord;
+
+static int compare_shard_words(const void *a, const void *b)
+{
+    const ShardWord *wordA = a, *wordB = b;
+
+    int order = strcmp(wordA->word, wordB->word);
+    if (order != 0)
+        return order;
+
+    // Items are in translation and book order, which keeps postings in verse order
+    return (wordA->item > wordB->item) - (wordA->item < wordB->item);
+}
+
+// Encode the posting list of [words] (one word, in item order) of one translation
+static void encode_list(Build *build, Shard *shard, const ShardWord *words, size_t count, Bytes *refs, Bytes *positions)
+{
+    refs->size = 0, positions->size = 0;
+    uint32_t verses = 0, lastVerse = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const ItemWord *itemWord = &build->items[words[i].item].words[words[i].index];
+
+        // Postings of a verse are next to each other (and never split between items, which are books)
+        for (size_t p = 0; p < itemWord->count; )
+        {
+            uint32_t verse = itemWord->postings[p].verse;
+            size_t end = p;
+            while (end < itemWord->count && itemWord->postings[end].verse == verse)
+                end++;
+
+            put_varint(refs, verse - lastVerse);
+            lastVerse = verse;
+            verses++;
+
+            put_varint(positions, end - p);
+            uint32_t lastPosition = 0;
+            for (; p < end; p++)
+            {
+                put_varint(positions, itemWord->postings[p].position - lastPosition);
+                lastPosition = itemWord->postings[p].position;
+            }
+        }
+    }
+
+    if (shard->listCount == shard->listSize)
+    {
+        shard->listSize = (shard->listSize == 0) ? 256 : shard->listSize * 2;
+        shard->lists = realloc(shard->lists, shard->listSize * sizeof(IndexList));
+    }
+    shard->lists[shard->listCount++] = (IndexList) {
+        .offset = shard->postings.size,
+        .translation = build->items[words[0].item].translation,
+        .count = verses
+    };
+
+    put_varint(&shard->postings, verses);
+    put_varint(&shard->postings, refs->size);
+    bytes_append(&shard->postings, refs->data, refs->size);
+    bytes_append(&shard->postings, positions->data, positions->size);
+}
+
+// Encode every word starting with byte [b]
+static void encode_shard(Build *build, int b)
+{
+    Shard *shard = &build->shards[b];
+
+    size_t count = 0;
+    for (size_t i = 0; i < build->itemCount; i++)
+        count += build->items[i].byteStart[b + 1] - build->items[i].byteStart[b];
+    if (count == 0)
+        return;
+
+    ShardWord *words = malloc(count * sizeof(ShardWord));
+    count = 0;
+    for (size_t i = 0; i < build->itemCount; i++)
+        for (size_t w = build->items[i].byteStart[b]; w < build->items[i].byteStart[b + 1]; w++)
+            words[count++] = (ShardWord) { build->items[i].words[w].word, i, w };
+
+    qsort(words, count, sizeof(ShardWord), &compare_shard_words);
+
+    Bytes refs = { 0 }, positions = { 0 };
+    for (size_t start = 0; start < count; )
+    {
+        size_t end = start;
+        while (end < count && strcmp(words[end].word, words[start].word) == 0)
+            end++;
+
+        if (shard->termCount == shard->termSize)
+        {
+            shard->termSize = (shard->termSize == 0) ? 256 : shard->termSize * 2;
+            shard->terms = realloc(shard->terms, shard->termSize * sizeof(IndexTerm));
+        }
+        IndexTerm *term = &shard->terms[shard->termCount++];
+        term->string = shard->strings.size;
+        term->length = strlen(words[start].word);
+        term->firstList = shard->listCount;
+        bytes_append(&shard->strings, words[start].word, term->length);
+
+        // One list per translation
+        for (size_t from = start; from < end; )
+        {
+            size_t to = from;
+            while (to < end && build->items[words[to].item].translation == build->items[words[from].item].translation)
+                to++;
+
+            encode_list(build, shard, &words[from], to - from, &refs, &positions);
+            from = to;
+        }
+        term->listCount = shard->listCount - term->firstList;
+
+        start = end;
+    }
+
+    free(refs.data);
+    free(positions.data);
+    free(words);
+}
+
+static void *encode_shards(void *arg)
+{
+    Build *build = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&build->lock);
+        size_t b = build->next++;
+        pthread_mutex_unlock(&build->lock);
+
+        if (b >= 256)
+            break;
+
+        encode_shard(build, b);
+    }
+
+    return NULL;
+}
+
+static bool write_index(Build *build, const char *path, const IndexTranslation *translations)
+{
+    IndexHeader header = { .version = INDEX_VERSION, .translationCount = build->ctx->translationCount };
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+
+    uint64_t strings = 0, postings = 0;
+    for (int b = 0; b < 256; b++)
+    {
+        header.termCount += build->shards[b].termCount;
+        header.listCount += build->shards[b].listCount;
+        strings += build->shards[b].strings.size;
+        postings += build->shards[b].postings.size;
+    }
+
+    header.termsOffset = sizeof(IndexHeader) + header.translationCount * sizeof(IndexTranslation);
+    // Lists have 64-bit offsets, so keep them aligned
+    header.listsOffset = (header.termsOffset + header.termCount * sizeof(IndexTerm) + 7) & ~(uint64_t) 7;
+    header.hashOffset = header.listsOffset + header.listCount * sizeof(IndexList);
+    // At most half full
+    header.hashSize = 1;
+    while (header.hashSize < header.termCount * 2)
+        header.hashSize *= 2;
+    header.stringsOffset = header.hashOffset + header.hashSize * sizeof(uint32_t);
+    header.postingsOffset = header.stringsOffset + strings;
+    header.fileSize = header.postingsOffset + postings;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(translations, sizeof(IndexTranslation), header.translationCount, file);
+
+    // Offsets in shards start at 0, so move them after the shards before them
+    uint32_t stringBase = 0, listBase = 0;
+    for (int b = 0; b < 256; b++)
+    {
+        Shard *shard = &build->shards[b];
+        for (size_t t = 0; t < shard->termCount; t++)
+        {
+            IndexTerm term = shard->terms[t];
+            term.string += stringBase, term.firstList += listBase;
+            fwrite(&term, sizeof(term), 1, file);
+        }
+        stringBase += shard->strings.size, listBase += shard->listCount;
+    }
+
+    static const char padding[8];
+    size_t written = header.termsOffset + header.termCount * sizeof(IndexTerm);
+    fwrite(padding, 1, header.listsOffset - written, file);
+
+    uint64_t postingBase = 0;
+    for (int b = 0; b < 256; b++)
+    {
+        Shard *shard = &build->shards[b];
+        for (size_t l = 0; l < shard->listCount; l++)
+        {
+            IndexList list = shard->lists[l];
+            list.offset += postingBase;
+            fwrite(&list, sizeof(list), 1, file);
+        }
+        postingBase += shard->postings.size;
+    }
+
+    uint32_t *hash = calloc(header.hashSize, sizeof(uint32_t));
+    if (hash == NULL)
+    {
+        fclose(file);
+        return false;
+    }
+    uint32_t termNumber = 0;
+    for (int b = 0; b < 256; b++)
+    {
+        Shard *shard = &build->shards[b];
+        for (size_t t = 0; t < shard->termCount; t++)
+        {
+            uint32_t slot = hash_word((const char*) &shard->strings.data[shard->terms[t].string], shard->terms[t].length) & (header.hashSize - 1);
+            while (hash[slot] != 0)
+                slot = (slot + 1) & (header.hashSize - 1);
+            hash[slot] = ++termNumber;
+        }
+    }
+    fwrite(hash, sizeof(uint32_t), header.hashSize, file);
+    free(hash);
+
+	// (Shards of bytes no word starts with have nothing, and no buffer)
+    for (int b = 0; b < 256; b++)
+        if (build->shards[b].strings.size > 0)
+            fwrite(build->shards[b].strings.data, 1, build->shards[b].strings.size, file);
+    for (int b = 0; b < 256; b++)
+        if (build->shards[b].postings.size > 0)
+            fwrite(build->shards[b].postings.data, 1, build->shards[b].postings.size, file);
+
+    bool ok = !ferror(file);
+
+    return (fclose(file) == 0) && ok;
+}
+
+// Build the index from every translation in [translations] into [path]
+static bool build_index(const bible_ctx *ctx, const char *path, const IndexTranslation *translations, int threads)
+{
+    Build build = { .ctx = ctx, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+    // One item per book of every translation
+    size_t itemSize = 0;
+    for (size_t t = 0; t < ctx->translationCount; t++)
+    {
+        char source[strlen(ctx->dbDir) + strlen(ctx->translations[t].name) + 16];
+        translation_path(ctx, ctx->translations[t].name, source, sizeof(source));
+
+        sqlite3 *db;
+        sqlite3_stmt *sql;
+        if (sqlite3_open_v2(source, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK
+            || sqlite3_prepare_v2(db, "SELECT DISTINCT book_number FROM verses ORDER BY book_number", -1, &sql, NULL) != SQLITE_OK)
+        {
+            sqlite3_close(db);
+            continue;
+        }
+
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+			// Books outside the 66 have no refs
+            int book = book_index(sqlite3_column_int(sql, 0));
+            if (book == 0)
+                continue;
+
+            if (build.itemCount == itemSize)
+            {
+                itemSize = (itemSize == 0) ? 128 : itemSize * 2;
+                build.items = realloc(build.items, itemSize * sizeof(BuildItem));
+            }
+            build.items[build.itemCount++] = (BuildItem) { .translation = t, .book = book };
+        }
+        sqlite3_finalize(sql);
+        sqlite3_close(db);
+    }
+
+    bible_threads_run(threads, &read_items, &build);
+
+    bool built = false;
+    if (!build.failed)
+    {
+        build.next = 0;
+        bible_threads_run(threads, &encode_shards, &build);
+
+        char tempPath[strlen(path) + 32];
+        sidecar_temp_path(path, tempPath, sizeof(tempPath));
+
+        // Readers never see a half-written index
+        built = sidecar_finish(tempPath, path, write_index(&build, tempPath, translations));
+    }
+
+    for (size_t i = 0; i < build.itemCount; i++)
+    {
+        for (size_t w = 0; w < build.items[i].wordCount; w++)
+        {
+            free(build.items[i].words[w].word);
+            free(build.items[i].words[w].postings);
+        }
+        free(build.items[i].words);
+    }
+    free(build.items);
+
+    for (int b = 0; b < 256; b++)
+    {
+        free(build.shards[b].terms);
+        free(build.shards[b].lists);
+        free(build.shards[b].strings.data);
+        free(build.shards[b].postings.data);
+    }
+    pthread_mutex_destroy(&build.lock);
+
+    return built;
+}
+
+// ---- Reading ----
+
+static WordIndex *index_open(const char *path)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return NULL;
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(IndexHeader))
+    {
+        close(file);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    const IndexHeader *header = map;
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != INDEX_VERSION
+        || header->fileSize != (uint64_t) info.st_size)
+    {
+        munmap(map, info.st_size);
+        return NULL;
+    }
+
+    WordIndex *index = malloc(sizeof(WordIndex));
+    const uint8_t *base = map;
+    *index = (WordIndex) {
+        .map = map,
+        .size = info.st_size,
+        .header = header,
+        .translations = (const IndexTranslation*) (base + sizeof(IndexHeader)),
+        .terms = (const IndexTerm*) (base + header->termsOffset),
+        .lists = (const IndexList*) (base + header->listsOffset),
+        .hash = (const uint32_t*) (base + header->hashOffset),
+        .strings = (const char*) (base + header->stringsOffset),
+        .postings = base + header->postingsOffset
+    };
+
+    return index;
+}
+
+void word_index_free(WordIndex *index)
+{
+    if (index != NULL)
+    {
+        munmap(index->map, index->size);
+        free(index);
+    }
+}
+
+// The index was built from exactly the translations there are now
+static bool index_is_current(const WordIndex *index, const IndexTranslation *translations, size_t count)
+{
+    return index->header->translationCount == count
+        && memcmp(index->translations, translations, count * sizeof(IndexTranslation)) == 0;
+}
+
+bool bible_index_build(bible_ctx *ctx, int threads)
+{
+    if (ctx == NULL || ctx->translationCount == 0)
+        return false;
+
+    IndexTranslation translations[ctx->translationCount];
+    for (size_t t = 0; t < ctx->translationCount; t++)
+        if (!translation_info(ctx, t, &translations[t]))
+            return false;
+
+    char path[strlen(ctx->dbDir) + 32];
+    index_path(ctx, path, sizeof(path));
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    // Use the index on disk if it's current
+    if (ctx->wordIndex == NULL)
+        ctx->wordIndex = index_open(path);
+
+    if (ctx->wordIndex == NULL || !index_is_current(ctx->wordIndex, translations, ctx->translationCount))
+    {
+        word_index_free(ctx->wordIndex);
+        ctx->wordIndex = NULL;
+
+        sidecar_folder(ctx);
+
+        if (build_index(ctx, path, translations, threads))
+            ctx->wordIndex = index_open(path);
+    }
+
+    bool ok = ctx->wordIndex != NULL;
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    return ok;
+}
+
+// ---- Posting lists ----
+
+static const IndexList *find_list(const WordIndex *index, const char *word, uint32_t translation)
+{
+    size_t length = strlen(word);
+    uint32_t mask = index->header->hashSize - 1;
+
+    for (uint32_t slot = hash_word(word, length) & mask; index->hash[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const IndexTerm *term = &index->terms[index->hash[slot] - 1];
+        if (term->length != length || memcmp(&index->strings[term->string], word, length) != 0)
+            continue;
+
+        for (uint32_t l = term->firstList; l < term->firstList + term->listCount; l++)
+            if (index->lists[l].translation == translation)
+                return &index->lists[l];
+        return NULL;
+    }
+
+    return NULL;
+}
+
+// Refs of the verses of a posting list, and the positions of the word in each verse if [positions] isn't NULL
+// (verse i's positions are (*positions)[(*positionStart)[i]..(*positionStart)[i + 1]])
+static bible_refs decode_list(const WordIndex *index, const IndexList *list, uint32_t **positions, uint32_t **positionStart)
+{
+    bible_refs refs = { 0 };
+    if (list == NULL)
+        return refs;
+
+    uint32_t count, refBytes;
+    const uint8_t *data = get_varint(&index->postings[list->offset], &count);
+    data = get_varint(data, &refBytes);
+
+    refs.refs = malloc((count + 1) * sizeof(bible_ref));
+    refs.count = count;
+
+    uint32_t ref = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t delta;
+        data = get_varint(data, &delta);
+        refs.refs[i] = ref += delta;
+    }
+
+    if (positions != NULL)
+    {
+        size_t size = count * 2 + 4;
+        *positions = malloc(size * sizeof(uint32_t));
+        *positionStart = malloc((count + 1) * sizeof(uint32_t));
+
+        size_t total = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t positionCount, position = 0;
+            data = get_varint(data, &positionCount);
+
+            (*positionStart)[i] = total;
+            if (total + positionCount > size)
+            {
+                while (total + positionCount > size)
+                    size *= 2;
+                *positions = realloc(*positions, size * sizeof(uint32_t));
+            }
+
+            for (uint32_t p = 0; p < positionCount; p++)
+            {
+                uint32_t delta;
+                data = get_varint(data, &delta);
+                (*positions)[total++] = position += delta;
+            }
+        }
+        (*positionStart)[count] = total;
+    }
+
+    return refs;
+}
+
+// First index from [start] whose ref is >= [target] ([count] if there's none)
+// Takes bigger and bigger steps, then a binary search, then compares the last few refs at once
+static size_t gallop(const bible_ref *refs, size_t count, size_t start, bible_ref target)
+{
+    size_t low = start, high = start, step = 1;
+    while (high < count && refs[high] < target)
+    {
+        low = high + 1;
+        high = start + step;
+        step *= 2;
+    }
+    if (high > count)
+        high = count;
+
+    while (high - low > 8)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (refs[mid] < target)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+#ifdef __SSE2__
+    // Ids from [high] on are >= [target], so counting the smaller ones of the next 8 finds it
+    // (refs are under 2^31, so signed comparisons work)
+    if (low + 8 <= count)
+    {
+        __m128i wanted = _mm_set1_epi32(target);
+        __m128i first = _mm_loadu_si128((const __m128i*) &refs[low]);
+        __m128i second = _mm_loadu_si128((const __m128i*) &refs[low + 4]);
+        int smaller = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(first, wanted)))
+            | (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(second, wanted))) << 4);
+
+        return low + __builtin_popcount(smaller);
+    }
+#endif
+
+    while (low < high && refs[low] < target)
+        low++;
+
+    return low;
+}
+
+static bible_refs intersect(bible_refs a, bible_refs b)
+{
+    // Go through the shorter list, jumping ahead in the longer one
+    if (a.count > b.count)
+    {
+        bible_refs swap = a;
+        a = b, b = swap;
+    }
+
+    bible_refs result = { .refs = malloc((a.count + 1) * sizeof(bible_ref)) };
+    size_t j = 0;
+    for (size_t i = 0; i < a.count && j < b.count; i++)
+    {
+        j = gallop(b.refs, b.count, j, a.refs[i]);
+        if (j < b.count && b.refs[j] == a.refs[i])
+            result.refs[result.count++] = a.refs[i];
+    }
+
+    return result;
+}
+
+// Refs of [a] that aren't in [b]
+static bible_refs subtract(bible_refs a, bible_refs b)
+{
+    bible_refs result = { .refs = malloc((a.count + 1) * sizeof(bible_ref)) };
+    size_t j = 0;
+    for (size_t i = 0; i < a.count; i++)
+    {
+        j = gallop(b.refs, b.count, j, a.refs[i]);
+        if (j >= b.count || b.refs[j] != a.refs[i])
+            result.refs[result.count++] = a.refs[i];
+    }
+
+    return result;
+}
+
+static bible_refs unite(bible_refs a, bible_refs b)
+{
+    bible_refs result = { .refs = malloc((a.count + b.count + 1) * sizeof(bible_ref)) };
+    size_t i = 0, j = 0;
+    while (i < a.count || j < b.count)
+    {
+        bible_ref ref;
+        if (j >= b.count || (i < a.count && a.refs[i] < b.refs[j]))
+            ref = a.refs[i++];
+        else if (i >= a.count || b.refs[j] < a.refs[i])
+            ref = b.refs[j++];
+        else
+            ref = a.refs[i++], j++;
+
+        result.refs[result.count++] = ref;
+    }
+
+    return result;
+}
+
+// ---- Queries ----
+
+typedef struct
+{
+    const WordIndex *index;
+    const char *str;
+
+    // Next token (if [peeked])
+    char token[MAX_WORD * 2];
+    bool peeked;
+
+    char *error;
+    size_t errorSize;
+    bool failed;
+} Parser;
+
+// A part of a query, which may be excluded (NOT)
+typedef struct
+{
+    bible_refs refs;
+    bool negated;
+} Operand;
+
+static bible_refs parse_or(Parser *parser, uint32_t translation);
+
+static bible_refs fail(Parser *parser, const char *message, const char *token)
+{
+    if (!parser->failed)
+        snprintf(parser->error, parser->errorSize, message, token);
+    parser->failed = true;
+
+    return (bible_refs) { 0 };
+}
+
+// Tokens are brackets or anything between spaces and brackets
+static const char *peek(Parser *parser)
+{
+    if (parser->peeked)
+        return (parser->token[0] != '\0') ? parser->token : NULL;
+
+    const char *str = parser->str;
+    while (*str == ' ' || *str == '\t')
+        str++;
+
+    size_t length = 0;
+    if (*str == '(' || *str == ')')
+        parser->token[length++] = *str++;
+    else
+        while (*str != '\0' && *str != ' ' && *str != '\t' && *str != '(' && *str != ')' && length + 1 < sizeof(parser->token))
+            parser->token[length++] = *str++;
+
+    parser->token[length] = '\0';
+    parser->str = str;
+    parser->peeked = true;
+
+    return (length > 0) ? parser->token : NULL;
+}
+
+static void consume(Parser *parser)
+{
+    parser->peeked = false;
+}
+
+static bool is_token(const char *token, const char *keyword)
+{
+    return token != NULL && strcmp(token, keyword) == 0;
+}
+
+// Number of the translation [name] (of [length]) in [index], which isn't its number in the context's list
+static bool index_translation(const WordIndex *index, const char *name, size_t length, uint32_t *translation)
+{
+    for (uint32_t t = 0; t < index->header->translationCount; t++)
+    {
+        if (strlen(index->translations[t].name) == length && strncasecmp(index->translations[t].name, name, length) == 0)
+        {
+            *translation = t;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool find_translation(Parser *parser, const char *name, size_t length, uint32_t *translation)
+{
+    if (index_translation(parser->index, name, length, translation))
+        return true;
+
+    char copy[length + 1];
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    fail(parser, "Unknown translation \"%s\"", copy);
+
+    return false;
+}
+
+// Split a [translation:]word token, folding the word like the index did
+static bool parse_term(Parser *parser, const char *token, uint32_t *translation, char *word)
+{
+    const char *colon = strchr(token, ':');
+    if (colon != NULL)
+    {
+        if (!find_translation(parser, token, colon - token, translation))
+            return false;
+        token = colon + 1;
+    }
+
+    bool unknown;
+    const char *str = token;
+    if (next_word(&str, word, MAX_WORD, &unknown) == 0)
+    {
+        fail(parser, "\"%s\" isn't a word", token);
+        return false;
+    }
+
+    // e.g. "Lord's" is two words in the index
+    char rest[MAX_WORD];
+    if (next_word(&str, rest, sizeof(rest), &unknown) > 0)
+    {
+        fail(parser, "\"%s\" is more than one word (leave out the punctuation)", token);
+        return false;
+    }
+
+    return true;
+}
+
+// Verses where [a] and [b] are at most [distance] words apart
+static bible_refs near(Parser *parser, uint32_t translation, const char *a, const char *b, uint32_t distance)
+{
+    uint32_t *positionsA, *startA, *positionsB, *startB;
+    bible_refs refsA = decode_list(parser->index, find_list(parser->index, a, translation), &positionsA, &startA);
+    bible_refs refsB = decode_list(parser->index, find_list(parser->index, b, translation), &positionsB, &startB);
+
+    bible_refs result = { .refs = malloc((refsA.count + 1) * sizeof(bible_ref)) };
+    size_t j = 0;
+    for (size_t i = 0; i < refsA.count && j < refsB.count; i++)
+    {
+        j = gallop(refsB.refs, refsB.count, j, refsA.refs[i]);
+        if (j >= refsB.count || refsB.refs[j] != refsA.refs[i])
+            continue;
+
+        // Both position lists are sorted, so walk them together
+        uint32_t p = startA[i], q = startB[j];
+        bool close = false;
+        while (!close && p < startA[i + 1] && q < startB[j + 1])
+        {
+            uint32_t x = positionsA[p], y = positionsB[q];
+            close = ((x > y) ? x - y : y - x) <= distance;
+            if (x < y)
+                p++;
+            else
+                q++;
+        }
+
+        if (close)
+            result.refs[result.count++] = refsA.refs[i];
+    }
+
+    if (refsA.refs != NULL)
+        free(positionsA), free(startA);
+    if (refsB.refs != NULL)
+        free(positionsB), free(startB);
+    free(refsA.refs);
+    free(refsB.refs);
+
+    return result;
+}
+
+// ( query ) | TRANSLATION:( query ) | [TRANSLATION:]word [NEAR[/n] [TRANSLATION:]word]
+static bible_refs parse_primary(Parser *parser, uint32_t translation)
+{
+    const char *token = peek(parser);
+    if (token == NULL)
+        return fail(parser, "The query ended too early", "");
+
+    size_t length = strlen(token);
+    bool group = is_token(token, "(");
+
+    // A translation for everything in the brackets
+    if (length > 1 && token[length - 1] == ':')
+    {
+        if (!find_translation(parser, token, length - 1, &translation))
+            return (bible_refs) { 0 };
+
+        consume(parser);
+        if (!is_token(peek(parser), "("))
+            return fail(parser, "Expected \"(\" after \"%s\"", token);
+        group = true;
+    }
+
+    if (group)
+    {
+        consume(parser);
+        bible_refs refs = parse_or(parser, translation);
+
+        if (!is_token(peek(parser), ")"))
+        {
+            free(refs.refs);
+            return fail(parser, "Missing \")\"", "");
+        }
+        consume(parser);
+
+        return refs;
+    }
+
+    if (is_token(token, ")") || is_token(token, "AND") || is_token(token, "OR") || strncmp(token, "NEAR", 4) == 0)
+        return fail(parser, "Expected a word instead of \"%s\"", token);
+
+    char word[MAX_WORD];
+    uint32_t wordTranslation = translation;
+    if (!parse_term(parser, token, &wordTranslation, word))
+        return (bible_refs) { 0 };
+    consume(parser);
+
+    // Proximity
+    token = peek(parser);
+    if (token != NULL && strncmp(token, "NEAR", 4) == 0 && (token[4] == '\0' || token[4] == '/'))
+    {
+        int distance = DEFAULT_NEAR;
+        if (token[4] == '/' && sscanf(&token[5], "%d", &distance) != 1)
+            return fail(parser, "Expected a number in \"%s\" (e.g. NEAR/5)", token);
+        consume(parser);
+
+        const char *other = peek(parser);
+        if (other == NULL)
+            return fail(parser, "Expected a word after NEAR", "");
+
+        char otherWord[MAX_WORD];
+        uint32_t otherTranslation = translation;
+        if (!parse_term(parser, other, &otherTranslation, otherWord))
+            return (bible_refs) { 0 };
+        consume(parser);
+
+        if (otherTranslation != wordTranslation)
+            return fail(parser, "Both words of NEAR must be in the same translation", "");
+
+        return near(parser, wordTranslation, word, otherWord, (distance < 0) ? 0 : distance);
+    }
+
+    return decode_list(parser->index, find_list(parser->index, word, wordTranslation), NULL, NULL);
+}
+
+static Operand parse_not(Parser *parser, uint32_t translation)
+{
+    bool negated = is_token(peek(parser), "NOT");
+    if (negated)
+        consume(parser);
+
+    return (Operand) { parse_primary(parser, translation), negated };
+}
+
+// Operands joined by AND (or just spaces). "a NOT b" is a AND NOT b
+static bible_refs parse_and(Parser *parser, uint32_t translation)
+{
+    bible_refs included = { 0 }, excluded = { 0 };
+    bool hasIncluded = false;
+
+    for (;;)
+    {
+        const char *token = peek(parser);
+        if (token == NULL || is_token(token, ")") || is_token(token, "OR"))
+            break;
+        if (is_token(token, "AND"))
+        {
+            consume(parser);
+            continue;
+        }
+
+        Operand operand = parse_not(parser, translation);
+        if (parser->failed)
+        {
+            free(operand.refs.refs);
+            break;
+        }
+
+        // Collect everything excluded, then take it out at the end
+        bible_refs *target = operand.negated ? &excluded : &included;
+        bible_refs combined;
+        if (operand.negated)
+            combined = unite(*target, operand.refs);
+        else if (!hasIncluded)
+            combined = operand.refs, operand.refs.refs = NULL;
+        else
+            combined = intersect(*target, operand.refs);
+
+        hasIncluded |= !operand.negated;
+        free(operand.refs.refs);
+        free(target->refs);
+        *target = combined;
+    }
+
+    if (!parser->failed && !hasIncluded)
+        fail(parser, "NOT needs something to exclude from (e.g. \"KJV:grace NOT MSG:grace\")", "");
+
+    bible_refs result = { 0 };
+    if (!parser->failed)
+        result = subtract(included, excluded);
+
+    free(included.refs);
+    free(excluded.refs);
+
+    return result;
+}
+
+static bible_refs parse_or(Parser *parser, uint32_t translation)
+{
+    bible_refs result = parse_and(parser, translation);
+
+    while (!parser->failed && is_token(peek(parser), "OR"))
+    {
+        consume(parser);
+
+        bible_refs other = parse_and(parser, translation);
+        bible_refs combined = unite(result, other);
+        free(result.refs);
+        free(other.refs);
+        result = combined;
+    }
+
+    return result;
+}
+
+bible_refs *bible_index_query(bible_ctx *ctx, const char *query, const char *translation, char *error, size_t errorSize)
+{
+    if (ctx == NULL || query == NULL)
+        return NULL;
+
+    // Only checked once per context, like the translations
+    if (ctx->wordIndex == NULL && !bible_index_build(ctx, 0))
+    {
+        snprintf(error, errorSize, "Couldn't build the word index");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    Parser parser = { .index = ctx->wordIndex, .str = query, .error = error, .errorSize = errorSize };
+
+    uint32_t defaultTranslation = 0;
+    if (translation != NULL)
+        find_translation(&parser, translation, strlen(translation), &defaultTranslation);
+
+    bible_refs refs = { 0 };
+    if (!parser.failed)
+        refs = parse_or(&parser, defaultTranslation);
+    if (!parser.failed && peek(&parser) != NULL)
+        fail(&parser, "Unexpected \"%s\" (missing \"(\"?)", parser.token);
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    if (parser.failed)
+    {
+        free(refs.refs);
+        return NULL;
+    }
+
+    bible_refs *result = malloc(sizeof(bible_refs));
+    *result = refs;
+
+    return result;
+}
+
+void bible_refs_free(bible_refs *refs)
+{
+    if (refs != NULL)
+    {
+        free(refs->refs);
+        free(refs);
+    }
+}
+
+// ---- Concordance ----
+
+bible_concordance *bible_concordance_get(bible_ctx *ctx, const char *word, const char *translation)
+{
+    if (ctx == NULL || word == NULL)
+        return NULL;
+
+    // Split up like the verses were
+    char folded[MAX_WORD];
+    bool unknown;
+    if (next_word(&word, folded, sizeof(folded), &unknown) == 0)
+        return NULL;
+
+    // Built again if translations were added or changed since (e.g. found by bible_ctx_refresh()). If that
+    // fails, the index there is still used for the translations it has
+    bible_index_build(ctx, 0);
+
+    pthread_mutex_lock(&ctx->indexLock);
+    const WordIndex *index = ctx->wordIndex;
+    uint32_t t = 0;
+    if (index == NULL || (translation != NULL && !index_translation(index, translation, strlen(translation), &t)))
+    {
+        pthread_mutex_unlock(&ctx->indexLock);
+        return NULL;
+    }
+
+    uint32_t *positions = NULL, *positionStart = NULL;
+    bible_refs refs = decode_list(index, find_list(index, folded, t), &positions, &positionStart);
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    if (refs.refs == NULL)
+        return NULL;
+
+    bible_concordance *concordance = calloc(1, sizeof(bible_concordance));
+    concordance->count = refs.count;
+    concordance->refs = refs.refs;
+    concordance->positions = malloc(refs.count * sizeof(uint32_t));
+    concordance->occurrences = positionStart[refs.count];
+
+    // Verses are in Bible order, so each book's are next to each other
+    size_t bookSize = 0;
+    for (size_t i = 0; i < refs.count; i++)
+    {
+        concordance->positions[i] = positions[positionStart[i]];
+
+        int book = BIBLE_REF_BOOK(refs.refs[i]);
+        bible_book_range *last = (concordance->bookCount > 0) ? &concordance->books[concordance->bookCount - 1] : NULL;
+        if (last != NULL && last->book == book)
+        {
+            last->count++;
+            last->occurrences += positionStart[i + 1] - positionStart[i];
+            continue;
+        }
+
+        if (concordance->bookCount == bookSize)
+        {
+            bookSize = (bookSize == 0) ? 16 : bookSize * 2;
+            concordance->books = realloc(concordance->books, bookSize * sizeof(bible_book_range));
+        }
+        concordance->books[concordance->bookCount++] = (bible_book_range) {
+            .book = book, .first = i, .count = 1, .occurrences = positionStart[i + 1] - positionStart[i]
+        };
+    }
+
+    free(positions);
+    free(positionStart);
+
+    return concordance;
+}
+
+void bible_concordance_free(bible_concordance *concordance)
+{
+    if (concordance != NULL)
+    {
+        free(concordance->refs);
+        free(concordance->positions);
+        free(concordance->books);
+        free(concordance);
+    }
+}
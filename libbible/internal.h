@@ -0,0 +1,196 @@
+// Shared between the files of libbible (not part of the public header)
+#include <pthread.h>
+#include "../lib/sqlite/sqlite3.h"
+#include "bible.h"
+
+#define CACHE_SLOTS 1024
+// Translations are [dbDir]/NAME.SQLite3
+#define TRANSLATION_EXTENSION ".SQLite3"
+
+// Verses in SQLite (the search index's rowids and the notes database): the translation's book number
+// * 1000000 + chapter * 1000 + verse. Everywhere else they're bible_refs
+#define VERSE_ID(bookNumber, chapter, verse) ((uint32_t) (bookNumber) * 1000000 + (uint32_t) (chapter) * 1000 + (uint32_t) (verse))
+
+// Word index of every translation (see index.c)
+typedef struct WordIndex WordIndex;
+// Trigrams and folded text of one translation, for fuzzy search (see fuzzy.c)
+typedef struct FuzzyIndex FuzzyIndex;
+// TF-IDF matrix of one translation, for related verses (see related.c)
+typedef struct RelatedIndex RelatedIndex;
+// Parallel passages of one translation (see parallels.c)
+typedef struct ParallelIndex ParallelIndex;
+// Counts of every chapter of one translation (see stats.c)
+typedef struct StatsIndex StatsIndex;
+// How one translation numbers its verses (see versification.c)
+typedef struct VersificationIndex VersificationIndex;
+// Book names of one translation, sorted for prefix search (see books.c)
+typedef struct BookIndex BookIndex;
+// Section titles of one translation (see titles.c)
+typedef struct TitleIndex TitleIndex;
+
+typedef enum
+{
+    STMT_BOOK_NAMES,
+    STMT_BOOK_NAME,
+    STMT_NEXT_BOOK,
+    STMT_PREV_BOOK,
+    STMT_CHAPTER_COUNT,
+    STMT_VERSE_COUNT,
+    STMT_CHAPTER,
+    STMT_TITLES,
+    STMT_SEARCH,
+    STMT_SEARCH_SLOW,
+    STMT_BOOK_VERSES,
+    STMT_CLEAR_RANGES,
+    STMT_ADD_RANGE,
+    STMT_RANGE_VERSES,
+    STMT_RANGE_TITLES,
+    STMT_ALL_TITLES,
+    STMT_COUNT
+} Statement;
+
+typedef struct
+{
+    int verse;
+    char *text, *title;
+} CachedVerse;
+
+// A chapter shared by every connection to the same translation
+typedef struct
+{
+    // Translation and chapter in one word (see chapter_key() in cache.c)
+    uint64_t key;
+
+    size_t count;
+    CachedVerse *verses;
+
+    // Number of users (the chapter is freed after it is evicted and released by everyone)
+    int refs;
+    bool evicted;
+} CachedChapter;
+
+struct bible_ctx
+{
+    char *dbDir;
+
+    // Translations in [dbDir] (see registry.c)
+    bible_translation_info *translations;
+    size_t translationCount, translationCapacity;
+    // Index + 1 of each translation by the hash of its name (0 = empty), [translationHashSize] a power of 2
+    uint32_t *translationHash;
+    size_t translationHashSize;
+
+    // Each chapter goes into one slot (picked by its hash), replacing what was there
+    CachedChapter *slots[CACHE_SLOTS];
+    size_t misses, hits;
+    pthread_mutex_t cacheLock;
+
+    // Only one search index is built at a time
+    pthread_mutex_t indexLock;
+    // Loaded (or built) on the first query
+    WordIndex *wordIndex;
+    // Built on the first fuzzy search of each translation
+    FuzzyIndex *fuzzyIndexes;
+    // Loaded (or built) the first time related verses of a translation are asked for
+    RelatedIndex *relatedIndexes;
+    // Loaded (or built) the first time parallel passages of a translation are asked for
+    ParallelIndex *parallelIndexes;
+    // Loaded (or counted) the first time the statistics of a translation are asked for
+    StatsIndex *statsIndexes;
+    // Worked out the first time a translation's verses are mapped to another's
+    VersificationIndex *versifications;
+    // Made the first time books of a translation are suggested
+    BookIndex *bookIndexes;
+    // Made the first time the outline of a translation is asked for
+    TitleIndex *titleIndexes;
+};
+
+struct bible_conn
+{
+    bible_ctx *ctx;
+    char translation[64];
+    // Index of the translation in [ctx] (-1 if it isn't one of them, so its chapters aren't cached)
+    int translationIndex;
+
+    sqlite3 *db;
+    // Statements are prepared once and reused
+    sqlite3_stmt *statements[STMT_COUNT];
+    bool hasStories;
+    // The search index is attached as "search" (checked once per connection)
+    bool searchChecked, hasSearch;
+    // The temporary table of bible_get_ranges() (created on first use)
+    bool hasRanges;
+
+    pthread_mutex_t lock;
+};
+
+// MyBible book number of [book] (1..66) e.g. 10 for Genesis, and the other way round (0 if there's none)
+int book_number(int book);
+int book_index(int bookNumber);
+// Verse of a row of a translation (0 if its book isn't one of the 66, or a ref can't hold it)
+bible_ref row_ref(int bookNumber, int chapter, int verse);
+// [ref] as a VERSE_ID() and back (0 if it isn't one of the 66 books)
+uint32_t verse_id(bible_ref ref);
+bible_ref verse_ref(uint32_t id);
+
+// Get prepared statement [id] (lock must be held). Reset it with done() after use
+sqlite3_stmt *statement(bible_conn *conn, Statement id);
+void done(sqlite3_stmt *sql);
+// Copy a book name without its trailing whitespace
+void copy_book_name(char *longName, size_t longNameSize, const unsigned char *name);
+// [i]th standard name or abbreviation (lower case, without spaces) and its book 1..66 (NULL past the last one)
+const char *standard_book_key(size_t i, int *book);
+
+// Get a chapter from the cache of [conn]'s context, reading it if needed (NULL if it doesn't exist)
+// Call cache_release() when done with it
+CachedChapter *cache_get_chapter(bible_conn *conn, bible_ref chapter);
+void cache_release(bible_ctx *ctx, CachedChapter *chapter);
+void cache_clear(bible_ctx *ctx);
+
+void word_index_free(WordIndex *index);
+// Free [index] and the ones after it
+void fuzzy_index_free(FuzzyIndex *index);
+// Free [index] and the ones after it
+void related_index_free(RelatedIndex *index);
+// Free [index] and the ones after it
+void parallel_index_free(ParallelIndex *index);
+// Free [index] and the ones after it
+void stats_index_free(StatsIndex *index);
+// Free [index] and the ones after it
+void versification_free(VersificationIndex *index);
+// Free [index] and the ones after it
+void book_index_free(BookIndex *index);
+// Free [index] and the ones after it
+void title_index_free(TitleIndex *index);
+// [conn]'s name of [book] (1..66), from the book index (false if it has no name)
+bool book_index_name(bible_conn *conn, int book, char *longName, size_t longNameSize);
+
+// Find the translations of [ctx] (from the manifest if the folder hasn't changed) and free them
+void registry_load(bible_ctx *ctx);
+void registry_free(bible_ctx *ctx);
+
+// Files made from the translations, kept in [dbDir]/.index (see sidecar.c)
+// Path of translation [name] e.g. "db/KJV.SQLite3"
+void translation_path(const bible_ctx *ctx, const char *name, char *path, size_t pathSize);
+// Path of file [name][extension] in the index folder e.g. "db/.index/KJV.rel"
+void sidecar_path(const bible_ctx *ctx, const char *name, const char *extension, char *path, size_t pathSize);
+// Make the index folder (if it isn't there)
+void sidecar_folder(const bible_ctx *ctx);
+// Size and modification time of translation [name] (what's made from it is made again when they change)
+bool source_info(const bible_ctx *ctx, const char *name, int64_t *size, int64_t *mtime);
+// Temporary file to write [path] into, before sidecar_finish() moves it into place
+void sidecar_temp_path(const char *path, char *tempPath, size_t tempPathSize);
+// If [written], sync [tempPath] to disk and rename it over [path]. Otherwise (or if that fails) remove it
+// Returns whether [path] is the new file
+bool sidecar_finish(const char *tempPath, const char *path, bool written);
+
+// Set the book name and text (without tags) of each hit, from its verse
+void fill_hits(bible_conn *conn, bible_results *results);
+
+// Read [chapter] (with titles) from the database. Returns the number of verses
+size_t load_chapter(bible_conn *conn, bible_ref chapter, CachedVerse **verses);
+
+// Copy the next word of [*str] to [word] the way the search indexes see it (lower case, without accents)
+// and move [*str] past it. Returns the word's length (0 if there are no more words)
+// [*unknown] is set if the word might be folded differently by the index (or didn't fit)
+size_t next_word(const char **str, char *word, size_t wordSize, bool *unknown);
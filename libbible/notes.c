@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+// Bookmarks and highlights of the user, in their own SQLite database (translations are only read)
+//
+// Highlights of a verse are kept merged: ranges of words that don't overlap or touch, so the ones of a passage
+// come back sorted and ready to draw over it. Verses are stored as VERSE_ID()s, as the databases already
+// saved have them, and made bible_refs as they're read
+
+typedef enum
+{
+    NOTES_BOOKMARKS,
+    NOTES_HIGHLIGHTS,
+    NOTES_IS_BOOKMARKED,
+    NOTES_ADD_BOOKMARK,
+    NOTES_REMOVE_BOOKMARK,
+    NOTES_VERSE_HIGHLIGHTS,
+    NOTES_CLEAR_HIGHLIGHTS,
+    NOTES_ADD_HIGHLIGHT,
+    NOTES_COUNT
+} NotesStatement;
+
+static const char *const notesQueries[NOTES_COUNT] =
+{
+    [NOTES_BOOKMARKS] = "SELECT verse_id FROM bookmarks WHERE verse_id BETWEEN ?1 AND ?2 ORDER BY verse_id",
+    [NOTES_HIGHLIGHTS] = "SELECT verse_id, first_word, last_word FROM highlights"
+        " WHERE translation = ?1 AND verse_id BETWEEN ?2 AND ?3 ORDER BY verse_id, first_word",
+    [NOTES_IS_BOOKMARKED] = "SELECT 1 FROM bookmarks WHERE verse_id = ?1",
+    [NOTES_ADD_BOOKMARK] = "INSERT INTO bookmarks (verse_id, created) VALUES (?1, strftime('%s', 'now'))",
+    [NOTES_REMOVE_BOOKMARK] = "DELETE FROM bookmarks WHERE verse_id = ?1",
+    [NOTES_VERSE_HIGHLIGHTS] = "SELECT first_word, last_word FROM highlights"
+        " WHERE translation = ?1 AND verse_id = ?2 ORDER BY first_word",
+    [NOTES_CLEAR_HIGHLIGHTS] = "DELETE FROM highlights WHERE translation = ?1 AND verse_id = ?2",
+    [NOTES_ADD_HIGHLIGHT] = "INSERT INTO highlights (translation, verse_id, first_word, last_word) VALUES (?1, ?2, ?3, ?4)"
+};
+
+static const char createNotes[] =
+    "CREATE TABLE IF NOT EXISTS bookmarks (verse_id INTEGER PRIMARY KEY, created INTEGER);"
+    "CREATE TABLE IF NOT EXISTS highlights (translation TEXT NOT NULL, verse_id INTEGER NOT NULL,"
+    " first_word INTEGER NOT NULL, last_word INTEGER NOT NULL);"
+    "CREATE INDEX IF NOT EXISTS highlights_verse ON highlights (translation, verse_id, first_word);";
+
+struct bible_notes
+{
+    sqlite3 *db;
+    sqlite3_stmt *statements[NOTES_COUNT];
+    pthread_mutex_t lock;
+};
+
+// Most highlights of one verse (it has fewer words than this)
+#define MAX_VERSE_HIGHLIGHTS 256
+
+bible_notes *bible_notes_open(const char *path)
+{
+    bible_notes *notes = calloc(1, sizeof(bible_notes));
+    if (notes == NULL)
+        return NULL;
+
+    if (sqlite3_open_v2(path, &notes->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK
+        || sqlite3_exec(notes->db, createNotes, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(notes->db);
+        free(notes);
+        return NULL;
+    }
+
+	// Another instance may be writing
+    sqlite3_busy_timeout(notes->db, 1000);
+    pthread_mutex_init(&notes->lock, NULL);
+
+    return notes;
+}
+
+void bible_notes_close(bible_notes *notes)
+{
+    if (notes == NULL)
+        return;
+
+    for (int i = 0; i < NOTES_COUNT; i++)
+        sqlite3_finalize(notes->statements[i]);
+    sqlite3_close(notes->db);
+    pthread_mutex_destroy(&notes->lock);
+    free(notes);
+}
+
+static sqlite3_stmt *notes_statement(bible_notes *notes, NotesStatement id)
+{
+    if (notes->statements[id] == NULL
+        && sqlite3_prepare_v2(notes->db, notesQueries[id], -1, &notes->statements[id], NULL) != SQLITE_OK)
+    {
+        sqlite3_finalize(notes->statements[id]);
+        notes->statements[id] = NULL;
+    }
+
+    return notes->statements[id];
+}
+
+static bool grow_array(void **array, size_t *capacity, size_t count, size_t itemSize)
+{
+    if (count < *capacity)
+        return true;
+
+    size_t newCapacity = (*capacity == 0) ? 16 : *capacity * 2;
+    void *grown = realloc(*array, newCapacity * itemSize);
+    if (grown == NULL)
+        return false;
+
+    *array = grown, *capacity = newCapacity;
+    return true;
+}
+
+bible_annotations *bible_annotations_get(bible_notes *notes, const char *translation, bible_ref first, bible_ref last)
+{
+    if (notes == NULL)
+        return NULL;
+
+    uint32_t firstId = verse_id(first), lastId = verse_id(last);
+
+    bible_annotations *annotations = calloc(1, sizeof(bible_annotations));
+    if (annotations == NULL)
+        return NULL;
+
+    size_t bookmarkCapacity = 0, highlightCapacity = 0;
+    bool failed = false;
+
+    pthread_mutex_lock(&notes->lock);
+
+    sqlite3_stmt *sql = notes_statement(notes, NOTES_BOOKMARKS);
+    if (sql != NULL)
+    {
+        sqlite3_bind_int64(sql, 1, firstId);
+        sqlite3_bind_int64(sql, 2, lastId);
+        while (!failed && sqlite3_step(sql) == SQLITE_ROW)
+        {
+            bible_ref ref = verse_ref(sqlite3_column_int64(sql, 0));
+            failed = !grow_array((void**) &annotations->bookmarks, &bookmarkCapacity, annotations->bookmarkCount, sizeof(bible_ref));
+            if (!failed && ref != 0)
+                annotations->bookmarks[annotations->bookmarkCount++] = ref;
+        }
+        done(sql);
+    }
+
+    sql = (translation != NULL) ? notes_statement(notes, NOTES_HIGHLIGHTS) : NULL;
+    if (sql != NULL)
+    {
+        sqlite3_bind_text(sql, 1, translation, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(sql, 2, firstId);
+        sqlite3_bind_int64(sql, 3, lastId);
+        while (!failed && sqlite3_step(sql) == SQLITE_ROW)
+        {
+            bible_ref ref = verse_ref(sqlite3_column_int64(sql, 0));
+            failed = !grow_array((void**) &annotations->highlights, &highlightCapacity, annotations->highlightCount, sizeof(bible_highlight));
+            if (!failed && ref != 0)
+                annotations->highlights[annotations->highlightCount++] = (bible_highlight)
+                {
+                    .ref = ref,
+                    .firstWord = sqlite3_column_int(sql, 1),
+                    .lastWord = sqlite3_column_int(sql, 2)
+                };
+        }
+        done(sql);
+    }
+
+    pthread_mutex_unlock(&notes->lock);
+
+    if (failed)
+    {
+        bible_annotations_free(annotations);
+        return NULL;
+    }
+
+    return annotations;
+}
+
+void bible_annotations_free(bible_annotations *annotations)
+{
+    if (annotations == NULL)
+        return;
+
+    free(annotations->bookmarks);
+    free(annotations->highlights);
+    free(annotations);
+}
+
+// Run [sql] (bound to [verseId]) to the end, returning whether there was a row
+static bool run_for_verse(sqlite3_stmt *sql, uint32_t verseId, bool *ok)
+{
+    if (sql == NULL)
+    {
+        *ok = false;
+        return false;
+    }
+
+    sqlite3_bind_int64(sql, 1, verseId);
+    int result = sqlite3_step(sql);
+    *ok = (result == SQLITE_ROW || result == SQLITE_DONE);
+    done(sql);
+
+    return result == SQLITE_ROW;
+}
+
+bool bible_bookmark_toggle(bible_notes *notes, bible_ref ref)
+{
+    uint32_t verseId = verse_id(ref);
+    if (notes == NULL || verseId == 0)
+        return false;
+
+    bool ok;
+    pthread_mutex_lock(&notes->lock);
+
+    bool bookmarked = run_for_verse(notes_statement(notes, NOTES_IS_BOOKMARKED), verseId, &ok);
+    run_for_verse(notes_statement(notes, bookmarked ? NOTES_REMOVE_BOOKMARK : NOTES_ADD_BOOKMARK), verseId, &ok);
+    if (ok)
+        bookmarked = !bookmarked;
+
+    pthread_mutex_unlock(&notes->lock);
+
+    return bookmarked;
+}
+
+// Words [first]..[last] added to (or taken from) the merged [ranges] of a verse. Returns the new count
+static size_t change_ranges(uint16_t ranges[][2], size_t count, uint16_t first, uint16_t last, bool add)
+{
+    uint16_t changed[MAX_VERSE_HIGHLIGHTS + 2][2];
+    size_t changedCount = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+		// Ranges apart from it stay as they are (ones touching it join it)
+        if (ranges[i][1] + 1 < first || ranges[i][0] > last + 1 || (!add && (ranges[i][1] < first || ranges[i][0] > last)))
+        {
+            memcpy(changed[changedCount++], ranges[i], sizeof(ranges[i]));
+            continue;
+        }
+
+        if (add)
+        {
+            if (ranges[i][0] < first)
+                first = ranges[i][0];
+            if (ranges[i][1] > last)
+                last = ranges[i][1];
+            continue;
+        }
+
+		// What's left either side of the words cleared
+        if (ranges[i][0] < first)
+            changed[changedCount][0] = ranges[i][0], changed[changedCount++][1] = first - 1;
+        if (ranges[i][1] > last)
+            changed[changedCount][0] = last + 1, changed[changedCount++][1] = ranges[i][1];
+    }
+
+    if (add)
+    {
+        size_t at = 0;
+        while (at < changedCount && changed[at][0] < first)
+            at++;
+        memmove(changed[at + 1], changed[at], (changedCount - at) * sizeof(changed[0]));
+        changed[at][0] = first, changed[at][1] = last;
+        changedCount++;
+    }
+
+    if (changedCount > MAX_VERSE_HIGHLIGHTS)
+        changedCount = MAX_VERSE_HIGHLIGHTS;
+    memcpy(ranges, changed, changedCount * sizeof(changed[0]));
+
+    return changedCount;
+}
+
+bool bible_highlight_toggle(bible_notes *notes, const char *translation, bible_ref ref, uint16_t firstWord, uint16_t lastWord)
+{
+    uint32_t verseId = verse_id(ref);
+    if (notes == NULL || translation == NULL || verseId == 0 || lastWord < firstWord)
+        return false;
+
+    uint16_t ranges[MAX_VERSE_HIGHLIGHTS][2];
+    size_t count = 0;
+    bool ok = true;
+
+    pthread_mutex_lock(&notes->lock);
+    sqlite3_exec(notes->db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+
+    sqlite3_stmt *sql = notes_statement(notes, NOTES_VERSE_HIGHLIGHTS);
+    if (sql != NULL)
+    {
+        sqlite3_bind_text(sql, 1, translation, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(sql, 2, verseId);
+        while (count < MAX_VERSE_HIGHLIGHTS && sqlite3_step(sql) == SQLITE_ROW)
+        {
+            ranges[count][0] = sqlite3_column_int(sql, 0);
+            ranges[count][1] = sqlite3_column_int(sql, 1);
+            count++;
+        }
+        done(sql);
+    }
+
+	// Cleared if one range has all of them (they're merged, so it's that or some aren't highlighted)
+    bool highlighted = false;
+    for (size_t i = 0; i < count; i++)
+        highlighted |= ranges[i][0] <= firstWord && ranges[i][1] >= lastWord;
+    count = change_ranges(ranges, count, firstWord, lastWord, !highlighted);
+
+	// The verse's ranges are written again
+    sql = notes_statement(notes, NOTES_CLEAR_HIGHLIGHTS);
+    if ((ok = sql != NULL))
+    {
+        sqlite3_bind_text(sql, 1, translation, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(sql, 2, verseId);
+        ok = sqlite3_step(sql) == SQLITE_DONE;
+        done(sql);
+    }
+
+    sql = notes_statement(notes, NOTES_ADD_HIGHLIGHT);
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        if (!(ok = sql != NULL))
+            break;
+
+        sqlite3_bind_text(sql, 1, translation, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(sql, 2, verseId);
+        sqlite3_bind_int(sql, 3, ranges[i][0]);
+        sqlite3_bind_int(sql, 4, ranges[i][1]);
+        ok = sqlite3_step(sql) == SQLITE_DONE;
+        done(sql);
+    }
+
+    sqlite3_exec(notes->db, ok ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+    pthread_mutex_unlock(&notes->lock);
+
+    return ok;
+}
@@ -0,0 +1,568 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "internal.h"
+
+// Parallel passages: verses that say nearly the same thing somewhere else (Kings and Chronicles,
+// the Gospels, the Psalms quoted in Hebrews)
+//
+// Every verse gets a MinHash signature of its 3-word pieces (shingles): the smallest hash of them under
+// each of SIGNATURE_SIZE hash functions. Two verses share a signature entry about as often as they
+// share shingles (their Jaccard similarity). Signatures are cut into BANDS bands, and verses with a
+// band in common are compared. Matches of verses that follow each other are joined into passages
+//
+// The passages are kept in [dbDir]/.index/TRANSLATION.par: a ParallelHeader, then ParallelRecords
+// sorted by their first verse (each passage is there twice, once from each side)
+
+#define PARALLEL_MAGIC "BIBLEPAR"
+#define PARALLEL_VERSION 2
+
+#define SHINGLE_WORDS 3
+#define SIGNATURE_SIZE 64
+#define BANDS 16
+#define BAND_ROWS (SIGNATURE_SIZE / BANDS)
+// Bands shared by more verses are stock phrases ("And the LORD spake unto Moses, saying"), not parallels
+#define MAX_BUCKET 32
+// Lowest (estimated) similarity that's kept
+#define MIN_SIMILARITY 0.5
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version, count;
+    // The translation it was built from
+    int64_t sourceSize, sourceMtime;
+} ParallelHeader;
+
+typedef struct
+{
+    bible_ref first, last, otherFirst, otherLast;
+    // Similarity * 10000
+    uint32_t similarity;
+} ParallelRecord;
+
+struct ParallelIndex
+{
+    char translation[64];
+    ParallelIndex *next;
+
+    size_t count;
+    ParallelRecord *records;
+    // Widest [first..last] of them (in refs), to find the ones reaching into a chapter
+    uint32_t longest;
+};
+
+// ---- Building ----
+
+typedef struct
+{
+    bible_ref *refs;
+    size_t verseCount, verseSize;
+    // Verse i's shingle hashes are shingles[shingleStart[i]..shingleStart[i + 1]]
+    uint64_t *shingles;
+    size_t shingleCount, shingleSize;
+    uint32_t *shingleStart;
+
+    uint32_t *signatures;
+} ParallelBuild;
+
+// Finalizer of splitmix64: spreads every bit of [x] over the result
+static inline uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t hash_text(const char *text, uint64_t hash)
+{
+    // FNV-1a
+    for (; *text != '\0'; text++)
+        hash = (hash ^ (unsigned char) *text) * 0x100000001B3ull;
+
+    return hash;
+}
+
+static void add_verse(bible_ref ref, const char *text, void *data)
+{
+    ParallelBuild *build = data;
+
+    if (build->verseCount + 1 >= build->verseSize)
+    {
+        build->verseSize = (build->verseSize == 0) ? 1024 : build->verseSize * 2;
+        build->refs = realloc(build->refs, build->verseSize * sizeof(bible_ref));
+        build->shingleStart = realloc(build->shingleStart, (build->verseSize + 1) * sizeof(uint32_t));
+    }
+
+    size_t textSize = strlen(text) + 1;
+    char *plain = malloc(textSize);
+    bible_strip_tags(text, plain, textSize);
+
+    // The last few words (as hashes), to make shingles from
+    uint64_t words[SHINGLE_WORDS];
+    size_t wordCount = 0;
+    char word[64];
+    bool unknown;
+    const char *str = plain;
+    while (next_word(&str, word, sizeof(word), &unknown) > 0)
+    {
+        memmove(&words[0], &words[1], (SHINGLE_WORDS - 1) * sizeof(uint64_t));
+        words[SHINGLE_WORDS - 1] = hash_text(word, 0xCBF29CE484222325ull);
+
+        if (++wordCount < SHINGLE_WORDS)
+            continue;
+
+        if (build->shingleCount == build->shingleSize)
+        {
+            build->shingleSize = (build->shingleSize == 0) ? 65536 : build->shingleSize * 2;
+            build->shingles = realloc(build->shingles, build->shingleSize * sizeof(uint64_t));
+        }
+
+        uint64_t shingle = 0;
+        for (int w = 0; w < SHINGLE_WORDS; w++)
+            shingle = mix(shingle ^ words[w]);
+        build->shingles[build->shingleCount++] = shingle;
+    }
+    free(plain);
+
+    build->refs[build->verseCount] = ref;
+    build->shingleStart[++build->verseCount] = build->shingleCount;
+}
+
+// Verse pair (indexes, [a] < [b]) that shares a band
+typedef struct
+{
+    uint32_t a, b;
+} Candidate;
+
+typedef struct
+{
+    uint64_t hash;
+    uint32_t verse;
+} BandEntry;
+
+typedef struct
+{
+    ParallelBuild *build;
+
+    // Next piece of work (verses for signatures, bands for candidates)
+    size_t next;
+    pthread_mutex_t lock;
+
+    Candidate *candidates;
+    size_t candidateCount, candidateSize;
+} ParallelWork;
+
+static size_t take_work(ParallelWork *work, size_t amount)
+{
+    pthread_mutex_lock(&work->lock);
+    size_t start = work->next;
+    work->next += amount;
+    pthread_mutex_unlock(&work->lock);
+
+    return start;
+}
+
+static void *sign_verses(void *arg)
+{
+    ParallelWork *work = arg;
+    ParallelBuild *build = work->build;
+
+    size_t start;
+    while ((start = take_work(work, 256)) < build->verseCount)
+    {
+        size_t end = (start + 256 < build->verseCount) ? start + 256 : build->verseCount;
+        for (size_t v = start; v < end; v++)
+        {
+            uint32_t *signature = &build->signatures[v * SIGNATURE_SIZE];
+            for (int h = 0; h < SIGNATURE_SIZE; h++)
+                signature[h] = UINT32_MAX;
+
+            // Hash function h is mix(shingle + h * constant)
+            for (uint32_t s = build->shingleStart[v]; s < build->shingleStart[v + 1]; s++)
+                for (int h = 0; h < SIGNATURE_SIZE; h++)
+                {
+                    uint32_t hash = (uint32_t) mix(build->shingles[s] + (uint64_t) (h + 1) * 0x9E3779B97F4A7C15ull);
+                    if (hash < signature[h])
+                        signature[h] = hash;
+                }
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_band_entries(const void *a, const void *b)
+{
+    const BandEntry *entryA = a, *entryB = b;
+    if (entryA->hash != entryB->hash)
+        return (entryA->hash > entryB->hash) - (entryA->hash < entryB->hash);
+
+    return (entryA->verse > entryB->verse) - (entryA->verse < entryB->verse);
+}
+
+static int compare_candidates(const void *a, const void *b)
+{
+    const Candidate *candidateA = a, *candidateB = b;
+    if (candidateA->a != candidateB->a)
+        return (candidateA->a > candidateB->a) - (candidateA->a < candidateB->a);
+
+    return (candidateA->b > candidateB->b) - (candidateA->b < candidateB->b);
+}
+
+// Verses in the same chapter aren't parallels (e.g. the refrain of Psalm 136)
+static inline bool same_chapter(bible_ref a, bible_ref b)
+{
+    return a >> 8 == b >> 8;
+}
+
+static void *band_verses(void *arg)
+{
+    ParallelWork *work = arg;
+    ParallelBuild *build = work->build;
+    BandEntry *entries = malloc((build->verseCount + 1) * sizeof(BandEntry));
+
+    Candidate *found = NULL;
+    size_t foundCount = 0, foundSize = 0;
+
+    size_t band;
+    while ((band = take_work(work, 1)) < BANDS)
+    {
+        size_t count = 0;
+        for (size_t v = 0; v < build->verseCount; v++)
+        {
+            // Verses too short for a shingle have nothing to compare
+            if (build->shingleStart[v] == build->shingleStart[v + 1])
+                continue;
+
+            const uint32_t *rows = &build->signatures[v * SIGNATURE_SIZE + band * BAND_ROWS];
+            uint64_t hash = band;
+            for (int r = 0; r < BAND_ROWS; r++)
+                hash = mix(hash ^ rows[r]);
+            entries[count++] = (BandEntry) { hash, v };
+        }
+
+        qsort(entries, count, sizeof(BandEntry), &compare_band_entries);
+
+        for (size_t start = 0, end; start < count; start = end)
+        {
+            for (end = start + 1; end < count && entries[end].hash == entries[start].hash; end++);
+            if (end - start > MAX_BUCKET)
+                continue;
+
+            for (size_t i = start; i < end; i++)
+                for (size_t j = i + 1; j < end; j++)
+                {
+                    if (same_chapter(build->refs[entries[i].verse], build->refs[entries[j].verse]))
+                        continue;
+
+                    if (foundCount == foundSize)
+                    {
+                        foundSize = (foundSize == 0) ? 1024 : foundSize * 2;
+                        found = realloc(found, foundSize * sizeof(Candidate));
+                    }
+                    found[foundCount++] = (Candidate) { entries[i].verse, entries[j].verse };
+                }
+        }
+    }
+    free(entries);
+
+    // Nothing to add (found is NULL then)
+    if (foundCount == 0)
+        return NULL;
+
+    pthread_mutex_lock(&work->lock);
+    if (work->candidateCount + foundCount > work->candidateSize)
+    {
+        work->candidateSize = work->candidateCount + foundCount;
+        work->candidates = realloc(work->candidates, (work->candidateSize + 1) * sizeof(Candidate));
+    }
+    memcpy(&work->candidates[work->candidateCount], found, foundCount * sizeof(Candidate));
+    work->candidateCount += foundCount;
+    pthread_mutex_unlock(&work->lock);
+
+    free(found);
+
+    return NULL;
+}
+
+// Fraction of the signatures of verses [a] and [b] that are the same
+static double similarity(const ParallelBuild *build, uint32_t a, uint32_t b)
+{
+    const uint32_t *signatureA = &build->signatures[a * SIGNATURE_SIZE], *signatureB = &build->signatures[b * SIGNATURE_SIZE];
+
+    int same = 0;
+    for (int h = 0; h < SIGNATURE_SIZE; h++)
+        same += signatureA[h] == signatureB[h];
+
+    return (double) same / SIGNATURE_SIZE;
+}
+
+static bool is_candidate(const Candidate *candidates, size_t count, uint32_t a, uint32_t b)
+{
+    Candidate key = { a, b };
+    return bsearch(&key, candidates, count, sizeof(Candidate), &compare_candidates) != NULL;
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    const ParallelRecord *recordA = a, *recordB = b;
+    if (recordA->first != recordB->first)
+        return (recordA->first > recordB->first) - (recordA->first < recordB->first);
+
+    return (recordA->otherFirst > recordB->otherFirst) - (recordA->otherFirst < recordB->otherFirst);
+}
+
+// Join matching verses that follow each other (in both places) into passages
+static ParallelRecord *find_passages(const ParallelBuild *build, Candidate *pairs, size_t pairCount, size_t *count)
+{
+    ParallelRecord *records = malloc((pairCount * 2 + 1) * sizeof(ParallelRecord));
+    *count = 0;
+
+    for (size_t p = 0; p < pairCount; p++)
+    {
+        uint32_t a = pairs[p].a, b = pairs[p].b;
+
+        // Only start at the beginning of a passage
+        if (a > 0 && same_chapter(build->refs[a - 1], build->refs[a]) && same_chapter(build->refs[b - 1], build->refs[b])
+            && is_candidate(pairs, pairCount, a - 1, b - 1))
+            continue;
+
+        size_t length = 1;
+        double total = similarity(build, a, b);
+        while (b + length < build->verseCount
+            && same_chapter(build->refs[a], build->refs[a + length]) && same_chapter(build->refs[b], build->refs[b + length])
+            && is_candidate(pairs, pairCount, a + length, b + length))
+        {
+            total += similarity(build, a + length, b + length);
+            length++;
+        }
+
+        uint32_t score = (uint32_t) (total / length * 10000 + 0.5);
+        records[(*count)++] = (ParallelRecord) {
+            build->refs[a], build->refs[a + length - 1], build->refs[b], build->refs[b + length - 1], score
+        };
+        records[(*count)++] = (ParallelRecord) {
+            build->refs[b], build->refs[b + length - 1], build->refs[a], build->refs[a + length - 1], score
+        };
+    }
+
+    qsort(records, *count, sizeof(ParallelRecord), &compare_records);
+
+    return records;
+}
+
+static bool build_parallels(bible_conn *conn, const char *path, int threads, int64_t sourceSize, int64_t sourceMtime)
+{
+    ParallelBuild build = { 0 };
+    build.shingleStart = malloc(sizeof(uint32_t));
+    build.shingleStart[0] = 0;
+
+    for (int book = bible_adjacent_book(conn, 0, 1, NULL, 0); book > 0; book = bible_adjacent_book(conn, book, 1, NULL, 0))
+        bible_each_verse(conn, book, &add_verse, &build);
+
+    ParallelWork work = { .build = &build };
+    pthread_mutex_init(&work.lock, NULL);
+
+    build.signatures = malloc((build.verseCount * SIGNATURE_SIZE + 1) * sizeof(uint32_t));
+    bible_threads_run(threads, &sign_verses, &work);
+    work.next = 0;
+    bible_threads_run((threads < BANDS) ? threads : BANDS, &band_verses, &work);
+    pthread_mutex_destroy(&work.lock);
+
+    // Each pair once, if it's similar enough
+    if (work.candidateCount > 0)
+        qsort(work.candidates, work.candidateCount, sizeof(Candidate), &compare_candidates);
+    size_t pairCount = 0;
+    for (size_t c = 0; c < work.candidateCount; c++)
+    {
+        if (pairCount > 0 && compare_candidates(&work.candidates[pairCount - 1], &work.candidates[c]) == 0)
+            continue;
+        if (similarity(&build, work.candidates[c].a, work.candidates[c].b) >= MIN_SIMILARITY)
+            work.candidates[pairCount++] = work.candidates[c];
+    }
+
+    size_t recordCount;
+    ParallelRecord *records = find_passages(&build, work.candidates, pairCount, &recordCount);
+
+    ParallelHeader header = {
+        .version = PARALLEL_VERSION, .count = recordCount, .sourceSize = sourceSize, .sourceMtime = sourceMtime
+    };
+    memcpy(header.magic, PARALLEL_MAGIC, sizeof(header.magic));
+
+    char tempPath[strlen(path) + 32];
+    sidecar_temp_path(path, tempPath, sizeof(tempPath));
+
+    // Readers never see a half-written file
+    bool written = false;
+    FILE *file = fopen(tempPath, "wb");
+    if (file != NULL)
+    {
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(records, sizeof(ParallelRecord), recordCount, file);
+        written = !ferror(file);
+        written &= (fclose(file) == 0);
+    }
+    bool built = sidecar_finish(tempPath, path, written);
+
+    free(records);
+    free(work.candidates);
+    free(build.refs);
+    free(build.shingles);
+    free(build.shingleStart);
+    free(build.signatures);
+
+    return built;
+}
+
+// ---- Reading ----
+
+static ParallelIndex *parallels_open(const char *path, const char *translation, int64_t sourceSize, int64_t sourceMtime)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    // Rebuilt when the translation changes
+    ParallelHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, PARALLEL_MAGIC, sizeof(header.magic)) != 0
+        || header.version != PARALLEL_VERSION || header.sourceSize != sourceSize || header.sourceMtime != sourceMtime)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    ParallelIndex *index = calloc(1, sizeof(ParallelIndex));
+    snprintf(index->translation, sizeof(index->translation), "%s", translation);
+    index->records = malloc((header.count + 1) * sizeof(ParallelRecord));
+    index->count = fread(index->records, sizeof(ParallelRecord), header.count, file);
+    fclose(file);
+
+    for (size_t r = 0; r < index->count; r++)
+        if (index->records[r].last - index->records[r].first > index->longest)
+            index->longest = index->records[r].last - index->records[r].first;
+
+    return index;
+}
+
+void parallel_index_free(ParallelIndex *index)
+{
+    while (index != NULL)
+    {
+        ParallelIndex *next = index->next;
+
+        free(index->records);
+        free(index);
+
+        index = next;
+    }
+}
+
+// The parallel passages of [conn]'s translation, building them if [threads] isn't 0
+// (otherwise NULL if they haven't been built)
+static ParallelIndex *get_parallel_index(bible_conn *conn, int threads)
+{
+    bible_ctx *ctx = conn->ctx;
+
+    int64_t sourceSize, sourceMtime;
+    if (!source_info(ctx, conn->translation, &sourceSize, &sourceMtime))
+        return NULL;
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    ParallelIndex *index = ctx->parallelIndexes;
+    while (index != NULL && strcmp(index->translation, conn->translation) != 0)
+        index = index->next;
+
+    if (index == NULL)
+    {
+        char path[strlen(ctx->dbDir) + strlen(conn->translation) + 32];
+        sidecar_path(ctx, conn->translation, ".par", path, sizeof(path));
+
+        index = parallels_open(path, conn->translation, sourceSize, sourceMtime);
+        if (index == NULL && threads != 0)
+        {
+            sidecar_folder(ctx);
+
+            if (threads < 0)
+                threads = sysconf(_SC_NPROCESSORS_ONLN);
+            if (threads <= 0)
+                threads = 1;
+
+            if (build_parallels(conn, path, threads, sourceSize, sourceMtime))
+                index = parallels_open(path, conn->translation, sourceSize, sourceMtime);
+        }
+
+        if (index != NULL)
+        {
+            index->next = ctx->parallelIndexes;
+            ctx->parallelIndexes = index;
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    // The passages don't change once loaded, so they're used without the lock
+    return index;
+}
+
+bool bible_parallels_build(bible_conn *conn, int threads)
+{
+    return conn != NULL && get_parallel_index(conn, (threads > 0) ? threads : -1) != NULL;
+}
+
+bible_parallels *bible_get_parallels(bible_conn *conn, bible_ref chapter)
+{
+    ParallelIndex *index = (conn != NULL) ? get_parallel_index(conn, 0) : NULL;
+    if (index == NULL)
+        return NULL;
+
+    // Passages in the chapter, or reaching into it (or everywhere)
+    bible_ref start = 0, end = UINT32_MAX;
+    if (chapter != 0)
+        start = chapter & ~(bible_ref) 0xFF, end = start + 0x100;
+
+    size_t low = 0, high = index->count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (index->records[mid].first < start)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+	// Ones starting before it, that may end in it
+    while (low > 0 && index->records[low - 1].first + index->longest >= start)
+        low--;
+
+    bible_parallels *parallels = calloc(1, sizeof(bible_parallels));
+    parallels->parallels = malloc((index->count - low + 1) * sizeof(bible_parallel));
+
+    for (size_t r = low; r < index->count && index->records[r].first < end; r++)
+    {
+        const ParallelRecord *record = &index->records[r];
+        if (record->last < start)
+            continue;
+
+        parallels->parallels[parallels->count++] = (bible_parallel) {
+            record->first, record->last, record->otherFirst, record->otherLast, record->similarity / 10000.0
+        };
+    }
+
+    return parallels;
+}
+
+void bible_parallels_free(bible_parallels *parallels)
+{
+    if (parallels != NULL)
+    {
+        free(parallels->parallels);
+        free(parallels);
+    }
+}
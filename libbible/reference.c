@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+// References like "1 Cor 13:4-7; Jn 3:16, 18; Ps 23", parsed without allocating or calling sscanf
+// Book names are looked up in a table made once (sorted, for binary search), not in the translation
+
+typedef struct
+{
+    const char *key;
+    unsigned char book;
+} BookKey;
+
+// Names and common abbreviations in lower case without spaces, sorted by key (as strcmp() does)
+static const BookKey bookKeys[] =
+{
+    { "1ch", 13 }, { "1chr", 13 }, { "1chron", 13 }, { "1chronicles", 13 }, { "1co", 46 }, { "1cor", 46 },
+    { "1corinthians", 46 }, { "1jhn", 62 }, { "1jn", 62 }, { "1jo", 62 }, { "1john", 62 }, { "1kg", 11 },
+    { "1kgs", 11 }, { "1ki", 11 }, { "1kings", 11 }, { "1p", 60 }, { "1pe", 60 }, { "1pet", 60 },
+    { "1peter", 60 }, { "1pt", 60 }, { "1sa", 9 }, { "1sam", 9 }, { "1samuel", 9 }, { "1sm", 9 },
+    { "1th", 52 }, { "1thes", 52 }, { "1thess", 52 }, { "1thessalonians", 52 }, { "1ti", 54 }, { "1tim", 54 },
+    { "1timothy", 54 }, { "1tm", 54 }, { "2ch", 14 }, { "2chr", 14 }, { "2chron", 14 }, { "2chronicles", 14 },
+    { "2co", 47 }, { "2cor", 47 }, { "2corinthians", 47 }, { "2jhn", 63 }, { "2jn", 63 }, { "2jo", 63 },
+    { "2john", 63 }, { "2kg", 12 }, { "2kgs", 12 }, { "2ki", 12 }, { "2kings", 12 }, { "2p", 61 },
+    { "2pe", 61 }, { "2pet", 61 }, { "2peter", 61 }, { "2pt", 61 }, { "2sa", 10 }, { "2sam", 10 },
+    { "2samuel", 10 }, { "2sm", 10 }, { "2th", 53 }, { "2thes", 53 }, { "2thess", 53 },
+    { "2thessalonians", 53 }, { "2ti", 55 }, { "2tim", 55 }, { "2timothy", 55 }, { "2tm", 55 },
+    { "3jhn", 64 }, { "3jn", 64 }, { "3jo", 64 }, { "3john", 64 }, { "ac", 44 }, { "act", 44 },
+    { "acts", 44 }, { "am", 30 }, { "amos", 30 }, { "apocalypse", 66 }, { "canticles", 22 }, { "co", 51 },
+    { "col", 51 }, { "colossians", 51 }, { "da", 27 }, { "dan", 27 }, { "daniel", 27 }, { "de", 5 },
+    { "deut", 5 }, { "deuteronomy", 5 }, { "dn", 27 }, { "dt", 5 }, { "ecc", 21 }, { "eccl", 21 },
+    { "ecclesiastes", 21 }, { "eph", 49 }, { "ephes", 49 }, { "ephesians", 49 }, { "es", 17 }, { "est", 17 },
+    { "esth", 17 }, { "esther", 17 }, { "ex", 2 }, { "exo", 2 }, { "exod", 2 }, { "exodus", 2 },
+    { "eze", 26 }, { "ezek", 26 }, { "ezekiel", 26 }, { "ezk", 26 }, { "ezr", 15 }, { "ezra", 15 },
+    { "ga", 48 }, { "gal", 48 }, { "galatians", 48 }, { "ge", 1 }, { "gen", 1 }, { "genesis", 1 },
+    { "gn", 1 }, { "hab", 35 }, { "habakkuk", 35 }, { "hag", 37 }, { "haggai", 37 }, { "hb", 35 },
+    { "heb", 58 }, { "hebrews", 58 }, { "hg", 37 }, { "ho", 28 }, { "hos", 28 }, { "hosea", 28 },
+    { "is", 23 }, { "isa", 23 }, { "isaiah", 23 }, { "james", 59 }, { "jas", 59 }, { "jb", 18 }, { "jd", 65 },
+    { "jdg", 7 }, { "je", 24 }, { "jer", 24 }, { "jeremiah", 24 }, { "jg", 7 }, { "jhn", 43 }, { "jl", 29 },
+    { "jm", 59 }, { "jn", 43 }, { "jnh", 32 }, { "job", 18 }, { "joel", 29 }, { "john", 43 }, { "jon", 32 },
+    { "jonah", 32 }, { "jos", 6 }, { "josh", 6 }, { "joshua", 6 }, { "jsh", 6 }, { "jud", 65 },
+    { "jude", 65 }, { "judg", 7 }, { "judges", 7 }, { "la", 25 }, { "lam", 25 }, { "lamentations", 25 },
+    { "le", 3 }, { "lev", 3 }, { "leviticus", 3 }, { "lk", 42 }, { "luk", 42 }, { "luke", 42 }, { "lv", 3 },
+    { "mal", 39 }, { "malachi", 39 }, { "mark", 41 }, { "mat", 40 }, { "matt", 40 }, { "matthew", 40 },
+    { "mc", 33 }, { "mic", 33 }, { "micah", 33 }, { "mk", 41 }, { "ml", 39 }, { "mr", 41 }, { "mrk", 41 },
+    { "mt", 40 }, { "na", 34 }, { "nah", 34 }, { "nahum", 34 }, { "nb", 4 }, { "ne", 16 }, { "neh", 16 },
+    { "nehemiah", 16 }, { "nm", 4 }, { "nu", 4 }, { "num", 4 }, { "numbers", 4 }, { "ob", 31 },
+    { "obad", 31 }, { "obadiah", 31 }, { "phil", 50 }, { "philem", 57 }, { "philemon", 57 },
+    { "philippians", 50 }, { "phlm", 57 }, { "phm", 57 }, { "php", 50 }, { "pp", 50 }, { "pr", 20 },
+    { "pro", 20 }, { "prov", 20 }, { "proverbs", 20 }, { "prv", 20 }, { "ps", 19 }, { "psa", 19 },
+    { "psalm", 19 }, { "psalms", 19 }, { "pss", 19 }, { "qoh", 21 }, { "re", 66 }, { "rev", 66 },
+    { "revelation", 66 }, { "rm", 45 }, { "ro", 45 }, { "rom", 45 }, { "romans", 45 }, { "rth", 8 },
+    { "ru", 8 }, { "ruth", 8 }, { "rv", 66 }, { "sg", 22 }, { "song", 22 }, { "songofsolomon", 22 },
+    { "songofsongs", 22 }, { "sos", 22 }, { "ti", 56 }, { "tit", 56 }, { "titus", 56 }, { "zc", 38 },
+    { "zec", 38 }, { "zech", 38 }, { "zechariah", 38 }, { "zep", 36 }, { "zeph", 36 }, { "zephaniah", 36 },
+    { "zp", 36 },
+};
+#define BOOK_KEY_COUNT (sizeof(bookKeys) / sizeof(bookKeys[0]))
+
+static const char *const bookTitles[BIBLE_BOOK_COUNT + 1] =
+{
+    "", "Genesis", "Exodus", "Leviticus", "Numbers", "Deuteronomy", "Joshua", "Judges", "Ruth", "1 Samuel",
+    "2 Samuel", "1 Kings", "2 Kings", "1 Chronicles", "2 Chronicles", "Ezra", "Nehemiah", "Esther", "Job",
+    "Psalms", "Proverbs", "Ecclesiastes", "Song of Solomon", "Isaiah", "Jeremiah", "Lamentations", "Ezekiel",
+    "Daniel", "Hosea", "Joel", "Amos", "Obadiah", "Jonah", "Micah", "Nahum", "Habakkuk", "Zephaniah", "Haggai",
+    "Zechariah", "Malachi", "Matthew", "Mark", "Luke", "John", "Acts", "Romans", "1 Corinthians",
+    "2 Corinthians", "Galatians", "Ephesians", "Philippians", "Colossians", "1 Thessalonians",
+    "2 Thessalonians", "1 Timothy", "2 Timothy", "Titus", "Philemon", "Hebrews", "James", "1 Peter", "2 Peter",
+    "1 John", "2 John", "3 John", "Jude", "Revelation"
+};
+
+// MyBible book numbers of the books, in order
+static const short bookNumbers[BIBLE_BOOK_COUNT + 1] =
+{
+    0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150, 160, 190, 220, 230, 240, 250, 260,
+    290, 300, 310, 330, 340, 350, 360, 370, 380, 390, 400, 410, 420, 430, 440, 450, 460, 470, 480, 490, 500,
+    510, 520, 530, 540, 550, 560, 570, 580, 590, 600, 610, 620, 630, 640, 650, 660, 670, 680, 690, 700,
+    710, 720, 730
+};
+
+static inline bool is_letter(char c)
+{
+    return (unsigned) ((c | 32) - 'a') < 26;
+}
+
+static inline bool is_digit(char c)
+{
+    return (unsigned) (c - '0') < 10;
+}
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Obadiah, Philemon, 2 John, 3 John and Jude, where "Jude 3" is a verse
+static inline bool one_chapter(int book)
+{
+    return book == 31 || book == 57 || book == 63 || book == 64 || book == 65;
+}
+
+// [i]th standard name or abbreviation and its book, for book suggestions (NULL past the last one)
+const char *standard_book_key(size_t i, int *book)
+{
+    if (i >= BOOK_KEY_COUNT)
+        return NULL;
+
+    *book = bookKeys[i].book;
+    return bookKeys[i].key;
+}
+
+int bible_book_lookup(const char *name, size_t length)
+{
+    // Lower case, without spaces and dots e.g. "1 Cor." -> "1cor"
+    char key[24];
+    size_t keyLength = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (name[i] == ' ' || name[i] == '.')
+            continue;
+        if ((!is_letter(name[i]) && !is_digit(name[i])) || keyLength + 1 >= sizeof(key))
+            return 0;
+
+        key[keyLength++] = is_letter(name[i]) ? name[i] | 32 : name[i];
+    }
+    key[keyLength] = '\0';
+
+    if (keyLength == 0)
+        return 0;
+
+    // First key that isn't before [key]
+    size_t low = 0, high = BOOK_KEY_COUNT;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (strcmp(bookKeys[mid].key, key) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low < BOOK_KEY_COUNT && strcmp(bookKeys[low].key, key) == 0)
+        return bookKeys[low].book;
+
+    // Otherwise the first book with a name starting with it (like the book field always did)
+    int book = 0;
+    for (size_t i = low; i < BOOK_KEY_COUNT && strncmp(bookKeys[i].key, key, keyLength) == 0; i++)
+        if (book == 0 || bookKeys[i].book < book)
+            book = bookKeys[i].book;
+
+    return book;
+}
+
+int book_number(int book)
+{
+    return (book >= 1 && book <= BIBLE_BOOK_COUNT) ? bookNumbers[book] : 0;
+}
+
+int book_index(int bookNumber)
+{
+    size_t low = 1, high = BIBLE_BOOK_COUNT + 1;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (bookNumbers[mid] < bookNumber)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return (low <= BIBLE_BOOK_COUNT && bookNumbers[low] == bookNumber) ? (int) low : 0;
+}
+
+bible_ref row_ref(int bookNumber, int chapter, int verse)
+{
+    int book = book_index(bookNumber);
+    bool fits = chapter >= 0 && chapter < BIBLE_REF_END && verse >= 0 && verse < BIBLE_REF_END;
+    return (book > 0 && fits) ? BIBLE_REF(book, chapter, verse) : 0;
+}
+
+uint32_t verse_id(bible_ref ref)
+{
+    int bookNumber = book_number(BIBLE_REF_BOOK(ref));
+    return (bookNumber > 0) ? VERSE_ID(bookNumber, BIBLE_REF_CHAPTER(ref), BIBLE_REF_VERSE(ref)) : 0;
+}
+
+bible_ref verse_ref(uint32_t id)
+{
+    return row_ref(id / 1000000, id / 1000 % 1000, id % 1000);
+}
+
+const char *bible_book_title(int book)
+{
+    return (book >= 1 && book <= BIBLE_BOOK_COUNT) ? bookTitles[book] : "";
+}
+
+// End of the book name at the start of [str] e.g. "1 Cor" in "1 Cor 13:4" ([str] if there's none)
+static const char *book_name_end(const char *str)
+{
+    const char *end = str;
+
+    // 1, 2 or 3 then letters
+    if (*end >= '1' && *end <= '3')
+    {
+        end++;
+        while (*end == ' ' || *end == '.')
+            end++;
+    }
+
+    if (!is_letter(*end))
+        return str;
+
+    while (is_letter(*end) || *end == ' ' || *end == '.' || (unsigned char) *end >= 0x80)
+        end++;
+    while (end[-1] == ' ')
+        end--;
+
+    return end;
+}
+
+// Chapter or verse number (-1 if it's too big)
+static int read_number(const char **str)
+{
+    int number = 0;
+    for (; is_digit(**str); (*str)++)
+        if (number <= BIBLE_REF_END)
+            number = number * 10 + (**str - '0');
+
+    return (number < BIBLE_REF_END) ? number : -1;
+}
+
+// Skip a hyphen or an en dash (and the spaces around it)
+static bool skip_dash(const char **str)
+{
+    const char *s = *str;
+    while (is_space(*s))
+        s++;
+
+    if (*s == '-')
+        s++;
+    else if (memcmp(s, "\xE2\x80\x93", 3) == 0)
+        s += 3;
+    else
+        return false;
+
+    while (is_space(*s))
+        s++;
+    *str = s;
+
+    return true;
+}
+
+int bible_parse_references(const char *text, bible_range *ranges, size_t maxRanges)
+{
+    if (text == NULL)
+        return -1;
+
+    const char *str = text;
+    int count = 0, book = 0, chapter = 0;
+    // After a comma, a number on its own is another verse of [chapter] if the reference before had verses
+    bool verseList = false;
+
+    for (;;)
+    {
+        while (is_space(*str))
+            str++;
+        if (*str == '\0')
+            break;
+
+        // A book (otherwise it's the one before)
+        const char *nameEnd = book_name_end(str);
+        bool hasBook = nameEnd != str;
+        if (hasBook)
+        {
+            if ((book = bible_book_lookup(str, nameEnd - str)) == 0)
+                return -1;
+
+            str = nameEnd, chapter = 0, verseList = false;
+            while (is_space(*str))
+                str++;
+        }
+        else if (book == 0)
+            return -1;
+
+        int firstChapter, firstVerse, lastChapter, lastVerse;
+        bool hasVerses = false;
+
+        // A whole book
+        if (!is_digit(*str))
+        {
+            if (!hasBook)
+                return -1;
+
+            firstChapter = 1, firstVerse = 1;
+            lastChapter = BIBLE_REF_END, lastVerse = BIBLE_REF_END;
+        }
+
+        else
+        {
+            int number = read_number(&str);
+            if ((*str == ':' || *str == '.') && is_digit(str[1]))
+            {
+                str++;
+                firstChapter = number, firstVerse = read_number(&str);
+                hasVerses = true;
+            }
+            // "Jn 3:16, 18" or "Jude 3"
+            else if (verseList || one_chapter(book))
+            {
+                firstChapter = verseList ? chapter : 1, firstVerse = number;
+                hasVerses = true;
+            }
+            else
+                firstChapter = number, firstVerse = 1;
+
+            lastChapter = firstChapter, lastVerse = hasVerses ? firstVerse : BIBLE_REF_END;
+
+            // Range e.g. 13:4-7, 1:1-2:3 or 1-3
+            if (skip_dash(&str))
+            {
+                if (!is_digit(*str))
+                    return -1;
+
+                number = read_number(&str);
+                if ((*str == ':' || *str == '.') && is_digit(str[1]))
+                {
+                    str++;
+                    lastChapter = number, lastVerse = read_number(&str);
+                    hasVerses = true;
+                }
+                else if (hasVerses)
+                    lastVerse = number;
+                else
+                    lastChapter = number;
+            }
+        }
+
+        if (firstChapter <= 0 || firstVerse <= 0 || lastChapter <= 0 || lastVerse <= 0)
+            return -1;
+
+        bible_range range = {
+            BIBLE_REF(book, firstChapter, firstVerse), BIBLE_REF(book, lastChapter, lastVerse)
+        };
+        if (range.last < range.first)
+            return -1;
+
+        if ((size_t) count < maxRanges)
+            ranges[count] = range;
+        count++;
+        chapter = lastChapter;
+
+        // Separator, or straight on to another book
+        while (is_space(*str))
+            str++;
+        if (*str == ',')
+            verseList = hasVerses, str++;
+        else if (*str == ';')
+            verseList = false, str++;
+        else if (*str != '\0' && !is_letter(*str))
+            return -1;
+    }
+
+    return count;
+}
+
+static int compare_ranges(const void *a, const void *b)
+{
+    bible_ref first = ((const bible_range*) a)->first, other = ((const bible_range*) b)->first;
+    return (first > other) - (first < other);
+}
+
+size_t bible_merge_ranges(bible_range *ranges, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    qsort(ranges, count, sizeof(bible_range), &compare_ranges);
+
+    size_t merged = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+		// Overlapping, or straight after it in the same chapter (e.g. 3:16-17 and 3:18)
+        if (ranges[i].first <= ranges[merged].last + 1)
+        {
+            if (ranges[i].last > ranges[merged].last)
+                ranges[merged].last = ranges[i].last;
+        }
+        else
+            ranges[++merged] = ranges[i];
+    }
+
+    return merged + 1;
+}
@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "internal.h"
+
+// The translations in a folder, made to scale to hundreds of them
+//
+// Opening every file to see what it has would slow down every start, so what's found is kept in
+// [dbDir]/.index/translations: a ManifestHeader with the modification time of the folder, then a
+// bible_translation_info per translation. Adding, removing or renaming a file changes the folder's time, so
+// while it's the same the manifest is used as it is. Otherwise only the new and changed files are opened.
+// Names are looked up in a hash table (open addressing with linear probing)
+
+#define MANIFEST_MAGIC "BIBLETRN"
+#define MANIFEST_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version, count;
+    // Of [dbDir] when it was looked at (-1 if it might have changed since, in the same second)
+    int64_t dirMtime;
+} ManifestHeader;
+
+static const char infoQuery[] =
+    "SELECT name, value FROM info "
+    "WHERE name IN ('language', 'description')";
+static const char booksQuery[] =
+    "SELECT book_number FROM books";
+static const char storiesQuery[] =
+    "SELECT COUNT(*) FROM sqlite_master "
+    "WHERE type='table' "
+    "AND name='stories'";
+
+// ---- Lookup ----
+
+// FNV-1a
+static uint32_t hash_name(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char*) name; *c != '\0'; c++)
+        hash = (hash ^ *c) * 16777619u;
+
+    return hash;
+}
+
+static void rebuild_hash(bible_ctx *ctx)
+{
+	// At most half full
+    size_t size = 16;
+    while (size < ctx->translationCount * 2)
+        size *= 2;
+
+    uint32_t *hash = calloc(size, sizeof(uint32_t));
+    if (hash == NULL)
+        return;
+
+    for (size_t i = 0; i < ctx->translationCount; i++)
+    {
+        size_t slot = hash_name(ctx->translations[i].name) & (size - 1);
+        while (hash[slot] != 0)
+            slot = (slot + 1) & (size - 1);
+        hash[slot] = i + 1;
+    }
+
+    free(ctx->translationHash);
+    ctx->translationHash = hash;
+    ctx->translationHashSize = size;
+}
+
+int bible_translation_index(const bible_ctx *ctx, const char *name)
+{
+    if (ctx == NULL || name == NULL || ctx->translationHash == NULL)
+        return -1;
+
+    size_t mask = ctx->translationHashSize - 1;
+    for (size_t slot = hash_name(name) & mask; ctx->translationHash[slot] != 0; slot = (slot + 1) & mask)
+    {
+        uint32_t index = ctx->translationHash[slot] - 1;
+        if (strcmp(ctx->translations[index].name, name) == 0)
+            return index;
+    }
+
+    return -1;
+}
+
+size_t bible_translation_count(const bible_ctx *ctx)
+{
+    return (ctx != NULL) ? ctx->translationCount : 0;
+}
+
+const char *bible_translation_name(const bible_ctx *ctx, size_t index)
+{
+    if (ctx != NULL && index < ctx->translationCount)
+        return ctx->translations[index].name;
+
+    return "";
+}
+
+const bible_translation_info *bible_translation(const bible_ctx *ctx, size_t index)
+{
+    return (ctx != NULL && index < ctx->translationCount) ? &ctx->translations[index] : NULL;
+}
+
+// ---- Reading the files ----
+
+// Open translation file [path] to see what it has
+static void read_translation(const char *path, const char *name, const struct stat *fileInfo,
+    bible_translation_info *info)
+{
+    memset(info, 0, sizeof(bible_translation_info));
+    snprintf(info->name, sizeof(info->name), "%s", name);
+    info->size = fileInfo->st_size;
+    info->mtime = fileInfo->st_mtime;
+
+    sqlite3 *db;
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return;
+    }
+
+    sqlite3_stmt *sql;
+
+	// Not every translation has an info table
+    if (sqlite3_prepare_v2(db, infoQuery, -1, &sql, NULL) == SQLITE_OK)
+    {
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            const char *key = (const char*) sqlite3_column_text(sql, 0);
+            const char *value = (const char*) sqlite3_column_text(sql, 1);
+            if (key == NULL || value == NULL)
+                continue;
+
+            if (strcmp(key, "language") == 0)
+                snprintf(info->language, sizeof(info->language), "%s", value);
+            else
+                copy_book_name(info->description, sizeof(info->description), (const unsigned char*) value);
+        }
+    }
+    sqlite3_finalize(sql);
+
+    if (sqlite3_prepare_v2(db, booksQuery, -1, &sql, NULL) == SQLITE_OK)
+    {
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            int book = book_index(sqlite3_column_int(sql, 0));
+            if (book == 0)
+                continue;
+
+            info->bookCount++;
+            info->flags |= (book <= 39) ? BIBLE_TRANSLATION_OLD_TESTAMENT : BIBLE_TRANSLATION_NEW_TESTAMENT;
+        }
+    }
+    sqlite3_finalize(sql);
+
+    if (sqlite3_prepare_v2(db, storiesQuery, -1, &sql, NULL) == SQLITE_OK
+        && sqlite3_step(sql) == SQLITE_ROW && sqlite3_column_int(sql, 0) > 0)
+        info->flags |= BIBLE_TRANSLATION_TITLES;
+    sqlite3_finalize(sql);
+
+    sqlite3_close(db);
+}
+
+static bool add_translation(bible_ctx *ctx, const bible_translation_info *info)
+{
+    if (ctx->translationCount == ctx->translationCapacity)
+    {
+        size_t capacity = (ctx->translationCapacity == 0) ? 16 : ctx->translationCapacity * 2;
+        bible_translation_info *translations = realloc(ctx->translations, capacity * sizeof(bible_translation_info));
+        if (translations == NULL)
+            return false;
+
+        ctx->translations = translations;
+        ctx->translationCapacity = capacity;
+    }
+
+    ctx->translations[ctx->translationCount++] = *info;
+    return true;
+}
+
+static int compare_translations(const void *a, const void *b)
+{
+    const char *name = ((const bible_translation_info*) a)->name, *other = ((const bible_translation_info*) b)->name;
+    int order = strcasecmp(name, other);
+
+    return (order != 0) ? order : strcmp(name, other);
+}
+
+// Look at every file of [dbDir]: open the new and changed ones, add the new ones (by name) after the others and
+// mark the ones that are gone. Returns true if anything changed
+static bool scan_translations(bible_ctx *ctx)
+{
+    DIR *dir = opendir(ctx->dbDir);
+    if (dir == NULL)
+        return false;
+
+    size_t known = ctx->translationCount;
+    bool *seen = calloc(known + 1, sizeof(bool));
+    bool changed = false;
+
+    struct dirent *file;
+	// While there are files in db folder
+    while ((file = readdir(dir)))
+    {
+        // If file name has the extension ".SQLite3" (and the name fits)
+        const char *ext = strstr(file->d_name, TRANSLATION_EXTENSION);
+        if (ext == NULL || ext == file->d_name || strcmp(ext, TRANSLATION_EXTENSION) != 0
+            || ext - file->d_name >= (long) sizeof(((bible_translation_info*) 0)->name))
+            continue;
+
+        char name[sizeof(((bible_translation_info*) 0)->name)];
+        snprintf(name, sizeof(name), "%.*s", (int) (ext - file->d_name), file->d_name);
+
+        char path[strlen(ctx->dbDir) + strlen(file->d_name) + 2];
+        snprintf(path, sizeof(path), "%s/%s", ctx->dbDir, file->d_name);
+
+        struct stat fileInfo;
+        if (stat(path, &fileInfo) != 0 || !S_ISREG(fileInfo.st_mode))
+            continue;
+
+		// Only files added since aren't in the hash table yet
+        int index = bible_translation_index(ctx, name);
+        if (index >= 0)
+        {
+            bible_translation_info *info = &ctx->translations[index];
+            seen[index] = true;
+
+            if (info->size == fileInfo.st_size && info->mtime == fileInfo.st_mtime
+                && !(info->flags & BIBLE_TRANSLATION_REMOVED))
+                continue;
+
+            read_translation(path, name, &fileInfo, info);
+            changed = true;
+        }
+
+        else
+        {
+            bible_translation_info info;
+            read_translation(path, name, &fileInfo, &info);
+            changed |= add_translation(ctx, &info);
+        }
+    }
+
+    closedir(dir);
+
+    for (size_t i = 0; i < known; i++)
+    {
+        if (!seen[i] && !(ctx->translations[i].flags & BIBLE_TRANSLATION_REMOVED))
+        {
+            ctx->translations[i].flags |= BIBLE_TRANSLATION_REMOVED;
+            changed = true;
+        }
+    }
+    free(seen);
+
+    qsort(&ctx->translations[known], ctx->translationCount - known, sizeof(bible_translation_info),
+        &compare_translations);
+
+    if (changed)
+        rebuild_hash(ctx);
+
+    return changed;
+}
+
+// ---- Manifest ----
+
+static void manifest_path(const bible_ctx *ctx, char *path, size_t pathSize)
+{
+    sidecar_path(ctx, "translations", "", path, pathSize);
+}
+
+// Modification time of [dbDir], or -1 if it can't be trusted to change with the next file added
+// (it's in seconds, so a file added later in the same second wouldn't change it)
+static int64_t folder_time(const bible_ctx *ctx)
+{
+    struct stat info;
+    if (stat(ctx->dbDir, &info) != 0 || info.st_mtime >= time(NULL))
+        return -1;
+
+    return info.st_mtime;
+}
+
+// Read the manifest into [ctx]. Returns true if it's up to date with the folder
+static bool read_manifest(bible_ctx *ctx, int64_t dirMtime)
+{
+    char path[strlen(ctx->dbDir) + 32];
+    manifest_path(ctx, path, sizeof(path));
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    ManifestHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, MANIFEST_MAGIC, sizeof(header.magic)) != 0
+        || header.version != MANIFEST_VERSION)
+    {
+        fclose(file);
+        return false;
+    }
+
+    bible_translation_info info;
+    size_t count = 0;
+    while (count < header.count && fread(&info, sizeof(info), 1, file) == 1)
+    {
+        info.name[sizeof(info.name) - 1] = '\0';
+        if (!add_translation(ctx, &info))
+            break;
+        count++;
+    }
+    fclose(file);
+
+    return count == header.count && dirMtime != -1 && header.dirMtime == dirMtime;
+}
+
+// Write the translations of [ctx] (but not the removed ones) in order of name
+static void write_manifest(const bible_ctx *ctx, int64_t dirMtime)
+{
+    bible_translation_info *translations = malloc((ctx->translationCount + 1) * sizeof(bible_translation_info));
+    if (translations == NULL)
+        return;
+
+    ManifestHeader header = { .version = MANIFEST_VERSION, .dirMtime = dirMtime };
+    memcpy(header.magic, MANIFEST_MAGIC, sizeof(header.magic));
+    for (size_t i = 0; i < ctx->translationCount; i++)
+        if (!(ctx->translations[i].flags & BIBLE_TRANSLATION_REMOVED))
+            translations[header.count++] = ctx->translations[i];
+    qsort(translations, header.count, sizeof(bible_translation_info), &compare_translations);
+
+    char path[strlen(ctx->dbDir) + 32];
+    manifest_path(ctx, path, sizeof(path));
+    char tempPath[strlen(path) + 32];
+    sidecar_temp_path(path, tempPath, sizeof(tempPath));
+
+    // Readers never see a half-written file
+    FILE *file = fopen(tempPath, "wb");
+    if (file != NULL)
+    {
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(translations, sizeof(bible_translation_info), header.count, file);
+
+        bool written = !ferror(file);
+        written &= (fclose(file) == 0);
+        sidecar_finish(tempPath, path, written);
+    }
+
+    free(translations);
+}
+
+void registry_load(bible_ctx *ctx)
+{
+	// Made before looking at the folder's time, since making it changes the time
+    sidecar_folder(ctx);
+
+    int64_t dirMtime = folder_time(ctx);
+    bool current = read_manifest(ctx, dirMtime);
+    rebuild_hash(ctx);
+    if (current)
+        return;
+
+	// What the manifest says about the files that haven't changed is kept
+    scan_translations(ctx);
+
+	// Nothing uses the indexes yet, so the list can be put in order
+    size_t count = 0;
+    for (size_t i = 0; i < ctx->translationCount; i++)
+        if (!(ctx->translations[i].flags & BIBLE_TRANSLATION_REMOVED))
+            ctx->translations[count++] = ctx->translations[i];
+    ctx->translationCount = count;
+    qsort(ctx->translations, count, sizeof(bible_translation_info), &compare_translations);
+    rebuild_hash(ctx);
+
+    write_manifest(ctx, dirMtime);
+}
+
+bool bible_ctx_refresh(bible_ctx *ctx)
+{
+    if (ctx == NULL)
+        return false;
+
+    int64_t dirMtime = folder_time(ctx);
+    if (!scan_translations(ctx))
+        return false;
+
+    write_manifest(ctx, dirMtime);
+    return true;
+}
+
+void registry_free(bible_ctx *ctx)
+{
+    free(ctx->translations);
+    free(ctx->translationHash);
+}
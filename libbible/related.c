@@ -0,0 +1,625 @@
+// Allows strdup to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "internal.h"
+
+// Related verses: the verses that use the most of the same (rare) words
+//
+// Every verse is a TF-IDF vector of its words (folded like the other indexes), scaled to length 1 and
+// quantized to a byte per word. The matrix is kept in [dbDir]/.index/TRANSLATION.rel, memory-mapped:
+//   RelatedHeader
+//   bible_ref refs[verseCount]                the verses, in Bible order
+//   uint32_t rowStart[verseCount + 1]         verse i's words are rowTerms[rowStart[i]..rowStart[i + 1]]
+//   uint32_t rowTerms[entryCount]             word numbers, sorted
+//   uint32_t columnStart[termCount + 1]       verses using word t are columnVerses[columnStart[t]..columnStart[t + 1]]
+//   uint32_t columnVerses[entryCount]         verse numbers, in order
+//   uint8_t  rowWeights[entryCount]
+//   uint8_t  columnWeights[entryCount]
+// A query adds up (weight in the verse * weight in each other verse) for the verse's words, one word's
+// column at a time, then keeps the best scores with a bounded heap
+
+#define RELATED_MAGIC "BIBLEREL"
+#define RELATED_VERSION 2
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version, verseCount, termCount, entryCount;
+    // The translation it was built from
+    int64_t sourceSize, sourceMtime;
+    uint64_t refsOffset, rowStartOffset, rowTermsOffset, columnStartOffset, columnVersesOffset;
+    uint64_t rowWeightsOffset, columnWeightsOffset, fileSize;
+} RelatedHeader;
+
+struct RelatedIndex
+{
+    char translation[64];
+    RelatedIndex *next;
+
+    void *map;
+    size_t size;
+
+    const RelatedHeader *header;
+    const bible_ref *refs;
+    const uint32_t *rowStart, *rowTerms, *columnStart, *columnVerses;
+    const uint8_t *rowWeights, *columnWeights;
+};
+
+// ---- Building ----
+
+typedef struct
+{
+    uint32_t term;
+    uint32_t count;
+} TermCount;
+
+typedef struct
+{
+    // Words (as numbers)
+    char **words;
+    size_t wordCount, wordSize;
+    uint32_t *table;
+    size_t tableSize;
+
+    bible_ref *refs;
+    size_t verseCount, verseSize;
+    // Verse i's words (and how many times it uses each) are terms[termStart[i]..termStart[i + 1]]
+    TermCount *terms;
+    size_t termCount, termSize;
+    uint32_t *termStart;
+} RelatedBuild;
+
+static uint32_t hash_word(const char *word)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *word != '\0'; word++)
+        hash = (hash ^ (unsigned char) *word) * 16777619u;
+
+    return hash;
+}
+
+// Number of [word], adding it if it's new
+static uint32_t word_number(RelatedBuild *build, const char *word)
+{
+    // Keep the table at most half full
+    if (build->wordCount * 2 >= build->tableSize)
+    {
+        size_t newSize = (build->tableSize == 0) ? 4096 : build->tableSize * 2;
+        uint32_t *newTable = calloc(newSize, sizeof(uint32_t));
+        for (size_t i = 0; i < build->tableSize; i++)
+        {
+            if (build->table[i] == 0)
+                continue;
+
+            size_t slot = hash_word(build->words[build->table[i] - 1]) & (newSize - 1);
+            while (newTable[slot] != 0)
+                slot = (slot + 1) & (newSize - 1);
+            newTable[slot] = build->table[i];
+        }
+
+        free(build->table);
+        build->table = newTable, build->tableSize = newSize;
+    }
+
+    size_t slot = hash_word(word) & (build->tableSize - 1);
+    while (build->table[slot] != 0)
+    {
+        if (strcmp(build->words[build->table[slot] - 1], word) == 0)
+            return build->table[slot] - 1;
+        slot = (slot + 1) & (build->tableSize - 1);
+    }
+
+    if (build->wordCount == build->wordSize)
+    {
+        build->wordSize = (build->wordSize == 0) ? 4096 : build->wordSize * 2;
+        build->words = realloc(build->words, build->wordSize * sizeof(char*));
+    }
+    build->words[build->wordCount] = strdup(word);
+    build->table[slot] = ++build->wordCount;
+
+    return build->wordCount - 1;
+}
+
+static int compare_terms(const void *a, const void *b)
+{
+    uint32_t termA = ((const TermCount*) a)->term, termB = ((const TermCount*) b)->term;
+    return (termA > termB) - (termA < termB);
+}
+
+static void add_verse(bible_ref ref, const char *text, void *data)
+{
+    RelatedBuild *build = data;
+
+    if (build->verseCount + 1 >= build->verseSize)
+    {
+        build->verseSize = (build->verseSize == 0) ? 1024 : build->verseSize * 2;
+        build->refs = realloc(build->refs, build->verseSize * sizeof(bible_ref));
+        build->termStart = realloc(build->termStart, (build->verseSize + 1) * sizeof(uint32_t));
+    }
+
+    size_t textSize = strlen(text) + 1;
+    char *plain = malloc(textSize);
+    bible_strip_tags(text, plain, textSize);
+
+    size_t start = build->termCount;
+    char word[64];
+    bool unknown;
+    const char *str = plain;
+    while (next_word(&str, word, sizeof(word), &unknown) > 0)
+    {
+        if (build->termCount == build->termSize)
+        {
+            build->termSize = (build->termSize == 0) ? 65536 : build->termSize * 2;
+            build->terms = realloc(build->terms, build->termSize * sizeof(TermCount));
+        }
+        build->terms[build->termCount++] = (TermCount) { word_number(build, word), 1 };
+    }
+    free(plain);
+
+    // Count each word once, with the number of times it's used
+    TermCount *terms = &build->terms[start];
+    size_t count = build->termCount - start, unique = 0;
+    qsort(terms, count, sizeof(TermCount), &compare_terms);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (unique > 0 && terms[unique - 1].term == terms[i].term)
+            terms[unique - 1].count++;
+        else
+            terms[unique++] = terms[i];
+    }
+    build->termCount = start + unique;
+
+    build->refs[build->verseCount] = ref;
+    build->termStart[++build->verseCount] = build->termCount;
+}
+
+static bool write_related(const RelatedBuild *build, const char *path, int64_t sourceSize, int64_t sourceMtime)
+{
+    uint32_t verses = build->verseCount, terms = build->wordCount, entries = build->termCount;
+
+	// How many verses use each word, for the inverse document frequency
+    uint32_t *columnStart = calloc(terms + 1, sizeof(uint32_t));
+    for (uint32_t e = 0; e < entries; e++)
+        columnStart[build->terms[e].term + 1]++;
+    for (uint32_t t = 0; t < terms; t++)
+        columnStart[t + 1] += columnStart[t];
+
+    uint32_t *rowTerms = malloc((entries + 1) * sizeof(uint32_t));
+    uint8_t *rowWeights = malloc(entries + 1);
+    uint32_t *columnVerses = malloc((entries + 1) * sizeof(uint32_t));
+    uint8_t *columnWeights = malloc(entries + 1);
+    uint32_t *fill = malloc((terms + 1) * sizeof(uint32_t));
+    memcpy(fill, columnStart, (terms + 1) * sizeof(uint32_t));
+
+    for (uint32_t v = 0; v < verses; v++)
+    {
+        uint32_t start = build->termStart[v], end = build->termStart[v + 1];
+
+        // (1 + log tf) * log(N / df), scaled to length 1
+        float weights[end - start + 1];
+        float length = 0;
+        for (uint32_t e = start; e < end; e++)
+        {
+            uint32_t term = build->terms[e].term;
+            float idf = logf((float) verses / (columnStart[term + 1] - columnStart[term]));
+            weights[e - start] = (1 + logf(build->terms[e].count)) * idf;
+            length += weights[e - start] * weights[e - start];
+        }
+        length = (length > 0) ? sqrtf(length) : 1;
+
+        for (uint32_t e = start; e < end; e++)
+        {
+            uint32_t term = build->terms[e].term;
+            uint8_t quantized = (uint8_t) lrintf(weights[e - start] / length * 255);
+
+            rowTerms[e] = term, rowWeights[e] = quantized;
+            columnVerses[fill[term]] = v, columnWeights[fill[term]] = quantized;
+            fill[term]++;
+        }
+    }
+    free(fill);
+
+    RelatedHeader header = {
+        .version = RELATED_VERSION, .verseCount = verses, .termCount = terms, .entryCount = entries,
+        .sourceSize = sourceSize, .sourceMtime = sourceMtime
+    };
+    memcpy(header.magic, RELATED_MAGIC, sizeof(header.magic));
+    header.refsOffset = sizeof(RelatedHeader);
+    header.rowStartOffset = header.refsOffset + verses * sizeof(bible_ref);
+    header.rowTermsOffset = header.rowStartOffset + (verses + 1) * sizeof(uint32_t);
+    header.columnStartOffset = header.rowTermsOffset + entries * sizeof(uint32_t);
+    header.columnVersesOffset = header.columnStartOffset + (terms + 1) * sizeof(uint32_t);
+    header.rowWeightsOffset = header.columnVersesOffset + entries * sizeof(uint32_t);
+    header.columnWeightsOffset = header.rowWeightsOffset + entries;
+    header.fileSize = header.columnWeightsOffset + entries;
+
+    bool ok = false;
+    FILE *file = fopen(path, "wb");
+    if (file != NULL)
+    {
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(build->refs, sizeof(bible_ref), verses, file);
+        fwrite(build->termStart, sizeof(uint32_t), verses + 1, file);
+        fwrite(rowTerms, sizeof(uint32_t), entries, file);
+        fwrite(columnStart, sizeof(uint32_t), terms + 1, file);
+        fwrite(columnVerses, sizeof(uint32_t), entries, file);
+        fwrite(rowWeights, 1, entries, file);
+        fwrite(columnWeights, 1, entries, file);
+
+        ok = !ferror(file);
+        ok &= (fclose(file) == 0);
+    }
+
+    free(columnStart);
+    free(rowTerms), free(rowWeights);
+    free(columnVerses), free(columnWeights);
+
+    return ok;
+}
+
+static bool build_related(bible_conn *conn, const char *path, int64_t sourceSize, int64_t sourceMtime)
+{
+    RelatedBuild build = { 0 };
+    build.termStart = malloc(sizeof(uint32_t));
+    build.termStart[0] = 0;
+
+    for (int book = bible_adjacent_book(conn, 0, 1, NULL, 0); book > 0; book = bible_adjacent_book(conn, book, 1, NULL, 0))
+        bible_each_verse(conn, book, &add_verse, &build);
+
+    char tempPath[strlen(path) + 32];
+    sidecar_temp_path(path, tempPath, sizeof(tempPath));
+
+    // Readers never see a half-written matrix
+    bool built = sidecar_finish(tempPath, path,
+        build.verseCount > 0 && write_related(&build, tempPath, sourceSize, sourceMtime));
+
+    for (size_t w = 0; w < build.wordCount; w++)
+        free(build.words[w]);
+    free(build.words);
+    free(build.table);
+    free(build.refs);
+    free(build.terms);
+    free(build.termStart);
+
+    return built;
+}
+
+// ---- Reading ----
+
+static RelatedIndex *related_open(const char *path, const char *translation, int64_t sourceSize, int64_t sourceMtime)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return NULL;
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(RelatedHeader))
+    {
+        close(file);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    // Rebuilt when the translation changes
+    const RelatedHeader *header = map;
+    if (memcmp(header->magic, RELATED_MAGIC, sizeof(header->magic)) != 0 || header->version != RELATED_VERSION
+        || header->fileSize != (uint64_t) info.st_size
+        || header->sourceSize != sourceSize || header->sourceMtime != sourceMtime)
+    {
+        munmap(map, info.st_size);
+        return NULL;
+    }
+
+    RelatedIndex *index = calloc(1, sizeof(RelatedIndex));
+    const uint8_t *base = map;
+    snprintf(index->translation, sizeof(index->translation), "%s", translation);
+    index->map = map;
+    index->size = info.st_size;
+    index->header = header;
+    index->refs = (const bible_ref*) (base + header->refsOffset);
+    index->rowStart = (const uint32_t*) (base + header->rowStartOffset);
+    index->rowTerms = (const uint32_t*) (base + header->rowTermsOffset);
+    index->columnStart = (const uint32_t*) (base + header->columnStartOffset);
+    index->columnVerses = (const uint32_t*) (base + header->columnVersesOffset);
+    index->rowWeights = base + header->rowWeightsOffset;
+    index->columnWeights = base + header->columnWeightsOffset;
+
+    return index;
+}
+
+void related_index_free(RelatedIndex *index)
+{
+    while (index != NULL)
+    {
+        RelatedIndex *next = index->next;
+
+        munmap(index->map, index->size);
+        free(index);
+
+        index = next;
+    }
+}
+
+// The related-verses matrix of [conn]'s translation, loaded (or built) the first time
+static RelatedIndex *get_related_index(bible_conn *conn)
+{
+    bible_ctx *ctx = conn->ctx;
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    RelatedIndex *index = ctx->relatedIndexes;
+    while (index != NULL && strcmp(index->translation, conn->translation) != 0)
+        index = index->next;
+
+    int64_t sourceSize, sourceMtime;
+    if (index == NULL && source_info(ctx, conn->translation, &sourceSize, &sourceMtime))
+    {
+        char path[strlen(ctx->dbDir) + strlen(conn->translation) + 32];
+        sidecar_path(ctx, conn->translation, ".rel", path, sizeof(path));
+
+        index = related_open(path, conn->translation, sourceSize, sourceMtime);
+        if (index == NULL)
+        {
+            sidecar_folder(ctx);
+
+            if (build_related(conn, path, sourceSize, sourceMtime))
+                index = related_open(path, conn->translation, sourceSize, sourceMtime);
+        }
+
+        if (index != NULL)
+        {
+            index->next = ctx->relatedIndexes;
+            ctx->relatedIndexes = index;
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    // The matrix doesn't change once loaded, so it's used without the lock
+    return index;
+}
+
+// ---- Querying ----
+
+typedef struct
+{
+    uint32_t score, verse;
+} Scored;
+
+// Worse first (lower score, then later verse), so the heap's top is the one to drop
+static inline bool worse(Scored a, Scored b)
+{
+    return a.score < b.score || (a.score == b.score && a.verse > b.verse);
+}
+
+static void sift_down(Scored *heap, size_t count, size_t i)
+{
+    for (;;)
+    {
+        size_t smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < count && worse(heap[left], heap[smallest]))
+            smallest = left;
+        if (right < count && worse(heap[right], heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            return;
+
+        Scored swap = heap[i];
+        heap[i] = heap[smallest], heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+static void heap_push(Scored *heap, size_t *count, size_t limit, Scored item)
+{
+    if (*count < limit)
+    {
+        // Sift up
+        size_t i = (*count)++;
+        heap[i] = item;
+        while (i > 0 && worse(heap[i], heap[(i - 1) / 2]))
+        {
+            Scored swap = heap[i];
+            heap[i] = heap[(i - 1) / 2], heap[(i - 1) / 2] = swap;
+            i = (i - 1) / 2;
+        }
+    }
+    else if (worse(heap[0], item))
+    {
+        heap[0] = item;
+        sift_down(heap, *count, 0);
+    }
+}
+
+static int compare_scored(const void *a, const void *b)
+{
+    // Best first
+    Scored scoredA = *(const Scored*) a, scoredB = *(const Scored*) b;
+    return worse(scoredA, scoredB) - worse(scoredB, scoredA);
+}
+
+// Verse number (row) of [ref] (-1 if it isn't there)
+static long find_verse(const RelatedIndex *index, bible_ref ref)
+{
+    size_t low = 0, high = index->header->verseCount;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (index->refs[mid] < ref)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return (low < index->header->verseCount && index->refs[low] == ref) ? (long) low : -1;
+}
+
+// Best [limit] verses for verse [row] into [best] (best first). [scores] has room for every verse
+static size_t top_related(const RelatedIndex *index, uint32_t row, size_t limit, uint32_t *scores, Scored *best)
+{
+    uint32_t verses = index->header->verseCount;
+    memset(scores, 0, verses * sizeof(uint32_t));
+
+    // Dot products with every verse at once, one word's column at a time
+    for (uint32_t e = index->rowStart[row]; e < index->rowStart[row + 1]; e++)
+    {
+        uint32_t term = index->rowTerms[e], weight = index->rowWeights[e];
+        const uint32_t *columnVerses = index->columnVerses;
+        const uint8_t *columnWeights = index->columnWeights;
+
+        for (uint32_t c = index->columnStart[term]; c < index->columnStart[term + 1]; c++)
+            scores[columnVerses[c]] += weight * columnWeights[c];
+    }
+    // Not related to itself
+    scores[row] = 0;
+
+    size_t count = 0;
+    uint32_t i = 0;
+
+#ifdef __SSE2__
+    // Only look at the scores that beat the worst one kept, 4 at a time
+    // (scores are at most 255 * 255 per word, so they fit in a signed int)
+    for (; i + 4 <= verses; i += 4)
+    {
+        uint32_t threshold = (count < limit) ? 0 : best[0].score;
+        __m128i block = _mm_loadu_si128((const __m128i*) &scores[i]);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(block, _mm_set1_epi32((int) threshold))));
+
+        while (mask != 0)
+        {
+            int lane = __builtin_ctz(mask);
+            heap_push(best, &count, limit, (Scored) { scores[i + lane], i + lane });
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < verses; i++)
+        if (scores[i] > 0)
+            heap_push(best, &count, limit, (Scored) { scores[i], i });
+
+    qsort(best, count, sizeof(Scored), &compare_scored);
+
+    return count;
+}
+
+bible_results *bible_related(bible_conn *conn, bible_ref ref, int limit)
+{
+    if (conn == NULL || limit <= 0)
+        return NULL;
+
+    RelatedIndex *index = get_related_index(conn);
+    if (index == NULL)
+        return NULL;
+
+    long row = find_verse(index, ref);
+    if (row < 0)
+        return NULL;
+
+    uint32_t *scores = malloc(index->header->verseCount * sizeof(uint32_t));
+    Scored *best = malloc(limit * sizeof(Scored));
+    size_t count = top_related(index, row, limit, scores, best);
+    free(scores);
+
+    bible_results *results = calloc(1, sizeof(bible_results));
+    results->hits = calloc(count + 1, sizeof(bible_hit));
+    results->indexed = true;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        bible_hit *hit = &results->hits[results->count++];
+        hit->ref = index->refs[best[i].verse];
+        // Cosine similarity of 1 is 255 * 255
+        hit->score = 1 - best[i].score / (255.0 * 255.0);
+    }
+    free(best);
+
+    fill_hits(conn, results);
+
+    return results;
+}
+
+typedef struct
+{
+    const RelatedIndex *index;
+    const bible_ref *refs;
+    size_t count, limit;
+    bible_ref *out;
+
+    // Next verse to work on
+    size_t next;
+    pthread_mutex_t lock;
+} RelatedBatch;
+
+static void *related_worker(void *arg)
+{
+    RelatedBatch *batch = arg;
+    uint32_t *scores = malloc(batch->index->header->verseCount * sizeof(uint32_t));
+    Scored *best = malloc(batch->limit * sizeof(Scored));
+
+    for (;;)
+    {
+        // Take verses a few at a time, so threads don't wait on the lock
+        pthread_mutex_lock(&batch->lock);
+        size_t start = batch->next;
+        batch->next += 64;
+        pthread_mutex_unlock(&batch->lock);
+
+        if (start >= batch->count)
+            break;
+
+        size_t end = (start + 64 < batch->count) ? start + 64 : batch->count;
+        for (size_t i = start; i < end; i++)
+        {
+            bible_ref *out = &batch->out[i * batch->limit];
+            memset(out, 0, batch->limit * sizeof(bible_ref));
+
+            long row = find_verse(batch->index, batch->refs[i]);
+            if (row < 0)
+                continue;
+
+            size_t count = top_related(batch->index, row, batch->limit, scores, best);
+            for (size_t b = 0; b < count; b++)
+                out[b] = batch->index->refs[best[b].verse];
+        }
+    }
+
+    free(scores);
+    free(best);
+
+    return NULL;
+}
+
+bool bible_related_batch(bible_conn *conn, const bible_ref *refs, size_t count, int limit, int threads, bible_ref *out)
+{
+    if (conn == NULL || refs == NULL || out == NULL || limit <= 0)
+        return false;
+
+    RelatedIndex *index = get_related_index(conn);
+    if (index == NULL)
+        return false;
+
+    RelatedBatch batch = { .index = index, .refs = refs, .count = count, .limit = limit, .out = out };
+    pthread_mutex_init(&batch.lock, NULL);
+
+    bible_threads_run(threads, &related_worker, &batch);
+    pthread_mutex_destroy(&batch.lock);
+
+    return true;
+}
@@ -0,0 +1,384 @@
+// Allows strdup to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "internal.h"
+
+// Bump when the index layout changes, so old indexes are rebuilt
+#define SEARCH_INDEX_VERSION 1
+
+// An index is only used if it was built from a file of the same size and modification time
+static bool index_is_current(const char *path, int64_t size, int64_t mtime)
+{
+    sqlite3 *db;
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return false;
+    }
+
+    int matches = 0;
+    sqlite3_stmt *sql;
+    if (sqlite3_prepare_v2(db, "SELECT key, value FROM meta", -1, &sql, NULL) == SQLITE_OK)
+    {
+        while (sqlite3_step(sql) == SQLITE_ROW)
+        {
+            const char *key = (const char*) sqlite3_column_text(sql, 0);
+            long long value = sqlite3_column_int64(sql, 1);
+
+            if ((strcmp(key, "version") == 0 && value == SEARCH_INDEX_VERSION)
+                || (strcmp(key, "source_size") == 0 && value == size)
+                || (strcmp(key, "source_mtime") == 0 && value == mtime))
+                matches++;
+        }
+    }
+    sqlite3_finalize(sql);
+    sqlite3_close(db);
+
+    return matches == 3;
+}
+
+// strip_tags(text) for SQL
+static void strip_tags_function(sqlite3_context *context, int argCount, sqlite3_value **args)
+{
+    (void) argCount;
+
+    const char *text = (const char*) sqlite3_value_text(args[0]);
+    if (text == NULL)
+    {
+        sqlite3_result_null(context);
+        return;
+    }
+
+    size_t size = strlen(text) + 1;
+    char *plain = malloc(size);
+    size_t len = bible_strip_tags(text, plain, size);
+    sqlite3_result_text(context, plain, len, &free);
+}
+
+// Build the index into a temporary file and move it into place when it's complete
+static bool build_index(const bible_ctx *ctx, const char *translation, const char *path, int64_t size, int64_t mtime)
+{
+    sidecar_folder(ctx);
+
+    char tempPath[strlen(path) + 32];
+    sidecar_temp_path(path, tempPath, sizeof(tempPath));
+    unlink(tempPath);
+
+    sqlite3 *db;
+    if (sqlite3_open_v2(tempPath, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return sidecar_finish(tempPath, path, false);
+    }
+
+    char source[strlen(ctx->dbDir) + strlen(translation) + 16];
+    translation_path(ctx, translation, source, sizeof(source));
+
+    bool built = false;
+    sqlite3_stmt *attach = NULL;
+
+    sqlite3_create_function(db, "strip_tags", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL, &strip_tags_function, NULL, NULL);
+
+    if (sqlite3_exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;", NULL, NULL, NULL) == SQLITE_OK
+        && sqlite3_prepare_v2(db, "ATTACH ? AS source", -1, &attach, NULL) == SQLITE_OK
+        && sqlite3_bind_text(attach, 1, source, -1, SQLITE_STATIC) == SQLITE_OK
+        && sqlite3_step(attach) == SQLITE_DONE)
+    {
+        char meta[200];
+        snprintf(meta, sizeof(meta),
+            "INSERT INTO meta VALUES ('version', %d), ('source_size', %lld), ('source_mtime', %lld);",
+            SEARCH_INDEX_VERSION, (long long) size, (long long) mtime);
+
+        built = sqlite3_exec(db,
+            "BEGIN;"
+            "CREATE TABLE meta (key TEXT PRIMARY KEY, value INTEGER);"
+            "CREATE VIRTUAL TABLE verses_fts USING fts5(text, tokenize = 'unicode61 remove_diacritics 2');"
+            // Rowids are VERSE_ID()s (made bible_refs as the hits are read)
+            "INSERT INTO verses_fts (rowid, text) "
+                "SELECT book_number * 1000000 + chapter * 1000 + verse, strip_tags(text) FROM source.verses;"
+            "INSERT INTO verses_fts (verses_fts) VALUES ('optimize');",
+            NULL, NULL, NULL) == SQLITE_OK
+            && sqlite3_exec(db, meta, NULL, NULL, NULL) == SQLITE_OK
+            && sqlite3_exec(db, "COMMIT; DETACH source;", NULL, NULL, NULL) == SQLITE_OK;
+    }
+
+    sqlite3_finalize(attach);
+    built &= sqlite3_close(db) == SQLITE_OK;
+
+    return sidecar_finish(tempPath, path, built);
+}
+
+bool bible_search_index(bible_conn *conn)
+{
+    if (conn == NULL)
+        return false;
+
+    bible_ctx *ctx = conn->ctx;
+
+    char path[strlen(ctx->dbDir) + strlen(conn->translation) + 32];
+    sidecar_path(ctx, conn->translation, ".fts", path, sizeof(path));
+
+    int64_t size, mtime;
+    if (!source_info(ctx, conn->translation, &size, &mtime))
+        return false;
+
+    pthread_mutex_lock(&ctx->indexLock);
+    bool current = index_is_current(path, size, mtime) || build_index(ctx, conn->translation, path, size, mtime);
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    pthread_mutex_lock(&conn->lock);
+    conn->searchChecked = true;
+
+    // Swap in the (new) index
+    if (conn->hasSearch)
+    {
+        sqlite3_exec(conn->db, "DETACH search", NULL, NULL, NULL);
+        conn->hasSearch = false;
+    }
+
+    sqlite3_stmt *sql;
+    if (current && sqlite3_prepare_v2(conn->db, "ATTACH ? AS search", -1, &sql, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_text(sql, 1, path, -1, SQLITE_STATIC);
+        conn->hasSearch = (sqlite3_step(sql) == SQLITE_DONE);
+        sqlite3_finalize(sql);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    return conn->hasSearch;
+}
+
+// Turn what the user typed into an FTS5 query: every word must match, the last one can be a prefix
+// e.g. loved the wor -> "loved" "the" "wor"*
+static bool make_match_query(const char *query, char *match, size_t matchSize)
+{
+    size_t len = 0;
+    int words = 0;
+
+    const unsigned char *str = (const unsigned char*) query;
+    while (*str != '\0')
+    {
+        // Letters, digits and anything non-ASCII (e.g. accented letters) are part of words
+        while (*str != '\0' && !(isalnum(*str) || *str >= 0x80)) str++;
+        if (*str == '\0')
+            break;
+
+        const unsigned char *start = str;
+        while (isalnum(*str) || *str >= 0x80) str++;
+
+        int written = snprintf(&match[len], matchSize - len, "%s\"%.*s\"", (words > 0) ? " " : "", (int) (str - start), start);
+        if (written < 0 || len + written + 2 >= matchSize)
+            return false;
+        len += written;
+        words++;
+    }
+
+    if (words == 0)
+        return false;
+
+    // Only treat the last word as a prefix if the user is still typing it
+    size_t queryLen = strlen(query);
+    if (queryLen > 0 && !isspace((unsigned char) query[queryLen - 1]))
+        match[len++] = '*';
+    match[len] = '\0';
+
+    return true;
+}
+
+bible_results *bible_search(bible_conn *conn, const char *query, int limit)
+{
+    return bible_search_cancellable(conn, query, limit, NULL);
+}
+
+// SQLite calls this every few thousand instructions while searching, and stops if it returns non-zero
+static int is_cancelled(void *cancel)
+{
+    return *(volatile int*) cancel != 0;
+}
+
+bible_results *bible_search_cancellable(bible_conn *conn, const char *query, int limit, volatile int *cancel)
+{
+    if (conn == NULL || query == NULL || query[0] == '\0')
+        return NULL;
+
+    if (!conn->searchChecked)
+        bible_search_index(conn);
+
+    char match[strlen(query) * 3 + 16];
+    if (conn->hasSearch && !make_match_query(query, match, sizeof(match)))
+        return NULL;
+
+    // Without an index: %query%
+    if (!conn->hasSearch)
+        snprintf(match, sizeof(match), "%%%s%%", query);
+
+    bible_results *results = calloc(1, sizeof(bible_results));
+    results->indexed = conn->hasSearch;
+    size_t size = 0;
+    int status = SQLITE_DONE;
+
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = statement(conn, conn->hasSearch ? STMT_SEARCH : STMT_SEARCH_SLOW);
+    if (sql != NULL)
+    {
+        if (cancel != NULL)
+            sqlite3_progress_handler(conn->db, 1000, &is_cancelled, (void*) cancel);
+
+        sqlite3_bind_text(sql, 1, match, -1, SQLITE_STATIC);
+        sqlite3_bind_int(sql, 2, limit);
+
+        while ((status = sqlite3_step(sql)) == SQLITE_ROW)
+        {
+            if (results->count == size)
+            {
+                size = (size == 0) ? 16 : size * 2;
+                results->hits = realloc(results->hits, size * sizeof(bible_hit));
+            }
+
+            // Books other than the 66 aren't shown
+            bible_ref ref = verse_ref(sqlite3_column_int(sql, 0));
+            const char *text = (const char*) sqlite3_column_text(sql, 2);
+            if (ref == 0)
+                continue;
+
+            bible_hit *hit = &results->hits[results->count++];
+            hit->ref = ref;
+            copy_book_name(hit->book, sizeof(hit->book), sqlite3_column_text(sql, 1));
+            hit->score = sqlite3_column_double(sql, 3);
+
+            // The index already has the text without tags
+            size_t textSize = strlen(text) + 1;
+            char *plain = malloc(textSize);
+            if (conn->hasSearch)
+                memcpy(plain, text, textSize);
+            else
+                bible_strip_tags(text, plain, textSize);
+            hit->text = plain;
+        }
+        done(sql);
+
+        if (cancel != NULL)
+            sqlite3_progress_handler(conn->db, 0, NULL, NULL);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    // Cancelled (SQLITE_INTERRUPT) or failed
+    if (status != SQLITE_DONE)
+    {
+        bible_results_free(results);
+        return NULL;
+    }
+
+    results->truncated = (limit >= 0 && results->count >= (size_t) limit);
+
+    return results;
+}
+
+// Whether [text] has every word of [words] (the last one as a prefix if [prefix]), like the index would
+static bool has_words(const char *text, char words[][64], size_t wordCount, bool prefix)
+{
+    bool found[wordCount];
+    memset(found, 0, sizeof(found));
+    size_t foundCount = 0;
+
+    char word[64];
+    bool unknown;
+    while (foundCount < wordCount && next_word(&text, word, sizeof(word), &unknown) > 0)
+    {
+        for (size_t i = 0; i < wordCount; i++)
+        {
+            if (found[i])
+                continue;
+
+            bool isPrefix = prefix && i == wordCount - 1;
+            // When unsure, keep the verse rather than lose a match
+            if (unknown || strcmp(word, words[i]) == 0
+                || (isPrefix && strncmp(word, words[i], strlen(words[i])) == 0))
+            {
+                found[i] = true;
+                foundCount++;
+            }
+        }
+    }
+
+    return foundCount == wordCount;
+}
+
+// Case-insensitive (ASCII) strstr, like LIKE
+static bool has_text(const char *text, const char *query)
+{
+    size_t queryLen = strlen(query);
+    for (; *text != '\0'; text++)
+        if (strncasecmp(text, query, queryLen) == 0)
+            return true;
+
+    return false;
+}
+
+bible_results *bible_search_refine(const bible_results *previous, const char *previousQuery, const char *query)
+{
+    if (previous == NULL || previousQuery == NULL || query == NULL || previous->truncated)
+        return NULL;
+
+    // Typing more can only narrow the results down
+    size_t previousLen = strlen(previousQuery), queryLen = strlen(query);
+    if (previousLen == 0 || queryLen <= previousLen || strncmp(query, previousQuery, previousLen) != 0)
+        return NULL;
+
+    // Folding non-ASCII queries (e.g. Greek or Cyrillic) is left to the index
+    for (size_t i = 0; i < queryLen; i++)
+        if ((unsigned char) query[i] >= 0x80)
+            return NULL;
+
+    // Words of [query] as the index sees them
+    char words[queryLen / 2 + 1][64];
+    size_t wordCount = 0;
+    bool unknown;
+    const char *str = query;
+    while (wordCount < queryLen / 2 + 1 && next_word(&str, words[wordCount], sizeof(words[0]), &unknown) > 0)
+    {
+        // Word too long to compare
+        if (unknown)
+            return NULL;
+        wordCount++;
+    }
+    if (wordCount == 0)
+        return NULL;
+
+    bool prefix = !isspace((unsigned char) query[queryLen - 1]);
+
+    bible_results *results = calloc(1, sizeof(bible_results));
+    results->indexed = previous->indexed;
+    if (previous->count > 0)
+        results->hits = malloc(previous->count * sizeof(bible_hit));
+
+    // Keeps the previous order, so results don't jump around while typing
+    for (size_t i = 0; i < previous->count; i++)
+    {
+        const bible_hit *hit = &previous->hits[i];
+        if (previous->indexed ? has_words(hit->text, words, wordCount, prefix) : has_text(hit->text, query))
+        {
+            results->hits[results->count] = *hit;
+            results->hits[results->count++].text = strdup(hit->text);
+        }
+    }
+
+    return results;
+}
+
+void bible_results_free(bible_results *results)
+{
+    if (results == NULL)
+        return;
+
+    for (size_t i = 0; i < results->count; i++)
+        free((char*) results->hits[i].text);
+
+    free(results->hits);
+    free(results);
+}
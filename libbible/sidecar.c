@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "internal.h"
+
+// Files made from the translations (search indexes, the related-verses matrix, counts, ...) are kept in
+// [dbDir]/.index, so they aren't mistaken for translations. Each records the size and modification time of
+// what it was made from, and is written to a temporary file that is renamed over the old one when complete,
+// so readers (other processes too) see the old file or the new one, never half of one
+
+void translation_path(const bible_ctx *ctx, const char *name, char *path, size_t pathSize)
+{
+    snprintf(path, pathSize, "%s/%s%s", ctx->dbDir, name, TRANSLATION_EXTENSION);
+}
+
+void sidecar_path(const bible_ctx *ctx, const char *name, const char *extension, char *path, size_t pathSize)
+{
+    snprintf(path, pathSize, "%s/.index/%s%s", ctx->dbDir, name, extension);
+}
+
+void sidecar_folder(const bible_ctx *ctx)
+{
+    char directory[strlen(ctx->dbDir) + 16];
+    snprintf(directory, sizeof(directory), "%s/.index", ctx->dbDir);
+    mkdir(directory, 0755);
+}
+
+bool source_info(const bible_ctx *ctx, const char *name, int64_t *size, int64_t *mtime)
+{
+    char source[strlen(ctx->dbDir) + strlen(name) + sizeof(TRANSLATION_EXTENSION) + 1];
+    translation_path(ctx, name, source, sizeof(source));
+
+    struct stat info;
+    if (stat(source, &info) != 0)
+        return false;
+
+    *size = info.st_size, *mtime = info.st_mtime;
+    return true;
+}
+
+void sidecar_temp_path(const char *path, char *tempPath, size_t tempPathSize)
+{
+	// Unique to the process, so two building the same file don't write into each other's
+    snprintf(tempPath, tempPathSize, "%s.%ld.tmp", path, (long) getpid());
+}
+
+bool sidecar_finish(const char *tempPath, const char *path, bool written)
+{
+	// On disk before it's renamed, or a crash could leave an empty file under the new name
+    if (written)
+    {
+        int fd = open(tempPath, O_RDONLY);
+        written = fd >= 0 && fsync(fd) == 0;
+        if (fd >= 0)
+            close(fd);
+    }
+
+    if (written && rename(tempPath, path) == 0)
+        return true;
+
+    remove(tempPath);
+    return false;
+}
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "internal.h"
+
+// Counts of every chapter (verses, words, characters, words of Jesus), so questions like "longest chapters"
+// don't read the text again
+//
+// They're counted on a few threads (each with its own SQLite connection, taking a book at a time) and kept
+// in [dbDir]/.index/TRANSLATION.stats: a StatsHeader, then a StatsRecord per chapter in Bible order
+
+#define STATS_MAGIC "BIBLESTA"
+#define STATS_VERSION 2
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version, count;
+    // The translation it was built from
+    int64_t sourceSize, sourceMtime;
+} StatsHeader;
+
+typedef struct
+{
+    // Of the chapter (or book)
+    bible_ref ref;
+    uint32_t verses, words, characters, redWords;
+} StatsRecord;
+
+struct StatsIndex
+{
+    char translation[64];
+    StatsIndex *next;
+
+    // Chapters in Bible order, then books
+    size_t chapterCount, bookCount;
+    StatsRecord *chapters, *books;
+};
+
+// ---- Building ----
+
+typedef struct
+{
+    int book;
+    StatsRecord *chapters;
+    size_t chapterCount;
+} StatsBook;
+
+typedef struct
+{
+    const char *path;
+
+    StatsBook *books;
+    size_t bookCount;
+
+    // Next book to count
+    size_t next;
+    pthread_mutex_t lock;
+    bool failed;
+} StatsBuild;
+
+// Words and characters (not bytes) of text without tags
+static void count_text(const char *plain, uint32_t *words, uint32_t *characters)
+{
+    for (const char *c = plain; *c != '\0'; c++)
+        if (((unsigned char) *c & 0xC0) != 0x80)
+            (*characters)++;
+
+    char word[64];
+    bool unknown;
+    while (next_word(&plain, word, sizeof(word), &unknown) > 0)
+        (*words)++;
+}
+
+// Words inside <J></J> (red letters)
+static uint32_t count_red_words(const char *text, char *plain, size_t plainSize)
+{
+    uint32_t words = 0, characters = 0;
+
+    for (const char *start = strstr(text, "<J>"); start != NULL; start = strstr(start, "<J>"))
+    {
+        start += strlen("<J>");
+        const char *end = strstr(start, "</J>");
+        size_t length = (end != NULL) ? (size_t) (end - start) : strlen(start);
+
+        char part[length + 1];
+        memcpy(part, start, length);
+        part[length] = '\0';
+
+        bible_strip_tags(part, plain, plainSize);
+        count_text(plain, &words, &characters);
+
+        start += length;
+    }
+
+    return words;
+}
+
+static bool count_book(sqlite3 *db, StatsBook *book)
+{
+    sqlite3_stmt *sql;
+    if (sqlite3_prepare_v2(db, "SELECT chapter, text FROM verses WHERE book_number = ? ORDER BY chapter, verse",
+        -1, &sql, NULL) != SQLITE_OK)
+        return false;
+    sqlite3_bind_int(sql, 1, book_number(book->book));
+
+    size_t size = 0, plainSize = 0;
+    char *plain = NULL;
+    while (sqlite3_step(sql) == SQLITE_ROW)
+    {
+        bible_ref chapter = BIBLE_REF(book->book, sqlite3_column_int(sql, 0), 0);
+        const char *text = (const char*) sqlite3_column_text(sql, 1);
+        if (text == NULL)
+            continue;
+
+        if (book->chapterCount == 0 || book->chapters[book->chapterCount - 1].ref != chapter)
+        {
+            if (book->chapterCount == size)
+            {
+                size = (size == 0) ? 64 : size * 2;
+                book->chapters = realloc(book->chapters, size * sizeof(StatsRecord));
+            }
+            book->chapters[book->chapterCount++] = (StatsRecord) { .ref = chapter };
+        }
+
+        size_t textSize = strlen(text) + 1;
+        if (textSize > plainSize)
+        {
+            plainSize = textSize;
+            plain = realloc(plain, plainSize);
+        }
+
+        StatsRecord *record = &book->chapters[book->chapterCount - 1];
+        record->verses++;
+        bible_strip_tags(text, plain, plainSize);
+        count_text(plain, &record->words, &record->characters);
+        record->redWords += count_red_words(text, plain, plainSize);
+    }
+    sqlite3_finalize(sql);
+    free(plain);
+
+    return true;
+}
+
+static void *count_books(void *arg)
+{
+    StatsBuild *build = arg;
+
+    sqlite3 *db = NULL;
+    if (sqlite3_open_v2(build->path, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        build->failed = true;
+        return NULL;
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&build->lock);
+        size_t i = build->next++;
+        pthread_mutex_unlock(&build->lock);
+
+        if (i >= build->bookCount)
+            break;
+
+        if (!count_book(db, &build->books[i]))
+            build->failed = true;
+    }
+
+    sqlite3_close(db);
+
+    return NULL;
+}
+
+static bool build_stats(bible_conn *conn, const char *path, int threads, int64_t sourceSize, int64_t sourceMtime)
+{
+    const bible_ctx *ctx = conn->ctx;
+    char source[strlen(ctx->dbDir) + strlen(conn->translation) + 16];
+    translation_path(ctx, conn->translation, source, sizeof(source));
+
+    StatsBuild build = { .path = source };
+    pthread_mutex_init(&build.lock, NULL);
+
+    size_t size = 0;
+    for (int book = bible_adjacent_book(conn, 0, 1, NULL, 0); book > 0; book = bible_adjacent_book(conn, book, 1, NULL, 0))
+    {
+        if (build.bookCount == size)
+        {
+            size = (size == 0) ? 128 : size * 2;
+            build.books = realloc(build.books, size * sizeof(StatsBook));
+        }
+        build.books[build.bookCount++] = (StatsBook) { .book = book };
+    }
+
+    bible_threads_run(threads, &count_books, &build);
+    pthread_mutex_destroy(&build.lock);
+
+    StatsHeader header = { .version = STATS_VERSION, .sourceSize = sourceSize, .sourceMtime = sourceMtime };
+    memcpy(header.magic, STATS_MAGIC, sizeof(header.magic));
+    for (size_t b = 0; b < build.bookCount; b++)
+        header.count += build.books[b].chapterCount;
+
+    char tempPath[strlen(path) + 32];
+    sidecar_temp_path(path, tempPath, sizeof(tempPath));
+
+    // Readers never see a half-written file
+    bool written = false;
+    FILE *file = (!build.failed) ? fopen(tempPath, "wb") : NULL;
+    if (file != NULL)
+    {
+        fwrite(&header, sizeof(header), 1, file);
+        for (size_t b = 0; b < build.bookCount; b++)
+            fwrite(build.books[b].chapters, sizeof(StatsRecord), build.books[b].chapterCount, file);
+
+        written = !ferror(file);
+        written &= (fclose(file) == 0);
+    }
+    bool built = (file != NULL) && sidecar_finish(tempPath, path, written);
+
+    for (size_t b = 0; b < build.bookCount; b++)
+        free(build.books[b].chapters);
+    free(build.books);
+
+    return built;
+}
+
+// ---- Reading ----
+
+static StatsIndex *stats_open(const char *path, const char *translation, int64_t sourceSize, int64_t sourceMtime)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    // Counted again when the translation changes
+    StatsHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, STATS_MAGIC, sizeof(header.magic)) != 0
+        || header.version != STATS_VERSION || header.sourceSize != sourceSize || header.sourceMtime != sourceMtime)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    StatsIndex *index = calloc(1, sizeof(StatsIndex));
+    snprintf(index->translation, sizeof(index->translation), "%s", translation);
+    index->chapters = malloc((header.count + 1) * sizeof(StatsRecord));
+    index->chapterCount = fread(index->chapters, sizeof(StatsRecord), header.count, file);
+    fclose(file);
+
+    // Books are the sums of their chapters (chapter 0)
+    index->books = malloc((index->chapterCount + 1) * sizeof(StatsRecord));
+    for (size_t c = 0; c < index->chapterCount; c++)
+    {
+        const StatsRecord *chapter = &index->chapters[c];
+        bible_ref bookRef = chapter->ref & ~(bible_ref) 0xFFFF;
+        if (index->bookCount == 0 || index->books[index->bookCount - 1].ref != bookRef)
+            index->books[index->bookCount++] = (StatsRecord) { .ref = bookRef };
+
+        StatsRecord *book = &index->books[index->bookCount - 1];
+        book->verses += chapter->verses;
+        book->words += chapter->words;
+        book->characters += chapter->characters;
+        book->redWords += chapter->redWords;
+    }
+
+    return index;
+}
+
+void stats_index_free(StatsIndex *index)
+{
+    while (index != NULL)
+    {
+        StatsIndex *next = index->next;
+
+        free(index->chapters);
+        free(index->books);
+        free(index);
+
+        index = next;
+    }
+}
+
+// The counts of [conn]'s translation, counting them on [threads] threads (0 = one per core) if needed
+static StatsIndex *get_stats_index(bible_conn *conn, int threads)
+{
+    bible_ctx *ctx = conn->ctx;
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    StatsIndex *index = ctx->statsIndexes;
+    while (index != NULL && strcmp(index->translation, conn->translation) != 0)
+        index = index->next;
+
+    int64_t sourceSize, sourceMtime;
+    if (index == NULL && source_info(ctx, conn->translation, &sourceSize, &sourceMtime))
+    {
+        char path[strlen(ctx->dbDir) + strlen(conn->translation) + 32];
+        sidecar_path(ctx, conn->translation, ".stats", path, sizeof(path));
+
+        index = stats_open(path, conn->translation, sourceSize, sourceMtime);
+        if (index == NULL)
+        {
+            sidecar_folder(ctx);
+
+            if (build_stats(conn, path, threads, sourceSize, sourceMtime))
+                index = stats_open(path, conn->translation, sourceSize, sourceMtime);
+        }
+
+        if (index != NULL)
+        {
+            index->next = ctx->statsIndexes;
+            ctx->statsIndexes = index;
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    // The counts don't change once loaded, so they're used without the lock
+    return index;
+}
+
+static bible_stats to_stats(const StatsRecord *record)
+{
+    return (bible_stats) {
+        .ref = record->ref,
+        .verses = record->verses, .words = record->words, .characters = record->characters, .redWords = record->redWords,
+        .minutes = (float) record->words / BIBLE_WORDS_PER_MINUTE
+    };
+}
+
+bool bible_stats_build(bible_conn *conn, int threads)
+{
+    return conn != NULL && get_stats_index(conn, threads) != NULL;
+}
+
+bool bible_stats_get(bible_conn *conn, bible_ref ref, bible_stats *stats)
+{
+    StatsIndex *index = (conn != NULL) ? get_stats_index(conn, 0) : NULL;
+    if (index == NULL)
+        return false;
+
+    // Of the chapter (or of the book, for chapter 0)
+    ref &= ~(bible_ref) 0xFF;
+    bool book = BIBLE_REF_CHAPTER(ref) == 0;
+    const StatsRecord *records = book ? index->books : index->chapters;
+    size_t count = book ? index->bookCount : index->chapterCount;
+    size_t low = 0, high = count;
+
+    // Both are in Bible order, which is the order of refs
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (records[mid].ref < ref)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == count || records[low].ref != ref)
+        return false;
+
+    *stats = to_stats(&records[low]);
+    return true;
+}
+
+bible_stats_table *bible_stats_table_get(bible_conn *conn, bool books)
+{
+    StatsIndex *index = (conn != NULL) ? get_stats_index(conn, 0) : NULL;
+    if (index == NULL)
+        return NULL;
+
+    const StatsRecord *records = books ? index->books : index->chapters;
+    size_t count = books ? index->bookCount : index->chapterCount;
+
+    bible_stats_table *table = calloc(1, sizeof(bible_stats_table));
+    table->stats = malloc((count + 1) * sizeof(bible_stats));
+    for (; table->count < count; table->count++)
+        table->stats[table->count] = to_stats(&records[table->count]);
+
+    return table;
+}
+
+void bible_stats_table_free(bible_stats_table *table)
+{
+    if (table != NULL)
+    {
+        free(table->stats);
+        free(table);
+    }
+}
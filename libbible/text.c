@@ -0,0 +1,174 @@
+#include <string.h>
+#include <ctype.h>
+#include "internal.h"
+
+static size_t strip_tags(const char *text, char *out, size_t outSize, bool keepNotes)
+{
+    size_t len = 0;
+    if (outSize == 0)
+        return 0;
+
+    const char *str = text;
+    while (*str != '\0')
+    {
+        if (*str != '<')
+        {
+            if (len + 1 < outSize)
+                out[len++] = *str;
+            str++;
+            continue;
+        }
+
+        const char *tagEnd = strchr(str, '>');
+        if (tagEnd == NULL)
+            break;
+
+        // Footnotes and notes are not part of the text
+        if (!keepNotes && (strncmp(str, "<f>", 3) == 0 || strncmp(str, "<n>", 3) == 0))
+        {
+            const char *closing = strstr(tagEnd, (str[1] == 'f') ? "</f>" : "</n>");
+            str = (closing != NULL) ? closing + 4 : tagEnd + 1;
+            continue;
+        }
+
+        // Line breaks (and the ends of kept notes) become spaces
+        bool isNote = strncmp(str, "<f>", 3) == 0 || strncmp(str, "</f>", 4) == 0
+            || strncmp(str, "<n>", 3) == 0 || strncmp(str, "</n>", 4) == 0;
+        if ((strncmp(str, "<br/>", 5) == 0 || strncmp(str, "<pb/>", 5) == 0 || isNote) && len + 1 < outSize)
+            out[len++] = ' ';
+
+        str = tagEnd + 1;
+    }
+
+    out[len] = '\0';
+
+    return len;
+}
+
+size_t bible_strip_tags(const char *text, char *out, size_t outSize)
+{
+    return strip_tags(text, out, outSize, false);
+}
+
+size_t bible_strip_tags_keep_notes(const char *text, char *out, size_t outSize)
+{
+    return strip_tags(text, out, outSize, true);
+}
+
+// How the index's tokenizer (unicode61 remove_diacritics) sees one UTF-8 character, as far as it matters
+// for ASCII queries. [*size] is set to the character's length in bytes
+typedef enum
+{
+    CHAR_SEPARATOR, // Not part of a word
+    CHAR_FOLDED, // Same as an ASCII letter or digit, which is put in [*folded]
+    CHAR_OTHER, // Part of a word, but never the same as an ASCII letter
+    CHAR_UNKNOWN, // Might fold to an ASCII letter
+} CharKind;
+
+// U+00C0 - U+00FF: what each letter becomes without its accent ('?' doesn't fold, ' ' isn't a letter)
+static const char latin1[] = "aaaaaa?ceeeeiiii?nooooo ?uuuuy??aaaaaa?ceeeeiiii?nooooo ?uuuuy?y";
+
+static CharKind classify(const unsigned char *str, char *folded, int *size)
+{
+    *size = 1;
+
+    if (*str < 0x80)
+    {
+        *folded = tolower(*str);
+        return isalnum(*str) ? CHAR_FOLDED : CHAR_SEPARATOR;
+    }
+
+    // Length of the character from its first byte (stopping early if it's cut off)
+    int length = (*str >= 0xF0) ? 4 : (*str >= 0xE0) ? 3 : 2;
+    while (*size < length && (str[*size] & 0xC0) == 0x80)
+        (*size)++;
+
+    // U+0080 - U+00BF: mostly punctuation and symbols
+    if (*str == 0xC2)
+        return CHAR_SEPARATOR;
+
+    if (*str == 0xC3 && *size == 2)
+    {
+        *folded = latin1[str[1] - 0x80];
+        return (*folded == ' ') ? CHAR_SEPARATOR : (*folded == '?') ? CHAR_OTHER : CHAR_FOLDED;
+    }
+
+    // U+0100 - U+017F (Latin Extended-A) has many letters that fold to ASCII
+    if (*str == 0xC4 || *str == 0xC5)
+        return CHAR_UNKNOWN;
+
+    // U+2000 - U+206F: general punctuation (e.g. curly quotes)
+    if (*str == 0xE2 && *size == 3 && (str[1] == 0x80 || str[1] == 0x81))
+        return CHAR_SEPARATOR;
+
+    return CHAR_OTHER;
+}
+
+size_t next_word(const char **str, char *word, size_t wordSize, bool *unknown)
+{
+    const unsigned char *s = (const unsigned char*) *str;
+    size_t length = 0;
+    int size;
+    char folded;
+
+    *unknown = false;
+
+    // Skip separators
+    while (*s != '\0' && classify(s, &folded, &size) == CHAR_SEPARATOR)
+        s += size;
+
+    CharKind kind;
+    while (*s != '\0' && (kind = classify(s, &folded, &size)) != CHAR_SEPARATOR)
+    {
+        if (kind == CHAR_UNKNOWN)
+            *unknown = true;
+
+        // Words that don't fit are cut off
+        if (length + size >= wordSize)
+            *unknown = true;
+        else if (kind == CHAR_FOLDED)
+            word[length++] = folded;
+        // Characters that don't fold are kept as they are (so they never match ASCII)
+        else
+        {
+            memcpy(&word[length], s, size);
+            length += size;
+        }
+
+        s += size;
+    }
+
+    word[length] = '\0';
+    *str = (const char*) s;
+
+    return length;
+}
+
+long bible_word_offset(const char *text, uint32_t position, size_t *length)
+{
+    if (text == NULL)
+        return -1;
+
+    char word[64];
+    bool unknown;
+    const char *str = text;
+    for (uint32_t i = 0; ; i++)
+    {
+        // Find where the word starts (after the separators next_word() skips)
+        const unsigned char *start = (const unsigned char*) str;
+        char folded;
+        int size;
+        while (*start != '\0' && classify(start, &folded, &size) == CHAR_SEPARATOR)
+            start += size;
+
+        if (next_word(&str, word, sizeof(word), &unknown) == 0)
+            return -1;
+
+        if (i == position)
+        {
+            if (length != NULL)
+                *length = str - (const char*) start;
+            return (const char*) start - text;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#include <unistd.h>
+#include "bible.h"
+
+// The builders share their work out through their [data] (e.g. the next item to take, under a lock), so
+// it's done whether one thread or many run it
+
+int bible_threads_start(pthread_t *workers, int count, void *(*function)(void*), void *data)
+{
+    int started = 0;
+    while (started < count && pthread_create(&workers[started], NULL, function, data) == 0)
+        started++;
+
+	// Do it here if no thread could start
+    if (started == 0)
+        function(data);
+
+    return started;
+}
+
+void bible_threads_join(pthread_t *workers, int started)
+{
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+}
+
+void bible_threads_run(int threads, void *(*function)(void*), void *data)
+{
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0)
+        threads = 1;
+
+    pthread_t workers[threads];
+    bible_threads_join(workers, bible_threads_start(workers, threads, function, data));
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+// Section titles of a translation (its stories table), for an outline of a book or the whole Bible
+//
+// Read with one query the first time the translation's outline is asked for: every title (without tags) goes
+// into one block of text, and the sections are (ref, offset of the title) pairs sorted by ref, so
+// the sections of a book, or the one a verse is in, are a binary search away
+
+struct TitleIndex
+{
+    char translation[64];
+    TitleIndex *next;
+
+    size_t count;
+    bible_section *sections;
+    char *text;
+};
+
+static TitleIndex *build_title_index(bible_conn *conn)
+{
+    TitleIndex *index = calloc(1, sizeof(TitleIndex));
+    if (index == NULL)
+        return NULL;
+    snprintf(index->translation, sizeof(index->translation), "%s", conn->translation);
+
+    size_t capacity = 0, textLength = 0, textSize = 0;
+    bool failed = false;
+
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_stmt *sql = conn->hasStories ? statement(conn, STMT_ALL_TITLES) : NULL;
+    while (sql != NULL && !failed && sqlite3_step(sql) == SQLITE_ROW)
+    {
+        const unsigned char *title = sqlite3_column_text(sql, 3);
+        bible_ref ref = row_ref(sqlite3_column_int(sql, 0), sqlite3_column_int(sql, 1), sqlite3_column_int(sql, 2));
+        if (title == NULL || ref == 0)
+            continue;
+
+		// Room for the title (it's only ever shorter without its tags)
+        size_t length = strlen((const char*) title);
+        if (index->count == capacity)
+        {
+            size_t newCapacity = (capacity == 0) ? 1024 : capacity * 2;
+            bible_section *sections = realloc(index->sections, newCapacity * sizeof(bible_section));
+            failed = sections == NULL;
+            if (!failed)
+                index->sections = sections, capacity = newCapacity;
+        }
+        while (!failed && textLength + length + 1 > textSize)
+        {
+            size_t newSize = (textSize == 0) ? 65536 : textSize * 2;
+            char *text = realloc(index->text, newSize);
+            failed = text == NULL;
+            if (!failed)
+                index->text = text, textSize = newSize;
+        }
+        if (failed)
+            break;
+
+        size_t stripped = bible_strip_tags((const char*) title, &index->text[textLength], length + 1);
+        if (stripped == 0)
+            continue;
+
+        index->sections[index->count++] = (bible_section) { .ref = ref, .offset = textLength };
+        textLength += stripped + 1;
+    }
+    if (sql != NULL)
+        done(sql);
+    pthread_mutex_unlock(&conn->lock);
+
+    if (failed)
+    {
+        title_index_free(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+void title_index_free(TitleIndex *index)
+{
+    while (index != NULL)
+    {
+        TitleIndex *next = index->next;
+
+        free(index->sections);
+        free(index->text);
+        free(index);
+
+        index = next;
+    }
+}
+
+static TitleIndex *get_title_index(bible_conn *conn)
+{
+    bible_ctx *ctx = conn->ctx;
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    TitleIndex *index = ctx->titleIndexes;
+    while (index != NULL && strcmp(index->translation, conn->translation) != 0)
+        index = index->next;
+
+    if (index == NULL && (index = build_title_index(conn)) != NULL)
+    {
+        index->next = ctx->titleIndexes;
+        ctx->titleIndexes = index;
+    }
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    // It doesn't change once made, so it's used without the lock
+    return index;
+}
+
+bool bible_outline_get(bible_conn *conn, bible_outline *outline)
+{
+    TitleIndex *index = (conn != NULL) ? get_title_index(conn) : NULL;
+    if (index == NULL)
+        return false;
+
+    *outline = (bible_outline) { .count = index->count, .sections = index->sections, .text = index->text };
+    return true;
+}
+
+size_t bible_outline_find(const bible_outline *outline, bible_ref ref)
+{
+    size_t low = 0, high = outline->count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (outline->sections[mid].ref < ref)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+// Verse numbering (versification) of each translation, compared with the standard (KJV) numbering
+//
+// A translation either numbers a passage like the standard does or like another tradition does (mostly the
+// Hebrew one e.g. Malachi 4:1-6 is 3:19-24). Which one it follows shows in the length of a chapter near the
+// passage (Malachi 3 has 24 verses instead of 18), so each passage is checked with one verse count the first
+// time a translation is used. What's left is a short list of exceptions sorted by verse, for binary search
+
+enum
+{
+    // Both ways, or only from the translation to the standard (several of its verses are one standard verse)
+    // or only from the standard (one of its verses is several standard verses)
+    BOTH_WAYS,
+    TO_STANDARD,
+    FROM_STANDARD
+};
+
+typedef struct
+{
+    // Applies to translations with [probeVerses] verses in chapter [probeChapter] of [book] (1..66)
+    uint8_t book, probeChapter, probeVerses;
+    // Their verses [chapter:first..last] are the standard's from [standardChapter:standardVerse] on
+    // ([last] = BIBLE_REF_END: to the end of the chapter)
+    uint8_t chapter, first, last, standardChapter, standardVerse;
+    uint8_t direction;
+} Renumbering;
+
+#define END BIBLE_REF_END
+
+// Hebrew (and some other) numberings. Psalm titles are added by add_psalm_titles()
+static const Renumbering renumberings[] =
+{
+    { 1, 31, 54, 32, 1, 1, 31, 55, BOTH_WAYS }, { 1, 31, 54, 32, 2, END, 32, 1, BOTH_WAYS },
+    { 2, 7, 29, 7, 26, 29, 8, 1, BOTH_WAYS }, { 2, 7, 29, 8, 1, END, 8, 5, BOTH_WAYS },
+    { 2, 21, 37, 21, 37, 37, 22, 1, BOTH_WAYS }, { 2, 21, 37, 22, 1, END, 22, 2, BOTH_WAYS },
+    { 3, 5, 26, 5, 20, 26, 6, 1, BOTH_WAYS }, { 3, 5, 26, 6, 1, END, 6, 8, BOTH_WAYS },
+    { 4, 16, 35, 17, 1, 15, 16, 36, BOTH_WAYS }, { 4, 16, 35, 17, 16, END, 17, 1, BOTH_WAYS },
+    { 4, 29, 39, 30, 1, 1, 29, 40, BOTH_WAYS }, { 4, 29, 39, 30, 2, END, 30, 1, BOTH_WAYS },
+    { 5, 12, 31, 13, 1, 1, 12, 32, BOTH_WAYS }, { 5, 12, 31, 13, 2, END, 13, 1, BOTH_WAYS },
+    { 5, 22, 29, 23, 1, 1, 22, 30, BOTH_WAYS }, { 5, 22, 29, 23, 2, END, 23, 1, BOTH_WAYS },
+    { 5, 28, 69, 28, 69, 69, 29, 1, BOTH_WAYS }, { 5, 28, 69, 29, 1, END, 29, 2, BOTH_WAYS },
+    { 9, 21, 16, 21, 1, 1, 20, 42, TO_STANDARD }, { 9, 21, 16, 21, 2, END, 21, 1, BOTH_WAYS },
+    { 9, 23, 28, 24, 1, 1, 23, 29, BOTH_WAYS }, { 9, 23, 28, 24, 2, END, 24, 1, BOTH_WAYS },
+    { 10, 18, 32, 19, 1, 1, 18, 33, BOTH_WAYS }, { 10, 18, 32, 19, 2, END, 19, 1, BOTH_WAYS },
+    { 11, 4, 20, 5, 1, 14, 4, 21, BOTH_WAYS }, { 11, 4, 20, 5, 15, END, 5, 1, BOTH_WAYS },
+    { 11, 22, 54, 22, 44, 44, 22, 43, TO_STANDARD }, { 11, 22, 54, 22, 45, END, 22, 44, BOTH_WAYS },
+    { 12, 11, 20, 12, 1, 1, 11, 21, BOTH_WAYS }, { 12, 11, 20, 12, 2, END, 12, 1, BOTH_WAYS },
+    { 13, 5, 41, 5, 27, 41, 6, 1, BOTH_WAYS }, { 13, 5, 41, 6, 1, END, 6, 16, BOTH_WAYS },
+    { 14, 1, 18, 1, 18, 18, 2, 1, BOTH_WAYS }, { 14, 1, 18, 2, 1, END, 2, 2, BOTH_WAYS },
+    { 16, 3, 38, 3, 33, 38, 4, 1, BOTH_WAYS }, { 16, 3, 38, 4, 1, END, 4, 7, BOTH_WAYS },
+    { 16, 9, 37, 10, 1, 1, 9, 38, BOTH_WAYS }, { 16, 9, 37, 10, 2, END, 10, 1, BOTH_WAYS },
+    { 18, 40, 32, 40, 25, 32, 41, 1, BOTH_WAYS }, { 18, 40, 32, 41, 1, END, 41, 9, BOTH_WAYS },
+    { 21, 4, 17, 4, 17, 17, 5, 1, BOTH_WAYS }, { 21, 4, 17, 5, 1, END, 5, 2, BOTH_WAYS },
+    { 22, 6, 12, 7, 1, 1, 6, 13, BOTH_WAYS }, { 22, 6, 12, 7, 2, END, 7, 1, BOTH_WAYS },
+    { 23, 8, 23, 8, 23, 23, 9, 1, BOTH_WAYS }, { 23, 8, 23, 9, 1, END, 9, 2, BOTH_WAYS },
+    { 23, 64, 11, 63, 19, 19, 64, 1, FROM_STANDARD }, { 23, 64, 11, 64, 1, END, 64, 2, BOTH_WAYS },
+    { 24, 8, 23, 8, 23, 23, 9, 1, BOTH_WAYS }, { 24, 8, 23, 9, 1, END, 9, 2, BOTH_WAYS },
+    { 26, 20, 44, 21, 1, 5, 20, 45, BOTH_WAYS }, { 26, 20, 44, 21, 6, END, 21, 1, BOTH_WAYS },
+    { 27, 3, 33, 3, 31, 33, 4, 1, BOTH_WAYS }, { 27, 3, 33, 4, 1, END, 4, 4, BOTH_WAYS },
+    { 27, 5, 30, 6, 1, 1, 5, 31, BOTH_WAYS }, { 27, 5, 30, 6, 2, END, 6, 1, BOTH_WAYS },
+    { 28, 1, 9, 2, 1, 2, 1, 10, BOTH_WAYS }, { 28, 1, 9, 2, 3, END, 2, 1, BOTH_WAYS },
+    { 28, 11, 11, 12, 1, 1, 11, 12, BOTH_WAYS }, { 28, 11, 11, 12, 2, END, 12, 1, BOTH_WAYS },
+    { 28, 13, 15, 14, 1, 1, 13, 16, BOTH_WAYS }, { 28, 13, 15, 14, 2, END, 14, 1, BOTH_WAYS },
+    { 29, 2, 27, 3, 1, 5, 2, 28, BOTH_WAYS }, { 29, 2, 27, 4, 1, END, 3, 1, BOTH_WAYS },
+    { 32, 1, 16, 2, 1, 1, 1, 17, BOTH_WAYS }, { 32, 1, 16, 2, 2, END, 2, 1, BOTH_WAYS },
+    { 33, 4, 14, 4, 14, 14, 5, 1, BOTH_WAYS }, { 33, 4, 14, 5, 1, END, 5, 2, BOTH_WAYS },
+    { 34, 1, 14, 2, 1, 1, 1, 15, BOTH_WAYS }, { 34, 1, 14, 2, 2, END, 2, 1, BOTH_WAYS },
+    { 38, 1, 17, 2, 1, 4, 1, 18, BOTH_WAYS }, { 38, 1, 17, 2, 5, END, 2, 1, BOTH_WAYS },
+    { 39, 3, 24, 3, 19, 24, 4, 1, BOTH_WAYS },
+    // The doxology at the end of Romans 14 (Orthodox translations)
+    { 45, 14, 26, 14, 24, 26, 16, 25, BOTH_WAYS },
+    // 3 John 14 split in two
+    { 64, 1, 15, 1, 15, 15, 1, 14, TO_STANDARD },
+};
+
+// Psalms whose title is verse 1 (or verses 1-2) in the Hebrew numbering
+static const uint8_t oneVerseTitles[] =
+{
+    3, 4, 5, 6, 7, 8, 9, 12, 13, 18, 19, 20, 21, 22, 30, 31, 34, 36, 38, 39, 40, 41, 42, 44, 45, 46, 47, 48, 49,
+    53, 55, 56, 57, 58, 59, 61, 62, 63, 64, 65, 67, 68, 69, 70, 75, 76, 77, 80, 81, 83, 84, 85, 88, 89, 92,
+    102, 108, 140, 142
+};
+static const uint8_t twoVerseTitles[] = { 51, 52, 54, 60 };
+
+#define PSALMS 19
+// Psalm 3 has 9 verses (instead of 8) when titles are numbered
+#define TITLES_CHAPTER 3
+#define TITLES_VERSES 9
+
+struct VersificationIndex
+{
+    char translation[64];
+    VersificationIndex *next;
+
+    // Sorted by [first], without overlaps: from the translation to the standard, and the other way round
+    // (where [first..last] are standard verses and [standard] the translation's)
+    size_t toCount, fromCount;
+    bible_renumbering *toStandard, *fromStandard;
+};
+
+typedef struct
+{
+    bible_renumbering *list;
+    size_t count, size;
+} RenumberingList;
+
+static void add(RenumberingList *list, bible_ref first, bible_ref last, bible_ref standard)
+{
+    if (list->count == list->size)
+    {
+        list->size = (list->size == 0) ? 64 : list->size * 2;
+        list->list = realloc(list->list, list->size * sizeof(bible_renumbering));
+    }
+
+    list->list[list->count++] = (bible_renumbering) { .first = first, .last = last, .standard = standard };
+}
+
+static void add_renumbering(RenumberingList *to, RenumberingList *from, const Renumbering *r)
+{
+    bible_ref first = BIBLE_REF(r->book, r->chapter, r->first), last = BIBLE_REF(r->book, r->chapter, r->last);
+    bible_ref standard = BIBLE_REF(r->book, r->standardChapter, r->standardVerse);
+
+	// The standard verses they cover ([last] may run on to the end of the chapter)
+    int standardLast = r->standardVerse + (r->last - r->first);
+    if (r->last == END || standardLast > END)
+        standardLast = END;
+
+    if (r->direction != FROM_STANDARD)
+        add(to, first, last, standard);
+    if (r->direction != TO_STANDARD)
+        add(from, standard, BIBLE_REF(r->book, r->standardChapter, standardLast), first);
+}
+
+static void add_psalm_titles(RenumberingList *to, RenumberingList *from)
+{
+    for (size_t i = 0; i < sizeof(oneVerseTitles); i++)
+    {
+        uint8_t psalm = oneVerseTitles[i];
+        // Psalm 13:6 is 13:5-6 in the standard numbering
+        uint8_t last = (psalm == 13) ? 6 : END;
+
+        add_renumbering(to, from, &(Renumbering) { PSALMS, TITLES_CHAPTER, TITLES_VERSES, psalm, 1, 1, psalm, 1, TO_STANDARD });
+        add_renumbering(to, from, &(Renumbering) { PSALMS, TITLES_CHAPTER, TITLES_VERSES, psalm, 2, last, psalm, 1, BOTH_WAYS });
+        if (psalm == 13)
+            add_renumbering(to, from, &(Renumbering) { PSALMS, TITLES_CHAPTER, TITLES_VERSES, psalm, 6, 6, psalm, 6, FROM_STANDARD });
+    }
+
+    for (size_t i = 0; i < sizeof(twoVerseTitles); i++)
+    {
+        uint8_t psalm = twoVerseTitles[i];
+
+        add_renumbering(to, from, &(Renumbering) { PSALMS, TITLES_CHAPTER, TITLES_VERSES, psalm, 1, 1, psalm, 1, TO_STANDARD });
+        add_renumbering(to, from, &(Renumbering) { PSALMS, TITLES_CHAPTER, TITLES_VERSES, psalm, 2, 2, psalm, 1, TO_STANDARD });
+        add_renumbering(to, from, &(Renumbering) { PSALMS, TITLES_CHAPTER, TITLES_VERSES, psalm, 3, END, psalm, 1, BOTH_WAYS });
+    }
+}
+
+static int compare_renumberings(const void *a, const void *b)
+{
+    bible_ref first = ((const bible_renumbering*) a)->first, other = ((const bible_renumbering*) b)->first;
+    return (first > other) - (first < other);
+}
+
+// Work out how [conn]'s translation numbers its verses
+static VersificationIndex *build_versification(bible_conn *conn)
+{
+    VersificationIndex *index = calloc(1, sizeof(VersificationIndex));
+    if (index == NULL)
+        return NULL;
+    snprintf(index->translation, sizeof(index->translation), "%s", conn->translation);
+
+    RenumberingList to = { 0 }, from = { 0 };
+
+	// Neighbouring renumberings share their check, so it's only done once
+    const Renumbering *checked = NULL;
+    bool applies = false;
+    for (size_t i = 0; i < sizeof(renumberings) / sizeof(*renumberings); i++)
+    {
+        const Renumbering *r = &renumberings[i];
+        if (checked == NULL || r->book != checked->book || r->probeChapter != checked->probeChapter)
+        {
+            checked = r;
+            applies = bible_verse_count(conn, BIBLE_REF(r->book, r->probeChapter, 0)) == r->probeVerses;
+        }
+
+        if (applies)
+            add_renumbering(&to, &from, r);
+    }
+
+    if (bible_verse_count(conn, BIBLE_REF(PSALMS, TITLES_CHAPTER, 0)) == TITLES_VERSES)
+        add_psalm_titles(&to, &from);
+
+    // The lists are NULL if nothing applies
+    if (to.count > 0)
+        qsort(to.list, to.count, sizeof(bible_renumbering), &compare_renumberings);
+    if (from.count > 0)
+        qsort(from.list, from.count, sizeof(bible_renumbering), &compare_renumberings);
+
+    index->toStandard = to.list, index->toCount = to.count;
+    index->fromStandard = from.list, index->fromCount = from.count;
+
+    return index;
+}
+
+void versification_free(VersificationIndex *index)
+{
+    while (index != NULL)
+    {
+        VersificationIndex *next = index->next;
+
+        free(index->toStandard);
+        free(index->fromStandard);
+        free(index);
+
+        index = next;
+    }
+}
+
+static VersificationIndex *get_versification(bible_conn *conn)
+{
+    bible_ctx *ctx = conn->ctx;
+
+    pthread_mutex_lock(&ctx->indexLock);
+
+    VersificationIndex *index = ctx->versifications;
+    while (index != NULL && strcmp(index->translation, conn->translation) != 0)
+        index = index->next;
+
+    if (index == NULL && (index = build_versification(conn)) != NULL)
+    {
+        index->next = ctx->versifications;
+        ctx->versifications = index;
+    }
+
+    pthread_mutex_unlock(&ctx->indexLock);
+
+    // It doesn't change once made, so it's used without the lock
+    return index;
+}
+
+// [ref] moved by the renumbering it's in (if any)
+static bible_ref renumber(const bible_renumbering *list, size_t count, bible_ref ref)
+{
+	// Last renumbering starting at or before [ref]
+    size_t low = 0, high = count;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (list[mid].first <= ref)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low > 0 && ref <= list[low - 1].last)
+        return list[low - 1].standard + (ref - list[low - 1].first);
+
+    return ref;
+}
+
+bible_ref bible_to_standard(bible_conn *conn, bible_ref ref)
+{
+    VersificationIndex *index = (conn != NULL) ? get_versification(conn) : NULL;
+    return (index != NULL) ? renumber(index->toStandard, index->toCount, ref) : ref;
+}
+
+bible_ref bible_from_standard(bible_conn *conn, bible_ref ref)
+{
+    VersificationIndex *index = (conn != NULL) ? get_versification(conn) : NULL;
+    return (index != NULL) ? renumber(index->fromStandard, index->fromCount, ref) : ref;
+}
+
+bible_ref bible_map_verse(bible_conn *from, bible_conn *to, bible_ref ref)
+{
+    return bible_from_standard(to, bible_to_standard(from, ref));
+}
+
+size_t bible_versification(bible_conn *conn, const bible_renumbering **renumberings)
+{
+    VersificationIndex *index = (conn != NULL) ? get_versification(conn) : NULL;
+    *renumberings = (index != NULL) ? index->toStandard : NULL;
+
+    return (index != NULL) ? index->toCount : 0;
+}
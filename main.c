@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <strings.h>
 #include <ctype.h>
 #include <ncurses.h>
 #include <locale.h>
@@ -6,22 +7,49 @@
 #include "components/input-field.h"
 #include "ui/bible-display.h"
 #include "util/store.h"
+#include "util/notes.h"
 #include "ui/translation-selection.h"
 #include "util/logger.h"
+#include "cli/print.h"
+#include "cli/batch.h"
+#include "cli/serve.h"
+#include "cli/daemon.h"
+#include "cli/query.h"
+#include "cli/grep.h"
+#include "cli/related.h"
+#include "cli/parallels.h"
+#include "cli/stats.h"
+#include "cli/versification.h"
+#include "util/daemon-client.h"
+#include "ui/search.h"
+#include "ui/find.h"
+#include "ui/concordance.h"
+#include "ui/related.h"
+#include "ui/reading-time.h"
+#include "ui/history.h"
+#include "ui/outline.h"
 
 static size_t bookInf, chapterInf, verseInf;
 
-static char book[20] = "Genesis";
-static int chapter = 1, verse = 1;
+// The verse being read
+static bible_ref ref = BIBLE_REF(1, 1, 1);
+// The references being read when several are opened at once e.g. "Rom 3:23; 6:23; 5:8" (0 otherwise)
+#define MAX_RANGES 64
+static bible_range ranges[MAX_RANGES];
+static size_t rangeCount = 0;
 
 static MEVENT mouseEvent;
 
 static bool book_callback(const char *);
+static void book_typed(const char *);
 // We're using floats because they can be down-casted to ints
 static bool chapter_callback(float);
 static bool verse_callback(float);
 
 static void load_bible_path(int argCount, char **args);
+static void set_input_fields(int verse);
+static void go_to_search_result(void);
+static void open_concordance(const char *word);
 
 static void hor_nav(bool right);
 
@@ -29,6 +57,28 @@ static void hor_nav(bool right);
 
 int main(int argc, char **argv)
 {
+	// Non-interactive modes don't need ncurses, the log or the translation list
+	if (argc >= 2 && strcmp(argv[1], "--print") == 0)
+		return print_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
+		return batch_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--serve-stdio") == 0)
+		return serve_stdio_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--daemon") == 0)
+		return daemon_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--query") == 0)
+		return query_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--grep") == 0)
+		return grep_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--related") == 0)
+		return related_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--parallels") == 0)
+		return parallels_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--stats") == 0)
+		return stats_mode(argc - 2, argv + 2);
+	if (argc >= 2 && strcmp(argv[1], "--versification") == 0)
+		return versification_mode(argc - 2, argv + 2);
+
     setlocale(LC_CTYPE, ""); // enable UTF-8
     initscr();
     noecho(); // Don't show user input
@@ -36,17 +86,23 @@ int main(int argc, char **argv)
     curs_set(FALSE); // Disable cursor
     keypad(stdscr, true); // Allow function and arrow keys and mouse
 	// Capture mouse
-    mousemask(REPORT_MOUSE_POSITION | BUTTON1_CLICKED | BUTTON4_PRESSED | BUTTON5_PRESSED, NULL); 
+    mousemask(REPORT_MOUSE_POSITION | BUTTON1_CLICKED | BUTTON1_DOUBLE_CLICKED | BUTTON4_PRESSED | BUTTON5_PRESSED, NULL); 
+    set_escdelay(25); // [ESC] closes search, so don't wait a second for it
     use_default_colors(); // Allows transparent color pairs
     start_color(); // Enable colours
 
     // Colour pairs (id, fg, bg)
     init_pair(RED_COLOUR, COLOR_RED, -1 /* no bg*/);
+    init_pair(HIGHLIGHT_COLOUR, COLOR_BLACK, COLOR_YELLOW);
 
     refresh();
 
-	// Open db of first translation (0)
-    open_bible_db(0);
+	// Open db of the translation last read (or the first one)
+    int translation = bible_translation_index(db_context(), get_stored_translation());
+    if (translation < 0 || !open_bible_db(translation))
+        open_bible_db(translation = 0);
+	// Chapters come from the daemon if one is running (otherwise straight from SQLite)
+    daemon_connect(daemon_socket_path());
 
 	enable_logging();
    
@@ -60,6 +116,8 @@ int main(int argc, char **argv)
         "",
         &book_callback
     );
+	// Suggest books as they're typed
+    inf_set_on_change(bookInf, &book_typed);
     chapterInf = inf_new_number
     (
         (Rect) {.w = COLS / 5, .h = 1, .x = COLS / 2 + 1, .y = LINES - 3},
@@ -78,7 +136,9 @@ int main(int argc, char **argv)
     );
 
 	// Show translation text
-    translation_selection();
+    translation_selection(translation);
+	// Reading time of the chapter
+    reading_time();
 
 	// Setup window for bible text
     init_bible();
@@ -86,11 +146,58 @@ int main(int argc, char **argv)
 	// If bible path is specified, load it
 	// Else, use previous one
 	// 	Or if first time, use Genesis 1
+    history_load();
     load_bible_path(argc, argv);
+    history_push(ref);
 
     int c;
-    while(tolower(c = getch()) != 'q')
+	// Going through matches of find (Ctrl-F)
+	bool finding = false;
+    for (;;)
     {
+		// Input fields draw over it
+		show_reading_time();
+		if (tolower(c = getch()) == 'q')
+			break;
+
+		// n/N go to the next/previous match, scrolling keeps them and anything else stops finding
+		if (finding)
+		{
+			if (c == 'n' || c == 'N')
+			{
+				find_next_in_bible(c == 'n');
+				continue;
+			}
+
+			// Highlight the matched words (or clear them if they already are)
+			bible_ref verse;
+			int firstWord, lastWord;
+			if (c == 'h' && match_words_in_bible(&verse, &firstWord, &lastWord))
+			{
+				toggle_highlight(verse, firstWord, lastWord);
+				update_bible_annotations(verse);
+				continue;
+			}
+
+			// Concordance of the matched word
+			char word[64];
+			if (c == '*' && match_word_in_bible(word, sizeof(word)))
+			{
+				finding = false;
+				end_find_in_bible();
+				open_concordance(word);
+				continue;
+			}
+
+			if (c != KEY_UP && c != KEY_DOWN && c != KEY_MOUSE)
+			{
+				finding = false;
+				end_find_in_bible();
+				if (c == 27 /* escape */)
+					continue;
+			}
+		}
+
         if (c == KEY_UP || c == KEY_DOWN)
 		{
             scroll_bible(c == KEY_UP);
@@ -103,6 +210,15 @@ int main(int argc, char **argv)
 			// BUTTON5_PRESSED -> scroll down
 			if (mouseEvent.bstate & BUTTON4_PRESSED || mouseEvent.bstate & BUTTON5_PRESSED)
 				scroll_bible(mouseEvent.bstate & BUTTON4_PRESSED);
+
+			// Double clicking a word shows its concordance
+			char word[64];
+			if (mouseEvent.bstate & BUTTON1_DOUBLE_CLICKED && word_at_bible(mouseEvent.y, mouseEvent.x, word, sizeof(word)))
+			{
+				finding = false;
+				end_find_in_bible();
+				open_concordance(word);
+			}
 		}
 
         else if (c == KEY_LEFT || c == KEY_RIGHT)
@@ -111,25 +227,106 @@ int main(int argc, char **argv)
             hor_nav(c == KEY_RIGHT);
 		}
 
-        else if (c == '\t' || c == 353 /* shift-tab */)
+		// Back and forward through the places jumped to
+        else if (c == KEY_SLEFT || c == KEY_SRIGHT)
+		{
+			if (history_go((c == KEY_SRIGHT) ? 1 : -1, &ref))
+			{
+				rangeCount = 0;
+				set_input_fields(BIBLE_REF_VERSE(ref));
+				inf_switch_focus(bookInf);
+			}
+
+			continue;
+		}
+
+		// Search (book names can't contain '/', so this doesn't clash with typing)
+        else if (c == '/')
+		{
+			if (search_open(&ref))
+				go_to_search_result();
+			else
+				display_bible(0);
+
+			continue;
+		}
+
+		// Related verses of the current verse
+        else if (c == 18 /* ctrl-r */)
+		{
+			if (related_open(&ref))
+				go_to_search_result();
+			else
+				display_bible(0);
+
+			continue;
+		}
+
+		// Section titles of the book (or the whole Bible)
+        else if (c == 5 /* ctrl-e */)
+		{
+			if (outline_open(&ref))
+				go_to_search_result();
+			else
+				display_bible(0);
+
+			continue;
+		}
+
+		// Find in chapter
+        else if (c == 6 /* ctrl-f */)
+		{
+			finding = find_open();
+			continue;
+		}
+
+		// Bookmark the verse at the top of the screen (or remove its bookmark)
+        else if (c == 4 /* ctrl-d */)
+		{
+			bible_ref verse;
+			if (top_verse_in_bible(&verse))
+			{
+				toggle_bookmark(verse);
+				update_bible_annotations(verse);
+			}
+			continue;
+		}
+
+		// Next or previous translation, or one picked from the list
+        else if (c == '\t' || c == 353 /* shift-tab */ || c == 20 /* ctrl-t */)
         {
-            change_translation(c == '\t');
+			// Stay on the same passage, however the next translation numbers its verses
+            ref = to_standard_numbering(ref);
+            for (size_t i = 0; i < rangeCount; i++)
+                ranges[i] = (bible_range) { to_standard_numbering(ranges[i].first), to_standard_numbering(ranges[i].last) };
+
+			// (If nothing is picked, the passage is shown again in the same translation)
+            if (c == 20)
+                pick_translation();
+            else
+                change_translation(c == '\t');
+
+            ref = from_standard_numbering(ref);
+            for (size_t i = 0; i < rangeCount; i++)
+                ranges[i] = (bible_range) { from_standard_numbering(ranges[i].first), from_standard_numbering(ranges[i].last) };
             
             reset_bible_start_pos();
 			// If able to get bible from db
-            if (store_bible_text(book, chapter, verse))
+            if ((rangeCount > 0) ? store_bible_ranges(ranges, rangeCount) != 0 : store_bible_text(ref))
 			{
 				log_bool(TRUE, "store_bible_text");
-                display_bible(verse);
+                display_bible((rangeCount > 0) ? 0 : BIBLE_REF_VERSE(ref));
+                history_update(ref);
 
 				// Reset input fields
 				// in case user was typing a new path while tab was hit
-				inf_set_text_value(bookInf, book);
-				inf_set_number_value(chapterInf, chapter);
-				inf_set_number_value(verseInf, verse);
+				set_input_fields(BIBLE_REF_VERSE(ref));
 				
 				// Prompt user to type in book
 				inf_switch_focus(bookInf);
+
+				// The new translation is where to start next time
+				save_stored_verse();
 			}
 
 			else
@@ -147,10 +344,16 @@ int main(int argc, char **argv)
     }
 
 	// Cleanup
+    save_stored_verse();
+    history_close();
     inf_cleanup();
     close_bible();
     close_translation();
+    close_reading_time();
     close_db();
+    close_bible_store();
+    close_notes();
+	daemon_disconnect();
 	close_logging();
 
     endwin();
@@ -160,43 +363,59 @@ int main(int argc, char **argv)
 
 static void load_bible_path(int argCount, char **args)
 {
-	// If bible path is passed as an argument correctly
-    if (argCount == 3 && isdigit(args[2][0]))
+	// Join the arguments, so both `1 Cor 13:4` and "1 Cor 13:4" work
+    char text[128] = "";
+    for (int i = 1; i < argCount; i++)
     {
-        strncpy(book, args[1], sizeof(book) - 1);
-        sscanf(args[2], "%d%*c%d", &chapter, &verse);
+        if (text[0] != '\0')
+            strncat(text, " ", sizeof(text) - strlen(text) - 1);
+        strncat(text, args[i], sizeof(text) - strlen(text) - 1);
     }
 
-    else
+	// If bible path is passed as an argument correctly (and the translation has the book)
+	// Else, use previous bible path
+    int count = bible_parse_references(text, ranges, MAX_RANGES);
+
+	// A list of references is shown as one passage
+    if (count > 1)
     {
-		// Use previous bible path
-        get_stored_path(book, &chapter, &verse);
+        rangeCount = (count < MAX_RANGES) ? count : MAX_RANGES;
+        bible_ref first = store_bible_ranges(ranges, rangeCount);
+        if (first != 0)
+        {
+            ref = first;
+            set_input_fields(BIBLE_REF_VERSE(ref));
+            inf_switch_focus(bookInf);
+            display_bible(0);
+
+            return;
+        }
+        rangeCount = 0;
     }
 
-	// If previous functions worked properly
-    if (strlen(book) > 0 && chapter > 0 && verse > 0)
+    if (count >= 1 && get_max_chapter(ranges[0].first) > 0)
+        ref = ranges[0].first;
+    else
+        ref = get_stored_ref();
+
+    int maxChapter = get_max_chapter(ref);
+    if (maxChapter > 0 && BIBLE_REF_CHAPTER(ref) <= maxChapter)
     {
-        int maxChapter = get_max_chapter(book);
-        if (maxChapter > 0 && chapter <= maxChapter)
+        int verseCount = get_no_of_verses(ref);
+        if (BIBLE_REF_VERSE(ref) <= verseCount)
         {
-            int verseCount = get_no_of_verses(book, chapter);
-            if (verse <= verseCount)
+			// If access to db was successful
+            if (store_bible_text(ref))
             {
-				// If access to db was successful
-                if (store_bible_text(book, chapter, verse))
-                {
-					// Set the values of the input fields to the gotten bible path
-                    inf_set_text_value(bookInf, book);
-                    inf_set_number_value(chapterInf, chapter);
-                    inf_set_number_value(verseInf, verse);
+				// Set the values of the input fields to the gotten bible path
+                set_input_fields(BIBLE_REF_VERSE(ref));
 
-					// Prompt user to type in book
-                    inf_switch_focus(bookInf);
+				// Prompt user to type in book
+                inf_switch_focus(bookInf);
 
-                    display_bible(verse);
+                display_bible(BIBLE_REF_VERSE(ref));
 
-					return; // Avoids printing the error below
-                }
+				return; // Avoids printing the error below
             }
         }
     }
@@ -205,16 +424,43 @@ static void load_bible_path(int argCount, char **args)
 	display_bible_error("Couldn't access Bible\nTry pressing [TAB] to change the translation");
 }
 
-// TODO: Implement search here
+// Show the books starting with what's typed: the rest of the best one (what Enter picks), then the others
+static void book_typed(const char *typed)
+{
+    bible_book_suggestion suggestions[6];
+    size_t count = suggest_books(typed, suggestions, 6);
+
+    char hint[128] = "";
+    if (count > 0)
+    {
+        size_t typedLength = strlen(typed);
+        if (strncasecmp(suggestions[0].name, typed, typedLength) == 0)
+            snprintf(hint, sizeof(hint), "%s", suggestions[0].name + typedLength);
+        else
+            snprintf(hint, sizeof(hint), " %s", suggestions[0].name);
+
+        for (size_t i = 1; i < count; i++)
+        {
+            size_t length = strlen(hint);
+            snprintf(hint + length, sizeof(hint) - length, "%s%s%s",
+                (i == 1) ? "  (" : ", ", suggestions[i].name, (i == count - 1) ? ")" : "");
+        }
+    }
+
+    inf_set_hint(bookInf, hint);
+}
+
 static bool book_callback(const char *bk)
 {
-	// Longest book is at most 19 characters long
-    strncpy(book, bk, 19);
+    bible_ref bookRef = find_book(bk);
 
-    int maxChapter = get_max_chapter(bk);
-    if (maxChapter > 0)
+    int maxChapter = get_max_chapter(bookRef);
+    if (bookRef != 0 && maxChapter > 0)
     {
-        get_book(book, 0);
+        ref = bookRef;
+
+        char book[40];
+        get_book_name(ref, book, sizeof(book));
         inf_set_text_value(bookInf, book);
 
         inf_set_number_value(chapterInf, maxChapter);
@@ -233,17 +479,22 @@ static bool book_callback(const char *bk)
 
 static bool chapter_callback(float ch)
 {
-    chapter = ch;
-
-    int maxChapter = get_max_chapter(book);
+    int maxChapter = get_max_chapter(ref);
     if (ch > 0 && ch <= maxChapter)
     {
-        int verseCount = get_no_of_verses(book, ch);
+        bible_ref chapterRef = BIBLE_REF(BIBLE_REF_BOOK(ref), (int) ch, 1);
+
+        int verseCount = get_no_of_verses(chapterRef);
         if (verseCount > 0)
         {
-            bool bibleStored = store_bible_text(book, ch, 1);
+            history_leave();
+            bool bibleStored = store_bible_text(chapterRef);
             if (bibleStored)
             {
+                ref = chapterRef;
+                rangeCount = 0;
+                history_push(ref);
+
                 inf_set_number_value(verseInf, verseCount);
                 inf_switch_focus(verseInf);
 
@@ -270,24 +521,26 @@ static bool chapter_callback(float ch)
 
 static bool verse_callback(float v)
 {
-    verse = v;
-
-    int verseCount = get_no_of_verses(book, chapter);
+    int verseCount = get_no_of_verses(ref);
     if (v > 0 && (int) v <= verseCount)
     {
+        ref = BIBLE_REF(BIBLE_REF_BOOK(ref), BIBLE_REF_CHAPTER(ref), (int) v);
+
         inf_switch_focus(bookInf);
 
-        // Store verse to file 
-        FILE *bibleStore = fopen(bibleStorePath, "r+b");
-        if (bibleStore != NULL)
+		// Back to the whole chapter from a list of references
+        if (rangeCount > 0)
         {
-			// Move to correct position in file (after book, chapter and colon)
-            fseek(bibleStore, snprintf(NULL, 0, "%s %i:", book, chapter), SEEK_SET);
-            fprintf(bibleStore, "%03i", (int) v);
-            fclose(bibleStore);
+            rangeCount = 0;
+            reset_bible_start_pos();
+            store_bible_text(ref);
         }
 
+		// Store verse to file, so it's opened next time
+        keep_stored_verse(ref);
+        save_stored_verse();
         display_bible(v);
+        history_update(ref);
 
         return true;
     }
@@ -300,35 +553,62 @@ static bool verse_callback(float v)
     return false;
 }
 
-// Use arrow keys to move from chapter to chapter
-// Or to next or previous book
-static void hor_nav(bool right)
+// Show [ref]'s book and chapter, and [verse], in the input fields
+static void set_input_fields(int verse)
+{
+    char book[40];
+    if (get_book_name(ref, book, sizeof(book)))
+        inf_set_text_value(bookInf, book);
+
+    inf_set_number_value(chapterInf, BIBLE_REF_CHAPTER(ref));
+    inf_set_number_value(verseInf, verse);
+}
+
+// Show the verse picked in the search
+static void open_concordance(const char *word)
+{
+	if (concordance_open(word, &ref))
+		go_to_search_result();
+	else
+		display_bible(0);
+}
+
+static void go_to_search_result(void)
 {
-    int maxChapters = get_max_chapter(book);
-    if (maxChapters <= 0) return;
-
-    // If right arrow key is pressed and current chapter is less than max chapter
-    if (right && chapter < maxChapters)
-        chapter++;
-    // If left arrow key is pressed and current chapter is greater than 1
-    else if (!right && chapter > 1)
-        chapter--;
-    // Called when at the extreme
-    // i.e. current chapter is 1 or max chapter
+    history_leave();
+    if (store_bible_text(ref))
+    {
+        rangeCount = 0;
+        history_push(ref);
+        set_input_fields(BIBLE_REF_VERSE(ref));
+        inf_switch_focus(bookInf);
+
+        reset_bible_start_pos();
+        display_bible(BIBLE_REF_VERSE(ref));
+    }
+
     else
     {
-        if (get_book(book, right) == false)
-            return;
-        chapter = 1;
+        display_bible_error("Couldn't open that verse");
     }
+}
+
+// Use arrow keys to move from chapter to chapter
+// Or to the next or previous book (its first chapter going right and its last one going left)
+static void hor_nav(bool right)
+{
+    bible_ref chapterRef = get_adjacent_chapter(ref, right ? 1 : -1);
+    if (chapterRef == 0)
+        return;
 
 	// Get bible text from new path
-    if (store_bible_text(book, chapter, verse))
+    if (store_bible_text(chapterRef))
     {
-        inf_set_text_value(bookInf, book);
-        inf_set_number_value(chapterInf, chapter);
-        inf_set_number_value(verseInf, get_no_of_verses(book, chapter));
+        ref = chapterRef;
+        rangeCount = 0;
+        history_update(ref);
 
+        set_input_fields(get_no_of_verses(ref));
         inf_switch_focus(verseInf);
 
         reset_bible_start_pos();
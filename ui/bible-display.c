@@ -3,10 +3,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <ncurses.h>
+#include "../util/text.h"
+#include "../util/notes.h"
 #include "bible-display.h"
 
-extern const char bibleStorePath[];
+extern char bibleStorePath[];
+extern unsigned long bibleStoreVersion;
 
 static WINDOW *win = NULL;
 static int w = 80, h = 24, startTermLine = 1;
@@ -41,251 +45,775 @@ void reset_bible_start_pos(void)
     startTermLine = 1;
 }
 
-static int get_word(const char *str, char *word)
+// The chapter laid out in rows as wide as the window
+// Scrolling and highlighting matches redraw from here, without reading or wrapping the text again
+typedef struct
 {
-    if (str == NULL || word == NULL)
-        return 0;
+	// Bytes of [layout.text] and the attributes they're drawn with
+    size_t start, length;
+    attr_t attrs;
+} Run;
 
-	// Move to next character, if at space
-    if (*str == ' ') str++;
-    
-    // Clear current [word] content
-    memset(word, 0, strlen(word));
-
-	// Determines the end of a word
-	// Words are separated by spaces, so that is the [endChar]
-    char endChar = ' ';
-	// If [str] starts at '<', it's a tag
-	// So end at tag end
-    if (*str == '<')
-        endChar = '>';
-    // If there's no space after word
-	// That is, we're at the end of the line
-    else if (strchr(str, ' ') == NULL)
+typedef struct
+{
+    size_t start, length;
+    size_t firstRun, runCount;
+	// Verse starting on this row (0 if none)
+    int verse;
+} Row;
+
+typedef struct
+{
+	// Bytes of [layout.text]
+    size_t start, end;
+} Word;
+
+// A line of the bible store that's a verse
+typedef struct
+{
+	// Verse in the standard numbering (0 if the bible store doesn't say)
+    bible_ref ref;
+    size_t firstRow;
+	// Bytes of its number e.g. "[16]", and its words (numbered from 0, in [layout.words])
+    size_t numberStart, numberEnd;
+    size_t firstWord, wordCount;
+} VerseLine;
+
+typedef struct
+{
+	// Rows follow each other in [text], separated by ' ' (wrapped) or '\n' (new line)
+    char *text;
+    size_t textLength, textSize;
+    Run *runs;
+    size_t runCount, runSize;
+    Row *rows;
+    size_t rowCount, rowSize;
+	// Where each verse's words are, for bookmarks and highlights
+    Word *words;
+    size_t wordCount, wordSize;
+    VerseLine *verses;
+    size_t verseCount, verseSize;
+
+	// What the layout was made from
+    unsigned long version;
+    int width;
+    bool valid;
+} Layout;
+
+static Layout layout = { 0 };
+
+// Matches of the find query (byte ranges of [layout.text])
+typedef struct
+{
+    size_t start, end;
+} Match;
+
+static Match *matches = NULL;
+static size_t matchCount = 0, matchSize = 0, currentMatch = 0;
+
+// Bookmarks and highlights drawn over the text: byte ranges of [layout.text], sorted and not overlapping
+// Made from the annotations of the verses shown, read once whenever the layout (or an annotation) changes
+typedef struct
+{
+    size_t start, end;
+    attr_t attrs;
+} Overlay;
+
+static Overlay *overlays = NULL;
+static size_t overlayCount = 0, overlaySize = 0;
+
+static void *grow(void *array, size_t *size, size_t needed, size_t itemSize)
+{
+    if (needed <= *size)
+        return array;
+
+    size_t newSize = (*size == 0) ? 64 : *size;
+    while (newSize < needed)
+        newSize *= 2;
+
+    void *grown = realloc(array, newSize * itemSize);
+    if (grown == NULL)
     {
-		// Lines end with the new line character
-        endChar = '\n';
-        // If there's no new line after word
-		// Files end with the null character
-        if (strchr(str, '\n') == NULL)
-            endChar = '\0';
+        perror("realloc");
+        exit(EXIT_FAILURE);
     }
 
-	// Length of word is the distance from the first character to a white space or tag end
-    int distToChar = strchr(str, endChar) - str;
-	// Since a tag also includes its end character, increment its length
-    if (endChar == '>') distToChar++;
+    *size = newSize;
+    return grown;
+}
+
+static void new_row(int verse)
+{
+	// Separate from the last row, so matches can't join the end of one line to the next
+    if (layout.rowCount > 0)
+    {
+        layout.text = grow(layout.text, &layout.textSize, layout.textLength + 2, 1);
+        layout.text[layout.textLength++] = (verse == -1) ? ' ' : '\n';
+    }
 
-    // Get word
-    strncpy(word, str, distToChar);
-    word[distToChar] = '\0';
+    layout.rows = grow(layout.rows, &layout.rowSize, layout.rowCount + 1, sizeof(Row));
+    layout.rows[layout.rowCount++] = (Row) { .start = layout.textLength, .firstRun = layout.runCount, .verse = (verse > 0) ? verse : 0 };
+}
 
-    // If tag is in word e.g. Adam<e>
-    if (word[0] != '<' && strchr(word, '<') != NULL)
+static void add_text(const char *str, size_t length, attr_t attrs)
+{
+    Row *row = &layout.rows[layout.rowCount - 1];
+
+    layout.text = grow(layout.text, &layout.textSize, layout.textLength + length + 1, 1);
+    memcpy(&layout.text[layout.textLength], str, length);
+
+	// Continue the last run if nothing changed
+    Run *last = (row->runCount > 0) ? &layout.runs[layout.runCount - 1] : NULL;
+    if (last != NULL && last->attrs == attrs && last->start + last->length == layout.textLength)
+        last->length += length;
+    else
     {
-		// Get the distance of the first character in word to tag start
-		// This is the actual length of the word (without the tag)
-        int indexOfChar = strchr(word, '<') - word;
-        int lenOfTag = strlen(word) - indexOfChar;
+        layout.runs = grow(layout.runs, &layout.runSize, layout.runCount + 1, sizeof(Run));
+        layout.runs[layout.runCount++] = (Run) { .start = layout.textLength, .length = length, .attrs = attrs };
+        row->runCount++;
+    }
+
+    layout.textLength += length;
+    row->length += length;
+}
 
-        // Clear tag part starting from the beginning of the tag
-        memset(&word[indexOfChar], 0, lenOfTag);
+static inline bool tag_equal(const char *tag, size_t len, const char *name)
+{
+    return (strlen(name) == len && strncmp(tag, name, len) == 0);
+}
+
+// Attributes after [tag]
+static attr_t handle_tag(const char *tag, size_t len, attr_t attrs)
+{
+    if (tag_equal(tag, len, "<J>"))
+        return attrs | COLOR_PAIR(RED_COLOUR);
+    else if (tag_equal(tag, len, "</J>"))
+        return attrs & ~COLOR_PAIR(RED_COLOUR);
+    else if (tag_equal(tag, len, "<v>"))
+        return attrs | A_DIM;
+    else if (tag_equal(tag, len, "</v>"))
+        return attrs & ~A_DIM;
+    // Mark of a verse with a parallel passage
+    else if (tag_equal(tag, len, "<p>"))
+        return attrs | A_BOLD;
+    else if (tag_equal(tag, len, "</p>"))
+        return attrs & ~A_BOLD;
+	else if (tag_equal(tag, len, "<b>") || tag_equal(tag, len, "<e>"))
+		return attrs | A_BOLD;
+ 	else if (tag_equal(tag, len, "</b>") || tag_equal(tag, len, "</e>"))
+		return attrs & ~A_BOLD;
+	// else if (tag_equal(tag, len, "<pb/>"))
+    //    new line
+    // else if (tag_equal(tag, len, "<t>"))
+    //     tab
+    // else if (tag_equal(tag, len, "<br/>"))
+    //     new line
+
+    return attrs;
+}
+
+// Number of characters (not bytes) in [length] bytes of UTF-8
+static int columns_of(const char *str, size_t length)
+{
+    int columns = 0;
+    for (size_t i = 0; i < length; i++)
+        if (((unsigned char) str[i] & 0xC0) != 0x80)
+            columns++;
+
+    return columns;
+}
+
+// Whether text after [tag] is a verse's number or mark, rather than its words
+static bool marker_after(const char *tag, size_t len, bool marker)
+{
+    if (tag_equal(tag, len, "<v>") || tag_equal(tag, len, "<p>"))
+        return true;
+    else if (tag_equal(tag, len, "</v>") || tag_equal(tag, len, "</p>"))
+        return false;
+
+    return marker;
+}
+
+// Word wrap a line of the bible store e.g. "<ref=65793><v>[1] </v>In the beginning"
+static void layout_line(const char *line, int verse, attr_t *attrs)
+{
+    new_row(verse);
+    int rowColumns = 0;
+
+    VerseLine *verseLine = NULL;
+    if (verse > 0)
+    {
+        layout.verses = grow(layout.verses, &layout.verseSize, layout.verseCount + 1, sizeof(VerseLine));
+        verseLine = &layout.verses[layout.verseCount++];
+        *verseLine = (VerseLine) { .firstRow = layout.rowCount - 1, .firstWord = layout.wordCount };
+        if (strncmp(line, "<ref=", 5) == 0)
+            verseLine->ref = strtoul(line + 5, NULL, 10);
     }
+    bool marker = false;
 
-    return strlen(word);
+    const char *str = line;
+    while (*str != '\0' && *str != '\n')
+    {
+		// Words are separated by spaces
+        bool spaceBefore = false;
+        attr_t spaceAttrs = *attrs;
+        while (*str == ' ')
+            str++, spaceBefore = true;
+
+        const char *wordStart = str;
+        int wordColumns = 0;
+        while (*str != '\0' && *str != '\n' && *str != ' ')
+        {
+            if (*str == '<')
+            {
+                const char *tagEnd = strchr(str, '>');
+                if (tagEnd == NULL)
+                    break;
+				// Skip footnotes and notes i.e., the text in between the tag and its closing tag
+                if (tag_equal(str, tagEnd - str + 1, "<f>") || tag_equal(str, tagEnd - str + 1, "<n>"))
+                {
+                    const char *closing = strstr(tagEnd, (str[1] == 'f') ? "</f>" : "</n>");
+                    str = (closing != NULL) ? closing + 4 : tagEnd + 1;
+                }
+                else
+                    str = tagEnd + 1;
+                continue;
+            }
+
+            size_t length = strcspn(str, " <\n");
+            wordColumns += columns_of(str, length);
+            str += length;
+        }
+
+		// Only tags
+        if (wordColumns == 0)
+        {
+            for (const char *tag = wordStart; tag < str; tag++)
+                if (*tag == '<' && strchr(tag, '>') != NULL)
+                {
+                    *attrs = handle_tag(tag, strchr(tag, '>') - tag + 1, *attrs);
+                    marker = marker_after(tag, strchr(tag, '>') - tag + 1, marker);
+                }
+            continue;
+        }
+
+		// If the word (and the space after it) doesn't fit, go to a new line
+        if (rowColumns > 0 && rowColumns + 1 + wordColumns + (*str == ' ') >= w)
+        {
+            new_row(-1);
+            rowColumns = 0;
+        }
+        else if (rowColumns > 0 && spaceBefore)
+        {
+            add_text(" ", 1, spaceAttrs);
+            rowColumns++;
+        }
+
+		// Add the word, changing attributes at its tags e.g. Adam<e>
+        size_t textStart = layout.textLength;
+        bool markerWord = false;
+        for (const char *part = wordStart; part < str; )
+        {
+            if (*part == '<')
+            {
+                const char *tagEnd = strchr(part, '>');
+                if (tag_equal(part, tagEnd - part + 1, "<f>") || tag_equal(part, tagEnd - part + 1, "<n>"))
+                {
+                    const char *closing = strstr(tagEnd, (part[1] == 'f') ? "</f>" : "</n>");
+                    part = (closing != NULL && closing < str) ? closing + 4 : tagEnd + 1;
+                }
+                else
+                {
+                    *attrs = handle_tag(part, tagEnd - part + 1, *attrs);
+                    marker = marker_after(part, tagEnd - part + 1, marker);
+                    part = tagEnd + 1;
+                }
+                continue;
+            }
+
+            size_t length = strcspn(part, "<");
+            if (part + length > str)
+                length = str - part;
+			// It's whatever its first letter is
+            if (layout.textLength == textStart)
+                markerWord = marker;
+            add_text(part, length, *attrs);
+            part += length;
+        }
+
+        rowColumns += wordColumns;
+
+		// The verse's number, or one of its words
+        if (verseLine != NULL && markerWord)
+        {
+            if (verseLine->numberEnd == 0)
+                verseLine->numberStart = textStart, verseLine->numberEnd = layout.textLength;
+        }
+        else if (verseLine != NULL)
+        {
+            layout.words = grow(layout.words, &layout.wordSize, layout.wordCount + 1, sizeof(Word));
+            layout.words[layout.wordCount++] = (Word) { .start = textStart, .end = layout.textLength };
+            verseLine->wordCount++;
+        }
+    }
 }
 
-static inline bool str_equal(const char *s1, const char *s2)
+static void add_overlay(size_t start, size_t end, attr_t attrs)
 {
-    return (strcmp(s1, s2) == 0);
+    if (end <= start)
+        return;
+
+    overlays = grow(overlays, &overlaySize, overlayCount + 1, sizeof(Overlay));
+    overlays[overlayCount++] = (Overlay) { .start = start, .end = end, .attrs = attrs };
 }
 
-// Enable attributes depending on the tag
-static void handle_tag(char* tag)
+static int compare_refs(const void *a, const void *b)
 {
-    if (str_equal(tag, "<J>"))
-        wattron(win, COLOR_PAIR(RED_COLOUR));
-    else if (str_equal(tag, "</J>"))
-        wattroff(win, COLOR_PAIR(RED_COLOUR));
-    else if (str_equal(tag, "<v>"))
-        wattron(win, A_DIM);
-    else if (str_equal(tag, "</v>"))
-        wattroff(win, A_DIM);
-	else if (str_equal(tag, "<b>") || str_equal(tag, "<e>"))
-		wattron(win, A_BOLD);
- 	else if (str_equal(tag, "</b>") || str_equal(tag, "</e>"))
-		wattroff(win, A_BOLD);
-	// else if (str_equal(tag, "<pb/>"))
-    //    wprintw(win, "\n ");
-    // else if (str_equal(tag, "<t>"))
-    //     waddch(win, '\t');
-    // else if (str_equal(tag, "<br/>"))
-    //     waddch(win, '\n');
+    bible_ref x = *(const bible_ref*) a, y = *(const bible_ref*) b;
+    return (x > y) - (x < y);
 }
 
-// Display bible text in window from text file
-void display_bible(int verse)
+// Read the annotations of the verses laid out (with one query), and where they're drawn
+static void annotate_layout(void)
+{
+    overlayCount = 0;
+
+    bible_ref first = UINT32_MAX, last = 0;
+    for (size_t v = 0; v < layout.verseCount; v++)
+    {
+        bible_ref ref = layout.verses[v].ref;
+        if (ref != 0 && ref < first)
+            first = ref;
+        if (ref > last)
+            last = ref;
+    }
+
+    bible_annotations *annotations = (last > 0) ? get_annotations(first, last) : NULL;
+    if (annotations == NULL)
+        return;
+
+	// Verses are in the order they're shown, each one's highlights in the order of its words
+    for (size_t v = 0; v < layout.verseCount; v++)
+    {
+        const VerseLine *verse = &layout.verses[v];
+        if (verse->ref == 0)
+            continue;
+
+        if (bsearch(&verse->ref, annotations->bookmarks, annotations->bookmarkCount, sizeof(bible_ref), &compare_refs) != NULL)
+            add_overlay(verse->numberStart, verse->numberEnd, COLOR_PAIR(HIGHLIGHT_COLOUR) | A_BOLD);
+
+		// First highlight of the verse
+        size_t low = 0, high = annotations->highlightCount;
+        while (low < high)
+        {
+            size_t mid = low + (high - low) / 2;
+            if (annotations->highlights[mid].ref < verse->ref)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        for (size_t i = low; i < annotations->highlightCount && annotations->highlights[i].ref == verse->ref; i++)
+        {
+            const bible_highlight *highlight = &annotations->highlights[i];
+            if (highlight->firstWord >= verse->wordCount)
+                break;
+
+            size_t lastWord = (highlight->lastWord < verse->wordCount) ? highlight->lastWord : verse->wordCount - 1;
+            add_overlay(layout.words[verse->firstWord + highlight->firstWord].start,
+                layout.words[verse->firstWord + lastWord].end, COLOR_PAIR(HIGHLIGHT_COLOUR));
+        }
+    }
+
+    bible_annotations_free(annotations);
+}
+
+// Lay out the bible store again if it (or the window width) changed
+static bool update_layout(void)
 {
+    if (layout.valid && layout.version == bibleStoreVersion && layout.width == w)
+        return true;
+
     FILE *bible = fopen(bibleStorePath, "r");
     if (bible == NULL)
-		return;
-		
-	wclear(win), wmove(win, 0, 0);
-	wattrset(win, A_NORMAL);
-	
-	char *line = malloc(1);
-	size_t lineSize = 1;
-
-	// Get first line (and throw it away, kinda)
-	getline(&line, &lineSize, bible);
-
-	int cursorY = 0, charCount = 0;
-	int currTermLine = 1, currVerse = 1;
-	bool canPrint = false, lastSpace = false;
-	char word[25 + 1] = "";
-	
-	// Get each line in file until end-of-file
-	while((getline(&line, &lineSize, bible) != EOF)
-		// Stop when cursor reaches window height
-		&& getcury(win) < h)
-	{
-		const char *str = line;
+		return false;
+
+    layout.textLength = layout.runCount = layout.rowCount = layout.wordCount = layout.verseCount = 0;
+    matchCount = 0;
+
+    char *line = NULL;
+    size_t lineSize = 0;
+
+    attr_t attrs = A_NORMAL;
+    int currVerse = 0;
+    while (getline(&line, &lineSize, bible) != EOF)
+    {
+		// Blank line between lines
+        if (layout.rowCount > 0)
+            new_row(0);
+
 		// Not all lines are verses e.g., titles
-		bool isAVerse = false;
-		while (*str != '\0' && *str != '\n')
-		{	
-			cursorY = getcury(win);
-
-			int wordLen = get_word(str, word); 
-			str += wordLen;
-
-			// Verses starting with a "<v>"
-			if (str_equal(word, "<v>"))
-				isAVerse = true;
-
-			// Print if at correct cursor location
-			// [startTermLine] is the line the user is currently reading
-			if ((verse <= 1 && currTermLine >= startTermLine)
-			// OR verse
-				|| verse == currVerse)
-			{
-				canPrint = true;
-				if (verse > 1)
-					// Save the line where the verse occurs
-					startTermLine = currTermLine;
-			}
-			
-			// Tag
-			if (word[0] == '<' && canPrint)
-			{
-				// If the tag is "<f>" or "<n>", skip it
-				// i.e., dismiss text in between tag and it's closing tag
-				if (str_equal(word, "<f>") || str_equal(word, "<n>"))
-				{
-					str = strchr(str, '>') + 1;
-					if (*str == ' ') str++;
-				}
-
-				else
-				{
-					handle_tag(word);
-					// Add space after tag, if needed
-					if (*str == ' ' && !lastSpace)
-						waddch(win, ' ');
-				}
-			}
-
-			else
-			{
-				charCount += (wordLen + (*str == ' '));
-				// Implement word wrap
-				// If the number of characters on the screen + number of characters about to be printed
-				// 	is greater than the width of the terminal, go to a new line
-				if (charCount >= w)
-				{
-					// Number of characters on new line is the length of the word to be printed
-					charCount = wordLen + (*str == ' ');
-					currTermLine++;
-
-					// If allowed to print
-					if (canPrint
-						// and last word didn't push cursor to the next line
-						//  (if cursor is pushed to the next line, its x-pos will be at 0)
-						&& getcurx(win) != 0)
-					{
-						waddch(win, '\n');
-						// If we're at the max height (terminal screen height)
-						if (getcury(win) == cursorY)
-							goto break2;
-						else
-							// Save new cursor position
-							cursorY = getcury(win);
-					}
-				}
-
-				if (canPrint)
-				{
-					wprintw(win, "%s", word);
-					
-					// If after printing word, cursor moves to next line
-					if (getcury(win) != cursorY)
-					{
-						// Reset [charCount] to number of characters on new line (should be 0)
-						charCount = getcurx(win);
-						currTermLine++;
-					}
-
-					else if (*str == ' ')
-					{
-						waddch(win, ' ');
-					}
-
-					lastSpace = (*str == ' ');
-				}
-			}
-
-			if (*str == ' ') str++;
-		}
-
-		if (canPrint)
-		{
-			cursorY = getcury(win);
-
-			// If you're already on a new line
-			if (getcurx(win) == 0)
-			 	// Delete new line
-				wdelch(win);
-
-			wprintw(win, "\n\n");
-			
-			// If we exceed the terminal's height
-			// That is, the cursor doesn't move down by 2 after printing 2 newlines
-			if (getcury(win) < cursorY + 2)
-				break;
-		}
-
-		// If we're at the end of the text file, don't allow further movement
-		if (feof(bible))
-		{
-			startTermLine--;
-		}
-
-		else
-		{
-			currTermLine += 2;
-			charCount = 0;
-			if (isAVerse) currVerse++;
-		}
-	}
-
-	// For breaking out of double while loops (see line ~209)
-	break2:
-
-	free(line);
-
-	wrefresh(win);
-
-	fclose(bible);
+        layout_line(line, (strstr(line, "<v>") != NULL) ? ++currVerse : 0, &attrs);
+    }
+
+    if (layout.text != NULL)
+        layout.text[layout.textLength] = '\0';
+
+    free(line);
+    fclose(bible);
+
+    layout.version = bibleStoreVersion;
+    layout.width = w;
+    layout.valid = true;
+
+    annotate_layout();
+
+    return true;
+}
+
+// First match ending after byte [offset]
+static size_t match_after(size_t offset)
+{
+    size_t low = 0, high = matchCount;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (matches[mid].end <= offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+// First overlay ending after byte [offset]
+static size_t overlay_after(size_t offset)
+{
+    size_t low = 0, high = overlayCount;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (overlays[mid].end <= offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+// Row containing byte [offset]
+static size_t row_of(size_t offset)
+{
+    size_t low = 0, high = layout.rowCount;
+    while (high - low > 1)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (layout.rows[mid].start <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+static void draw_row(size_t index)
+{
+    int y = (int) index - (startTermLine - 1);
+    if (y < 0 || y >= h)
+        return;
+
+    wmove(win, y, 0);
+    wattrset(win, A_NORMAL);
+    wclrtoeol(win);
+
+    const Row *row = &layout.rows[index];
+    size_t m = match_after(row->start), o = overlay_after(row->start);
+
+    for (size_t r = row->firstRun; r < row->firstRun + row->runCount; r++)
+    {
+        size_t at = layout.runs[r].start, end = at + layout.runs[r].length;
+        while (at < end)
+        {
+            while (m < matchCount && matches[m].end <= at)
+                m++;
+            while (o < overlayCount && overlays[o].end <= at)
+                o++;
+
+			// Split the run where bookmarks and highlights (drawn in their colour) and matches start and end
+            size_t partEnd = end;
+            attr_t attrs = layout.runs[r].attrs;
+            if (o < overlayCount && overlays[o].start <= at)
+            {
+                partEnd = (overlays[o].end < partEnd) ? overlays[o].end : partEnd;
+                attrs = (attrs & ~A_COLOR) | overlays[o].attrs;
+            }
+            else if (o < overlayCount && overlays[o].start < partEnd)
+                partEnd = overlays[o].start;
+
+            if (m < matchCount && matches[m].start <= at)
+            {
+                partEnd = (matches[m].end < partEnd) ? matches[m].end : partEnd;
+                attrs |= (m == currentMatch) ? A_REVERSE | A_BOLD : A_REVERSE;
+            }
+            else if (m < matchCount && matches[m].start < partEnd)
+                partEnd = matches[m].start;
+
+            wattrset(win, attrs);
+            waddnstr(win, &layout.text[at], partEnd - at);
+            at = partEnd;
+        }
+    }
+
+    wattrset(win, A_NORMAL);
+}
+
+// Display bible text in window from text file
+void display_bible(int verse)
+{
+    if (!update_layout())
+        return;
+
+	// Start at the row of [verse]
+    if (verse > 1)
+    {
+        for (size_t i = 0; i < layout.rowCount; i++)
+            if (layout.rows[i].verse == verse)
+            {
+                startTermLine = i + 1;
+                break;
+            }
+    }
+
+	// If we're at the end of the text, don't allow further movement
+    int lastStart = (int) layout.rowCount - h + 1;
+    if (startTermLine > lastStart)
+        startTermLine = (lastStart > 1) ? lastStart : 1;
+
+    werase(win);
+    for (size_t i = startTermLine - 1; i < layout.rowCount && (int) i < startTermLine - 1 + h; i++)
+        draw_row(i);
+
+    wrefresh(win);
+}
+
+// Scroll so the current match is on screen, or just redraw the rows it (and the last one) are on
+static void show_match(size_t previous)
+{
+    size_t first = row_of(matches[currentMatch].start), last = row_of(matches[currentMatch].end - 1);
+
+    if ((int) first < startTermLine - 1 || (int) last >= startTermLine - 1 + h)
+    {
+		// A third of the way down the screen
+        startTermLine = (int) first + 1 - h / 3;
+        if (startTermLine < 1)
+            startTermLine = 1;
+        display_bible(0);
+        return;
+    }
+
+    if (previous < matchCount)
+        for (size_t i = row_of(matches[previous].start); i <= row_of(matches[previous].end - 1); i++)
+            draw_row(i);
+    for (size_t i = first; i <= last; i++)
+        draw_row(i);
+
+    wrefresh(win);
+}
+
+size_t find_in_bible(const char *query)
+{
+    size_t queryLength = strlen(query);
+    if (!update_layout())
+        return 0;
+
+    char lower[queryLength + 1];
+    for (size_t i = 0; i <= queryLength; i++)
+        lower[i] = tolower((unsigned char) query[i]);
+
+    matchCount = 0;
+    for (const char *found = layout.text;
+        queryLength > 0 && layout.text != NULL
+        && (found = find_nocase(found, layout.textLength - (found - layout.text), lower, queryLength)) != NULL;
+        found += queryLength)
+    {
+        matches = grow(matches, &matchSize, matchCount + 1, sizeof(Match));
+        size_t start = found - layout.text;
+        matches[matchCount++] = (Match) { .start = start, .end = start + queryLength };
+    }
+
+    if (matchCount == 0)
+    {
+        display_bible(0);
+        return 0;
+    }
+
+	// First match from the top of the screen
+    currentMatch = match_after(layout.rows[startTermLine - 1].start);
+    if (currentMatch == matchCount)
+        currentMatch = 0;
+
+	// Every match on screen is highlighted, so redraw it all
+    display_bible(0);
+    show_match(matchCount);
+
+    return matchCount;
+}
+
+size_t find_next_in_bible(bool forward)
+{
+    if (matchCount == 0)
+        return 0;
+
+    size_t previous = currentMatch;
+    if (forward)
+        currentMatch = (currentMatch + 1) % matchCount;
+    else
+        currentMatch = (currentMatch + matchCount - 1) % matchCount;
+
+    show_match(previous);
+
+    return currentMatch + 1;
+}
+
+void end_find_in_bible(void)
+{
+    if (matchCount == 0)
+        return;
+
+    matchCount = 0;
+    display_bible(0);
+}
+
+// Part of a word: letters, digits, apostrophes and anything that isn't ASCII
+static inline bool is_word_byte(char c)
+{
+    return isalnum((unsigned char) c) || c == '\'' || (unsigned char) c >= 0x80;
+}
+
+// Copy the word around byte [offset] of the chapter
+static bool copy_word(size_t offset, char *word, size_t wordSize)
+{
+    if (offset >= layout.textLength || !is_word_byte(layout.text[offset]))
+        return false;
+
+    size_t start = offset, end = offset;
+    while (start > 0 && is_word_byte(layout.text[start - 1]))
+        start--;
+    while (end < layout.textLength && is_word_byte(layout.text[end]))
+        end++;
+
+    snprintf(word, wordSize, "%.*s", (int) (end - start), &layout.text[start]);
+    return true;
+}
+
+bool word_at_bible(int y, int x, char *word, size_t wordSize)
+{
+	// Screen to window
+    int row = startTermLine - 1 + y, column = x - 1;
+    if (!layout.valid || y < 0 || y >= h || column < 0 || row >= (int) layout.rowCount)
+        return false;
+
+    const Row *r = &layout.rows[row];
+    size_t at = r->start;
+    for (int c = 0; at < r->start + r->length; at++)
+        if (((unsigned char) layout.text[at] & 0xC0) != 0x80 && c++ == column)
+            break;
+
+    return at < r->start + r->length && copy_word(at, word, wordSize);
+}
+
+bool match_word_in_bible(char *word, size_t wordSize)
+{
+    return currentMatch < matchCount && copy_word(matches[currentMatch].start, word, wordSize);
+}
+
+// Verse line that row [row] is part of (layout.verseCount if it's before the first one)
+static size_t verse_of_row(size_t row)
+{
+    size_t low = 0, high = layout.verseCount;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (layout.verses[mid].firstRow <= row)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return (low > 0) ? low - 1 : layout.verseCount;
+}
+
+bool match_words_in_bible(bible_ref *ref, int *firstWord, int *lastWord)
+{
+    if (currentMatch >= matchCount)
+        return false;
+
+    const Match *match = &matches[currentMatch];
+    size_t v = verse_of_row(row_of(match->start));
+    if (v == layout.verseCount || layout.verses[v].ref == 0)
+        return false;
+
+	// Words the match is (partly) in
+    const VerseLine *verse = &layout.verses[v];
+    int first = -1, last = -1;
+    for (size_t i = 0; i < verse->wordCount; i++)
+    {
+        const Word *word = &layout.words[verse->firstWord + i];
+        if (word->end > match->start && word->start < match->end)
+        {
+            if (first == -1)
+                first = i;
+            last = i;
+        }
+    }
+    if (first == -1)
+        return false;
+
+    *ref = verse->ref, *firstWord = first, *lastWord = last;
+    return true;
+}
+
+bool top_verse_in_bible(bible_ref *ref)
+{
+    if (!layout.valid || layout.verseCount == 0)
+        return false;
+
+	// The verse the top row is in, unless it starts above the screen and the next one starts on it
+    size_t top = startTermLine - 1, v = verse_of_row(top);
+    size_t next = (v == layout.verseCount) ? 0 : v + 1;
+    if ((v == layout.verseCount || layout.verses[v].firstRow < top) && next < layout.verseCount
+        && layout.verses[next].firstRow < top + h)
+        v = next;
+
+    if (v == layout.verseCount || layout.verses[v].ref == 0)
+        return false;
+
+    *ref = layout.verses[v].ref;
+    return true;
+}
+
+void update_bible_annotations(bible_ref ref)
+{
+    if (!layout.valid)
+        return;
+
+    annotate_layout();
+
+	// Only the rows of the verse are drawn again
+    for (size_t v = 0; v < layout.verseCount; v++)
+    {
+        if (layout.verses[v].ref != ref)
+            continue;
+
+        size_t end = (v + 1 < layout.verseCount) ? layout.verses[v + 1].firstRow : layout.rowCount;
+        for (size_t r = layout.verses[v].firstRow; r < end; r++)
+            draw_row(r);
+    }
+
+    wrefresh(win);
 }
 
 // Display error (in a red colour) in bible window
@@ -300,7 +828,113 @@ void display_bible_error(const char *error)
     wrefresh(win);
 }
 
+// ---- Screens kept to be shown again (see ui/history.c) ----
+
+struct BibleScreen
+{
+    Layout layout;
+    int startTermLine;
+};
+
+static void *copy_of(const void *array, size_t size)
+{
+    void *copy = malloc((size > 0) ? size : 1);
+    if (copy != NULL && size > 0)
+        memcpy(copy, array, size);
+
+    return copy;
+}
+
+static void free_layout(Layout *from)
+{
+    free(from->text), free(from->runs), free(from->rows), free(from->words), free(from->verses);
+}
+
+// Copy of [from], only as big as it is (the copy doesn't grow)
+static bool copy_layout(Layout *copy, const Layout *from)
+{
+    *copy = *from;
+    copy->text = copy_of(from->text, from->textLength);
+    copy->runs = copy_of(from->runs, from->runCount * sizeof(Run));
+    copy->rows = copy_of(from->rows, from->rowCount * sizeof(Row));
+    copy->words = copy_of(from->words, from->wordCount * sizeof(Word));
+    copy->verses = copy_of(from->verses, from->verseCount * sizeof(VerseLine));
+    copy->textSize = from->textLength, copy->runSize = from->runCount, copy->rowSize = from->rowCount;
+    copy->wordSize = from->wordCount, copy->verseSize = from->verseCount;
+
+    if (copy->text == NULL || copy->runs == NULL || copy->rows == NULL || copy->words == NULL || copy->verses == NULL)
+    {
+        free_layout(copy);
+        return false;
+    }
+
+    return true;
+}
+
+BibleScreen *save_bible_screen(void)
+{
+    if (!update_layout())
+        return NULL;
+
+    BibleScreen *screen = malloc(sizeof(BibleScreen));
+    if (screen == NULL || !copy_layout(&screen->layout, &layout))
+    {
+        free(screen);
+        return NULL;
+    }
+    screen->startTermLine = startTermLine;
+
+    return screen;
+}
+
+int bible_screen_start_pos(const BibleScreen *screen)
+{
+    return screen->startTermLine;
+}
+
+bool restore_bible_screen(const BibleScreen *screen)
+{
+	// Rows are only as wide as the window was
+    Layout copy;
+    if (screen->layout.width != w || !copy_layout(&copy, &screen->layout))
+        return false;
+
+	// It's of what's in the bible store now (see restore_bible_store())
+    free_layout(&layout);
+    layout = copy;
+    layout.version = bibleStoreVersion;
+    matchCount = 0;
+	// Annotations may have changed since
+    annotate_layout();
+
+    startTermLine = screen->startTermLine;
+    display_bible(0);
+
+    return true;
+}
+
+void free_bible_screen(BibleScreen *screen)
+{
+    if (screen == NULL)
+        return;
+
+    free_layout(&screen->layout);
+    free(screen);
+}
+
+int bible_start_pos(void)
+{
+    return startTermLine;
+}
+
+void set_bible_start_pos(int line)
+{
+    startTermLine = (line > 1) ? line : 1;
+}
+
 void close_bible(void)
 {
+    free_layout(&layout);
+    free(matches), free(overlays);
     delwin(win);
 }
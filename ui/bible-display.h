@@ -1,8 +1,46 @@
+#include <stdint.h>
+#include "../libbible/bible.h"
+
 #define RED_COLOUR 1
+// Bookmarks and highlights
+#define HIGHLIGHT_COLOUR 2
 
 void init_bible(void);
 void scroll_bible(bool up);
 void reset_bible_start_pos(void);
+// Row at the top of the window (from 1), e.g. to scroll back there later
+int bible_start_pos(void);
+void set_bible_start_pos(int line);
 void display_bible(int verse);
+
+// Find (ignoring case) in the displayed chapter, highlighting every match and showing the first one on screen
+// Returns the number of matches
+size_t find_in_bible(const char *query);
+// Go to the next (or previous) match, returning its number (from 1)
+size_t find_next_in_bible(bool forward);
+// Stop highlighting matches
+void end_find_in_bible(void);
+
+// Word at screen position ([y], [x]) e.g. where the mouse was clicked. Returns false if there's none
+bool word_at_bible(int y, int x, char *word, size_t wordSize);
+// Word of the current match (of find)
+bool match_word_in_bible(char *word, size_t wordSize);
+// Verse (in the standard numbering) and words (numbered from 0) of the current match, to highlight them
+bool match_words_in_bible(bible_ref *ref, int *firstWord, int *lastWord);
+// Verse (in the standard numbering) at the top of the screen: the first one whose number is shown, or the
+// one filling the screen. Returns false if there's none
+bool top_verse_in_bible(bible_ref *ref);
+// Read the annotations again after [ref]'s changed, drawing only its rows again
+void update_bible_annotations(bible_ref ref);
+
+// What's on screen (the chapter laid out, and how far it's scrolled), kept to be shown again without laying it out
+typedef struct BibleScreen BibleScreen;
+// NULL if nothing is shown
+BibleScreen *save_bible_screen(void);
+int bible_screen_start_pos(const BibleScreen *screen);
+// Show [screen] again, once its chapter is back in the bible store. Returns false if the window's width changed
+bool restore_bible_screen(const BibleScreen *screen);
+void free_bible_screen(BibleScreen *screen);
+
 void display_bible_error(const char *error);
 void close_bible(void);
\ No newline at end of file
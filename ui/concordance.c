@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ncurses.h>
+#include "../components/list-view.h"
+#include "../util/db.h"
+#include "concordance.h"
+
+// Books (and how many verses use the word) on the left, the verses on the right
+#define BOOKS_WIDTH 24
+// Enough for most references e.g. "1 Thessalonians 5:28"
+#define REFERENCE_WIDTH 22
+
+static bible_concordance *concordance = NULL;
+static bible_conn *conn = NULL;
+// Long name of each book of [concordance]
+static char (*bookNames)[40] = NULL;
+
+// Number of characters (not bytes) in [length] bytes of UTF-8
+static int columns_of(const char *str, size_t length)
+{
+    int columns = 0;
+    for (size_t i = 0; i < length; i++)
+        if (((unsigned char) str[i] & 0xC0) != 0x80)
+            columns++;
+
+    return columns;
+}
+
+// Book (index in [concordance->books]) of verse [index]
+static size_t book_of(size_t index)
+{
+    size_t low = 0, high = concordance->bookCount;
+    while (high - low > 1)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (concordance->books[mid].first <= index)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+static void draw_book(WINDOW *win, size_t index, int width, void *data)
+{
+    (void) data;
+    int y = getcury(win);
+
+    lv_print_clipped(win, bookNames[index], width - 7);
+    wmove(win, y, width - 7);
+    wprintw(win, "%6zu", concordance->books[index].count);
+}
+
+// Keyword in context: the reference, then the verse with the word in the middle
+static void draw_verse(WINDOW *win, size_t index, int width, void *data)
+{
+    (void) data;
+    bible_ref verseRef = concordance->refs[index];
+    int chapter = BIBLE_REF_CHAPTER(verseRef), verse = BIBLE_REF_VERSE(verseRef);
+    int y = getcury(win);
+
+    char reference[64];
+    snprintf(reference, sizeof(reference), "%s %i:%i", bookNames[book_of(index)], chapter, verse);
+    lv_print_clipped(win, reference, REFERENCE_WIDTH - 1);
+
+    int context = width - REFERENCE_WIDTH;
+    if (context <= 0)
+        return;
+
+	// Only the verses on screen are read (from the connection's cache)
+    bible_passage *passage = bible_get_passage(conn, verseRef, verseRef);
+    if (passage == NULL)
+        return;
+
+    size_t size = strlen(passage->verses[0].text) + 1;
+    char *plain = malloc(size);
+    bible_strip_tags(passage->verses[0].text, plain, size);
+    bible_passage_free(passage);
+
+    size_t length = 0;
+    long offset = bible_word_offset(plain, concordance->positions[index], &length);
+    if (offset < 0)
+        offset = 0;
+
+    int wordColumns = columns_of(&plain[offset], length);
+    int left = (context - wordColumns) / 2;
+    if (left < 0)
+        left = 0;
+
+	// As much of the text before the word as fits, lined up against it
+    const char *from = &plain[offset];
+    for (int columns = 0; from > plain && columns < left; )
+        if (((unsigned char) *--from & 0xC0) != 0x80)
+            columns++;
+    while (from < &plain[offset] && ((unsigned char) *from & 0xC0) == 0x80)
+        from++;
+
+    wmove(win, y, REFERENCE_WIDTH + left - columns_of(from, &plain[offset] - from));
+    waddnstr(win, from, &plain[offset] - from);
+
+    wattron(win, A_BOLD);
+    lv_print_clipped(win, &plain[offset], (wordColumns < context) ? wordColumns : context);
+    wattroff(win, A_BOLD);
+
+    if (left + wordColumns < context)
+        lv_print_clipped(win, &plain[offset + length], context - left - wordColumns);
+
+    free(plain);
+}
+
+static void draw_header(WINDOW *header, const char *word, const char *status)
+{
+    werase(header);
+
+    wattron(header, A_BOLD);
+    mvwprintw(header, 0, 0, "%s", word);
+    wattroff(header, A_BOLD);
+    wprintw(header, " (%s)  %s", bible_conn_translation(conn), status);
+    mvwprintw(header, 1, 0, "[TAB] switches between books and verses, [ENTER] opens a verse, [ESC] goes back");
+
+    wrefresh(header);
+}
+
+bool concordance_open(const char *word, bible_ref *ref)
+{
+    int w = COLS - 2, h = LINES - 3;
+    conn = db_connection();
+    if (h < 3 || w < BOOKS_WIDTH + REFERENCE_WIDTH + 10 || conn == NULL)
+        return false;
+
+	// (The empty third line clears the bible text above the lists)
+    WINDOW *header = newwin(3, w, 0, 1);
+    keypad(header, true);
+    draw_header(header, word, "Looking it up...");
+
+	// The word index is shared with --query (and built the first time)
+    concordance = bible_concordance_get(db_context(), word, bible_conn_translation(conn));
+    if (concordance == NULL)
+    {
+        draw_header(header, word, "isn't in this translation. Press any key to go back");
+        wgetch(header);
+        delwin(header);
+        return false;
+    }
+
+    bookNames = malloc(concordance->bookCount * sizeof(*bookNames));
+    for (size_t b = 0; b < concordance->bookCount; b++)
+        if (!bible_book_name(conn, concordance->books[b].book, bookNames[b], sizeof(bookNames[b])))
+            snprintf(bookNames[b], sizeof(bookNames[b]), "%s", bible_book_title(concordance->books[b].book));
+
+    char status[128];
+    snprintf(status, sizeof(status), "%zu verse%s, used %zu time%s in %zu book%s",
+        concordance->count, (concordance->count == 1) ? "" : "s",
+        concordance->occurrences, (concordance->occurrences == 1) ? "" : "s",
+        concordance->bookCount, (concordance->bookCount == 1) ? "" : "s");
+    draw_header(header, word, status);
+
+    ListView *books = lv_new((Rect) { .w = BOOKS_WIDTH, .h = h - 3, .x = 1, .y = 3 }, &draw_book, NULL);
+    ListView *verses = lv_new((Rect) { .w = w - BOOKS_WIDTH, .h = h - 3, .x = BOOKS_WIDTH + 1, .y = 3 }, &draw_verse, NULL);
+    lv_set_count(books, concordance->bookCount);
+    lv_set_count(verses, concordance->count);
+    lv_draw(books);
+    lv_draw(verses);
+
+    ListView *focus = verses;
+    bool picked = false;
+
+    int c;
+    while (!picked && (c = wgetch(header)) != 27 /* escape */)
+    {
+        if (c == '\t' || c == KEY_BTAB)
+            focus = (focus == verses) ? books : verses;
+
+        else if (c == '\n' || c == KEY_ENTER)
+        {
+            if (focus == books)
+                focus = verses;
+            else if (concordance->count > 0)
+            {
+                *ref = concordance->refs[verses->selected];
+                picked = *ref != 0;
+            }
+        }
+
+        else if (lv_handle_key(focus, c))
+        {
+			// Keep the other list in step
+            if (focus == books)
+            {
+                verses->top = concordance->books[books->selected].first;
+                lv_select(verses, verses->top);
+                lv_draw(verses);
+            }
+            else if (book_of(verses->selected) != books->selected)
+            {
+                lv_select(books, book_of(verses->selected));
+                lv_draw(books);
+            }
+        }
+    }
+
+    lv_free(books);
+    lv_free(verses);
+    delwin(header);
+
+    free(bookNames);
+    bookNames = NULL;
+    bible_concordance_free(concordance);
+    concordance = NULL;
+
+    return picked;
+}
@@ -0,0 +1,7 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "../libbible/bible.h"
+
+// Show every verse of the open translation with [word] in it, with the word in the middle of each line
+// Returns true and sets [ref] if a verse was picked, false if cancelled
+bool concordance_open(const char *word, bible_ref *ref);
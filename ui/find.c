@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include <ncurses.h>
+#include "bible-display.h"
+#include "find.h"
+
+#define MAX_FIND 60
+
+static char query[MAX_FIND + 1];
+static size_t queryLength = 0;
+
+static void draw_prompt(WINDOW *prompt, size_t count)
+{
+    werase(prompt);
+    wattron(prompt, A_REVERSE);
+    mvwhline(prompt, 0, 0, ' ', getmaxx(prompt));
+    mvwprintw(prompt, 0, 0, "Find: %s", query);
+
+    int y, x;
+    getyx(prompt, y, x);
+    if (queryLength > 0)
+        wprintw(prompt, "   %zu match%s", count, (count == 1) ? "" : "es");
+    wattroff(prompt, A_REVERSE);
+
+	// Keep the cursor after the query
+    wmove(prompt, y, x);
+    wrefresh(prompt);
+}
+
+bool find_open(void)
+{
+	// Over the last line of the bible text
+    WINDOW *prompt = newwin(1, COLS - 2, LINES - 4, 1);
+    if (prompt == NULL)
+        return false;
+    keypad(prompt, true);
+    curs_set(TRUE);
+
+	// Start from the last query
+    size_t count = find_in_bible(query);
+    draw_prompt(prompt, count);
+
+    int c;
+    while ((c = wgetch(prompt)) != 27 /* escape */ && c != '\n' && c != KEY_ENTER)
+    {
+        if (c == KEY_BACKSPACE || c == 127 || c == '\b')
+        {
+            if (queryLength == 0)
+                continue;
+			// Remove a whole UTF-8 character
+            while (queryLength > 1 && ((unsigned char) query[queryLength - 1] & 0xC0) == 0x80)
+                queryLength--;
+            query[--queryLength] = '\0';
+        }
+
+        else if (c >= ' ' && c < KEY_MIN && queryLength < MAX_FIND)
+        {
+            query[queryLength++] = c;
+            query[queryLength] = '\0';
+        }
+
+        else
+            continue;
+
+        count = find_in_bible(query);
+        draw_prompt(prompt, count);
+    }
+
+    curs_set(FALSE);
+    delwin(prompt);
+
+    if (c == 27 || count == 0)
+    {
+        end_find_in_bible();
+		// Bring back the line under the prompt
+        display_bible(0);
+        return false;
+    }
+
+    display_bible(0);
+    return true;
+}
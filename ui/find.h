@@ -0,0 +1,5 @@
+#include <stdbool.h>
+
+// Ask for text to find in the chapter (opened with Ctrl-F), highlighting matches as it's typed
+// Returns true if there are matches to go through with n/N, false if cancelled
+bool find_open(void);
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../util/db.h"
+#include "../util/store.h"
+#include "bible-display.h"
+#include "translation-selection.h"
+#include "history.h"
+
+// Places jumped to, oldest first, in a ring of the last HISTORY_SIZE
+//
+// The last few places left keep their screen (the chapter as it was laid out, and the bible store it came
+// from), so going back to one shows it again at once: nothing is read from the db or laid out again.
+// Between sessions only the places are kept (see history_close())
+
+#define HISTORY_SIZE 100
+// How many places keep their screen
+#define KEPT_SCREENS 16
+
+typedef struct
+{
+    bible_ref ref;
+    char translation[64];
+    // Row at the top of the window
+    int startPos;
+
+    // What was on screen when it was left (NULL if it isn't kept)
+    BibleScreen *screen;
+    char *store;
+    size_t storeLength;
+    float minutes;
+    // When it was left, to forget the screens of the places left longest ago
+    unsigned long left;
+} Place;
+
+static Place places[HISTORY_SIZE];
+static size_t first = 0, count = 0, current = 0;
+static unsigned long leaveCount = 0;
+
+// ---- Stored history ----
+//
+// A header, the translations the places are in, then 8 bytes a place, replaced whole like .bibleState
+
+static const char historyPath[] = ".bibleHistory";
+#define HISTORY_MAGIC "BHS2"
+
+typedef struct
+{
+    char magic[4];
+    uint16_t count, current;
+    // Names (char[64] each) after the header
+    uint16_t translationCount, reserved;
+} HistoryHeader;
+
+typedef struct
+{
+    bible_ref ref;
+    uint16_t translation, startPos;
+} StoredPlace;
+
+// Header, names and places, then the FNV-1a of them
+#define MAX_HISTORY_FILE (sizeof(HistoryHeader) + HISTORY_SIZE * (64 + sizeof(StoredPlace)) + sizeof(uint32_t))
+
+static Place *place_at(size_t i)
+{
+    return &places[(first + i) % HISTORY_SIZE];
+}
+
+static uint32_t checksum(const unsigned char *bytes, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    return hash;
+}
+
+static void forget_screen(Place *place)
+{
+    free_bible_screen(place->screen);
+    free(place->store);
+    place->screen = NULL, place->store = NULL;
+}
+
+void history_load(void)
+{
+    int fd = open(historyPath, O_RDONLY);
+    if (fd == -1)
+        return;
+
+    static unsigned char file[MAX_HISTORY_FILE];
+    ssize_t length = read(fd, file, sizeof(file));
+    close(fd);
+
+    HistoryHeader header;
+    if (length < (ssize_t) (sizeof(header) + sizeof(uint32_t)))
+        return;
+    memcpy(&header, file, sizeof(header));
+
+    size_t namesStart = sizeof(header), placesStart = namesStart + header.translationCount * 64;
+    size_t end = placesStart + header.count * sizeof(StoredPlace);
+    uint32_t stored;
+    if (memcmp(header.magic, HISTORY_MAGIC, sizeof(header.magic)) != 0 || header.count > HISTORY_SIZE
+        || header.translationCount > HISTORY_SIZE || header.current >= header.count
+        || (size_t) length != end + sizeof(stored))
+        return;
+
+    memcpy(&stored, &file[end], sizeof(stored));
+    if (stored != checksum(file, end))
+        return;
+
+    for (size_t i = 0; i < header.count; i++)
+    {
+        StoredPlace storedPlace;
+        memcpy(&storedPlace, &file[placesStart + i * sizeof(storedPlace)], sizeof(storedPlace));
+        if (storedPlace.translation >= header.translationCount)
+            continue;
+
+        Place *place = &places[count++];
+        *place = (Place) { .ref = storedPlace.ref, .startPos = storedPlace.startPos };
+        snprintf(place->translation, sizeof(place->translation), "%.63s", (const char*) &file[namesStart + storedPlace.translation * 64]);
+    }
+
+    current = (header.current < count) ? header.current : (count > 0) ? count - 1 : 0;
+}
+
+static void save_history(void)
+{
+    static unsigned char file[MAX_HISTORY_FILE];
+    HistoryHeader header = { .magic = HISTORY_MAGIC, .count = count, .current = current };
+
+	// Each translation's name once
+    size_t namesStart = sizeof(header);
+    uint16_t translations[HISTORY_SIZE];
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *name = place_at(i)->translation;
+        uint16_t t = 0;
+        while (t < header.translationCount && strncmp((const char*) &file[namesStart + t * 64], name, 64) != 0)
+            t++;
+
+        if (t == header.translationCount)
+        {
+            memset(&file[namesStart + t * 64], 0, 64);
+            memcpy(&file[namesStart + t * 64], name, strnlen(name, 63));
+            header.translationCount++;
+        }
+        translations[i] = t;
+    }
+
+    size_t length = namesStart + header.translationCount * 64;
+    for (size_t i = 0; i < count; i++, length += sizeof(StoredPlace))
+    {
+        int startPos = place_at(i)->startPos;
+        StoredPlace storedPlace = { .ref = place_at(i)->ref, .translation = translations[i],
+            .startPos = (startPos < UINT16_MAX) ? startPos : UINT16_MAX };
+        memcpy(&file[length], &storedPlace, sizeof(storedPlace));
+    }
+    memcpy(file, &header, sizeof(header));
+
+    uint32_t sum = checksum(file, length);
+    memcpy(&file[length], &sum, sizeof(sum));
+    length += sizeof(sum);
+
+    replace_file(historyPath, file, length);
+}
+
+void history_leave(void)
+{
+    if (count == 0)
+        return;
+
+    Place *place = place_at(current);
+    place->startPos = bible_start_pos();
+
+    forget_screen(place);
+    place->screen = save_bible_screen();
+    place->store = copy_bible_store(&place->storeLength, &place->minutes);
+    if (place->screen == NULL || place->store == NULL)
+    {
+        forget_screen(place);
+        return;
+    }
+    place->left = ++leaveCount;
+
+	// Forget the screen left longest ago, if there are too many
+    size_t kept = 0, oldest = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        Place *other = place_at(i);
+        if (other->screen == NULL)
+            continue;
+
+        if (kept++ == 0 || other->left < place_at(oldest)->left)
+            oldest = i;
+    }
+    if (kept > KEPT_SCREENS)
+        forget_screen(place_at(oldest));
+}
+
+void history_update(bible_ref ref)
+{
+    if (count == 0)
+        return;
+
+    Place *place = place_at(current);
+    place->ref = ref;
+    snprintf(place->translation, sizeof(place->translation), "%s", bible_conn_translation(db_connection()));
+    forget_screen(place);
+}
+
+void history_push(bible_ref ref)
+{
+	// Still in the same chapter (e.g. the place the last session ended)
+    const char *translation = bible_conn_translation(db_connection());
+    if (count > 0 && strcmp(place_at(current)->translation, translation) == 0
+        && BIBLE_REF_BOOK(place_at(current)->ref) == BIBLE_REF_BOOK(ref)
+        && BIBLE_REF_CHAPTER(place_at(current)->ref) == BIBLE_REF_CHAPTER(ref))
+    {
+        history_update(ref);
+        return;
+    }
+
+	// Going somewhere new forgets where going back came from
+    while (count > 0 && count > current + 1)
+        forget_screen(place_at(--count));
+
+	// The ring is full: forget the oldest place
+    if (count == HISTORY_SIZE)
+    {
+        forget_screen(place_at(0));
+        first = (first + 1) % HISTORY_SIZE;
+        count--;
+    }
+
+    current = count++;
+    Place *place = place_at(current);
+    *place = (Place) { .ref = ref, .startPos = 1 };
+    snprintf(place->translation, sizeof(place->translation), "%s", translation);
+}
+
+bool history_go(int direction, bible_ref *ref)
+{
+    if (count == 0 || (direction < 0 && current < (size_t) -direction) || current + direction >= count)
+        return false;
+
+    history_leave();
+    size_t previous = current;
+    current += direction;
+    Place *place = place_at(current);
+
+	// The place's own translation (it may have been removed)
+    if (strcmp(bible_conn_translation(db_connection()), place->translation) != 0)
+        select_translation(place->translation);
+    bool sameTranslation = strcmp(bible_conn_translation(db_connection()), place->translation) == 0;
+
+	// Shown again as it was, or the chapter stored again if it isn't kept (or is of another translation now)
+    if (sameTranslation && place->store != NULL && restore_bible_store(place->store, place->storeLength, place->minutes))
+    {
+        keep_stored_verse(place->ref);
+        if (restore_bible_screen(place->screen))
+        {
+            *ref = place->ref;
+            return true;
+        }
+    }
+    else if (!store_bible_text(place->ref))
+    {
+        current = previous;
+        return false;
+    }
+
+    set_bible_start_pos(place->startPos);
+    display_bible(0);
+
+    *ref = place->ref;
+    return true;
+}
+
+void history_close(void)
+{
+    if (count > 0)
+    {
+		// Where the last place was scrolled to
+        place_at(current)->startPos = bible_start_pos();
+        save_history();
+    }
+
+    for (size_t i = 0; i < count; i++)
+        forget_screen(place_at(i));
+    first = count = current = 0;
+}
@@ -0,0 +1,18 @@
+#include <stdbool.h>
+#include "../libbible/bible.h"
+
+// Places jumped to (by search, a reference, a chapter...), to go back and forward between with Shift-Left/Right
+
+// Read the history of the last session
+void history_load(void);
+// Keep the place being left (how far it's scrolled and what's on screen), before jumping somewhere else
+void history_leave(void);
+// [ref] of the open translation was jumped to (forgetting the places after the current one)
+void history_push(bible_ref ref);
+// The current place moved to [ref] without jumping e.g. to the next chapter, another verse or translation
+void history_update(bible_ref ref);
+// Go to the place before ([direction] < 0) or after the current one, and show it (as it was, if it's one of
+// the last few). Sets [ref] to its verse, and returns false if there's no such place or it couldn't be shown
+bool history_go(int direction, bible_ref *ref);
+// Save the history for the next session, and free it
+void history_close(void);
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <ncurses.h>
+#include "../components/list-view.h"
+#include "../util/db.h"
+#include "outline.h"
+
+#define MAX_TYPED 40
+
+static bible_outline outline;
+// Sections of the book (or the Bible) that's shown: [first, last)
+static size_t first = 0, last = 0;
+static bool wholeBible = false;
+static char book[40];
+
+// Sections matching [typed] (indexes in [outline]), best first
+typedef struct
+{
+    size_t index;
+    int score;
+} Shown;
+
+static Shown *shown = NULL;
+static size_t shownCount = 0;
+static char typed[MAX_TYPED + 1];
+static size_t typedLength = 0;
+
+// How well [title] matches [typed], whose letters (ignoring case and spaces) have to be in it in that order
+// Letters starting words and following each other count most, letters far apart least. -1 if it doesn't match
+static int fuzzy_score(const char *title, const char *typed)
+{
+    int score = 0;
+    const char *previous = NULL;
+
+    for (; *typed != '\0'; typed++)
+    {
+        if (*typed == ' ')
+            continue;
+
+        const char *at = (previous != NULL) ? previous + 1 : title;
+        while (*at != '\0' && tolower((unsigned char) *at) != tolower((unsigned char) *typed))
+            at++;
+        if (*at == '\0')
+            return -1;
+
+        if (at == title || !isalnum((unsigned char) at[-1]))
+            score += 8;
+        if (previous != NULL && at == previous + 1)
+            score += 4;
+        else if (previous != NULL)
+            score -= (at - previous < 10) ? at - previous : 10;
+
+        previous = at;
+    }
+
+    return score;
+}
+
+static int compare_shown(const void *a, const void *b)
+{
+    const Shown *x = a, *y = b;
+    if (x->score != y->score)
+        return y->score - x->score;
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static void filter_sections(void)
+{
+    shownCount = 0;
+    for (size_t i = first; i < last; i++)
+    {
+        int score = fuzzy_score(&outline.text[outline.sections[i].offset], typed);
+        if (score >= 0)
+            shown[shownCount++] = (Shown) { .index = i, .score = score };
+    }
+
+	// In Bible order until something's typed
+    if (typedLength > 0)
+        qsort(shown, shownCount, sizeof(Shown), &compare_shown);
+}
+
+static void draw_section(WINDOW *list, size_t index, int width, void *data)
+{
+    (void) data;
+    const bible_section *section = &outline.sections[shown[index].index];
+    bible_ref ref = section->ref;
+
+	// The book's name too when it's the whole Bible
+    char reference[64], name[40] = "";
+    if (wholeBible && !get_book_name(ref, name, sizeof(name)))
+        snprintf(name, sizeof(name), "%s", bible_book_title(BIBLE_REF_BOOK(ref)));
+    int refLength = snprintf(reference, sizeof(reference), "%s%s%i:%i  ", name, wholeBible ? " " : "",
+        BIBLE_REF_CHAPTER(ref), BIBLE_REF_VERSE(ref));
+
+    wattron(list, A_BOLD);
+    lv_print_clipped(list, reference, width);
+    wattroff(list, A_BOLD);
+
+    if (refLength < width)
+        lv_print_clipped(list, &outline.text[section->offset], width - refLength);
+}
+
+static void draw_outline(WINDOW *header, ListView *list)
+{
+    werase(header);
+    mvwprintw(header, 0, 0, "Sections: %s", typed);
+    if (last == first)
+        mvwprintw(header, 1, 0, "%s has no section titles. [TAB] switches to %s, [ESC] goes back",
+            wholeBible ? "This translation" : book, wholeBible ? book : "the whole Bible");
+    else
+        mvwprintw(header, 1, 0, "%zu of %zu in %s. [TAB] switches to %s, [ENTER] goes there, [ESC] goes back",
+            shownCount, last - first, wholeBible ? "the Bible" : book, wholeBible ? book : "the whole Bible");
+
+    lv_draw(list);
+
+    wmove(header, 0, 10 + typedLength);
+    wrefresh(header);
+}
+
+// Show the sections of the book of [ref] (or every book), starting on the one [ref] is in
+static void show_sections(ListView *list, bible_ref ref)
+{
+    int book = BIBLE_REF_BOOK(ref);
+    first = wholeBible ? 0 : bible_outline_find(&outline, BIBLE_REF(book, 0, 0));
+    last = wholeBible ? outline.count : bible_outline_find(&outline, BIBLE_REF(book + 1, 0, 0));
+
+    filter_sections();
+    lv_set_count(list, shownCount);
+
+	// The last section starting before [ref]
+    size_t current = bible_outline_find(&outline, ref + 1);
+    if (typedLength == 0 && current > first && current <= last)
+        lv_select(list, current - 1 - first);
+}
+
+bool outline_open(bible_ref *ref)
+{
+	// Same area as the bible text: what's typed on top, sections below
+    int w = COLS - 2, h = LINES - 3;
+    bible_conn *conn = db_connection();
+    if (h < 3 || w < 10 || conn == NULL || !bible_outline_get(conn, &outline))
+        return false;
+
+    shown = malloc((outline.count + 1) * sizeof(Shown));
+    if (shown == NULL)
+        return false;
+
+    if (!get_book_name(*ref, book, sizeof(book)))
+        snprintf(book, sizeof(book), "%s", bible_book_title(BIBLE_REF_BOOK(*ref)));
+
+    WINDOW *header = newwin(2, w, 0, 1);
+    keypad(header, true);
+
+    typed[0] = '\0';
+    typedLength = 0;
+
+    ListView *list = lv_new((Rect) { .w = w, .h = h - 2, .x = 1, .y = 2 }, &draw_section, NULL);
+    show_sections(list, *ref);
+
+    curs_set(TRUE);
+    draw_outline(header, list);
+
+    bool picked = false;
+    int c;
+    while (!picked && (c = wgetch(header)) != 27 /* escape */)
+    {
+        if (c == '\n' || c == KEY_ENTER)
+        {
+            if (list->selected < shownCount)
+            {
+                *ref = outline.sections[shown[list->selected].index].ref;
+                picked = true;
+            }
+            continue;
+        }
+
+        else if (c == '\t')
+        {
+            wholeBible = !wholeBible;
+            show_sections(list, *ref);
+            draw_outline(header, list);
+            continue;
+        }
+
+        else if (lv_handle_key(list, c))
+        {
+            draw_outline(header, list);
+            continue;
+        }
+
+        else if ((c == KEY_BACKSPACE || c == 127 || c == '\b') && typedLength > 0)
+            typed[--typedLength] = '\0';
+
+        else if (isprint(c) && typedLength < MAX_TYPED)
+        {
+            typed[typedLength++] = c;
+            typed[typedLength] = '\0';
+        }
+
+        else
+            continue;
+
+        filter_sections();
+        lv_set_count(list, shownCount);
+        draw_outline(header, list);
+    }
+
+    curs_set(FALSE);
+
+    lv_free(list);
+    delwin(header);
+
+    free(shown);
+    shown = NULL, shownCount = 0;
+
+    return picked;
+}
@@ -0,0 +1,7 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "../libbible/bible.h"
+
+// Show the section titles of [ref]'s book (or of the whole Bible, switched with [TAB]), filtered as they're
+// typed (opened with Ctrl-E). Returns true and sets [ref] to the section picked, false if cancelled
+bool outline_open(bible_ref *ref);
@@ -0,0 +1,50 @@
+#include <math.h>
+#include <ncurses.h>
+#include "reading-time.h"
+
+extern unsigned long bibleStoreVersion;
+extern float bibleStoreMinutes;
+
+#define WIDTH 9
+
+static WINDOW *win = NULL;
+static unsigned long shownVersion = 0;
+
+// Setup window inside the right end of the chapter field
+void reading_time(void)
+{
+    // Not if it would cover the chapter number
+    if (COLS / 5 < WIDTH + 6)
+        return;
+
+    win = newwin(1, WIDTH, LINES - 2, COLS / 2 + COLS / 5 - WIDTH - 1);
+}
+
+void show_reading_time(void)
+{
+    if (win == NULL)
+        return;
+
+    if (shownVersion != bibleStoreVersion)
+    {
+        shownVersion = bibleStoreVersion;
+
+        werase(win);
+        // Unknown if the chapter couldn't be counted
+        if (bibleStoreMinutes > 0)
+        {
+            wattron(win, A_DIM);
+            mvwprintw(win, 0, 0, "≈ %i min", (int) fmax(1, roundf(bibleStoreMinutes)));
+            wattroff(win, A_DIM);
+        }
+    }
+
+    touchwin(win);
+    wrefresh(win);
+}
+
+void close_reading_time(void)
+{
+    if (win != NULL)
+        delwin(win);
+}
@@ -0,0 +1,5 @@
+// Estimated reading time of the displayed chapter e.g. "≈ 4 min", at the end of the chapter field
+void reading_time(void);
+// Draw it again (the input fields draw over it), with the time of the chapter stored last
+void show_reading_time(void);
+void close_reading_time(void);
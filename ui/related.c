@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include <ncurses.h>
+#include "../components/list-view.h"
+#include "../util/db.h"
+#include "related.h"
+
+#define MAX_RELATED 50
+
+static bible_results *results = NULL;
+
+static void draw_related(WINDOW *win, size_t index, int width, void *data)
+{
+    (void) data;
+    const bible_hit *hit = &results->hits[index];
+
+    char reference[64];
+    int refLength = snprintf(reference, sizeof(reference), "%s %i:%i  ", hit->book, BIBLE_REF_CHAPTER(hit->ref), BIBLE_REF_VERSE(hit->ref));
+
+    wattron(win, A_BOLD);
+    lv_print_clipped(win, reference, width);
+    wattroff(win, A_BOLD);
+
+    if (refLength < width)
+        lv_print_clipped(win, hit->text, width - refLength);
+}
+
+bool related_open(bible_ref *ref)
+{
+	// Bottom half of the bible text, so the chapter stays in view
+    int w = COLS - 2, h = (LINES - 3) / 2;
+    bible_conn *conn = db_connection();
+    if (h < 3 || conn == NULL)
+        return false;
+
+    WINDOW *header = newwin(1, w, LINES - 3 - h, 1);
+    keypad(header, true);
+
+    char book[40], title[128];
+    if (!bible_book_name(conn, BIBLE_REF_BOOK(*ref), book, sizeof(book)))
+        snprintf(book, sizeof(book), "%s", bible_book_title(BIBLE_REF_BOOK(*ref)));
+    snprintf(title, sizeof(title), "Related to %s %i:%i", book, BIBLE_REF_CHAPTER(*ref), BIBLE_REF_VERSE(*ref));
+    wattron(header, A_REVERSE);
+    mvwhline(header, 0, 0, ' ', w);
+    mvwprintw(header, 0, 0, "%s (finding them...)", title);
+    wrefresh(header);
+
+	// The first time builds the translation's matrix
+    results = bible_related(conn, *ref, MAX_RELATED);
+
+    mvwhline(header, 0, 0, ' ', w);
+    if (results == NULL || results->count == 0)
+        mvwprintw(header, 0, 0, "%s: nothing found. Press any key to go back", title);
+    else
+        mvwprintw(header, 0, 0, "%s. [ENTER] opens a verse, [ESC] goes back", title);
+    wattroff(header, A_REVERSE);
+    wrefresh(header);
+
+    ListView *list = lv_new((Rect) { .w = w, .h = h - 1, .x = 1, .y = LINES - 3 - h + 1 }, &draw_related, NULL);
+    lv_set_count(list, (results != NULL) ? results->count : 0);
+    lv_draw(list);
+
+    bool picked = false;
+    int c;
+    while (list->count > 0 && !picked && (c = wgetch(header)) != 27 /* escape */)
+    {
+        if (c == '\n' || c == KEY_ENTER)
+        {
+            const bible_hit *hit = &results->hits[list->selected];
+            *ref = hit->ref;
+            picked = *ref != 0;
+        }
+        else
+            lv_handle_key(list, c);
+    }
+
+    if (list->count == 0)
+        wgetch(header);
+
+    lv_free(list);
+    delwin(header);
+
+    bible_results_free(results);
+    results = NULL;
+
+    return picked;
+}
@@ -0,0 +1,7 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "../libbible/bible.h"
+
+// Show the verses most like [ref] in a panel under the bible text (opened with Ctrl-R)
+// Returns true and sets [ref] if one was picked, false if cancelled
+bool related_open(bible_ref *ref);
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <ncurses.h>
+#include "../components/list-view.h"
+#include "../util/db.h"
+#include "search.h"
+
+#define MAX_QUERY 100
+#define MAX_RESULTS 500
+
+// Searches run on a worker with its own connection, so typing never waits for a query
+// Every keystroke cancels the search in progress and queues the new query
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bible_conn *conn;
+
+	// Latest query typed (query number [wanted])
+    char query[MAX_QUERY + 1];
+    unsigned long wanted;
+    volatile int cancel;
+    bool quit;
+
+	// Latest finished search (query number [finished]), only freed by the worker
+    bible_results *results;
+    char resultsQuery[MAX_QUERY + 1];
+    unsigned long finished;
+} Searcher;
+
+static Searcher searcher = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
+
+static WINDOW *header = NULL;
+static char query[MAX_QUERY + 1];
+static size_t queryLength = 0;
+
+static void *search_worker(void *arg)
+{
+    (void) arg;
+
+	// Build the index (if needed) before the first keystroke
+    bible_search_index(searcher.conn);
+
+    pthread_mutex_lock(&searcher.lock);
+    while (!searcher.quit)
+    {
+        if (searcher.finished == searcher.wanted)
+        {
+            pthread_cond_wait(&searcher.wake, &searcher.lock);
+            continue;
+        }
+
+        unsigned long number = searcher.wanted;
+        char current[MAX_QUERY + 1];
+        strcpy(current, searcher.query);
+        searcher.cancel = 0;
+        pthread_mutex_unlock(&searcher.lock);
+
+        bible_results *results = NULL;
+
+		// ~ at the start allows typos
+        if (current[0] == '~')
+            results = bible_search_fuzzy(searcher.conn, &current[1], 0, MAX_RESULTS, &searcher.cancel);
+
+		// If more was typed, filter the last results instead of searching again
+        else if (current[0] != '\0' && searcher.resultsQuery[0] != '~')
+            results = bible_search_refine(searcher.results, searcher.resultsQuery, current);
+
+        if (results == NULL && current[0] != '\0' && current[0] != '~')
+            results = bible_search_cancellable(searcher.conn, current, MAX_RESULTS, &searcher.cancel);
+
+        pthread_mutex_lock(&searcher.lock);
+
+		// A newer query stopped this one
+        if (results == NULL && searcher.cancel)
+            continue;
+
+        bible_results *old = searcher.results;
+        searcher.results = results;
+        strcpy(searcher.resultsQuery, current);
+        searcher.finished = number;
+
+		// The screen only reads results with the lock held
+        pthread_mutex_unlock(&searcher.lock);
+        bible_results_free(old);
+        pthread_mutex_lock(&searcher.lock);
+    }
+    pthread_mutex_unlock(&searcher.lock);
+
+    return NULL;
+}
+
+// Queue the current query (and stop the one being searched)
+static void search_query(void)
+{
+    pthread_mutex_lock(&searcher.lock);
+    strcpy(searcher.query, query);
+    searcher.wanted++;
+    searcher.cancel = 1;
+    pthread_cond_signal(&searcher.wake);
+    pthread_mutex_unlock(&searcher.lock);
+}
+
+static bool start_searcher(void)
+{
+    bible_conn *conn = db_connection();
+    if (conn == NULL)
+        return false;
+
+    searcher.conn = bible_conn_open(db_context(), bible_conn_translation(conn));
+    if (searcher.conn == NULL)
+        return false;
+
+    searcher.quit = false;
+    searcher.wanted = 0, searcher.finished = 0;
+    searcher.results = NULL;
+    searcher.resultsQuery[0] = '\0';
+
+    if (pthread_create(&searcher.thread, NULL, &search_worker, NULL) != 0)
+    {
+        bible_conn_close(searcher.conn);
+        return false;
+    }
+
+    return true;
+}
+
+static void stop_searcher(void)
+{
+    pthread_mutex_lock(&searcher.lock);
+    searcher.quit = true;
+    searcher.cancel = 1;
+    pthread_cond_signal(&searcher.wake);
+    pthread_mutex_unlock(&searcher.lock);
+
+    pthread_join(searcher.thread, NULL);
+
+    bible_results_free(searcher.results);
+    searcher.results = NULL;
+    bible_conn_close(searcher.conn);
+}
+
+static void draw_hit(WINDOW *win, size_t index, int width, void *data)
+{
+    (void) data;
+    const bible_hit *hit = &searcher.results->hits[index];
+
+    char reference[64];
+    int refLength = snprintf(reference, sizeof(reference), "%s %i:%i  ", hit->book, BIBLE_REF_CHAPTER(hit->ref), BIBLE_REF_VERSE(hit->ref));
+
+    wattron(win, A_BOLD);
+    lv_print_clipped(win, reference, width);
+    wattroff(win, A_BOLD);
+
+    if (refLength < width)
+        lv_print_clipped(win, hit->text, width - refLength);
+}
+
+// Put the cursor at the end of the query
+static void move_cursor(void)
+{
+    int columns = 0;
+	// Count characters, not bytes (UTF-8 continuation bytes start with 10xxxxxx)
+    for (size_t i = 0; i < queryLength; i++)
+        if (((unsigned char) query[i] & 0xC0) != 0x80)
+            columns++;
+
+    wmove(header, 0, 8 + columns);
+    wrefresh(header);
+}
+
+static void draw_header(const char *status)
+{
+    werase(header);
+
+    mvwprintw(header, 0, 0, "Search: %s", query);
+    mvwprintw(header, 1, 0, "%s", status);
+
+    move_cursor();
+}
+
+// Show the latest results (with the searcher locked)
+static void draw_results(ListView *list)
+{
+    char status[128];
+    const bible_results *results = searcher.results;
+
+    if (queryLength == 0)
+        snprintf(status, sizeof(status), "Type words to search for (~ first allows typos). [ENTER] opens a result, [ESC] goes back");
+    else if (searcher.finished != searcher.wanted)
+        snprintf(status, sizeof(status), "Searching...");
+    else if (results == NULL)
+        snprintf(status, sizeof(status), "Nothing to search for");
+    else
+        snprintf(status, sizeof(status), "%zu result%s%s", results->count,
+            (results->count == 1) ? "" : "s", results->truncated ? " (showing the best ones)" : "");
+
+    lv_draw(list);
+    draw_header(status);
+}
+
+bool search_open(bible_ref *ref)
+{
+	// Same area as the bible text: query and status on top, results below
+    int w = COLS - 2, h = LINES - 3;
+    if (h < 3 || w < 10 || !start_searcher())
+        return false;
+
+    header = newwin(2, w, 0, 1);
+    keypad(header, true);
+	// Check for results while waiting for keys
+    wtimeout(header, 30);
+
+    ListView *list = lv_new((Rect) { .w = w, .h = h - 2, .x = 1, .y = 2 }, &draw_hit, NULL);
+    unsigned long shown = 0;
+    bool picked = false;
+
+    curs_set(TRUE);
+
+	// Search again for the last query
+    if (queryLength > 0)
+        search_query();
+
+    pthread_mutex_lock(&searcher.lock);
+    draw_results(list);
+    pthread_mutex_unlock(&searcher.lock);
+
+    int c;
+    while ((c = wgetch(header)) != 27 /* escape */)
+    {
+        pthread_mutex_lock(&searcher.lock);
+
+        if (c == ERR)
+        {
+			// New results
+            if (shown != searcher.finished)
+            {
+                shown = searcher.finished;
+                lv_set_count(list, (searcher.results != NULL) ? searcher.results->count : 0);
+                draw_results(list);
+            }
+        }
+
+		// Go to the selected result
+        else if (c == '\n' || c == KEY_ENTER)
+        {
+            if (searcher.results != NULL && list->selected < searcher.results->count)
+            {
+                const bible_hit *hit = &searcher.results->hits[list->selected];
+
+                *ref = hit->ref;
+                picked = *ref != 0;
+            }
+        }
+
+        else if (lv_handle_key(list, c))
+        {
+			// Keep the cursor in the query
+            move_cursor();
+        }
+
+        else if (c == KEY_BACKSPACE || c == 127 || c == '\b')
+        {
+            if (queryLength > 0)
+            {
+				// Remove a whole UTF-8 character
+                while (queryLength > 1 && ((unsigned char) query[queryLength - 1] & 0xC0) == 0x80)
+                    queryLength--;
+                query[--queryLength] = '\0';
+            }
+        }
+
+        else if (c >= ' ' && c < KEY_MIN && queryLength < MAX_QUERY)
+        {
+            query[queryLength++] = c;
+            query[queryLength] = '\0';
+        }
+
+        pthread_mutex_unlock(&searcher.lock);
+
+        if (picked)
+            break;
+
+		// The query changed
+        if (c != ERR && strcmp(query, searcher.query) != 0)
+        {
+            search_query();
+            draw_header("Searching...");
+        }
+    }
+
+    curs_set(FALSE);
+
+    lv_free(list);
+    delwin(header);
+    header = NULL;
+
+    stop_searcher();
+
+    return picked;
+}
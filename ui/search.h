@@ -0,0 +1,7 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "../libbible/bible.h"
+
+// Let the user search the open translation (opened with '/')
+// Returns true and sets [ref] if a result was picked, false if cancelled
+bool search_open(bible_ref *ref);
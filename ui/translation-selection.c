@@ -1,43 +1,63 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <ncurses.h>
+#include "../components/list-view.h"
 #include "../util/store.h"
 #include "../util/db.h"
 #include "translation-selection.h"
 #include "bible-display.h"
 
+#define MAX_TYPED 40
+
 WINDOW *win;
 int currTranslation = 0;
 
-// Setup window and show first translation
-void translation_selection(void)
+// Translations shown in the picker (indexes in db_context()), and what's typed to filter them
+static size_t *shown = NULL, shownCount = 0;
+static char typed[MAX_TYPED + 1];
+static size_t typedLength = 0;
+
+// Show the name of the current translation, right-aligned in the space after the verse field
+static void draw_translation_name(void)
 {
-    win = newwin(1, 5, LINES - 2, COLS - 5);
-    keypad(win, true);
+    int w = getmaxx(win);
+    const char *name = get_translation(currTranslation);
+    int length = strlen(name);
 
-    wprintw(win, "%s", get_translation(0));
+    werase(win);
+    if (length > w)
+        mvwprintw(win, 0, 0, "%.*s~", w - 1, name);
+    else
+        mvwprintw(win, 0, w - length, "%s", name);
     wrefresh(win);
 }
 
-void change_translation(bool next)
+// Setup window and show the current translation
+void translation_selection(int current)
 {
-    wclear(win), wmove(win, 0, 0);
+    currTranslation = current;
 
-    int maxIndex = get_translations() - 1;
+	// Everything right of the input fields (see main.c)
+    int w = COLS - (COLS / 2 + 2 * (COLS / 5) + 2);
+    if (w < 5)
+        w = 5;
+    win = newwin(1, w, LINES - 2, COLS - w);
+    keypad(win, true);
 
-    currTranslation += (next ? 1 : -1);
-    if (currTranslation > maxIndex)
-	{
-        currTranslation = 0;
-	}
+	// Start watching the db folder for new translations
+    update_translations();
 
-    else if (currTranslation < 0)
-	{
-        currTranslation = maxIndex;
-	}
+    draw_translation_name();
+}
+
+static void switch_translation(int index)
+{
+    currTranslation = index;
+    draw_translation_name();
 
-    wprintw(win, "%s", get_translation(currTranslation));
-    wrefresh(win);
-    
 	// Open db of current translation
     if (open_bible_db(currTranslation) == false)
 	{
@@ -46,7 +66,203 @@ void change_translation(bool next)
 	}
 }
 
+void change_translation(bool next)
+{
+    update_translations();
+
+    int count = get_translations();
+    if (count == 0)
+        return;
+
+	// Skipping the ones removed from the db folder
+    int index = currTranslation;
+    for (int tries = 0; tries < count; tries++)
+    {
+        index = (index + (next ? 1 : -1) + count) % count;
+        if (!(bible_translation(db_context(), index)->flags & BIBLE_TRANSLATION_REMOVED))
+            break;
+    }
+
+    switch_translation(index);
+}
+
+bool select_translation(const char *name)
+{
+    update_translations();
+
+    int index = bible_translation_index(db_context(), name);
+    if (index < 0 || (bible_translation(db_context(), index)->flags & BIBLE_TRANSLATION_REMOVED))
+        return false;
+
+    switch_translation(index);
+    return true;
+}
+
+// ---- Picker ----
+
+// [text] contains [part] (ignoring case)
+static bool contains(const char *text, const char *part, size_t partLength)
+{
+    for (; *text != '\0'; text++)
+        if (strncasecmp(text, part, partLength) == 0)
+            return true;
+
+    return false;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcasecmp(get_translation(*(const size_t*) a), get_translation(*(const size_t*) b));
+}
+
+// Translations matching [typed]: the ones whose name starts with it, then the others, each by name
+static void filter_translations(void)
+{
+    bible_ctx *ctx = db_context();
+    size_t count = bible_translation_count(ctx);
+
+    free(shown);
+    shown = malloc((count + 1) * sizeof(size_t));
+    shownCount = 0;
+    if (shown == NULL)
+        return;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        size_t start = shownCount;
+        for (size_t i = 0; i < count; i++)
+        {
+            const bible_translation_info *info = bible_translation(ctx, i);
+            if (info->flags & BIBLE_TRANSLATION_REMOVED)
+                continue;
+
+            bool startsWith = strncasecmp(info->name, typed, typedLength) == 0;
+            if ((pass == 0) ? startsWith
+                : !startsWith && (contains(info->name, typed, typedLength)
+                    || contains(info->language, typed, typedLength) || contains(info->description, typed, typedLength)))
+                shown[shownCount++] = i;
+        }
+        qsort(&shown[start], shownCount - start, sizeof(size_t), &compare_names);
+    }
+}
+
+static void draw_info(WINDOW *list, size_t index, int width, void *data)
+{
+    (void) data;
+    const bible_translation_info *info = bible_translation(db_context(), shown[index]);
+
+    char name[80];
+    int nameLength = snprintf(name, sizeof(name), "%c %-10s ", ((int) shown[index] == currTranslation) ? '*' : ' ', info->name);
+
+    wattron(list, A_BOLD);
+    lv_print_clipped(list, name, width);
+    wattroff(list, A_BOLD);
+
+	// Language, description and which testaments it has
+    char details[192];
+    const char *testaments = (info->bookCount == 0) ? "  (no books)"
+        : !(info->flags & BIBLE_TRANSLATION_OLD_TESTAMENT) ? "  (New Testament)"
+        : !(info->flags & BIBLE_TRANSLATION_NEW_TESTAMENT) ? "  (Old Testament)" : "";
+    snprintf(details, sizeof(details), "%-4s %s%s", info->language, info->description, testaments);
+
+    if (nameLength < width)
+        lv_print_clipped(list, details, width - nameLength);
+}
+
+static void draw_picker(WINDOW *header, ListView *list)
+{
+    size_t total = 0;
+    for (int i = 0; i < get_translations(); i++)
+        if (!(bible_translation(db_context(), i)->flags & BIBLE_TRANSLATION_REMOVED))
+            total++;
+
+    werase(header);
+    mvwprintw(header, 0, 0, "Translation: %s", typed);
+    mvwprintw(header, 1, 0, "%zu of %zu. [ENTER] switches to it, [ESC] goes back", shownCount, total);
+
+    lv_draw(list);
+
+    wmove(header, 0, 13 + typedLength);
+    wrefresh(header);
+}
+
+bool pick_translation(void)
+{
+	// Same area as the bible text: what's typed on top, translations below
+    int w = COLS - 2, h = LINES - 3;
+    if (h < 3 || w < 10)
+        return false;
+
+    update_translations();
+
+    WINDOW *header = newwin(2, w, 0, 1);
+    keypad(header, true);
+
+    typed[0] = '\0';
+    typedLength = 0;
+    filter_translations();
+
+    ListView *list = lv_new((Rect) { .w = w, .h = h - 2, .x = 1, .y = 2 }, &draw_info, NULL);
+    lv_set_count(list, shownCount);
+
+	// Start on the current translation
+    for (size_t i = 0; i < shownCount; i++)
+        if ((int) shown[i] == currTranslation)
+            lv_select(list, i);
+
+    curs_set(TRUE);
+    draw_picker(header, list);
+
+    bool picked = false;
+    int c;
+    while (!picked && (c = wgetch(header)) != 27 /* escape */)
+    {
+        if (c == '\n' || c == KEY_ENTER)
+        {
+            if (list->selected < shownCount)
+            {
+                switch_translation(shown[list->selected]);
+                picked = true;
+            }
+            continue;
+        }
+
+        else if (lv_handle_key(list, c))
+        {
+            draw_picker(header, list);
+            continue;
+        }
+
+        else if ((c == KEY_BACKSPACE || c == 127 || c == '\b') && typedLength > 0)
+            typed[--typedLength] = '\0';
+
+        else if (isprint(c) && typedLength < MAX_TYPED)
+        {
+            typed[typedLength++] = c;
+            typed[typedLength] = '\0';
+        }
+
+        else
+            continue;
+
+        filter_translations();
+        lv_set_count(list, shownCount);
+        draw_picker(header, list);
+    }
+
+    curs_set(FALSE);
+
+    lv_free(list);
+    delwin(header);
+
+    free(shown);
+    shown = NULL, shownCount = 0;
+
+    return picked;
+}
+
 void close_translation(void)
 {
     delwin(win);
-}
\ No newline at end of file
+    close_translation_watch();
+}
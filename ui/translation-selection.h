@@ -1,3 +1,11 @@
-void translation_selection(void);
+#include <stdbool.h>
+
+// Show the name of the [current]th translation (the one open)
+void translation_selection(int current);
 void change_translation(bool next);
+// Switch to the translation named [name], returning false if there's none (in the db folder)
+bool select_translation(const char *name);
+// Pick a translation from a list that's filtered as you type (opened with Ctrl-T)
+// Returns true if one was picked (and switched to)
+bool pick_translation(void);
 void close_translation(void);
\ No newline at end of file
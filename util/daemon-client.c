@@ -0,0 +1,198 @@
+// Allows open_memstream to work on MacOS
+#define  _POSIX_C_SOURCE 200809L
+// Peer credentials of sockets (SO_PEERCRED on Linux, getpeereid() on MacOS)
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _DARWIN_C_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "daemon-client.h"
+#include "json.h"
+
+static int daemonFd = -1;
+
+// Where the daemon listens by default, the same for every user of the host
+static const char sharedPath[] = "/tmp/bible-daemon/bible.sock";
+
+const char *daemon_socket_path(void)
+{
+    const char *path = getenv("BIBLE_SOCKET");
+    return (path != NULL && path[0] != '\0') ? path : sharedPath;
+}
+
+bool daemon_socket_dir(const char *path)
+{
+    if (strcmp(path, sharedPath) != 0)
+        return true;
+
+    char dir[sizeof(sharedPath)];
+    snprintf(dir, sizeof(dir), "%s", path);
+    *strrchr(dir, '/') = '\0';
+
+	// Someone else could have made it first (to put their own socket there), so it's checked rather than trusted
+    struct stat info;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+        return false;
+
+    return lstat(dir, &info) == 0 && S_ISDIR(info.st_mode) && info.st_uid == getuid() && (info.st_mode & 022) == 0;
+}
+
+// The process listening on [fd] is the user's, or the owner's of the db folder (e.g. an account serving it to
+// a group of users), so nobody else can pretend to be the daemon and send their own text
+static bool peer_is_trusted(int fd)
+{
+#ifdef SO_PEERCRED
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0)
+        return false;
+    uid_t uid = peer.uid;
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(fd, &uid, &gid) != 0)
+        return false;
+#endif
+
+    struct stat info;
+    return uid == getuid() || (stat("db", &info) == 0 && info.st_uid == uid);
+}
+
+bool daemon_connect(const char *path)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path))
+        return false;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) < 0 || !peer_is_trusted(fd))
+    {
+        close(fd);
+        return false;
+    }
+
+    daemon_disconnect();
+    daemonFd = fd;
+
+    return true;
+}
+
+bool daemon_is_connected(void)
+{
+    return daemonFd >= 0;
+}
+
+void daemon_disconnect(void)
+{
+    if (daemonFd >= 0)
+    {
+        close(daemonFd);
+        daemonFd = -1;
+    }
+}
+
+char *daemon_request(const char *request)
+{
+    if (daemonFd < 0)
+        return NULL;
+
+    size_t len = strlen(request), sent = 0;
+    while (sent < len)
+    {
+        ssize_t n = send(daemonFd, request + sent, len - sent, 0);
+        if (n <= 0)
+        {
+            daemon_disconnect();
+            return NULL;
+        }
+        sent += n;
+    }
+
+    // Read until the end of the response line
+    size_t size = 4096, received = 0;
+    char *response = malloc(size);
+    while (true)
+    {
+        if (received + 1 >= size)
+            response = realloc(response, size *= 2);
+
+        ssize_t n = recv(daemonFd, response + received, size - received - 1, 0);
+        if (n <= 0)
+        {
+            free(response);
+            daemon_disconnect();
+            return NULL;
+        }
+
+        char *newLine = memchr(response + received, '\n', n);
+        received += n;
+        if (newLine != NULL)
+        {
+            *newLine = '\0';
+            return response;
+        }
+    }
+}
+
+bool daemon_get_chapter(const char *translation, const char *book, int chapter,
+    void (*callback)(int verse, const char *text, const char *title, void *data), void *data)
+{
+    if (daemonFd < 0)
+        return false;
+
+    char *request = NULL;
+    size_t requestLen = 0;
+    FILE *out = open_memstream(&request, &requestLen);
+    fputs("{\"id\":0,\"method\":\"chapter\",\"raw\":true,\"titles\":true,\"translation\":", out);
+    json_write_string(out, translation);
+    fputs(",\"book\":", out);
+    json_write_string(out, book);
+    fprintf(out, ",\"chapter\":%i}\n", chapter);
+    fclose(out);
+
+    char *response = daemon_request(request);
+    free(request);
+    if (response == NULL)
+        return false;
+
+    const char *result = json_find(response, "result");
+    const char *verses = (result != NULL) ? json_find(result, "verses") : NULL;
+
+    bool gotten = false;
+    if (verses != NULL)
+    {
+        // Text can't be longer than the response itself
+        size_t bufferSize = strlen(response);
+        char *text = malloc(bufferSize), *title = malloc(bufferSize);
+
+        for (const char *verse = json_array_next(verses); verse != NULL; verse = json_array_next(verse))
+        {
+            double number = 0;
+            if (!json_get_number(verse, "verse", &number) || !json_get_string(verse, "text", text, bufferSize))
+                continue;
+
+            bool hasTitle = json_get_string(verse, "title", title, bufferSize);
+            callback(number, text, hasTitle ? title : NULL, data);
+            gotten = true;
+        }
+
+        free(text);
+        free(title);
+    }
+
+    free(response);
+
+    return gotten;
+}
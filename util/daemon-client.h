@@ -0,0 +1,18 @@
+#include <stdbool.h>
+
+// Socket the daemon listens on: $BIBLE_SOCKET, or /tmp/bible-daemon/bible.sock (shared by the users of the host)
+const char *daemon_socket_path(void);
+// Make the directory of [path] if it's /tmp/bible-daemon. Returns false if it isn't the user's, or others can
+// write to it
+bool daemon_socket_dir(const char *path);
+// Connect to the daemon at [path] (false if there's none, or it's neither run by the user nor by the owner of
+// the db folder)
+bool daemon_connect(const char *path);
+bool daemon_is_connected(void);
+void daemon_disconnect(void);
+// Send a one-line JSON request and wait for its response (must be freed, NULL if the daemon went away)
+char *daemon_request(const char *request);
+// Get a chapter (with tags and titles) from the daemon, calling [callback] on each verse
+// Returns false if the daemon couldn't answer, so the caller can fall back to SQLite
+bool daemon_get_chapter(const char *translation, const char *book, int chapter,
+    void (*callback)(int verse, const char *text, const char *title, void *data), void *data);
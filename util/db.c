@@ -1,363 +1,393 @@
+#include <stdlib.h>
+#include <unistd.h>
 #include "db.h"
 #include "store.h"
-#include <ctype.h>
-#include <ncurses.h>
-
-const char bibleStorePath[] = ".bibleStore";
-
-// SQL queries
-
-static const char maxChapter[] =
-    "SELECT MAX(chapter) FROM verses "
-    "WHERE book_number = "
-        "(SELECT book_number FROM books "
-        "WHERE long_name LIKE ? LIMIT 1)";
-static const char maxVerse[] =
-    "SELECT MAX(verse) FROM verses "
-    "WHERE book_number = "
-        "(SELECT book_number FROM books "
-        "WHERE long_name LIKE ? LIMIT 1) "
-    "AND chapter = ?";
-static const char getBible[] =
-    "SELECT verses.text, books.long_name FROM verses "
-    "JOIN books ON verses.book_number = books.book_number "
-    "WHERE verses.book_number = "
-        "(SELECT book_number FROM books "
-        "WHERE long_name LIKE ? LIMIT 1) "
-    "AND chapter = ? "
-    "ORDER BY verse ASC";
-static const char storyTableExists[] = 
-	"SELECT COUNT(*) FROM sqlite_master "
-	"WHERE type='table' "
-	"AND name='stories'";
-static const char getTitle[] =
-	"SELECT title FROM stories "
-	"WHERE book_number = "
-		"(SELECT book_number FROM books "
-        "WHERE long_name LIKE ? LIMIT 1) "
-	"AND chapter = ? "
-	"AND verse = ? LIMIT 1";
-static const char getBook[] =
-    "SELECT long_name FROM books "
-    "WHERE book_number = "
-        "(SELECT book_number FROM books "
-        "WHERE long_name LIKE ? LIMIT 1)";
-static const char nextBook[] =
-    "SELECT long_name FROM books "
-    "WHERE book_number > "
-        "(SELECT book_number from books "
-        "WHERE long_name LIKE ? LIMIT 1) "
-    "ORDER BY book_number ASC LIMIT 1";
-static const char prevBook[] =
-    "SELECT long_name FROM books "
-    "WHERE book_number < "
-        "(SELECT book_number from books "
-        "WHERE long_name LIKE ? LIMIT 1) "
-    "ORDER BY book_number DESC LIMIT 1";
-
-static bool initialized = false;
-
-static sqlite3 *db = NULL;
+#include "daemon-client.h"
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
-bool open_bible_db(size_t index)
+// The app is a client of libbible, with one open translation at a time
+
+// Made the first time a chapter is stored, so several instances don't share one
+char bibleStorePath[64] = "";
+// Changes whenever a new chapter is stored (so the display knows to lay it out again)
+unsigned long bibleStoreVersion = 0;
+// Estimated reading time of the stored chapter (0 if it couldn't be counted)
+float bibleStoreMinutes = 0;
+
+static bible_ctx *ctx = NULL;
+static bible_conn *conn = NULL;
+
+typedef struct
 {
-	// Get number of translations
-    int maxIndex = get_translations();
+    FILE *bibleStore;
+    bible_ref ref;
+    // Book and chapter of the verses being stored
+    bible_ref chapter;
+    int count;
+    // Parallel passages starting in the chapter (NULL if they haven't been found)
+    bible_parallels *parallels;
+    // Book and chapter shown before the next verse, when verses of several chapters are stored
+    char heading[48];
+} StoredChapter;
+
+bible_ctx *db_context(void)
+{
+	// Look for translations the first time they're needed
+    if (ctx == NULL)
+        ctx = bible_ctx_new("db");
 
-	// If translation index is valid
-    if (index >= 0 && index < maxIndex)
-    {
-		// If db hasn't been opened (or just closed)
-        if (db == NULL)
-        {
-			// Path to db
-            char path[20];
-            snprintf(path, 19, "db/%s.SQLite3", get_translation(index));
+    return ctx;
+}
 
-            if (sqlite3_open(path, &db) == SQLITE_OK)
-            {
-                initialized = true;
-                return true;
-            }
+#ifdef __linux__
+// Tells when files are added to (or removed from) the db folder (-1 if it couldn't be watched)
+static int dbWatch = -1;
+#endif
 
-			// If couldn't open db, still close it
-            else
-			{
-                sqlite3_close(db);
-			}
-        }
+bool update_translations(void)
+{
+    bible_ctx *ctx = db_context();
+    if (ctx == NULL)
+        return false;
 
-		// If db is already opened, close it and open a new one
-		// This is run when a new translation is needed
-        else
+#ifdef __linux__
+	// Watch the folder the first time (after that, it's only looked at when it changed)
+    if (dbWatch == -1)
+    {
+        dbWatch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (dbWatch >= 0
+            && inotify_add_watch(dbWatch, "db", IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM | IN_CLOSE_WRITE) == -1)
         {
-			close_db();
-
-			return open_bible_db(index);
+            close(dbWatch);
+            dbWatch = -1;
         }
+
+		// Otherwise the folder is looked at every time
+        if (dbWatch == -1)
+            dbWatch = -2;
+    }
+
+    if (dbWatch >= 0)
+    {
+        char events[4096];
+        bool changed = false;
+        while (read(dbWatch, events, sizeof(events)) > 0)
+            changed = true;
+
+        return changed && bible_ctx_refresh(ctx);
     }
+#endif
+
+    return bible_ctx_refresh(ctx);
+}
+
+void close_translation_watch(void)
+{
+#ifdef __linux__
+    if (dbWatch >= 0)
+        close(dbWatch);
+    dbWatch = -1;
+#endif
+}
+
+bool open_bible_db(size_t index)
+{
+	// If translation index is valid
+    if (index < bible_translation_count(db_context()))
+        return open_bible_db_by_name(bible_translation_name(db_context(), index));
 
     return false;
 }
 
+bool open_bible_db_by_name(const char *translation)
+{
+	// If db is already opened, close it and open a new one
+	// This is run when a new translation is needed
+    close_db();
+
+    conn = bible_conn_open(db_context(), translation);
+
+    return conn != NULL;
+}
+
+bible_conn *db_connection(void)
+{
+    return conn;
+}
+
 void close_db(void)
 {
-    if (db != NULL)
+    if (conn != NULL)
 	{
-		sqlite3_close(db);
-
-		db = NULL;
-		initialized = false;
+		bible_conn_close(conn);
+		conn = NULL;
 	}
 }
 
 static bool check_init(void)
 {
-    if (!initialized)
+    if (conn == NULL)
         fprintf(stderr, "db.c: error: Database not initialized\n");
 
-    return initialized;
+    return conn != NULL;
 }
 
-// Add a percent sign to [str] and save it to [newStr]
-static inline void appendPercent(char *newStr, const char *str)
+bible_ref find_book(const char *name)
 {
-    sprintf(newStr, "%s%%", str);
+    if (!check_init() || name == NULL)
+        return 0;
+
+    int book = bible_find_book(conn, name, NULL, 0);
+    return (book > 0) ? BIBLE_REF(book, 1, 1) : 0;
 }
 
-int get_max_chapter(const char *book)
+size_t suggest_books(const char *typed, bible_book_suggestion *suggestions, size_t max)
 {
-    int noOfChapters = 0;
     if (!check_init())
         return 0;
-    
-    sqlite3_stmt *sql;
-	// Run [maxChapter] sql code on [db] and save it into [sql]
-    int rc = sqlite3_prepare_v2(db, maxChapter, -1, &sql, NULL);
 
-    if (rc == SQLITE_OK)
-    {
-        char text[strlen(book) + 2];
-        appendPercent(text, book);
-		// Change question mark in sql statement to [text]
-        rc = sqlite3_bind_text(sql, 1, text, -1, SQLITE_STATIC);
+    return bible_suggest_books(conn, typed, suggestions, max);
+}
 
-        if (rc == SQLITE_OK)
-        {
-			// If a row is returned
-            if (sqlite3_step(sql) == SQLITE_ROW)
-				// Save first column of first row to variable
-                noOfChapters = sqlite3_column_int(sql, 0);
-        }
-    }
+bool get_book_name(bible_ref ref, char *name, size_t nameSize)
+{
+    if (!check_init())
+        return false;
 
-    sqlite3_finalize(sql);
+    return bible_book_name(conn, BIBLE_REF_BOOK(ref), name, nameSize);
+}
 
-    return noOfChapters;
+int get_max_chapter(bible_ref ref)
+{
+    if (!check_init())
+        return 0;
+
+    return bible_chapter_count(conn, ref);
 }
 
-int get_no_of_verses(const char *book, int chapter)
+int get_no_of_verses(bible_ref ref)
 {
-    int verses = 0;
     if (!check_init())
-        return 0;    
+        return 0;
+
+    return bible_verse_count(conn, ref);
+}
 
-    sqlite3_stmt *sql;
-	// Run [maxVerse] sql code on [db] and save it into [sql]
-    int rc = sqlite3_prepare_v2(db, maxVerse, -1, &sql, NULL);
-    if (rc == SQLITE_OK)
+bible_ref get_adjacent_chapter(bible_ref ref, int direction)
+{
+    if (!check_init())
+        return 0;
+
+    return bible_adjacent_chapter(conn, ref, direction);
+}
+
+bible_ref to_standard_numbering(bible_ref ref)
+{
+    return check_init() ? bible_to_standard(conn, ref) : ref;
+}
+
+bible_ref from_standard_numbering(bible_ref ref)
+{
+    return check_init() ? bible_from_standard(conn, ref) : ref;
+}
+
+static void store_verse(int verse, const char *text, const char *title, void *data)
+{
+    StoredChapter *stored = data;
+
+	// One verse per line
+    if (stored->count > 0)
+        fputc('\n', stored->bibleStore);
+
+    if (stored->heading[0] != '\0')
     {
-        char text[strlen(book) + 2];
-        appendPercent(text, book);
-		// Change question mark in sql statement to [text]
-        rc = sqlite3_bind_text(sql, 1, text, -1, SQLITE_STATIC);
+        fprintf(stored->bibleStore, "<b>%s</b>\n", stored->heading);
+        stored->heading[0] = '\0';
+    }
+
+	// Add title of current verse (if it has)
+    if (title != NULL)
+        fprintf(stored->bibleStore, "<b>%s</b>\n", title);
 
-        if (rc == SQLITE_OK)
+	// Verse ref (in the standard numbering, for bookmarks and highlights), number, a mark if it's part of
+	// a parallel passage, and text
+    bible_ref ref = BIBLE_REF(BIBLE_REF_BOOK(stored->chapter), BIBLE_REF_CHAPTER(stored->chapter), verse);
+    fprintf(stored->bibleStore, "<ref=%lu><v>[%i] </v>", (unsigned long) to_standard_numbering(ref), verse);
+    for (size_t i = 0; stored->parallels != NULL && i < stored->parallels->count; i++)
+        if (ref >= stored->parallels->parallels[i].first && ref <= stored->parallels->parallels[i].last)
         {
-			// Change second question mark in sql statement to [chapter]
-            rc = sqlite3_bind_int(sql, 2, chapter);
-            if (rc == SQLITE_OK)
-            {
-				// If a row is returned
-                if (sqlite3_step(sql) == SQLITE_ROW)
-					// Save first column of first row to variable
-                    verses = sqlite3_column_int(sql, 0);
-            }
+            fputs("<p>‖ </p>", stored->bibleStore);
+            break;
+        }
+    fputs(text, stored->bibleStore);
+    stored->count++;
+}
+
+// Open the chapter file for writing (making it the first time)
+static FILE *open_bible_store(void)
+{
+    if (bibleStorePath[0] == '\0')
+    {
+        const char *tmp = getenv("TMPDIR");
+        snprintf(bibleStorePath, sizeof(bibleStorePath), "%s/bible-XXXXXX", (tmp != NULL && tmp[0] != '\0'
+            && strlen(tmp) < sizeof(bibleStorePath) - 16) ? tmp : "/tmp");
+
+        int fd = mkstemp(bibleStorePath);
+        if (fd == -1)
+        {
+            bibleStorePath[0] = '\0';
+            return NULL;
         }
+        close(fd);
     }
 
-    sqlite3_finalize(sql);
+    return fopen(bibleStorePath, "w");
+}
 
-    return verses;
+void close_bible_store(void)
+{
+    if (bibleStorePath[0] != '\0')
+        remove(bibleStorePath);
+    bibleStorePath[0] = '\0';
 }
 
-static bool get_title(const char *book, int chapter, int verse, char *title)
+char *copy_bible_store(size_t *length, float *minutes)
 {
-	if (!check_init())
-		return false;
+    FILE *bibleStore = (bibleStorePath[0] != '\0') ? fopen(bibleStorePath, "r") : NULL;
+    if (bibleStore == NULL)
+        return NULL;
+
+    char *text = NULL;
+    size_t size = 0;
+    *length = 0;
+    for (size_t read = 1; read > 0; *length += read)
+    {
+        if (*length == size)
+        {
+            char *grown = realloc(text, (size = (size == 0) ? 8192 : size * 2));
+            if (grown == NULL)
+            {
+                free(text), fclose(bibleStore);
+                return NULL;
+            }
+            text = grown;
+        }
+        read = fread(&text[*length], 1, size - *length, bibleStore);
+    }
+    fclose(bibleStore);
 
-	bool hasTitle = false;
+    *minutes = bibleStoreMinutes;
+    return text;
+}
 
-	sqlite3_stmt *sql;
-	// Run [storyTableExists] sql code on [db] and save it into [sql]
-	int rc = sqlite3_prepare_v2(db, storyTableExists, -1, &sql, NULL);
-	if (rc == SQLITE_OK)
-	{
-		if (sqlite3_step(sql) == SQLITE_ROW)
-		{
-			// If the first column of the first row returns a value greater than zero,
-			// Then the table "stories" exists
-			if (sqlite3_column_int(sql, 0) > 0)
-			{
-				// Reset statement, so it can be reused
-				sqlite3_reset(sql);
-				rc = sqlite3_prepare_v2(db, getTitle, -1, &sql, NULL);
-				if (rc == SQLITE_OK)
-				{
-					// Change question mark in sql statement to [book]
-					rc = sqlite3_bind_text(sql, 1, book, -1, SQLITE_STATIC);
-					if (rc == SQLITE_OK)
-					{
-						// Change second question mark in sql statement to [chapter]
-						rc = sqlite3_bind_int(sql, 2, chapter);
-						if (rc == SQLITE_OK)
-						{
-							// Change third question mark in sql statement to [verse]
-							rc = sqlite3_bind_int(sql, 3, verse);
-							if (rc == SQLITE_OK && sqlite3_step(sql) == SQLITE_ROW)
-							{
-								// Clear [title]
-								memset(title, 0, strlen(title));
-								// Copy text returned to [title]
-								strncpy(title, (const char*) sqlite3_column_text(sql, 0), 100);
-
-								// If title is not an empty string, it has a title
-								hasTitle = strlen(title) > 0;
-							}
-						}
-					}
-				}
-			}
-		}
-		
-	}
+bool restore_bible_store(const char *text, size_t length, float minutes)
+{
+    FILE *bibleStore = open_bible_store();
+    if (bibleStore == NULL)
+        return false;
+    bibleStoreVersion++;
 
-	sqlite3_finalize(sql);
+    bool written = fwrite(text, 1, length, bibleStore) == length;
+    written &= fclose(bibleStore) == 0;
+    bibleStoreMinutes = minutes;
 
-	return hasTitle;
+    return written;
 }
 
-bool store_bible_text(const char *book, int chapter, int verse)
+bool store_bible_text(bible_ref ref)
 {
     if (!check_init())
         return false;
 
-	bool stored = false;
+    int chapter = BIBLE_REF_CHAPTER(ref);
+    if (BIBLE_REF_BOOK(ref) == 0)
+        return false;
 
-    sqlite3_stmt *sql;
-	// Run [getBible] sql code on [db] and save it into [sql]
-    int rc = sqlite3_prepare_v2(db, getBible, -1, &sql, NULL);
-    if (rc == SQLITE_OK)
+    FILE *bibleStore = open_bible_store();
+    if (bibleStore == NULL)
+        return false;
+    bibleStoreVersion++;
+
+    StoredChapter stored = { .bibleStore = bibleStore, .ref = ref, .chapter = ref, .count = 0 };
+    // Only if they were already found (e.g. with --parallels), which takes a while
+    stored.parallels = bible_get_parallels(conn, ref);
+
+	// Counts come from a table made once per translation
+    bible_stats stats;
+    bibleStoreMinutes = bible_stats_get(conn, ref, &stats) ? stats.minutes : 0;
+
+	// Use the daemon's warm cache when one is running (it takes the book's name)
+    char book[40];
+    if (!daemon_is_connected() || !bible_book_name(conn, BIBLE_REF_BOOK(ref), book, sizeof(book))
+        || !daemon_get_chapter(bible_conn_translation(conn), book, chapter, &store_verse, &stored))
     {
-		// Change question mark in sql statement to [text]
-		char text[strlen(book) + 2];
-        appendPercent(text, book);
-        rc = sqlite3_bind_text(sql, 1, text, -1, SQLITE_STATIC);
+        bible_passage *passage = bible_get_passage(conn, ref & ~(bible_ref) 0xFF, ref | BIBLE_REF_END);
+        for (size_t i = 0; passage != NULL && i < passage->count; i++)
+            store_verse(passage->verses[i].verse, passage->verses[i].text, passage->verses[i].title, &stored);
 
-        if (rc == SQLITE_OK)
-        {
-			// Change second question mark in sql statement to [chapter]
-            rc = sqlite3_bind_int(sql, 2, chapter);
-            if (rc == SQLITE_OK)
-            {
-                FILE *bibleStore = fopen(bibleStorePath, "w");
-                if (bibleStore != NULL)
-                {
-                    int verse = 1;
-					// If a row is returned
-                    if (sqlite3_step(sql) == SQLITE_ROW)
-                    {
-						// Save bible path to first line
-                        fprintf(bibleStore, "%s %i:%03i\n", book, chapter, verse);
-                        do
-                        {
-                            if (verse > 1)
-                            	fputc('\n', bibleStore);
-							
-							char title[100 + 1];
-							// Add title of current verse (if it has)
-							if (get_title(book, chapter, verse, title))
-								fprintf(bibleStore, "<b>%s</b>\n", title);
-
-							// Verse number
-							fprintf(bibleStore, "<v>[%i] </v>", verse++);
-							// Verse text
-							fprintf(bibleStore, "%s", (const char*) sqlite3_column_text(sql, 0));
-                        } while (sqlite3_step(sql) == SQLITE_ROW);
-                    }
-
-                    fclose(bibleStore);
-                    
-                    if (verse > 1)
-                        stored = true;
-                }
-            }
-        }        
+        bible_passage_free(passage);
     }
 
-    sqlite3_finalize(sql);
+    fclose(bibleStore);
+    bible_parallels_free(stored.parallels);
+
+	// Where to start next time
+    if (stored.count > 0)
+        keep_stored_verse(ref);
 
-    return stored;
+    return stored.count > 0;
 }
 
-bool get_book(char *currBook, int option)
+bible_ref store_bible_ranges(const bible_range *ranges, size_t count)
 {
-	bool gotten = false;
+    if (!check_init())
+        return 0;
+
+	// All the verses are read at once, rather than a chapter at a time
+    bible_selection *selection = bible_get_ranges(conn, ranges, count);
+    if (selection == NULL)
+        return 0;
+
+    FILE *bibleStore = open_bible_store();
+    if (bibleStore == NULL)
+    {
+        bible_selection_free(selection);
+        return 0;
+    }
+    bibleStoreVersion++;
+	// Reading times are only counted for whole chapters
+    bibleStoreMinutes = 0;
 
-    if (check_init() && currBook != NULL)
+    StoredChapter stored = { .bibleStore = bibleStore, .ref = selection->refs[0], .count = 0, .parallels = NULL };
+    for (size_t i = 0; i < selection->count; i++)
     {
-        sqlite3_stmt *sql;
-		// Select sql query depending on option
-		// [option] = 0 -> [getBook]
-		// [option] < 0 -> [prevBook]
-		// [option] > 1 -> [nextBook]
-        const char *query = (option < 0)
-                            ? prevBook
-                            : (option > 0)
-                                ? nextBook
-                                : getBook;
-
-		// Run [query] sql code on [db] and save it into [sql]
-        int rc = sqlite3_prepare_v2(db, query, -1, &sql, NULL);
-        if (rc == SQLITE_OK)
+        bible_ref ref = selection->refs[i];
+        stored.chapter = ref;
+
+		// Heading (and parallel passages) of each chapter
+        if (i == 0 || BIBLE_REF_CHAPTER(ref) != BIBLE_REF_CHAPTER(selection->refs[i - 1])
+            || BIBLE_REF_BOOK(ref) != BIBLE_REF_BOOK(selection->refs[i - 1]))
         {
-            char text[strlen(currBook) + 2];
-            appendPercent(text, currBook);
+            char book[40];
+            if (!bible_book_name(conn, BIBLE_REF_BOOK(ref), book, sizeof(book)))
+                snprintf(book, sizeof(book), "%s", bible_book_title(BIBLE_REF_BOOK(ref)));
+            snprintf(stored.heading, sizeof(stored.heading), "%s %i", book, BIBLE_REF_CHAPTER(ref));
 
-			// Change question mark in sql statement to [text]
-            rc = sqlite3_bind_text(sql, 1, text, -1, SQLITE_STATIC);
-            if (rc == SQLITE_OK)
-            {
-				// If a row is returned
-                if (sqlite3_step(sql) == SQLITE_ROW)
-                {
-					// Save returned string to [currBook]
-                    strcpy(currBook, (const char*) sqlite3_column_text(sql, 0));
-                    gotten = true;
-
-	 				int n = strlen(currBook);
-					// If books ends with whitespace
-					if (isspace(currBook[n - 2]))
-					{
-						// Remove it
-						currBook[n - 2] = '\0';
-					}
-                }
-            }
+            bible_parallels_free(stored.parallels);
+            stored.parallels = bible_get_parallels(conn, ref);
         }
-        
-        sqlite3_finalize(sql);
+
+        store_verse(selection->verses[i].verse, selection->verses[i].text, selection->verses[i].title, &stored);
     }
 
-    return gotten;
+    fclose(bibleStore);
+    bible_parallels_free(stored.parallels);
+    bible_selection_free(selection);
+
+    if (stored.count > 0)
+        keep_stored_verse(stored.ref);
+
+    return stored.ref;
 }
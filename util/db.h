@@ -2,14 +2,46 @@
 #include <string.h>
 #include <strings.h>
 #include <stdbool.h>
-#define SQLITE_OMIT_DEPRECATED
-#include "../lib/sqlite/sqlite3.h"
+#include "../libbible/bible.h"
 
-extern const char bibleStorePath[];
+// Text of the chapter being read, for the display (a temporary file of this process)
+extern char bibleStorePath[];
 
+// The app's translations (in the db folder)
+bible_ctx *db_context(void);
+// Pick up translations added to or removed from the db folder (watched with inotify on Linux)
+// Returns true if there were any
+bool update_translations(void);
+void close_translation_watch(void);
 bool open_bible_db(size_t index);
+// Remove the file the chapters are stored in
+void close_bible_store(void);
+// Open a translation by name (e.g. "KJV")
+bool open_bible_db_by_name(const char *translation);
+// The open translation (NULL if none)
+bible_conn *db_connection(void);
 void close_db(void);
-int get_max_chapter(const char *book);
-int get_no_of_verses(const char *book, int chapter);
-bool store_bible_text(const char *book, int chapter, int verse);
-bool get_book(char *currBook, int option);
+
+// Books, chapters and verses are bible_refs (see libbible/bible.h): a book's name is only looked up once
+// The first verse of the book named (or abbreviated) [name] e.g. "Jn" (0 if there's no such book)
+bible_ref find_book(const char *name);
+// Books starting with [typed], best first (see bible_suggest_books()). Returns how many were put in [suggestions]
+size_t suggest_books(const char *typed, bible_book_suggestion *suggestions, size_t max);
+// The translation's name for the book of [ref]
+bool get_book_name(bible_ref ref, char *name, size_t nameSize);
+int get_max_chapter(bible_ref ref);
+int get_no_of_verses(bible_ref ref);
+// The chapter after ([direction] > 0) or before the one of [ref], in the next or previous book at the ends
+bible_ref get_adjacent_chapter(bible_ref ref, int direction);
+// [ref] of the open translation in the standard (KJV) verse numbering, and the other way round
+bible_ref to_standard_numbering(bible_ref ref);
+bible_ref from_standard_numbering(bible_ref ref);
+// Write the chapter of [ref] to the bible store (the verse of [ref] is kept with it, see save_stored_verse())
+bool store_bible_text(bible_ref ref);
+// Write the verses of [count] [ranges] (e.g. "Rom 3:23; 6:23; 5:8") to the bible store as one passage
+// Returns the first of them (0 if none of them exist)
+bible_ref store_bible_ranges(const bible_range *ranges, size_t count);
+// Copy of the bible store and its reading time (to show it again later without the db), NULL if there's none
+char *copy_bible_store(size_t *length, float *minutes);
+// Write a copy of the bible store back, as if its chapter had just been stored
+bool restore_bible_store(const char *text, size_t length, float minutes);
@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "json.h"
+
+static const char *skip_space(const char *str)
+{
+    while (isspace((unsigned char) *str)) str++;
+    return str;
+}
+
+// Return the character after the string starting at [str] (which points at the opening quote)
+static const char *skip_string(const char *str)
+{
+    for (str++; *str != '\0' && *str != '"'; str++)
+    {
+        if (*str == '\\' && str[1] != '\0')
+            str++;
+    }
+
+    return (*str == '"') ? str + 1 : str;
+}
+
+// Return the character after the value starting at [str]
+static const char *skip_value(const char *str)
+{
+    str = skip_space(str);
+
+    if (*str == '"')
+        return skip_string(str);
+
+    // Objects and arrays
+    if (*str == '{' || *str == '[')
+    {
+        int depth = 0;
+        while (*str != '\0')
+        {
+            if (*str == '"')
+            {
+                str = skip_string(str);
+                continue;
+            }
+
+            if (*str == '{' || *str == '[')
+                depth++;
+            else if (*str == '}' || *str == ']')
+                depth--;
+
+            str++;
+            if (depth == 0)
+                break;
+        }
+
+        return str;
+    }
+
+    // Numbers, true, false and null
+    while (*str != '\0' && *str != ',' && *str != '}' && *str != ']' && !isspace((unsigned char) *str))
+        str++;
+
+    return str;
+}
+
+// Find the value of the top-level [key] in [json]
+static const char *find_value(const char *json, const char *key)
+{
+    const char *str = skip_space(json);
+    if (*str != '{')
+        return NULL;
+
+    size_t keyLen = strlen(key);
+    str++;
+
+    while (true)
+    {
+        str = skip_space(str);
+        if (*str != '"')
+            return NULL;
+
+        const char *name = str + 1;
+        const char *nameEnd = skip_string(str);
+
+        str = skip_space(nameEnd);
+        if (*str != ':')
+            return NULL;
+        str = skip_space(str + 1);
+
+        // Name without its quotes
+        if ((size_t) (nameEnd - 1 - name) == keyLen && strncmp(name, key, keyLen) == 0)
+            return str;
+
+        str = skip_space(skip_value(str));
+        if (*str != ',')
+            return NULL;
+        str++;
+    }
+}
+
+// Read the 4 hex digits of a \u escape at [str], or return -1
+static long hex4(const char *str)
+{
+    long code = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (!isxdigit((unsigned char) str[i]))
+            return -1;
+        code = code * 16 + (isdigit((unsigned char) str[i]) ? str[i] - '0' : tolower((unsigned char) str[i]) - 'a' + 10);
+    }
+
+    return code;
+}
+
+// Write [code] as UTF-8 into [bytes], returning how many bytes it takes
+static size_t utf8_encode(long code, char *bytes)
+{
+    if (code < 0x80)
+    {
+        bytes[0] = code;
+        return 1;
+    }
+    if (code < 0x800)
+    {
+        bytes[0] = 0xC0 | (code >> 6);
+        bytes[1] = 0x80 | (code & 0x3F);
+        return 2;
+    }
+    if (code < 0x10000)
+    {
+        bytes[0] = 0xE0 | (code >> 12);
+        bytes[1] = 0x80 | ((code >> 6) & 0x3F);
+        bytes[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+
+    bytes[0] = 0xF0 | (code >> 18);
+    bytes[1] = 0x80 | ((code >> 12) & 0x3F);
+    bytes[2] = 0x80 | ((code >> 6) & 0x3F);
+    bytes[3] = 0x80 | (code & 0x3F);
+    return 4;
+}
+
+bool json_get_string(const char *json, const char *key, char *out, size_t outSize)
+{
+    const char *value = find_value(json, key);
+    if (value == NULL || *value != '"' || outSize == 0)
+        return false;
+
+    size_t len = 0;
+    for (const char *str = value + 1; *str != '\0' && *str != '"'; str++)
+    {
+        char bytes[4] = { *str };
+        size_t byteCount = 1;
+        if (*str == '\\' && str[1] != '\0')
+        {
+            char c = *++str;
+            bytes[0] = (c == 'n') ? '\n' : (c == 't') ? '\t' : (c == 'r') ? '\r'
+                : (c == 'b') ? '\b' : (c == 'f') ? '\f' : c;
+
+            // Code points as UTF-8, the ones past U+FFFF from a pair of surrogates (lone ones become U+FFFD)
+            long code;
+            if (c == 'u' && (code = hex4(str + 1)) >= 0)
+            {
+                str += 4;
+                if (code >= 0xD800 && code < 0xDC00)
+                {
+                    long low = (str[1] == '\\' && str[2] == 'u') ? hex4(str + 3) : -1;
+                    if (low >= 0xDC00 && low < 0xE000)
+                    {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        str += 6;
+                    }
+                    else
+                        code = 0xFFFD;
+                }
+                else if (code >= 0xDC00 && code < 0xE000)
+                    code = 0xFFFD;
+
+                byteCount = utf8_encode(code, bytes);
+            }
+        }
+
+        // Whole characters only
+        if (len + byteCount >= outSize)
+            break;
+        memcpy(&out[len], bytes, byteCount);
+        len += byteCount;
+    }
+
+    out[len] = '\0';
+
+    return true;
+}
+
+bool json_get_bool(const char *json, const char *key)
+{
+    const char *value = find_value(json, key);
+    if (value == NULL)
+        return false;
+
+    return strncmp(value, "true", 4) == 0 || strtod(value, NULL) != 0;
+}
+
+const char *json_find(const char *json, const char *key)
+{
+    return find_value(json, key);
+}
+
+const char *json_array_next(const char *str)
+{
+    str = skip_space(str);
+
+    // First element
+    if (*str == '[')
+    {
+        str = skip_space(str + 1);
+        return (*str == ']' || *str == '\0') ? NULL : str;
+    }
+
+    str = skip_space(skip_value(str));
+    if (*str != ',')
+        return NULL;
+
+    return skip_space(str + 1);
+}
+
+bool json_get_number(const char *json, const char *key, double *number)
+{
+    const char *value = find_value(json, key);
+    if (value == NULL)
+        return false;
+
+    char *end;
+    *number = strtod(value, &end);
+
+    return end != value;
+}
+
+bool json_get_raw(const char *json, const char *key, char *out, size_t outSize)
+{
+    const char *value = find_value(json, key);
+    if (value == NULL || outSize == 0)
+        return false;
+
+    size_t len = skip_value(value) - value;
+    if (len == 0 || len >= outSize)
+        return false;
+
+    strncpy(out, value, len);
+    out[len] = '\0';
+
+    return true;
+}
+
+void json_write_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+
+    for (; *str != '\0'; str++)
+    {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c == '\n')
+            fputs("\\n", out);
+        else if (c == '\t')
+            fputs("\\t", out);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        // UTF-8 is written as is
+        else
+            fputc(c, out);
+    }
+
+    fputc('"', out);
+}
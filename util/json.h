@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Just enough JSON for one-line requests like {"id": 1, "method": "lookup", "ref": "John 3:16"}
+// Only top-level keys of an object are looked at
+
+// Copy the string value of [key] in [json] to [out], unescaped (\u escapes as UTF-8), and cut at a whole
+// character if it doesn't fit (false if missing or not a string)
+bool json_get_string(const char *json, const char *key, char *out, size_t outSize);
+// Get the number value of [key] in [json] (false if missing or not a number)
+bool json_get_number(const char *json, const char *key, double *number);
+// True if [key] is true (or a non-zero number)
+bool json_get_bool(const char *json, const char *key);
+// Find the value of [key] e.g. an object or array, to look inside it
+const char *json_find(const char *json, const char *key);
+// Go through an array: pass the array to get its first element, then the element to get the next one (NULL at the end)
+const char *json_array_next(const char *arrayOrElement);
+// Copy the raw value of [key] (e.g. 12 or "abc") to [out], so it can be echoed back
+bool json_get_raw(const char *json, const char *key, char *out, size_t outSize);
+// Write [str] to [out] as a quoted, escaped JSON string
+void json_write_string(FILE *out, const char *str);
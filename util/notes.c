@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include "notes.h"
+#include "db.h"
+
+static const char notesPath[] = ".bibleNotes";
+static bible_notes *notes = NULL;
+static bool notesOpened = false;
+
+// Open the database the first time it's needed (making it if there's none)
+static bible_notes *get_notes(void)
+{
+    if (!notesOpened)
+    {
+        notesOpened = true;
+        notes = bible_notes_open(notesPath);
+    }
+
+    return notes;
+}
+
+bible_annotations *get_annotations(bible_ref first, bible_ref last)
+{
+    return bible_annotations_get(get_notes(), bible_conn_translation(db_connection()), first, last);
+}
+
+bool toggle_bookmark(bible_ref ref)
+{
+    return bible_bookmark_toggle(get_notes(), ref);
+}
+
+bool toggle_highlight(bible_ref ref, int firstWord, int lastWord)
+{
+    if (firstWord < 0 || lastWord > UINT16_MAX)
+        return false;
+
+    return bible_highlight_toggle(get_notes(), bible_conn_translation(db_connection()), ref, firstWord, lastWord);
+}
+
+void close_notes(void)
+{
+    bible_notes_close(notes);
+    notes = NULL, notesOpened = false;
+}
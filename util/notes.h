@@ -0,0 +1,14 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "../libbible/bible.h"
+
+// Bookmarks and highlights of the user (see bible_notes in libbible/bible.h), kept in .bibleNotes
+
+// Annotations of verses [first]..[last] (standard numbering), with the highlights of the open translation
+// Returns NULL if there's no database
+bible_annotations *get_annotations(bible_ref first, bible_ref last);
+// Bookmark [ref] (standard numbering), or remove its bookmark. Returns whether it's bookmarked now
+bool toggle_bookmark(bible_ref ref);
+// Highlight words [firstWord]..[lastWord] of [ref] (standard numbering), or clear them if they all are
+bool toggle_highlight(bible_ref ref, int firstWord, int lastWord);
+void close_notes(void);
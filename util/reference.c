@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "reference.h"
+
+// Books the table doesn't know (e.g. names in other languages): the last word is the chapter and verses
+static bool parse_loose_reference(const char *ref, char *book, size_t bookSize, int *chapter, int *verseStart, int *verseEnd)
+{
+    if (ref == NULL || book == NULL || bookSize == 0)
+        return false;
+
+    // Skip leading whitespace
+    while (isspace((unsigned char) *ref)) ref++;
+
+    size_t len = strlen(ref);
+    // Ignore trailing whitespace (and the new line from getline)
+    while (len > 0 && isspace((unsigned char) ref[len - 1])) len--;
+
+    if (len == 0)
+        return false;
+
+    // Last word, e.g. "3:16-18" in "1 John 3:16-18"
+    size_t lastWord = len;
+    while (lastWord > 0 && !isspace((unsigned char) ref[lastWord - 1])) lastWord--;
+
+    size_t bookLen = len;
+    *chapter = 1, *verseStart = 1, *verseEnd = 0;
+
+    // If the last word is a number and not the only word (so "1 John" stays a book)
+    if (lastWord > 0 && isdigit((unsigned char) ref[lastWord]))
+    {
+        int start = 0, end = 0;
+        // (chapter):(verse)-(verse)
+        int matched = sscanf(&ref[lastWord], "%d%*[:.]%d-%d", chapter, &start, &end);
+
+        if (*chapter <= 0)
+            return false;
+
+        if (matched >= 2)
+        {
+            *verseStart = start;
+            // A single verse is a range of one
+            *verseEnd = (matched == 3) ? end : start;
+
+            if (*verseStart <= 0 || *verseEnd < *verseStart)
+                return false;
+        }
+
+        bookLen = lastWord;
+        // Remove the space between the book and the chapter
+        while (bookLen > 0 && isspace((unsigned char) ref[bookLen - 1])) bookLen--;
+    }
+
+    if (bookLen == 0 || bookLen >= bookSize)
+        return false;
+
+    strncpy(book, ref, bookLen);
+    book[bookLen] = '\0';
+
+    return true;
+}
+
+int parse_references(bible_conn *conn, const char *text, bible_range *ranges, size_t maxRanges)
+{
+    if (text == NULL || ranges == NULL || maxRanges == 0)
+        return -1;
+
+    int count = bible_parse_references(text, ranges, maxRanges);
+    if (count >= 1)
+        return count;
+
+	// A book named in the translation's language, e.g. "Génesis 1:1"
+    char book[40];
+    int chapter, verseStart, verseEnd;
+    if (conn == NULL || !parse_loose_reference(text, book, sizeof(book), &chapter, &verseStart, &verseEnd))
+        return -1;
+
+    int index = bible_find_book(conn, book, NULL, 0);
+    if (index <= 0 || chapter >= BIBLE_REF_END || verseEnd >= BIBLE_REF_END)
+        return -1;
+
+    ranges[0].first = BIBLE_REF(index, chapter, verseStart);
+    ranges[0].last = BIBLE_REF(index, chapter, (verseEnd > 0) ? verseEnd : BIBLE_REF_END);
+
+    return 1;
+}
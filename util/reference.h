@@ -0,0 +1,9 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "../libbible/bible.h"
+
+// Read a Bible path like "1 John 3:16-18", "1Jn 3:16-18" or a list like "Rom 3:23; 6:23" into [ranges], as
+// bible_parse_references() does. A single reference can also name its book the way [conn]'s translation does
+// (e.g. "Génesis 1:1"). Returns how many ranges there are (more than [maxRanges] if they don't all fit), or -1
+// if [text] isn't a reference
+int parse_references(bible_conn *conn, const char *text, bible_range *ranges, size_t maxRanges);
@@ -1,126 +1,172 @@
-// Allows getline to work on MacOS
+// Allows pread to work on MacOS
 #define  _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
-#include <ctype.h>
-#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "store.h"
+#include "db.h"
 
-extern const char bibleStorePath[];
+// Where the reader is, so the next start opens there
+//
+// It's one small record, replaced whole (see replace_file()): written to a temporary file that's synced to disk,
+// then renamed over the old one, so a crash, a power cut or another instance saving at the same time leaves
+// either the old record or the new one, never half of each. It's read back with one pread(), and a record that doesn't add up is ignored
 
-char** translations = NULL;
-size_t noOfTranslations = 0;
+static const char statePath[] = ".bibleState";
+#define STATE_MAGIC "BST2"
 
-// Return line containing the bible path (first line)
-static char *get_bible_path()
+typedef struct
 {
-    FILE *store = fopen(bibleStorePath, "r");
-    if (store != NULL)
+    char magic[4];
+    // The verse, in the standard (KJV) numbering (the app may start with another translation)
+    bible_ref ref;
+    char translation[64];
+    // FNV-1a of everything above
+    uint32_t checksum;
+} StoredState;
+
+// Read once, at the first question
+static StoredState state;
+static bool stateRead = false, stateValid = false;
+// Where the reader is now, written by save_stored_verse() (not on every chapter, as each write waits for the disk)
+static StoredState kept;
+static bool keptValid = false;
+
+static uint32_t state_checksum(const StoredState *stored)
+{
+    uint32_t hash = 2166136261u;
+    const unsigned char *bytes = (const unsigned char*) stored;
+    for (size_t i = 0; i < offsetof(StoredState, checksum); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    return hash;
+}
+
+static void read_state(void)
+{
+    if (stateRead)
+        return;
+    stateRead = true;
+
+    int fd = open(statePath, O_RDONLY);
+    if (fd == -1)
+        return;
+
+    stateValid = pread(fd, &state, sizeof(state), 0) == sizeof(state)
+        && memcmp(state.magic, STATE_MAGIC, sizeof(state.magic)) == 0
+        && state.checksum == state_checksum(&state);
+    state.translation[sizeof(state.translation) - 1] = '\0';
+    close(fd);
+}
+
+// The first line of the chapter file of older versions, e.g. "0001010d" or "1 Corinthians 13:004"
+static bible_ref get_legacy_ref(void)
+{
+    FILE *store = fopen(".bibleStore", "r");
+    if (store == NULL)
+        return 0;
+
+    char line[64];
+    bible_ref ref = 0;
+    if (fgets(line, sizeof(line), store) != NULL)
     {
-        char *line = malloc(1);
-        size_t lineSize = 1;
+        char *end;
+        ref = strtoul(line, &end, 16);
 
-        if (getline(&line, &lineSize, store) != EOF)
-            return line;
+        bible_range range;
+        if (end == line || (*end != '\n' && *end != '\0'))
+            ref = (bible_parse_references(line, &range, 1) == 1) ? range.first : 0;
     }
+    fclose(store);
+
+    return ref;
+}
+
+bible_ref get_stored_ref(void)
+{
+    read_state();
+    bible_ref ref = stateValid ? state.ref : get_legacy_ref();
+
+	// It's kept in the standard numbering, as the app may start with another translation
+    ref = from_standard_numbering(ref);
 
-    return NULL;
+	// If there's no previously stored verse (or it isn't one), use default
+    int chapter = BIBLE_REF_CHAPTER(ref), verse = BIBLE_REF_VERSE(ref);
+    if (chapter == 0 || chapter > get_max_chapter(ref) || verse == 0 || verse > get_no_of_verses(ref))
+        ref = BIBLE_REF(1, 1, 1);
+
+    return ref;
+}
+
+const char *get_stored_translation(void)
+{
+    read_state();
+    return stateValid ? state.translation : "";
 }
 
-void get_stored_path(char *book, int *chapter, int *verse)
+bool replace_file(const char *path, const void *data, size_t length)
 {
-    char *biblePath = get_bible_path();
-    if (biblePath != NULL)
+	// Each instance writes its own temporary file
+    char tempPath[strlen(path) + 32];
+    snprintf(tempPath, sizeof(tempPath), "%s.%ld.tmp", path, (long) getpid());
+
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return false;
+
+	// On disk before it's renamed, or a power cut could leave the new name on an empty file
+    bool written = write(fd, data, length) == (ssize_t) length && fsync(fd) == 0;
+    written = (close(fd) == 0) && written && rename(tempPath, path) == 0;
+    if (!written)
     {
-		// If book contains number e.g., 1 Corinthians
-        if (isdigit(biblePath[0]))
-        {
-            int bookNo = 1;
-            char bookName[18] = "";
-
-			// (book number e.g. 1) (book name e.g. Corinthians) (chapter):(verse)
-            sscanf(biblePath, "%1d %17s %d%*c%d", &bookNo, bookName, chapter, verse);
-
-			// Combine [bookNo] and [bookName] to give the book
-            sprintf(book, "%d %s", bookNo, bookName);
-        }
-
-        else
-		{
-			// (book e.g. John) (chapter):(verse)
-            sscanf(biblePath, "%19s %d%*c%d", book, chapter, verse);
-		}
-
-        free(biblePath);
+        remove(tempPath);
+        return false;
     }
 
-	// If there's no previously stored path, use default
-    else
+	// And the rename itself (the files are in the working folder)
+    int folder = open(".", O_RDONLY);
+    if (folder != -1)
     {
-        strcpy(book, "Genesis");
-        *chapter = 1, *verse = 1;
+        fsync(folder);
+        close(folder);
     }
+
+    return true;
 }
 
-int get_translations(void)
+void keep_stored_verse(bible_ref ref)
+{
+    kept = (StoredState) { .magic = STATE_MAGIC, .ref = to_standard_numbering(ref) };
+    snprintf(kept.translation, sizeof(kept.translation), "%s", bible_conn_translation(db_connection()));
+    kept.checksum = state_checksum(&kept);
+    keptValid = true;
+}
+
+void save_stored_verse(void)
 {
-	// If function was already called
-    if (noOfTranslations > 0)
-        return noOfTranslations;
+	// Nothing to do if it's already saved (e.g. only chapters were turned, and back)
+    read_state();
+    if (!keptValid || (stateValid && memcmp(&kept, &state, sizeof(kept)) == 0))
+        return;
 
-    struct dirent *file;
-    DIR *dir = opendir("db");
+    if (!replace_file(statePath, &kept, sizeof(kept)))
+        return;
 
-    if (dir != NULL)
-    {
-		size_t translationCount = 0;
-
-		// While there are files in db folder
-        while ((file = readdir(dir)))
-        {
-            // If file name has the extension ".SQLITE3"
-            if (strstr(file->d_name, ".SQLite3"))
-            {
-				translationCount++;
-
-				// Memory allocation for an expanding list
-                if (translationCount == 1)
-				{
-                    translations = (char**) calloc(1, sizeof(char*));
-				}
-
-                else
-				{
-                    translations = (char**) realloc(translations, sizeof(char*) * translationCount);
-				}
-                
-				// Length of bible translation
-				// Find the distance from the period to the first letter
-				// e.g. KJV.SQLITE3: the first letter is 3 units away from the period
-                int strLength = strchr(file->d_name, '.') - file->d_name;
-
-                translations[translationCount - 1] = calloc(strLength + 1, sizeof(char));
-				// Store the name of current translation
-                strncpy(translations[translationCount - 1], file->d_name, strLength);
-            }
-        }
-
-        closedir(dir);
-
-		noOfTranslations = translationCount;
-        return noOfTranslations;
-    }
+    state = kept;
+    stateValid = true;
+}
 
-    return 0;
+int get_translations(void)
+{
+    return bible_translation_count(db_context());
 }
 
 const char *get_translation(size_t index)
 {
-    if (translations != NULL
-        && index >= 0 && index < noOfTranslations)
-        return translations[index];
-    
-    return "";
+    return bible_translation_name(db_context(), index);
 }
@@ -1,5 +1,17 @@
-// Get the previous book, chapter and verse stored in file
-void get_stored_path(char *book, int *chapter, int *verse);
+#include "../libbible/bible.h"
+
+// Get the previous verse stored in file (Genesis 1:1 if there isn't one)
+bible_ref get_stored_ref(void);
+// Translation the stored verse was read in ("" if there isn't one)
+const char *get_stored_translation(void);
+// Keep [ref] of the open translation as the verse to start from next time (e.g. the chapter turned to), to be
+// saved by save_stored_verse()
+void keep_stored_verse(bible_ref ref);
+// Save the verse kept, if it changed (when a verse is picked, the translation changes and at exit)
+void save_stored_verse(void);
+// Replace the file at [path] (in the working folder) with [length] bytes of [data], whole: written to a
+// temporary file, synced to disk, then renamed over it. Returns false (leaving the old file) if it can't be
+bool replace_file(const char *path, const void *data, size_t length);
 // Get all translations in db folder (and return the count)
 int get_translations(void);
 // Get name of [index]th translation
@@ -0,0 +1,109 @@
+#include <string.h>
+#include <strings.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "text.h"
+
+// ANSI escape codes
+static const char ansiRed[] = "\033[31m", ansiDefault[] = "\033[39m";
+static const char ansiBold[] = "\033[1m", ansiNormal[] = "\033[22m";
+
+static inline bool tag_equal(const char *tag, size_t len, const char *name)
+{
+    return (strlen(name) == len && strncmp(tag, name, len) == 0);
+}
+
+void print_verse_text(FILE *out, const char *text, bool colour)
+{
+    const char *str = text;
+    while (*str != '\0')
+    {
+        if (*str != '<')
+        {
+            // Print everything up to the next tag in one go
+            size_t len = strcspn(str, "<");
+            fwrite(str, 1, len, out);
+            str += len;
+            continue;
+        }
+
+        const char *tagEnd = strchr(str, '>');
+        // Unclosed tag, print it as is
+        if (tagEnd == NULL)
+        {
+            fputs(str, out);
+            break;
+        }
+
+        size_t tagLen = tagEnd - str + 1;
+
+        // Footnotes and notes are not part of the text
+        if (tag_equal(str, tagLen, "<f>") || tag_equal(str, tagLen, "<n>"))
+        {
+            const char *closing = strstr(tagEnd, (str[1] == 'f') ? "</f>" : "</n>");
+            str = (closing != NULL) ? closing + 4 : tagEnd + 1;
+            continue;
+        }
+
+        if (colour)
+        {
+            if (tag_equal(str, tagLen, "<J>"))
+                fputs(ansiRed, out);
+            else if (tag_equal(str, tagLen, "</J>"))
+                fputs(ansiDefault, out);
+            else if (tag_equal(str, tagLen, "<b>") || tag_equal(str, tagLen, "<e>"))
+                fputs(ansiBold, out);
+            else if (tag_equal(str, tagLen, "</b>") || tag_equal(str, tagLen, "</e>"))
+                fputs(ansiNormal, out);
+        }
+
+        // Line breaks become spaces
+        if (tag_equal(str, tagLen, "<br/>") || tag_equal(str, tagLen, "<pb/>"))
+            fputc(' ', out);
+
+        str = tagEnd + 1;
+    }
+
+    // Don't let colours leak into the next line
+    if (colour)
+        fprintf(out, "%s%s", ansiDefault, ansiNormal);
+}
+
+const char *find_nocase(const char *text, size_t length, const char *needle, size_t needleLength)
+{
+    if (needleLength == 0 || needleLength > length)
+        return NULL;
+
+    unsigned char lower = needle[0];
+    unsigned char upper = (lower >= 'a' && lower <= 'z') ? lower - 'a' + 'A' : lower;
+	// Last place the needle can start
+    size_t last = length - needleLength;
+    size_t i = 0;
+
+#ifdef __SSE2__
+	// Compare the first character against 16 places at a time, then check the rest where it matched
+    const __m128i lowerFirst = _mm_set1_epi8((char) lower), upperFirst = _mm_set1_epi8((char) upper);
+    for (; i + 16 <= last + 1; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *) &text[i]);
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, lowerFirst), _mm_cmpeq_epi8(block, upperFirst)));
+        while (mask != 0)
+        {
+            size_t at = i + __builtin_ctz(mask);
+            if (strncasecmp(&text[at + 1], &needle[1], needleLength - 1) == 0)
+                return &text[at];
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i <= last; i++)
+    {
+        unsigned char c = text[i];
+        if ((c == lower || c == upper) && strncasecmp(&text[i + 1], &needle[1], needleLength - 1) == 0)
+            return &text[i];
+    }
+
+    return NULL;
+}
@@ -0,0 +1,11 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Write verse [text] to [out] without its tags
+// If [colour] is true, the words of Jesus (<J>) are red and emphasis (<e>, <b>) is bold
+void print_verse_text(FILE *out, const char *text, bool colour);
+
+// Find [needle] (already lowercase) in [length] bytes of [text], ignoring ASCII case
+// Returns NULL if it isn't there
+const char *find_nocase(const char *text, size_t length, const char *needle, size_t needleLength);